@@ -0,0 +1,392 @@
+#include "Bitboard.h"
+#ifdef CHESS_DISPATCH
+#include <immintrin.h>
+#endif
+
+// Ray directions: the first four increase the square index, the last four are their opposites
+enum RayDirection { NORTH, EAST, NORTH_EAST, NORTH_WEST, SOUTH, WEST, SOUTH_WEST, SOUTH_EAST };
+
+static const int ray_steps[8][2] = { {1, 0}, {0, 1}, {1, 1}, {1, -1}, {-1, 0}, {0, -1}, {-1, -1}, {-1, 1} };
+
+static const int knight_steps[8][2] = { {-2, -1}, {-1, -2}, {1, -2}, {2, -1}, {2, 1}, {1, 2}, {-1, 2}, {-2, 1} };
+
+static bool is_within(int row, int col) { return row >= 0 && col >= 0 && row < 8 && col < 8; }
+
+const BitboardTables bitboard_tables;
+
+// Magic multipliers of the squares, found by trying sparse random numbers (the and of three) until every subset
+// of the square's mask lands on an index where no subset with different attacks does
+static const Bitboard bishop_magics[64] = {
+    0x00100200A1020208ULL, 0x0808014102020800ULL, 0x8410208881004100ULL, 0x0084440280802000ULL,
+    0x4001104052020000ULL, 0x0002011008718100ULL, 0x0411108230408102ULL, 0x000202004108A803ULL,
+    0x0800080210140112ULL, 0x0010212202084100ULL, 0x03081104108E0402ULL, 0x0000280600480042ULL,
+    0x2802040420400110ULL, 0x2100011008044000ULL, 0x000801110160202EULL, 0x14400200A4040200ULL,
+    0x0060000822240840ULL, 0x08A1440401220200ULL, 0x4082081000204500ULL, 0x0020200202004008ULL,
+    0x0292222400A00100ULL, 0x0835000090082108ULL, 0x0004008890841000ULL, 0x000080444400A840ULL,
+    0x3010082104881001ULL, 0x401820001816C084ULL, 0x4004100241010320ULL, 0x800C0800002200C0ULL,
+    0x0001010004104000ULL, 0x0000450000900808ULL, 0x000400400C0602C3ULL, 0x800840800300A800ULL,
+    0x8108250408400820ULL, 0x2308084403020400ULL, 0x1080260100080800ULL, 0x2000200801210104ULL,
+    0x8140004100201100ULL, 0x4020009880040A01ULL, 0x2282084104004C00ULL, 0x1011040103039040ULL,
+    0x0001047004004000ULL, 0x00084C4220020800ULL, 0x0002004050404800ULL, 0x2000104204824800ULL,
+    0x60B1081010400400ULL, 0x0208600800201210ULL, 0x0020081111014040ULL, 0x0001862202000340ULL,
+    0x2114020150881120ULL, 0x00024103C8205040ULL, 0x2020410080900800ULL, 0x4000800420881020ULL,
+    0x0000042002048110ULL, 0x2086491110018304ULL, 0x0010500E50C40011ULL, 0x0822821802028040ULL,
+    0x0032140402021004ULL, 0x0014210888010900ULL, 0x0120001032011000ULL, 0x6282024000840402ULL,
+    0x0008000606104400ULL, 0x0182044828100420ULL, 0x0001431042020040ULL, 0x4060888200440020ULL
+};
+
+static const Bitboard rook_magics[64] = {
+    0xDB80001440028024ULL, 0x0240022000100141ULL, 0x4200120040800820ULL, 0xA080080010000680ULL,
+    0x4600081002002085ULL, 0x0200010804508200ULL, 0x0880008011000200ULL, 0x2080010004304080ULL,
+    0x120200204102008CULL, 0x8204802000400080ULL, 0x0208808020001000ULL, 0x1009000900B00120ULL,
+    0x2001800C00800800ULL, 0x000A001002000804ULL, 0x4001010001020004ULL, 0x9002002200408401ULL,
+    0x00C0008002422882ULL, 0x0010084000200040ULL, 0x8080808020001000ULL, 0x0210808010000800ULL,
+    0x2280050008010010ULL, 0x002281800A000C00ULL, 0x0001040002010810ULL, 0x0010020030850044ULL,
+    0x0000400080208004ULL, 0x0800200080804000ULL, 0x0420002100410010ULL, 0x0040190300100260ULL,
+    0x0020080080800400ULL, 0x0200040080800200ULL, 0x0402000200080401ULL, 0x008021020002409CULL,
+    0x808000A009400840ULL, 0x0400400289802000ULL, 0xB10A002082001044ULL, 0x1930001080800802ULL,
+    0x3000800402800800ULL, 0x0000800200800400ULL, 0x4800100844000102ULL, 0x2808042182000E41ULL,
+    0x40C4400020828008ULL, 0x0400201000404009ULL, 0x1009002000110042ULL, 0x0810000900110022ULL,
+    0x0104080005010010ULL, 0x0000040002008080ULL, 0x1801000A00090004ULL, 0x4001106884020001ULL,
+    0x0040800020400180ULL, 0x4810004000200440ULL, 0x2000200010008080ULL, 0x0210000804004040ULL,
+    0x000C041008010100ULL, 0x0020020080040080ULL, 0x0100421001080400ULL, 0x5100140120904200ULL,
+    0x0205018000631141ULL, 0x4010400011002081ULL, 0xE40210092200C082ULL, 0x4005002010000489ULL,
+    0x0012010420089002ULL, 0x8019000A34004809ULL, 0x0408113008008244ULL, 0x1A30010400308042ULL
+};
+
+// Lookup of one slider on one square: the blockers on mask index the square's run of the attack table
+struct SliderEntry
+{
+    Bitboard mask;                          // the piece's lines without the edge squares, whose blockers do not matter
+    Bitboard magic;                         // multiplier hashing the blockers into the index
+    int shift;                              // 64 - bits of the index
+    Bitboard* attacks;                      // 2^(64 - shift) attack sets
+};
+
+// Attack tables of every square
+struct SliderTables
+{
+    SliderEntry bishop[64];
+    SliderEntry rook[64];
+    Bitboard bishop_table[0x1480];          // 5248 sets, the sum of 2^bits over the squares
+    Bitboard rook_table[0x19000];           // 102400 sets
+    bool pext;                              // the tables are in PEXT order, not magic order
+
+    SliderTables();
+};
+
+static SliderTables slider_tables;
+
+
+/*
+* NAME
+*      BitboardTables -- fills the attack tables
+*
+* SYNOPSYS
+*
+*      BitboardTables::BitboardTables();
+*
+* DESCRIPTION
+*
+*  This function steps from every square with the moves of each piece, and walks the eight rays
+ *  to fill the rays, between and line tables.
+*/
+BitboardTables::BitboardTables()
+{
+    for (int sq = 0; sq < 64; sq++)
+    {
+        int row = row_of(sq), col = col_of(sq);
+        knight[sq] = king[sq] = 0;
+        pawn[WHITE][sq] = pawn[BLACK][sq] = 0;
+        for (auto& step : knight_steps)
+            if (is_within(row + step[0], col + step[1]))
+                knight[sq] |= square_bb(make_square(row + step[0], col + step[1]));
+        for (auto& step : ray_steps)
+            if (is_within(row + step[0], col + step[1]))
+                king[sq] |= square_bb(make_square(row + step[0], col + step[1]));
+        for (int side_step = -1; side_step <= 1; side_step += 2)
+        {
+            if (is_within(row + 1, col + side_step))
+                pawn[WHITE][sq] |= square_bb(make_square(row + 1, col + side_step));
+            if (is_within(row - 1, col + side_step))
+                pawn[BLACK][sq] |= square_bb(make_square(row - 1, col + side_step));
+        }
+        for (int other = 0; other < 64; other++)
+            between[sq][other] = line[sq][other] = 0;
+    }
+
+    for (int sq = 0; sq < 64; sq++)
+    {
+        for (int direction = 0; direction < 8; direction++)
+        {
+            rays[direction][sq] = 0;
+            for (int r = row_of(sq) + ray_steps[direction][0], c = col_of(sq) + ray_steps[direction][1];
+                 is_within(r, c); r += ray_steps[direction][0], c += ray_steps[direction][1])
+                rays[direction][sq] |= square_bb(make_square(r, c));
+        }
+    }
+
+    for (int sq = 0; sq < 64; sq++)
+    {
+        for (int direction = 0; direction < 8; direction++)
+        {
+            Bitboard full_line = rays[direction][sq] | rays[(direction + 4) % 8][sq] | square_bb(sq);
+            Bitboard passed = 0;
+            for (Bitboard ray = rays[direction][sq]; ray; )
+            {
+                // walk outward from the square: the nearest square is the lowest on increasing rays
+                int other = (direction < 4) ? lsb(ray) : 63 - __builtin_clzll(ray);
+                ray ^= square_bb(other);
+                between[sq][other] = passed;
+                line[sq][other] = full_line;
+                passed |= square_bb(other);
+            }
+        }
+    }
+}
+
+
+/*
+* NAME
+*      RayAttacks -- attacks of a slider in one direction
+*
+* SYNOPSYS
+*
+*      static Bitboard ray_attacks(int direction, int sq, Bitboard occupied);
+*
+* DESCRIPTION
+*
+*  Returns the ray up to and including the first occupied square, found as the nearest set bit of the ray.
+*/
+static inline Bitboard ray_attacks(int direction, int sq, Bitboard occupied)
+{
+    Bitboard ray = bitboard_tables.rays[direction][sq];
+    Bitboard blockers = ray & occupied;
+    if (!blockers)
+        return ray;
+    int blocker = (direction < 4) ? lsb(blockers) : 63 - __builtin_clzll(blockers);
+    return ray ^ bitboard_tables.rays[direction][blocker];
+}
+
+
+/*
+* NAME
+*      SlidingAttacks -- attacks of a slider walking the rays
+*
+* SYNOPSYS
+*
+*      static Bitboard sliding_attacks(bool rook, int sq, Bitboard occupied);
+*
+* DESCRIPTION
+*
+*  The slow reference the attack tables are filled from.
+*/
+static Bitboard sliding_attacks(bool rook, int sq, Bitboard occupied)
+{
+    static const int rook_directions[4] = { NORTH, EAST, SOUTH, WEST };
+    static const int bishop_directions[4] = { NORTH_EAST, NORTH_WEST, SOUTH_WEST, SOUTH_EAST };
+    const int* directions = rook ? rook_directions : bishop_directions;
+    Bitboard attacks = 0;
+    for (int i = 0; i < 4; i++)
+        attacks |= ray_attacks(directions[i], sq, occupied);
+    return attacks;
+}
+
+
+/*
+* NAME
+*      SoftwarePext -- gathers the bits of b under the mask into the low bits
+*
+* SYNOPSYS
+*
+*      static uint64_t software_pext(Bitboard b, Bitboard mask);
+*
+* DESCRIPTION
+*
+*  What the PEXT instruction computes, to fill the tables in PEXT order on any host.
+*/
+static uint64_t software_pext(Bitboard b, Bitboard mask)
+{
+    uint64_t result = 0;
+    for (uint64_t bit = 1; mask; bit <<= 1)
+    {
+        if (b & mask & (0 - mask))
+            result |= bit;
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+
+/*
+* NAME
+*      FillSliderTables -- fills the attack tables in magic or PEXT order
+*
+* SYNOPSYS
+*
+*      static void fill_slider_tables(SliderTables& tables, bool pext);
+*
+* DESCRIPTION
+*
+*  Every subset of a square's mask is enumerated with the carry-rippler trick and its attacks stored at its index.
+ *  Both orders use the same runs of the tables, only the order inside a run differs.
+*/
+static void fill_slider_tables(SliderTables& tables, bool pext)
+{
+    for (int is_rook = 0; is_rook < 2; is_rook++)
+    {
+        for (int sq = 0; sq < 64; sq++)
+        {
+            SliderEntry& entry = is_rook ? tables.rook[sq] : tables.bishop[sq];
+            Bitboard subset = 0;
+            do
+            {
+                uint64_t index = pext ? software_pext(subset, entry.mask) : (subset * entry.magic) >> entry.shift;
+                entry.attacks[index] = sliding_attacks(is_rook, sq, subset);
+                subset = (subset - entry.mask) & entry.mask;
+            } while (subset);
+        }
+    }
+    tables.pext = pext;
+}
+
+
+/*
+* NAME
+*      SliderTables -- sets up the attack tables
+*
+* SYNOPSYS
+*
+*      SliderTables::SliderTables();
+*
+* DESCRIPTION
+*
+*  A square's mask is its lines without their edge squares, a blocker there hides nothing further.
+ *  Each square gets a run of 2^bits attack sets, then the tables are filled in magic order.
+*/
+SliderTables::SliderTables()
+{
+    Bitboard* next[2] = { bishop_table, rook_table };
+    for (int is_rook = 0; is_rook < 2; is_rook++)
+    {
+        for (int sq = 0; sq < 64; sq++)
+        {
+            SliderEntry& entry = is_rook ? rook[sq] : bishop[sq];
+            entry.mask = 0;
+            for (int direction = 0; direction < 8; direction++)
+            {
+                bool straight = direction == NORTH || direction == EAST || direction == SOUTH || direction == WEST;
+                Bitboard ray = bitboard_tables.rays[direction][sq];
+                if (straight != (is_rook == 1) || !ray)
+                    continue;
+                // the last square of the ray, the furthest from sq, is on the edge
+                int edge = (direction < 4) ? 63 - __builtin_clzll(ray) : lsb(ray);
+                entry.mask |= ray ^ square_bb(edge);
+            }
+            int bits = popcount(entry.mask);
+            entry.magic = is_rook ? rook_magics[sq] : bishop_magics[sq];
+            entry.shift = 64 - bits;
+            entry.attacks = next[is_rook];
+            next[is_rook] += (size_t)1 << bits;
+        }
+    }
+    fill_slider_tables(*this, false);
+}
+
+
+/*
+ * Kernels start
+ */
+
+static Bitboard bishop_attacks_magic(int sq, Bitboard occupied)
+{
+    const SliderEntry& entry = slider_tables.bishop[sq];
+    return entry.attacks[((occupied & entry.mask) * entry.magic) >> entry.shift];
+}
+
+static Bitboard rook_attacks_magic(int sq, Bitboard occupied)
+{
+    const SliderEntry& entry = slider_tables.rook[sq];
+    return entry.attacks[((occupied & entry.mask) * entry.magic) >> entry.shift];
+}
+
+#if defined(CHESS_DISPATCH) && !defined(__POPCNT__)
+static int popcount_software(Bitboard b)
+{
+    return __builtin_popcountll(b);
+}
+
+__attribute__((target("popcnt"))) static int popcount_hardware(Bitboard b)
+{
+    return __builtin_popcountll(b);
+}
+#endif
+
+#ifdef CHESS_DISPATCH
+__attribute__((target("bmi2"))) static Bitboard bishop_attacks_pext(int sq, Bitboard occupied)
+{
+    const SliderEntry& entry = slider_tables.bishop[sq];
+    return entry.attacks[_pext_u64(occupied, entry.mask)];
+}
+
+__attribute__((target("bmi2"))) static Bitboard rook_attacks_pext(int sq, Bitboard occupied)
+{
+    const SliderEntry& entry = slider_tables.rook[sq];
+    return entry.attacks[_pext_u64(occupied, entry.mask)];
+}
+#endif
+
+/*
+ * Kernels end
+ */
+
+#if defined(CHESS_DISPATCH) && !defined(__POPCNT__)
+int (*popcount_kernel)(Bitboard b) = popcount_software;
+#endif
+Bitboard (*bishop_attacks_kernel)(int sq, Bitboard occupied) = bishop_attacks_magic;
+Bitboard (*rook_attacks_kernel)(int sq, Bitboard occupied) = rook_attacks_magic;
+
+
+/*
+* NAME
+*      SelectBitboardKernels -- selects the popcount and sliding attack kernels
+*
+* SYNOPSYS
+*
+*      void select_bitboard_kernels(CpuTier tier);
+*
+* DESCRIPTION
+*
+*  POPCNT comes with the sse41 tier and PEXT with the bmi2 tier. The attack tables are refilled when the order
+ *  of their index changes, which takes about a millisecond.
+*/
+void select_bitboard_kernels(CpuTier tier)
+{
+    bool pext = false;
+#ifdef CHESS_DISPATCH
+    pext = tier >= CPU_BMI2;
+#ifndef __POPCNT__
+    popcount_kernel = (tier >= CPU_SSE41) ? popcount_hardware : popcount_software;
+#endif
+#endif
+    if (pext != slider_tables.pext)
+        fill_slider_tables(slider_tables, pext);
+#ifdef CHESS_DISPATCH
+    bishop_attacks_kernel = pext ? bishop_attacks_pext : bishop_attacks_magic;
+    rook_attacks_kernel = pext ? rook_attacks_pext : rook_attacks_magic;
+#endif
+}
+
+
+/*
+* NAME
+*      SliderKernelName -- returns the name of the sliding attack kernels in use
+*
+* SYNOPSYS
+*
+*      const char* slider_kernel_name();
+*/
+const char* slider_kernel_name()
+{
+    return slider_tables.pext ? "pext" : "magic";
+}
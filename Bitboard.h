@@ -0,0 +1,88 @@
+/*
+Bitboard functions
+-- Precomputed attack sets of every piece from every square, with bit 0 = a1 and bit 63 = h8 as in Position.
+-- Sliding attacks are looked up in tables indexed by the blockers on the piece's lines: the index is made with
+   PEXT on BMI2 hosts and with a magic multiply otherwise, and the kernel is selected at startup, see Cpu.h.
+-- Between and line tables give the squares strictly between two aligned squares and the whole line through them,
+   which the legal move generator uses for check blocking and pins.
+-- Pawn pushes and captures of a whole set of pawns are shifts, specialized at compile time on the pawns' color.
+*/
+
+
+#pragma once
+
+#include "Cpu.h"
+#include "Position.h"
+
+struct BitboardTables
+{
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn[2][64];                   // squares attacked by a pawn of the color
+    Bitboard rays[8][64];                   // empty board rays in the eight directions, see Bitboard.cpp
+    Bitboard between[64][64];               // squares strictly between two aligned squares, 0 otherwise
+    Bitboard line[64][64];                  // the edge to edge line through two aligned squares, 0 otherwise
+
+    BitboardTables();
+};
+
+extern const BitboardTables bitboard_tables;
+
+#if defined(CHESS_DISPATCH) && !defined(__POPCNT__)
+// The POPCNT instruction, or the compiler's software count on hosts without it
+extern int (*popcount_kernel)(Bitboard b);
+inline int popcount(Bitboard b) { return popcount_kernel(b); }
+#else
+inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+#endif
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+
+// Return and clear the lowest set square
+inline int pop_lsb(Bitboard& b)
+{
+    int sq = lsb(b);
+    b &= b - 1;
+    return sq;
+}
+
+inline Bitboard knight_attacks(int sq) { return bitboard_tables.knight[sq]; }
+inline Bitboard king_attacks(int sq) { return bitboard_tables.king[sq]; }
+inline Bitboard pawn_attacks(Color c, int sq) { return bitboard_tables.pawn[c][sq]; }
+inline Bitboard between_bb(int a, int b) { return bitboard_tables.between[a][b]; }
+inline Bitboard line_bb(int a, int b) { return bitboard_tables.line[a][b]; }
+
+extern Bitboard (*bishop_attacks_kernel)(int sq, Bitboard occupied);
+extern Bitboard (*rook_attacks_kernel)(int sq, Bitboard occupied);
+
+// Squares a bishop / rook / queen on the square attacks with the given occupancy
+inline Bitboard bishop_attacks(int sq, Bitboard occupied) { return bishop_attacks_kernel(sq, occupied); }
+inline Bitboard rook_attacks(int sq, Bitboard occupied) { return rook_attacks_kernel(sq, occupied); }
+inline Bitboard queen_attacks(int sq, Bitboard occupied) { return bishop_attacks(sq, occupied) | rook_attacks(sq, occupied); }
+
+// Point the popcount and sliding attack kernels at the tier's versions, refilling the attack tables if needed
+void select_bitboard_kernels(CpuTier tier);
+
+// Name of the sliding attack kernels in use: pext or magic
+const char* slider_kernel_name();
+
+const Bitboard FILE_A_BB = 0x0101010101010101ULL;
+const Bitboard FILE_H_BB = FILE_A_BB << 7;
+
+inline Bitboard row_bb(int row) { return 0xFFULL << (8 * row); }
+
+// Row of the color seen from its own side: relative_row<BLACK>(0) is the eighth row
+template <Color Us> constexpr int relative_row(int row) { return (Us == WHITE) ? row : 7 - row; }
+
+// Square difference of a step forward for the color's pawns
+template <Color Us> constexpr int pawn_forward() { return (Us == WHITE) ? 8 : -8; }
+
+// The squares in front of the pawns, and the squares they attack toward the a-file / the h-file
+template <Color Us> inline Bitboard pawn_push(Bitboard pawns) { return (Us == WHITE) ? pawns << 8 : pawns >> 8; }
+template <Color Us> inline Bitboard pawn_attacks_west(Bitboard pawns)
+{
+    return (Us == WHITE) ? (pawns & ~FILE_A_BB) << 7 : (pawns & ~FILE_A_BB) >> 9;
+}
+template <Color Us> inline Bitboard pawn_attacks_east(Bitboard pawns)
+{
+    return (Us == WHITE) ? (pawns & ~FILE_H_BB) << 9 : (pawns & ~FILE_H_BB) >> 7;
+}
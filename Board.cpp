@@ -1,4 +1,6 @@
 #include "Board.h"
+#include "Notation.h"
+#include "Trace.h"
 
 
 /*
@@ -17,6 +19,12 @@
 Board::Board() {
     // Create main board
     m_moves = 0;
+    m_game.set_start();
+    m_history.assign(1, m_game.key());
+    m_index = nullptr;
+    m_engine = ENGINE_ALPHABETA;
+    m_level = DEFAULT_DIFFICULTY_LEVEL;
+    m_seed = (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
     play_sequence[0] = "white";
     play_sequence[1] = "black";
     piece_filenames = { {
@@ -70,313 +78,17 @@ Board::~Board()
 *
 * DESCRIPTION
 *
-*  This function will add the valid moves of current piece, depending on which piece the pos has.
-*  Calls other functions to get valid moves for pawn, rook, bishop, and queen.
- *  Finds the valid moves for king and knight in its own code.
- *  For king, checks all the squares in the vicinity
- *  For knight, using an array, checks the potentially valid positions
+*  This function adds the target squares of the legal moves of the piece in the game, see Position::get_all_valids.
+ *  Moves that would leave the own king attacked are not valid; castling is the king's two square step.
 */
 void Board::get_valid_moves(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos) {
-    int row = std::get<0>(pos);
-    int col = std::get<1>(pos);
-
-    if (!board[row][col]->has_piece())
-        return;
-
-    Piece* piece = board[row][col]->get_piece();
-
-    if (piece->get_name() == "white_pawn")
-        deal_pawns(v, pos, true);
-
-    else if (piece->get_name() == "black_pawn")
-        deal_pawns(v, pos, false);
-
-    else if (piece->get_name() == "white_rook" || piece->get_name() == "black_rook")
-        deal_rook(v, pos);
-
-    else if (piece->get_name() == "white_bishop" || piece->get_name() == "black_bishop")
-        deal_bishop(v, pos);
-
-    else if (piece->get_name() == "white_knight" || piece->get_name() == "black_knight")
-    {
-        string piece_color = board[row][col]->get_piece()->get_color();
-        int possible_moves[8][2] = {
-                {-2, -1}, {-1, -2}, {1, -2}, {2, -1},
-                {2, 1}, {1, 2}, {-1, 2}, {-2, 1}
-        };
-
-        for (auto &move: possible_moves)
-        {
-            int potential_row = row + move[0];
-            int potential_col = col + move[1];
-
-            std::tuple<int, int> potential_pos = std::make_tuple(potential_row, potential_col);
-
-            if (is_within(potential_pos))
-            {
-                if (board[potential_row][potential_col]->has_piece())
-                    get_valid_on_piece(piece_color, potential_pos, v);
-                else
-                    v.insert(potential_pos);
-            }
-        }
-    }
-    else if (piece->get_name() == "white_queen" || piece->get_name() == "black_queen")
-    {
-        // Queen's potential move is the combination of the rooks and bishop, if they were to exist at the same position
-        deal_rook(v, pos);
-        deal_bishop(v, pos);
-    }
-
-    else if (piece->get_name() == "white_king" || piece->get_name() == "black_king")
-    {
-        string piece_color = board[row][col]->get_piece()->get_color();
-        int potential_row;
-        int potential_col;
-        std::tuple<int, int> potential_pos;
-        for (int i = -1; i < 2; i++)
-        {
-            for (int j = -1; j < 2; j++)
-            {
-                // skip the king's own square
-                if (i == 0 && j == 0)
-                    continue;
-                potential_row = row + i;
-                potential_col = col + j;
-                potential_pos = std::make_tuple(potential_row, potential_col);
-                if (!is_within(potential_pos))
-                    continue;
-                if (board[potential_row][potential_col]->has_piece())
-                    get_valid_on_piece(piece_color, potential_pos, v);
-                else
-                    v.insert(potential_pos);
-            }
-        }
-    }
-}
-
-/*
-* NAME
-*      GetValidOnPiece - helper for GetValidMoves, adds the square containing opposing piece to the set of valid moves
-*
-* SYNOPSYS
-*
-*      void Board::get_valid_on_piece(string piece_color, std::tuple<int, int>& oppose_pos, set<std::tuple<int, int>>& v);
-*      piece_color         ->  The piece's color whose valid moves is to be found
-*      v                   ->  The valid moves set in which a potential valid move is to be added
-*
-* DESCRIPTION
-*
-*  This function will check if the last piece on the valid move is an opposing piece
-*  If so, add to the valid moves, the square on which the opposing piece exists
- *  If it evaluates that the square being inspected is not opposing, it does not change the valids set.
-*/
-void Board::get_valid_on_piece(string piece_color, std::tuple<int, int>& oppose_pos, set<std::tuple<int, int>>& v) {
-
-    int oppose_row = std::get<0>(oppose_pos);
-    int oppose_col = std::get<1>(oppose_pos);
-    bool same_color = (piece_color == board[oppose_row][oppose_col]->get_piece()->get_color());
-    if (!same_color)
-    {
-        std::tuple<int, int> position = std::make_tuple(oppose_row, oppose_col);
-        v.insert(oppose_pos);
-    }
-}
-
-
-/*
-* NAME
-*      IsWithin - helper for GetValidMoves, checks if the position passed is within the bounds of the board
-*
-* SYNOPSYS
-*
-*      void Board::is_within(std::tuple<int, int>& pos);
-*      pos                   ->  position on the board to be checked, a tuple of row, column
-*
-* DESCRIPTION
-*
-*  This function will check if the position passed is within the board
-*/
-bool Board::is_within(std::tuple<int, int>& pos) {
-    int row = std::get<0>(pos);
-    int col = std::get<1>(pos);
-    if (row < 0 || col < 0 || row > 7 || col > 7)
-        return false;
-    return true;
-}
-
-/*
-* NAME
-*      DealPawns - helper for GetValidMoves, finds and adds the valid moves for a pawn
-*
-* SYNOPSYS
-*
-*      void Board::deal_pawns(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos, bool goes_up);
-*      v                   ->  set of valid moves
- *      pos                -> tuple of row, col -- current square on which the piece resides
- *     goes_up             -> bool that stores white or black piece
-*
-* DESCRIPTION
-*
-*  This function adds the valid moves for a pawn
- *  Depending on which pawn-- black or white, it adds the relevant positions (tuples of row, col) upward or downward
-*/
-void Board::deal_pawns(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos, bool goes_up) {
-    int multiplier = (goes_up) ? 1 : -1;
-    int row = std::get<0>(pos), col = get<1>(pos);
-
-    string piece_color = board[row][col]->get_piece()->get_color();
-
-    // move forward
-    std::tuple<int, int> potential_pos = std::make_tuple(row + multiplier * 1, col);
-    if (is_within(potential_pos) && !board[row + multiplier * 1][col]->has_piece())
-        v.insert(potential_pos);
-
-    // move foward-sideways if opposing key
-    potential_pos = std::make_tuple(row + multiplier * 1, col + 1);
-    if (is_within(potential_pos) && board[row + multiplier * 1][col + 1]->has_piece())
-        get_valid_on_piece(piece_color, potential_pos, v);
-
-    potential_pos = std::make_tuple(row + multiplier * 1, col - 1);
-    if (is_within(potential_pos) && board[row + multiplier * 1][col - 1]->has_piece())
-        get_valid_on_piece(piece_color, potential_pos, v);
-
-    // first move
-    int probable_row = (7 + multiplier * 1) % 7;
-    potential_pos = std::make_tuple(probable_row + multiplier * 2, col);
-    if (row == probable_row && !board[probable_row + multiplier * 2][col]->has_piece() && !board[probable_row + multiplier * 1][col]->has_piece())
-        v.insert(potential_pos);
+    MoveList moves;
+    m_game.get_valid_moves(make_square(std::get<0>(pos), std::get<1>(pos)), moves);
+    for (Move m : moves)
+        v.insert(std::make_tuple(row_of(move_to(m)), col_of(move_to(m))));
 }
 
 
-/*
-* NAME
-*      DealRook - helper for GetValidMoves, finds and adds the valid moves for a rook
-*
-* SYNOPSYS
-*
-*      void Board::deal_rook(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos);
-*      v                   ->  set of valid moves
- *      pos                -> tuple of row, col -- current square on which the piece resides
-*
-* DESCRIPTION
-*
-*  This function adds the valid moves for a rook.
- * Using up, down, left, and right potential nearest moves, calls ContinueUntilPiece to get all the valid moves in each direction.
-*/
-void Board::deal_rook(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos)
-{
-    int row = std::get<0>(pos);
-    int col = std::get<1>(pos);
-
-    string piece_color = board[row][col]->get_piece()->get_color();
-
-    int move_down = row - 1, move_up = row + 1, move_left = col - 1, move_right = col + 1;
-
-    // get all the valid squares moving down
-    std::tuple<int, int> potential_pos = std::make_tuple(move_down, col);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-
-    // get all the valid squares moving down
-    potential_pos = std::make_tuple(move_up, col);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-
-    // get all the valid squares moving left
-    potential_pos = std::make_tuple(row, move_left);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-
-    // get all the valid squares moving right
-    potential_pos = std::make_tuple(row, move_right);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-}
-
-
-/*
-* NAME
-*      DealBishop - helper for GetValidMoves, finds and adds the valid moves for a bishop
-*
-* SYNOPSYS
-*
-*      void Board::deal_bishop(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos);
-*      v                   ->  set of valid moves
- *      pos                -> tuple of row, col -- current square on which the piece resides
-*
-* DESCRIPTION
-*
-*  This function adds the valid moves for a rook.
- * Using potential nearest moves, calls ContinueUntilPiece to get all the valid moves in each direction.
-*/
-void Board::deal_bishop(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos)
-{
-    int row = std::get<0>(pos);
-    int col = std::get<1>(pos);
-
-    string piece_color = board[row][col]->get_piece()->get_color();
-
-    int row_up = row + 1;
-    int col_right = col + 1;
-    std::tuple<int, int> potential_pos = std::make_tuple(row_up, col_right);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-
-    int row_down = row - 1;
-    int col_left = col - 1;
-    potential_pos = std::make_tuple(row_down, col_left);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-
-    row_up = row + 1;
-    col_left = col - 1;
-    potential_pos = std::make_tuple(row_up, col_left);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-
-    row_down = row - 1;
-    col_right = col + 1;
-    potential_pos = std::make_tuple(row_down, col_right);
-    continue_until_piece(piece_color, v, pos, potential_pos);
-}
-
-/*
-* NAME
-*      ContinueUntilPiece - helper for deal_rook, deal_bishop, continues to add valid moves until there's a piece
-*
-* SYNOPSYS
-*
-*      void Board::continue_until_piece(string piece_color, set<std::tuple<int, int>>& v, std::tuple<int, int>& pos, std::tuple<int, int>& potential_pos)
-
-*      piece_color          ->  the color of the current piece
- *      v                   -> the set of valid moves
- *      pos                 -> tuple of row, col -- square which we know is valid
- *     potential_pos        -> potential valid move
-*
-* DESCRIPTION
-*
-*  This function recursively adds the valid moves for any piece which has a recurring pattern of valid moves
- *  For example, rook, bishop, and by extension, queen
- *  Based on the change between pos and potential_pos,
- *  in the next recursion, it finds the next potential_pos.
- *  Continues until there is a piece, in which case, checks to see if the piece is opposing or not, adds to valid accordingly
-*/
-void Board::continue_until_piece(string piece_color, set<std::tuple<int, int>>& v, std::tuple<int, int>& pos, std::tuple<int, int>& potential_pos)
-{
-    int row = std::get<0>(pos);
-    int col = std::get<1>(pos);
-    int potential_row = std::get<0>(potential_pos);
-    int potential_col = std::get<1>(potential_pos);
-
-    if (!is_within(potential_pos))
-        return;
-
-    if (board[potential_row][potential_col]->has_piece())
-    {
-        get_valid_on_piece(piece_color, potential_pos, v);
-        return;
-    }
-    v.insert(potential_pos);
-    std::tuple<int, int> next_potential_pos = make_tuple(potential_row + (potential_row - row), potential_col + (potential_col - col));
-    continue_until_piece(piece_color, v, potential_pos, next_potential_pos);
-}
-
-
-
 /*
 * NAME
 *      Graphics - Main function, runs the game.
@@ -420,6 +132,7 @@ void Board::graphics()
     bool move_piece = false;
     while (window->isOpen())
     {
+        TRACE_SCOPE("gui", "frame");
         // if this is the first move and ai plays white
         if (user_side != play_sequence[(m_moves % 2)] && m_moves == 0)
         {
@@ -438,6 +151,21 @@ void Board::graphics()
             if (event.type == event.Closed) {
                 window->close();
             }
+            // Pressing A shows the engine's best lines for the side to move
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::A)
+                analyze();
+            // Pressing D shows the games of the database that reached the position
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::D)
+                show_games();
+            // Pressing 1 to 8 sets the difficulty level of the engine's next moves
+            if (event.type == sf::Event::KeyPressed && event.key.code >= sf::Keyboard::Num1
+                && event.key.code < sf::Keyboard::Num1 + DIFFICULTY_LEVELS)
+            {
+                m_level = event.key.code - sf::Keyboard::Num1 + 1;
+                string level = "Level " + to_string(m_level) + ", " + to_string(difficulty_level(m_level).nodes) + " nodes per move";
+                cout << level << endl;
+                window->setTitle("Chess - " + level);
+            }
             // Upon mouse click on a square
 
             // If this is the first click,
@@ -459,21 +187,16 @@ void Board::graphics()
                     if (it != valids.end())
                     {
                         // if the click is on a valid square
-                        if (board[row][col]->has_piece())
-                        {
-                            // check for victory
-                            string piece_name = board[row][col]->get_piece()->get_name();
-                            if (piece_name == "white_king" || piece_name == "black_king")
-                            {
-                                window->close();
-                                return;
-                            }
-                        }
                         Piece *temp = board[row][col]->get_piece();
                         board[row][col]->set_piece(board[prev_row][prev_col]->remove_piece());
                         delete temp;
+                        string promotion = "";
                         if ((row == 0 || row == 7) && board[row][col]->get_piece()->get_type() == "pawn")
+                        {
                             change_pawn_on_last(click_pos);
+                            promotion = board[row][col]->get_piece()->get_type();
+                        }
+                        make_user_move(make_square(prev_row, prev_col), make_square(row, col), promotion);
                         m_moves++;
 
                         // call ai after user makes a move
@@ -522,6 +245,7 @@ void Board::graphics()
         }
 
         // continuously draw the board until an event occurs
+        TRACE_SCOPE("gui", "draw");
         window->clear();
         for (int i = 0; i < 8; i++)
         {
@@ -597,6 +321,7 @@ std::tuple<int, int> Board::on_click_get_square(sf::Event& event)
 */
 void Board::change_pawn_on_last(std::tuple<int, int>& pos)
 {
+    TRACE_SCOPE("gui", "promotion window");
     int row = std::get<0>(pos);
     int col = std::get<1>(pos);
 
@@ -697,6 +422,7 @@ void Board::change_pawn_on_last(std::tuple<int, int>& pos)
 */
 void Board::choose_side()
 {
+    TRACE_SCOPE("gui", "side window");
     side_window = new sf::RenderWindow(sf::VideoMode(2 * square_height, square_height), "Choose a side!", sf::Style::Close | sf::Style::Resize);
 
     for (int i = 0; i < 2; i++)
@@ -742,385 +468,202 @@ void Board::choose_side()
 
 /*
 * NAME
-*      GetAllValids - helper for minimax, finds all valids for a side
+*      SyncBoard - makes the main board show the game
 *
 * SYNOPSYS
 *
-*      void Board::get_all_valids(set< std::tuple<std::tuple<int, int>, std::tuple<int, int>>> &all_valids, string side);
-*      all_valids                   ->  set of valid moves for all pieces of the side
- *      side                        -> string containing the color of the side AI wants to find the valids for
+*      void Board::sync_board();
 *
 * DESCRIPTION
 *
-*  This function iterates through the board, calling GetValidMoves on each piece
- *  that is of the same color as the side
- *  Adds all of them to the all_valids set
+*  This function replaces the piece on every square that does not hold the piece of the game's position,
+ *  which after a move are the squares it touched, including a castling rook and a pawn captured en passant.
 */
-void Board::get_all_valids(set< std::tuple<std::tuple<int, int>, std::tuple<int, int>>> &all_valids, string side)
+void Board::sync_board()
 {
-    std::tuple<std::tuple<int, int>, std::tuple<int, int>> position_valid_pair;
-    for (int i = 0; i < 8; i++)
+    static const string type_names[7] = { "", "pawn", "knight", "bishop", "rook", "queen", "king" };
+
+    for (int row = 0; row < 8; row++)
     {
-        for (int j = 0; j < 8; j++)
+        for (int col = 0; col < 8; col++)
         {
-            if (board[i][j]->has_piece() && board[i][j]->get_piece()->get_color() == side)
-            {
-                set<std::tuple<int, int>> valids;
-                std::tuple<int, int> pos = std::make_tuple(i, j);
-                get_valid_moves(valids, pos);
-                for (const auto& valid : valids)
-                {
-                    position_valid_pair = std::make_tuple(pos, valid);
-                    all_valids.insert(position_valid_pair);
-                }
-            }
+            uint8_t code = m_game.piece_on(make_square(row, col));
+            string filename = "";
+            if (code != NO_PIECE)
+                filename = string(color_of(code) == WHITE ? "white_" : "black_") + type_names[type_of(code)] + ".png";
+            string current = board[row][col]->has_piece() ? board[row][col]->get_piece()->get_filename() : "";
+            if (current != filename)
+                board[row][col]->set_new_piece(filename);
         }
     }
-    return;
 }
 
+
 /*
 * NAME
-*      IsTerminal - checks to see if the board has reached a terminal state
+*      MakeUserMove - plays the user's move in the game
 *
 * SYNOPSYS
 *
-*      bool Board::is_terminal();
+*      void Board::make_user_move(int from, int to, string promotion);
+ *      from, to        -> squares of the move
+ *      promotion       -> type chosen for a pawn reaching the last square, "" otherwise
 *
 * DESCRIPTION
 *
-*  This function returns true if one of the king has fallen,
- *  effectively helping in terminating the function.
+*  This function finds the legal move between the squares, with the chosen promotion if there is one
+ *  (a queen if the choice was not made), makes it in the game and syncs the main board.
 */
-bool Board::is_terminal()
+void Board::make_user_move(int from, int to, string promotion)
 {
-    int num_kings = 0;
-    for (int i = 0; i < 8; i++)
+    static const string type_names[7] = { "", "pawn", "knight", "bishop", "rook", "queen", "king" };
+
+    MoveList moves;
+    m_game.get_valid_moves(from, moves);
+    Move move = MOVE_NONE;
+    for (Move m : moves)
     {
-        for (int j = 0; j < 8; j++)
-        {
-            if (board[i][j]->has_piece() && board[i][j]->get_piece()->get_type() == "king")
-                num_kings++;
-        }
+        if (move_to(m) != to)
+            continue;
+        // promotions are generated queen first
+        if (move == MOVE_NONE || type_names[move_promotion(m)] == promotion)
+            move = m;
     }
-    if (num_kings < 2)
-        return true;
-    return false;
+    if (move == MOVE_NONE)
+        return;
+    Undo undo;
+    m_game.make_move(move, undo);
+    m_history.push_back(m_game.key());
+    sync_board();
+    show_games();
 }
 
 
 /*
 * NAME
-*      SmartGuy - this function starts the minimax.
+*      IsTerminal - checks to see if the board has reached a terminal state
 *
 * SYNOPSYS
 *
-*      void Board::smart_guy(unsigned int a_space_size);
- *
- *      a_space_size -> the square size
+*      bool Board::is_terminal();
 *
 * DESCRIPTION
 *
-*  This function starts the minimax code, passing appropriate values for alpha-beta pruning and number of steps so far.
- *  Depending on the new best_action variable
- *  (tuple of current square of the piece which is calculated to be moved by minimax for the best outcome
- *             and the best valid square for the piece)
- *  that minimax changes, it moves the appropriate piece to the best position
+*  This function returns true if the side to move has no legal moves, being checkmated or stalemated,
+ *  or if the game is drawn by threefold repetition, the fifty-move rule or bare kings,
+ *  effectively helping in terminating the function.
 */
-void Board::smart_guy(unsigned int a_space_size)
+bool Board::is_terminal()
 {
-    int steps = 0;
-    if (user_side == "black")
-    {
-        int alpha_comp_util_max = std::numeric_limits<int>::max();
-        maximize(steps, alpha_comp_util_max);
-    }
-    else
-    {
-        int alpha_comp_util_min = std::numeric_limits<int>::min();
-        minimize(steps, alpha_comp_util_min);
-    }
-    auto pos = std::get<0>(best_action);
-    int p = std::get<0>(pos);
-    int q = std::get<1>(pos);
-    auto valid = std::get<1>(best_action);
-    int v = std::get<0>(valid);
-    int w = std::get<1>(valid);
-
-    Piece *temp = board[v][w]->get_piece();
-    board[v][w]->set_piece(board[p][q]->remove_piece());
-    if ((v == 0 || v == 7) && board[v][w]->get_piece()->get_type() == "pawn")
-    {
-        // create a new queen and add it in place of pawn
-        string piece_filename = "";
-        if (board[v][w]->get_piece()->get_color() == "white")
-            piece_filename = "white_queen.png";
-        else
-            piece_filename = "black_queen.png";
-        Piece *piece_change = new Piece(piece_filename, a_space_size);
-        Piece *temp2 = board[v][w]->get_piece();
-        // add the queen
-        board[v][w]->set_piece(piece_change);
-        delete temp2;
-    }
-    delete temp;
+    if (m_game.halfmove() >= 100 || count_repetitions(m_history, m_game.halfmove()) >= 3 || m_game.count_pieces() == 2)
+        return true;
+    MoveList moves;
+    m_game.get_all_valids(moves);
+    return moves.empty();
 }
 
 
 /*
 * NAME
-*      Minimize - this function is recursive and attempts to minimize the utility of the board for the black side
+*      SmartGuy - this function starts the minimax.
 *
 * SYNOPSYS
 *
-*      int Board::minimize(int &steps, int alpha_comp_util);
+*      void Board::smart_guy(unsigned int a_space_size);
  *
- *     steps            -> the depth of minimax tree
- *     alpha_comp_util  -> alpha_beta value
+ *      a_space_size -> the square size
 *
 * DESCRIPTION
 *
-*  Checks if the board is terminal, if so, calls the evaluation function SmartGuysHelper.
- * If the board is not terminal, finds all the valid move for black side,
- * For each valid move
-        * makes the move on the same board, and passes to maximize
-        * to see what the utility maximize returns for current valid move or action.
-        * Changes the board back to its original state.
-* Finds the action with lowest utility saving it to the Board member function best_action.
+*  This function hands the game's position to the selected engine with the level's limits, see Think.
+ *  It makes the level's pick among the lines returned in the game, syncs the main board with it
+ *  and shows the database's games.
 */
-int Board::minimize(int &steps, int alpha_comp_util)
+void Board::smart_guy(unsigned int a_space_size)
 {
-    steps++;
-    if (is_terminal() || steps > max_steps)
-    {
-        steps--;
-        return smart_guys_helper();
-    }
-    set< std::tuple<std::tuple<int, int>, std::tuple<int, int>>> all_valids;
-    std::tuple<std::tuple<int, int>, std::tuple<int, int>> lowest_action;
-    get_all_valids(all_valids, "black");
-
-    int utility = std::numeric_limits<int>::max();
-    int temp_utility;
-    Piece *hold_pos_piece = nullptr;
-    Piece *hold_val_piece = nullptr;
-    Piece *piece_change = nullptr;
-
-    for (auto& pos_valid : all_valids)
-    {
-        auto pos = std::get<0>(pos_valid);
-        int p = std::get<0>(pos);
-        int q = std::get<1>(pos);
-        auto valid = std::get<1>(pos_valid);
-        int v = std::get<0>(valid);
-        int w = std::get<1>(valid);
+    SearchResult result = think(level_limits(m_level));
+    Move move = (m_engine == ENGINE_ALPHABETA) ? choose_level_move(result, m_game, m_level, m_seed) : result.best_move;
+    if (move == MOVE_NONE)
+        return;
 
-        hold_pos_piece = board[p][q]->get_piece();
-        hold_val_piece = board[v][w]->get_piece();
-        board[v][w]->set_piece(board[p][q]->remove_piece());
-        if ((v == 0) && board[v][w]->get_piece()->get_type() == "pawn")
-        {
-            piece_change = new Piece("black_queen.png");
-            board[v][w]->set_piece(piece_change);
-        }
-        temp_utility = std::min(utility, maximize(steps, utility));
-        if (temp_utility < utility)
-        {
-            utility = temp_utility;
-            lowest_action = pos_valid;
-        }
-        board[p][q]->set_piece(hold_pos_piece);
-        board[v][w]->set_piece(hold_val_piece);
-        delete piece_change;
-        piece_change = nullptr;
-        hold_pos_piece = nullptr;
-        hold_val_piece = nullptr;
-        if (utility <= alpha_comp_util)
-            break;
-    }
-    if (steps == 1)
-    {
-        best_action = lowest_action;
-    }
-    steps--;
-    return utility;
+    Undo undo;
+    m_game.make_move(move, undo);
+    m_history.push_back(m_game.key());
+    sync_board();
+    show_games();
 }
 
 
 /*
 * NAME
-*      Maximize - this function is recursive and attempts to maximize the utility of the board for the white side
+*      Think - searches the game's position with the selected engine
 *
 * SYNOPSYS
 *
-*      int Board::maximize(int &steps, int alpha_comp_util);
- *
- *     steps            -> the depth of minimax tree
- *     alpha_comp_util  -> alpha_beta value
+*      SearchResult Board::think(SearchLimits limits);
 *
 * DESCRIPTION
 *
-*  Checks if the board is terminal, if so, calls the evaluation function SmartGuysHelper.
- * If the board is not terminal, finds all the valid move for white side,
- * For each valid move
-        * makes the move on the same board, and passes to minimize
-        * to see what the utility minimize returns for current valid move or action.
-        * Changes the board back to its original state.
-* Finds the action with highest utility saving it to the Board member function best_action.
+*  The minimax searches within the limits; the MCTS engine ignores them and runs mcts_playouts playouts,
+ *  keeping its tree from the previous move.
 */
-int Board::maximize(int &steps, int alpha_comp_util)
+SearchResult Board::think(SearchLimits limits)
 {
-    steps++;
-    if (is_terminal() || steps > max_steps)
-    {
-        steps--;
-        return smart_guys_helper();
-    }
-    set< std::tuple<std::tuple<int, int>, std::tuple<int, int>>> all_valids;
-    std::tuple<std::tuple<int, int>, std::tuple<int, int>> highest_action;
-    get_all_valids(all_valids, "white");
-
-    int utility = std::numeric_limits<int>::min();
-    int temp_utility;
-    Piece *hold_pos_piece = nullptr;
-    Piece *hold_val_piece = nullptr;
-    Piece *piece_change = nullptr;
-    for (auto& pos_valid : all_valids)
-    {
-        auto pos = std::get<0>(pos_valid);
-        int p = std::get<0>(pos);
-        int q = std::get<1>(pos);
-        auto valid = std::get<1>(pos_valid);
-        int v = std::get<0>(valid);
-        int w = std::get<1>(valid);
-
-        hold_pos_piece = board[p][q]->get_piece();
-        hold_val_piece = board[v][w]->get_piece();
-        board[v][w]->set_piece(board[p][q]->remove_piece());
-        if ((v == 7) && board[v][w]->get_piece()->get_type() == "pawn")
-        {
-            piece_change = new Piece("white_queen.png");
-            board[v][w]->set_piece(piece_change);
-        }
-
-        temp_utility = std::max(utility, minimize(steps, utility));
-        if (temp_utility > utility)
-        {
-            utility = temp_utility;
-            highest_action = pos_valid;
-        }
-        board[p][q]->set_piece(hold_pos_piece);
-        board[v][w]->set_piece(hold_val_piece);
-        delete piece_change;
-        piece_change = nullptr;
-        hold_pos_piece = nullptr;
-        hold_val_piece = nullptr;
-        if (utility >= alpha_comp_util)
-            break;
-    }
-    if (steps == 1)
-        best_action = highest_action;
-    steps--;
-    return utility;
+    if (m_engine == ENGINE_ALPHABETA)
+        return m_search.smart_guy(m_game, limits, m_history);
+    limits.nodes = mcts_playouts;
+    return m_mcts.search(m_game, limits, m_history);
 }
 
 
 /*
 * NAME
-*      SmartGuysHelper - this function is the evaluation function that returns the utility of the board
+*      Analyze - shows the engine's best lines in the game's position
 *
 * SYNOPSYS
 *
-*      int Board::smart_guys_helper();
- *
+*      void Board::analyze();
 *
 * DESCRIPTION
-*   // Returns utility of the board
-    // Calculates utility by assigning values to each pieces (material value)
-    // For white pieces, positive values are assigned
-    // For black pieces, equal negative values are assigned
-    // Hence, for white side, it would be optimal to have least important black pieces and most important white pieces
-    // vice-versa for black pieces.
-
-
-    // In addition, takes into account the mobility of the pieces.
-    // Mobilities' weight increases as the game progresses
+*
+*  This function searches the game's position with the level's node budget in multi-PV mode.
+ *  It prints the analysis_lines best moves with their scores and lines, and puts the best one in the window title.
 */
-int Board::smart_guys_helper()
+void Board::analyze()
 {
-
-
-    // assign values to each pieces
-    std::unordered_map<std::string, int> key_values;
-    key_values["pawn"] = 1;
-    key_values["knight"] = 3;
-    key_values["bishop"] = 3;
-    key_values["rook"] = 5;
-    key_values["queen"] = 9;
-    key_values["king"] = 100;
-
-    // count pieces to determine game start, mid game, or end game
-    int num_pieces = count_pieces();
-    float mobility = 0.0;
-    if (num_pieces <= 11)
-        mobility = 0.6;
-    else if (num_pieces <= 22)
-        mobility = 0.3;
-    else
-        mobility = 0.1;
-
-    int utility = 0;
-    int current_value;
-    string current_color;
-    string current_type;
-    for (int row = 0; row < 8; row++)
+    SearchLimits limits = level_limits(m_level);
+    limits.multi_pv = analysis_lines;
+    SearchResult result = think(limits);
+    for (size_t i = 0; i < result.lines.size(); i++)
     {
-        for (int col = 0; col < 8; col++)
-        {
-            if (board[row][col]->has_piece())
-            {
-                // material value
-                current_color = board[row][col]->get_piece()->get_color();
-                current_type = board[row][col]->get_piece()->get_type();
-                current_value = (current_color == "white") ? key_values[current_type] : (-1) * key_values[current_type];
-                utility += current_value;
-
-                // mobility except for king
-                if (current_type != "king"){
-                    set<std::tuple<int, int>> valids;
-                    std::tuple<int, int> pos = std::make_tuple(row, col);
-                    get_valid_moves(valids, pos);
-                    current_value = (current_color == "white") ? valids.size() : (-1) * valids.size();
-                    utility += (mobility * current_value);
-                }
-            }
-        }
+        cout << i + 1 << ". " << score_to_string(result.lines[i].score) << "  "
+             << line_to_san(m_game, result.lines[i].pv) << endl;
     }
-    return utility;
+    if (!result.lines.empty())
+        window->setTitle("Chess - " + score_to_string(result.lines[0].score) + " " + line_to_san(m_game, result.lines[0].pv));
 }
 
 
 /*
 * NAME
-*      CountPieces - this function counts the remaining pieces on the board
+*      ShowGames - shows the games of the database that reached the game's position
 *
 * SYNOPSYS
 *
-*      int Board::count_pieces();
- *
+*      void Board::show_games();
 *
 * DESCRIPTION
-*   Loops through the board and counts the number of pieces
+*
+*  This function looks the game's position up in the index, if one was given, and puts the number of games
+ *  and their results in the window title. A lookup is a binary search in the mapped index, quick enough for every move.
 */
-int Board::count_pieces() {
-    int num_pieces = 0;
-    for (int row = 0; row < 8; row++)
-    {
-        for (int col = 0; col < 8; col++) {
-            if (board[row][col]->has_piece())
-                num_pieces++;
-        }
-    }
-    return num_pieces;
+void Board::show_games()
+{
+    if (m_index == nullptr)
+        return;
+    IndexSummary summary = m_index->summarize(m_game.key());
+    string games = to_string(summary.games) + " games: +" + to_string(summary.results[GAME_WHITE_WINS])
+                 + " =" + to_string(summary.results[GAME_DRAWN]) + " -" + to_string(summary.results[GAME_BLACK_WINS]);
+    cout << games << endl;
+    window->setTitle("Chess - " + games);
 }
-
@@ -7,6 +7,10 @@
 #include <vector>
 #include "Piece.h"
 #include "Square.h"
+#include "Search.h"
+#include "PositionIndex.h"
+#include "Mcts.h"
+#include "Difficulty.h"
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <iostream>
@@ -47,18 +51,20 @@ private:
     sf::RenderWindow* side_window;
     sf::RenderWindow* option_window;
 
-    const int max_steps = 4;                                            // Max number of depth for minimax
-    std::tuple<std::tuple<int, int>, std::tuple<int, int>> best_action; // Best action returned by minimax
-                                                                        // tuple of one piece and the best valid move for it
-                                                                        // essentially, the best move that the ai can make
+    int m_level;                                                // Difficulty level of the engine's moves, see Difficulty.h
+    uint64_t m_seed;                                            // Seed of the level's random picks in this game
+    const int analysis_lines = 3;                               // Number of best moves the analysis shows
+    const int mcts_playouts = 20000;                            // Playouts per move of the MCTS engine
+    Search m_search;                                            // Graphics independent minimax
+    Mcts m_mcts;                                                // Monte Carlo tree search, the alternative engine
+    EngineKind m_engine;                                        // Engine that plays and analyzes
+    Position m_game;                                            // The game being played, the main board shows it
+    vector<uint64_t> m_history;                                 // Keys of the game's positions, the current one last
+    const PositionIndex* m_index;                               // Game database shown for the game's position, if any
 
     // Return the main board
     Square* (*get_board())[8][8] { return &board; }
 
-    // Check if the last piece on the valid move is an opposing piece
-    // If so, add to the valid moves, the square on which the opposing piece exists
-    void get_valid_on_piece(string piece_color, std::tuple<int, int>& oppose_pos, set<std::tuple<int, int>>& v);
-
     // Run graphics when the piece reaches last square
     // Give option to change pieces
     void change_pawn_on_last(std::tuple<int, int>& pos);
@@ -69,56 +75,47 @@ private:
     // Get valid move for a piece
     void get_valid_moves(set<tuple<int, int>>& v, tuple<int, int>& pos);
 
-    /*
-     * Helper functions for get_valid_moves start
-     */
-
-    // Ensure the potential valid move is within the board
-    bool is_within(tuple<int, int>& pos);
-
-    // Help find the valid moves for a Pawn
-    void deal_pawns(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos, bool goes_up);
-
-    // Help find the valid move for pieces with continuous valid moves
-    void continue_until_piece(string piece_color, set<std::tuple<int, int>>& v, std::tuple<int, int>& pos, std::tuple<int, int>& potential_pos);
-
-    // Help find the valid moves for a rook
-    void deal_rook(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos);
-
-    // Help find the valid moves for a Bishop
-    void deal_bishop(set<std::tuple<int, int>>& v, std::tuple<int, int>& pos);
-
-    /*
-     * Helper functions for get_valid_moves end
-     */
-
     // Return the square on which user clicked
     std::tuple<int, int> on_click_get_square(sf::Event& event);
 
     // Minimax originator
     void smart_guy(unsigned int a_space_size);
 
-    // Evaluation function: returns the utility of the board
-    int smart_guys_helper();
+    // Search the game's position with the selected engine
+    SearchResult think(SearchLimits limits);
 
-    // Return all valid moves for a side
-    void get_all_valids(set< std::tuple<std::tuple<int, int>, std::tuple<int, int>>>& all_valids, string side);
+    // Show the engine's best lines for the side to move
+    void analyze();
 
-    // Check if the board has reached a terminal state
-    bool is_terminal();
+    // Show how many games of the index reached the game's position and their results
+    void show_games();
 
-    // Utility minimizer
-    int minimize(int &steps, int alpha_comp_util);
+    // Update the squares of the main board whose piece differs from the game
+    void sync_board();
 
-    // Utility maximizer
-    int maximize(int &steps, int alpha_comp_util);
+    // Play the user's move between the squares in the game, promoting to the chosen type
+    void make_user_move(int from, int to, string promotion);
 
-    // Count pieces: helper for evaluation function
-    int count_pieces();
+    // Check if the board has reached a terminal state
+    bool is_terminal();
 
 public:
     Board();
     void graphics();
+
+    // Select the engine's evaluation, see Search::set_evaluation
+    void set_evaluation(EvalKind kind, const Network* network)
+    {
+        m_search.set_evaluation(kind, network);
+        m_mcts.set_evaluation(kind, network);
+    }
+
+    // Select the engine, and the threads of the MCTS engine
+    void set_engine(EngineKind engine, int threads = 1) { m_engine = engine; m_mcts.set_threads(threads); }
+    // Select the difficulty level of the engine's moves and the seed of its picks, see Difficulty.h
+    void set_level(int level, uint64_t seed) { m_level = level; m_seed = seed; }
+    // Select the game database the board shows, see show_games
+    void set_index(const PositionIndex* index) { m_index = index; }
     ~Board();
 };
 
@@ -0,0 +1,440 @@
+#include "Book.h"
+#include "Notation.h"
+#include "Pgn.h"
+#include "PackedPosition.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+static const size_t book_shards = 64;
+
+// Bytes of PGN text a thread takes at a time
+static const size_t chunk_bytes = 4 << 20;
+
+// Samples a thread collects before adding them to the shards
+static const size_t flush_samples = 1 << 16;
+
+static const size_t record_bytes = 16;
+
+
+/*
+* NAME
+*      BookMove -- encodes a move for the book
+*
+* SYNOPSYS
+*
+*      uint16_t book_move(const Position& position, Move m);
+*      position    ->  the position before the move
+*      m           ->  a legal move of the position
+*
+* DESCRIPTION
+*
+*  Packs to, from and promotion like the engine, with squares numbered the same way, but counts
+ *  the promotion pieces from 1 for a knight and writes castling as the king moving to its rook's square.
+*/
+uint16_t book_move(const Position& position, Move m)
+{
+    int from = move_from(m), to = move_to(m);
+    if (type_of(position.piece_on(from)) == KING && (to - from == 2 || from - to == 2))
+        to = (to > from) ? from + 3 : from - 4;
+    PieceType promotion = move_promotion(m);
+    int piece = (promotion == NO_TYPE) ? 0 : promotion - KNIGHT + 1;
+    return (uint16_t)(to | (from << 6) | (piece << 12));
+}
+
+
+/*
+* NAME
+*      FromBookMove -- decodes a book move
+*
+* SYNOPSYS
+*
+*      Move from_book_move(const Position& position, uint16_t move);
+*
+* DESCRIPTION
+*
+*  Returns MOVE_NONE if the move is not legal in the position, as for an entry of another position
+ *  sharing the key.
+*/
+Move from_book_move(const Position& position, uint16_t move)
+{
+    int to = move & 63, from = (move >> 6) & 63, piece = (move >> 12) & 7;
+    uint8_t moving = position.piece_on(from);
+    if (type_of(moving) == KING && position.piece_on(to) == make_piece(color_of(moving), ROOK))
+        to = (to > from) ? from + 2 : from - 2;
+    Move m = encode_move(from, to, piece ? (PieceType)(piece + KNIGHT - 1) : NO_TYPE);
+    return position.is_legal(m) ? m : MOVE_NONE;
+}
+
+
+/*
+* NAME
+*      BookBuilder -- creates a book builder without any games
+*
+* SYNOPSYS
+*
+*      BookBuilder::BookBuilder(const BookOptions& options);
+*/
+BookBuilder::BookBuilder(const BookOptions& options) : m_options(options), m_shards(book_shards)
+{
+    m_shard_limit = std::max<size_t>(1, options.max_entries / book_shards);
+    m_pruned = 0;
+}
+
+
+/*
+* NAME
+*      AddPgn -- adds the openings of a PGN file
+*
+* SYNOPSYS
+*
+*      bool BookBuilder::add_pgn(const string& filename);
+*
+* DESCRIPTION
+*
+*  The file is mapped rather than read, and cut into chunks of 4 MB; each thread takes the next chunk
+ *  and parses the games starting in it, so no thread waits on another except briefly for a shard's lock.
+ *  Memory stays bounded by the entry limit and the threads' sample buffers, whatever the size of the file.
+*/
+bool BookBuilder::add_pgn(const string& filename)
+{
+    MappedFile file(filename);
+    if (!file.is_open())
+        return false;
+    file.advise_sequential();
+    const char* data = (const char*)file.data();
+    size_t size = file.size();
+
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next_chunk(0);
+    atomic<uint64_t> total_games(0);
+    vector<thread> threads;
+    for (int i = 0; i < m_options.threads; i++)
+    {
+        threads.emplace_back([&]() {
+            vector<Sample> samples;
+            samples.reserve(flush_samples + 1024);
+            uint64_t games = 0;
+            for (size_t chunk = next_chunk++; chunk * chunk_bytes < size; chunk = next_chunk++)
+                add_chunk(data, size, chunk * chunk_bytes, std::min(size, (chunk + 1) * chunk_bytes), games, samples);
+            flush(samples);
+            total_games += games;
+        });
+    }
+    for (thread& t : threads)
+        t.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t entries = 0;
+    for (Shard& shard : m_shards)
+        entries += shard.counts.size();
+    cout << filename << ": " << total_games << " games, " << fixed << setprecision(1) << size / 1048576.0 << " MB in "
+         << seconds << " s (" << size / 1048576.0 / std::max(seconds, 1e-6) << " MB/s), " << entries << " pairs, "
+         << m_pruned << " pruned" << endl;
+    return true;
+}
+
+
+/*
+* NAME
+*      AddChunk -- adds the openings of the games starting in a chunk
+*
+* SYNOPSYS
+*
+*      void BookBuilder::add_chunk(const char* data, size_t size, size_t begin, size_t end, uint64_t& games,
+*                                  vector<Sample>& samples);
+*      games       ->  counts the games parsed
+*      samples     ->  the thread's samples not added to the shards yet
+*
+* DESCRIPTION
+*
+*  Games without a result add nothing. A game is replayed to encode its moves for the book;
+ *  the result goes to each move from the point of view of the side playing it.
+*/
+void BookBuilder::add_chunk(const char* data, size_t size, size_t begin, size_t end, uint64_t& games,
+                            vector<Sample>& samples)
+{
+    PgnParser parser(data, size, begin, end, m_options.max_plies);
+    PgnGame game;
+    Position position;
+    while (parser.next(game))
+    {
+        games++;
+        if (game.result == RESULT_NONE || game.moves.empty())
+            continue;
+        if (game.fen.empty())
+            position.set_start();
+        else if (!position.set_fen(game.fen))
+            continue;
+        for (Move m : game.moves)
+        {
+            int8_t result = (position.side_to_move() == WHITE) ? game.result : -game.result;
+            samples.push_back(Sample{ position.key(), book_move(position, m), result });
+            Undo undo;
+            position.make_move(m, undo);
+        }
+        if (samples.size() >= flush_samples)
+            flush(samples);
+    }
+}
+
+
+/*
+* NAME
+*      Flush -- adds samples to the shards
+*
+* SYNOPSYS
+*
+*      void BookBuilder::flush(vector<Sample>& samples);
+*
+* DESCRIPTION
+*
+*  The samples are sorted by shard, so each shard is locked once. A shard over its limit forgets the pairs
+ *  played in one game, then two and so on, until it is back to three quarters of the limit.
+*/
+void BookBuilder::flush(vector<Sample>& samples)
+{
+    auto shard_of = [](const Sample& sample) { return sample.key >> 58; };
+    std::sort(samples.begin(), samples.end(), [&](const Sample& a, const Sample& b) { return shard_of(a) < shard_of(b); });
+    for (size_t first = 0; first < samples.size(); )
+    {
+        Shard& shard = m_shards[shard_of(samples[first])];
+        lock_guard<mutex> lock(shard.lock);
+        size_t last = first;
+        for (; last < samples.size() && shard_of(samples[last]) == shard_of(samples[first]); last++)
+        {
+            BookCounts& counts = shard.counts[make_pair(samples[last].key, samples[last].move)];
+            if (samples[last].result > 0)
+                counts.wins++;
+            else if (samples[last].result < 0)
+                counts.losses++;
+            else
+                counts.draws++;
+        }
+        first = last;
+
+        for (uint32_t rarest = 1; shard.counts.size() > m_shard_limit; rarest++)
+        {
+            for (auto it = shard.counts.begin(); it != shard.counts.end() && shard.counts.size() > m_shard_limit * 3 / 4; )
+            {
+                const BookCounts& counts = it->second;
+                if (counts.wins + counts.draws + counts.losses <= rarest)
+                {
+                    it = shard.counts.erase(it);
+                    m_pruned++;
+                }
+                else
+                    ++it;
+            }
+        }
+    }
+    samples.clear();
+}
+
+
+/*
+* NAME
+*      Write -- writes the book
+*
+* SYNOPSYS
+*
+*      bool BookBuilder::write(const string& filename);
+*
+* DESCRIPTION
+*
+*  Pairs played in fewer than min_games games are left out. The records are sorted by key, then by weight,
+ *  heaviest first, and written big-endian.
+*/
+bool BookBuilder::write(const string& filename)
+{
+    struct Record
+    {
+        uint64_t key;
+        uint16_t move;
+        uint64_t weight;
+    };
+    vector<Record> records;
+    for (Shard& shard : m_shards)
+    {
+        for (auto& pair_counts : shard.counts)
+        {
+            const BookCounts& counts = pair_counts.second;
+            if (counts.wins + counts.draws + counts.losses >= (uint32_t)m_options.min_games)
+                records.push_back(Record{ pair_counts.first.first, pair_counts.first.second, 2ULL * counts.wins + counts.draws });
+        }
+        shard.counts = CountMap();
+    }
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+    });
+
+    ofstream out(filename, ios::binary);
+    if (!out)
+    {
+        cout << "Could not write " << filename << endl;
+        return false;
+    }
+    uint64_t heaviest = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        // the first record of a position is its heaviest
+        if (i == 0 || records[i].key != records[i - 1].key)
+            heaviest = records[i].weight;
+        uint64_t weight = (heaviest > 65535) ? records[i].weight * 65535 / heaviest : records[i].weight;
+        unsigned char bytes[record_bytes] = {};
+        for (int b = 0; b < 8; b++)
+            bytes[b] = (unsigned char)(records[i].key >> (56 - 8 * b));
+        bytes[8] = (unsigned char)(records[i].move >> 8);
+        bytes[9] = (unsigned char)records[i].move;
+        bytes[10] = (unsigned char)(weight >> 8);
+        bytes[11] = (unsigned char)weight;
+        out.write((const char*)bytes, sizeof(bytes));
+    }
+    cout << filename << ": " << records.size() << " moves" << endl;
+    return (bool)out;
+}
+
+
+/*
+* NAME
+*      Open -- maps a book
+*
+* SYNOPSYS
+*
+*      bool Book::open(const string& filename);
+*/
+bool Book::open(const string& filename)
+{
+    if (!m_file.open(filename))
+        return false;
+    if (m_file.size() % record_bytes)
+    {
+        cout << filename << " is not a book" << endl;
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      Probe -- finds the book moves of a position
+*
+* SYNOPSYS
+*
+*      int Book::probe(const Position& position, vector<BookEntry>& entries) const;
+*
+* DESCRIPTION
+*
+*  A binary search finds the position's first record; only the pages it touches are read from the file.
+ *  Moves that are not legal in the position, which belong to another position with the same key, are skipped.
+*/
+int Book::probe(const Position& position, vector<BookEntry>& entries) const
+{
+    auto read = [this](size_t index, int offset, int bytes) {
+        uint64_t value = 0;
+        const unsigned char* record = m_file.data() + index * record_bytes + offset;
+        for (int b = 0; b < bytes; b++)
+            value = (value << 8) | record[b];
+        return value;
+    };
+    uint64_t key = position.key();
+    size_t low = 0, high = size();
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (read(middle, 0, 8) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    int found = 0;
+    for (size_t index = low; index < size() && read(index, 0, 8) == key; index++)
+    {
+        Move m = from_book_move(position, (uint16_t)read(index, 8, 2));
+        if (m == MOVE_NONE)
+            continue;
+        entries.push_back(BookEntry{ key, m, (uint16_t)read(index, 10, 2), (uint32_t)read(index, 12, 4) });
+        found++;
+    }
+    return found;
+}
+
+
+/*
+* NAME
+*      BookCommand -- builds or probes an opening book
+*
+* SYNOPSYS
+*
+*      int book_command(int argc, char* argv[]);
+*
+* DESCRIPTION
+*
+*  book build <games.pgn> <book.bin> [options]
+ *     -threads <n>        parsing threads, one per core by default
+ *     -plies <n>          moves of each game in the book, 24 by default
+ *     -min-games <n>      games a move needs to be kept, 2 by default
+ *     -max-entries <n>    (position, move) pairs held while building, 4000000 by default
+ *  book probe <book.bin> <fen>
+ *     prints the position's book moves with their weights and shares
+*/
+int book_command(int argc, char* argv[])
+{
+    string action = (argc >= 1) ? argv[0] : "";
+    if (action == "build" && argc >= 3)
+    {
+        BookOptions options = { std::max(1, (int)thread::hardware_concurrency()), 24, 2, 4000000 };
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            string option = argv[i], value = argv[i + 1];
+            if (option == "-threads")
+                options.threads = std::max(1, atoi(value.c_str()));
+            else if (option == "-plies")
+                options.max_plies = std::max(1, atoi(value.c_str()));
+            else if (option == "-min-games")
+                options.min_games = std::max(1, atoi(value.c_str()));
+            else if (option == "-max-entries")
+                options.max_entries = std::max(1ULL, strtoull(value.c_str(), nullptr, 10));
+            else
+            {
+                cout << "Bad option " << option << " " << value << endl;
+                return 1;
+            }
+        }
+        BookBuilder builder(options);
+        return (builder.add_pgn(argv[1]) && builder.write(argv[2])) ? 0 : 1;
+    }
+    if (action == "probe" && argc == 3)
+    {
+        Book book;
+        Position position;
+        if (!book.open(argv[1]))
+            return 1;
+        if (!position.set_fen(argv[2]))
+        {
+            cout << "Bad FEN " << argv[2] << endl;
+            return 1;
+        }
+        vector<BookEntry> entries;
+        book.probe(position, entries);
+        uint64_t total = 0;
+        for (const BookEntry& entry : entries)
+            total += entry.weight;
+        for (const BookEntry& entry : entries)
+            cout << move_to_san(position, entry.move) << " " << entry.weight << " " << fixed << setprecision(1)
+                 << (total ? 100.0 * entry.weight / total : 0.0) << "%" << endl;
+        if (entries.empty())
+            cout << "not in book" << endl;
+        return 0;
+    }
+    cout << "usage: ChessAI book build <games.pgn> <book.bin> [options]" << endl
+         << "       ChessAI book probe <book.bin> <fen>" << endl;
+    return 1;
+}
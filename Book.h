@@ -0,0 +1,123 @@
+/*
+Book functions and BookBuilder class
+-- The engine's own book format: 16 byte big-endian records of position key, move, weight and learn value,
+   sorted by key and then by weight, so a position's moves are found by binary search in the mapped file.
+-- Keys are the engine's Zobrist keys and moves are 16 bit to, from and promotion, castling written as the king
+   taking its own rook. The records are laid out like Polyglot's, but Polyglot keys positions differently:
+   its tools find nothing in these books, and this engine finds nothing in Polyglot books.
+-- The builder maps a PGN file, cuts it into chunks at game starts and parses the chunks on all cores.
+   Every game adds a win, draw or loss, for the side to move, to each (position, move) of its opening,
+   collected in hash map shards each with its own lock. Memory stays bounded: a shard that outgrows its share
+   of the entry limit forgets the pairs met in the fewest games, a single one first.
+-- The weight of a move is twice its wins plus its draws, scaled down per position to fit 16 bits.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Position.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+struct BookEntry
+{
+    uint64_t key;                           // Zobrist key of the position
+    Move move;                              // the engine's encoding
+    uint16_t weight;                        // how often to play the move, relative to the position's other moves
+    uint32_t learn;                         // unused, 0
+};
+
+// The book's 16 bit move of a legal move in the position / the engine's move of a book move
+uint16_t book_move(const Position& position, Move m);
+Move from_book_move(const Position& position, uint16_t move);
+
+struct BookOptions
+{
+    int threads;                            // parsing threads
+    int max_plies;                          // moves of each game that go into the book
+    int min_games;                          // games a move needs to be kept
+    size_t max_entries;                     // (position, move) pairs held while building
+};
+
+// Games won, drawn and lost by the side playing a move
+struct BookCounts
+{
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+};
+
+class BookBuilder
+{
+private:
+    struct PairHash
+    {
+        size_t operator()(const pair<uint64_t, uint16_t>& p) const
+        {
+            return p.first ^ ((uint64_t)p.second * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+    // counts by position key and book move
+    typedef unordered_map<pair<uint64_t, uint16_t>, BookCounts, PairHash> CountMap;
+
+    struct Shard
+    {
+        mutex lock;
+        CountMap counts;
+    };
+
+    // A game's contribution waiting to be added to a shard
+    struct Sample
+    {
+        uint64_t key;
+        uint16_t move;                      // book encoding
+        int8_t result;                      // for the side playing the move
+    };
+
+    BookOptions m_options;
+    vector<Shard> m_shards;                 // a pair lives in the shard of its key's high bits
+    size_t m_shard_limit;                   // entries a shard holds before forgetting the rarest pairs
+    atomic<uint64_t> m_pruned;              // pairs forgotten
+
+    // Add the samples to their shards, locking each shard once
+    void flush(vector<Sample>& samples);
+
+    // Parse the games starting in the chunk and add their openings
+    void add_chunk(const char* data, size_t size, size_t begin, size_t end, uint64_t& games, vector<Sample>& samples);
+
+public:
+    BookBuilder(const BookOptions& options);
+
+    // Parse every game of the PGN file; returns false if it cannot be read
+    bool add_pgn(const string& filename);
+
+    // Write the pairs played in enough games, returns false if the file cannot be written
+    bool write(const string& filename);
+};
+
+// Opening book read through a memory mapping
+class Book
+{
+private:
+    MappedFile m_file;
+
+public:
+    // Map the book, returns false if it is not one
+    bool open(const string& filename);
+
+    // Append the position's moves to entries, heaviest first; returns how many there are
+    int probe(const Position& position, vector<BookEntry>& entries) const;
+
+    size_t size() const { return m_file.size() / 16; }
+};
+
+// Command line entry point: ChessAI book build <games.pgn> <book.bin> [options] / ChessAI book probe <book.bin> <fen>
+int book_command(int argc, char* argv[]);
@@ -0,0 +1,162 @@
+#include "Cpu.h"
+#include "Bitboard.h"
+#include "Nnue.h"
+#include <iostream>
+
+static const char* const tier_names[CPU_TIERS] = { "generic", "sse41", "avx2", "bmi2" };
+
+static CpuTier selected_tier = CPU_GENERIC;
+
+
+/*
+* NAME
+*      CpuSupports -- checks the host's instruction sets for a tier
+*
+* SYNOPSYS
+*
+*      bool cpu_supports(CpuTier tier);
+*
+* DESCRIPTION
+*
+*  The compiler's CPUID helpers also check that the operating system saves the AVX registers.
+*/
+bool cpu_supports(CpuTier tier)
+{
+#ifdef CHESS_DISPATCH
+    __builtin_cpu_init();
+    switch (tier)
+    {
+    case CPU_BMI2:
+        if (!__builtin_cpu_supports("bmi2"))
+            return false;
+        // fall through
+    case CPU_AVX2:
+        if (!__builtin_cpu_supports("avx2"))
+            return false;
+        // fall through
+    case CPU_SSE41:
+        return __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("sse4.1");
+    default:
+        return true;
+    }
+#else
+    return tier == CPU_GENERIC;
+#endif
+}
+
+
+/*
+* NAME
+*      DetectCpuTier -- returns the best tier of the host
+*
+* SYNOPSYS
+*
+*      CpuTier detect_cpu_tier();
+*/
+CpuTier detect_cpu_tier()
+{
+#ifdef CHESS_DISPATCH
+    __builtin_cpu_init();
+    bool slow_pext = __builtin_cpu_is("znver1") || __builtin_cpu_is("znver2");
+#else
+    bool slow_pext = true;
+#endif
+    if (!slow_pext && cpu_supports(CPU_BMI2))
+        return CPU_BMI2;
+    if (cpu_supports(CPU_AVX2))
+        return CPU_AVX2;
+    if (cpu_supports(CPU_SSE41))
+        return CPU_SSE41;
+    return CPU_GENERIC;
+}
+
+
+/*
+* NAME
+*      SetCpuTier -- selects the kernels of a tier
+*
+* SYNOPSYS
+*
+*      bool set_cpu_tier(CpuTier tier);
+*
+* DESCRIPTION
+*
+*  This function points the popcount, sliding attack and network kernels at the tier's versions.
+ *  Switching between magic and PEXT attacks refills the attack tables, so no search may be running.
+*/
+bool set_cpu_tier(CpuTier tier)
+{
+    if (!cpu_supports(tier))
+    {
+        cout << "This CPU cannot run the " << cpu_tier_name(tier) << " kernels" << endl;
+        return false;
+    }
+    select_bitboard_kernels(tier);
+    select_nnue_kernels(tier);
+    selected_tier = tier;
+    return true;
+}
+
+
+/*
+* NAME
+*      CpuTier -- returns the tier of the kernels in use
+*
+* SYNOPSYS
+*
+*      CpuTier cpu_tier();
+*/
+CpuTier cpu_tier()
+{
+    return selected_tier;
+}
+
+
+/*
+* NAME
+*      CpuTierName, ParseCpuTier -- convert between tiers and their names
+*
+* SYNOPSYS
+*
+*      const char* cpu_tier_name(CpuTier tier);
+*      bool parse_cpu_tier(const string& name, CpuTier& tier);
+*/
+const char* cpu_tier_name(CpuTier tier)
+{
+    return tier_names[tier];
+}
+
+bool parse_cpu_tier(const string& name, CpuTier& tier)
+{
+    for (int i = 0; i < CPU_TIERS; i++)
+    {
+        if (name == tier_names[i])
+        {
+            tier = (CpuTier)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+* NAME
+*      CpuCommand -- prints the tiers of the host
+*
+* SYNOPSYS
+*
+*      int cpu_command();
+*
+* DESCRIPTION
+*
+*  Prints every tier with whether the host supports it, then the kernels selected.
+*/
+int cpu_command()
+{
+    for (int i = 0; i < CPU_TIERS; i++)
+        cout << tier_names[i] << (cpu_supports((CpuTier)i) ? "  supported" : "  not supported") << endl;
+    cout << "detected " << cpu_tier_name(detect_cpu_tier()) << ", selected " << cpu_tier_name(selected_tier)
+         << ": " << slider_kernel_name() << " attacks, network kernels " << nnue_simd_name() << endl;
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+Cpu functions
+-- One binary for every x86-64 host: the hot kernels are compiled for several instruction set tiers and the best one
+   the CPU supports is selected once at startup, through function pointers, before any thread starts.
+-- Tiers, each including the ones before it:
+   generic  software popcount, magic multiply sliding attacks, plain C++ network kernels
+   sse41    POPCNT, SSE4.1 network kernels
+   avx2     AVX2 network kernels
+   bmi2     PEXT sliding attacks
+-- The bmi2 tier is not detected on AMD Zen 1 and Zen 2, where PEXT is microcoded and slower than magics,
+   but it can still be forced there, as can any tier the host supports, to compare the kernels.
+-- Builds whose compiler target already has POPCNT (-mpopcnt, -march=native...) inline popcount and skip its dispatch.
+   Other architectures, or x86 with CHESS_NO_DISPATCH defined, have the generic tier only.
+*/
+
+
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+#if !defined(CHESS_NO_DISPATCH) && (defined(__x86_64__) || defined(__i386__))
+#define CHESS_DISPATCH
+#endif
+
+enum CpuTier { CPU_GENERIC, CPU_SSE41, CPU_AVX2, CPU_BMI2, CPU_TIERS };
+
+// Best tier of the host
+CpuTier detect_cpu_tier();
+
+// Whether the host can run the tier's kernels
+bool cpu_supports(CpuTier tier);
+
+// Select the tier's kernels, returns false if the host cannot run them; call before starting threads
+bool set_cpu_tier(CpuTier tier);
+
+// Tier of the kernels in use
+CpuTier cpu_tier();
+
+const char* cpu_tier_name(CpuTier tier);
+
+// Tier of a name printed by cpu_tier_name, returns false for an unknown name
+bool parse_cpu_tier(const string& name, CpuTier& tier);
+
+// Command line entry point: ChessAI cpu, prints the tiers the host supports and the one selected
+int cpu_command();
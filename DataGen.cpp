@@ -0,0 +1,354 @@
+#include "DataGen.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Slots probed for a key, the 64 bytes of a cache line
+static const size_t key_set_probes = 8;
+
+
+/*
+* NAME
+*      KeySet -- creates an empty key set
+*
+* SYNOPSYS
+*
+*      KeySet::KeySet(size_t megabytes);
+*/
+KeySet::KeySet(size_t megabytes)
+{
+    size_t slots = key_set_probes;
+    while (slots * 2 * sizeof(uint64_t) <= std::max<size_t>(megabytes, 1) << 20)
+        slots *= 2;
+    m_slots.reset(new atomic<uint64_t>[slots]);
+    for (size_t i = 0; i < slots; i++)
+        m_slots[i].store(0, memory_order_relaxed);
+    m_mask = slots - 1;
+}
+
+
+/*
+* NAME
+*      Insert -- adds a key to the set
+*
+* SYNOPSYS
+*
+*      bool KeySet::insert(uint64_t key);
+*
+* DESCRIPTION
+*
+*  The key is looked for in the cache line of slots its low bits select, and claimed with a compare-and-swap
+ *  in the first empty one. Two threads adding the same key race for the same slot, so only one of them wins.
+ *  A key finding its line full is not remembered and counts as new, so a full set lets duplicates through
+ *  rather than dropping new positions. The key 0 marks empty slots and is stored as 1.
+*/
+bool KeySet::insert(uint64_t key)
+{
+    key = key ? key : 1;
+    size_t line = key & m_mask & ~(key_set_probes - 1);
+    for (size_t i = 0; i < key_set_probes; i++)
+    {
+        atomic<uint64_t>& slot = m_slots[line + i];
+        uint64_t found = slot.load(memory_order_relaxed);
+        if (found == 0 && slot.compare_exchange_strong(found, key, memory_order_relaxed))
+            return true;
+        if (found == key)
+            return false;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      DataGenerator -- opens the output and sets up the key set
+*
+* SYNOPSYS
+*
+*      DataGenerator::DataGenerator(const string& filename, const DataGenOptions& options, const Network* network);
+*      filename    ->  the PackedPosition file, appended to if it exists
+*      network     ->  network the searches evaluate with, nullptr for the handcrafted evaluation
+*/
+DataGenerator::DataGenerator(const string& filename, const DataGenOptions& options, const Network* network)
+    : m_options(options), m_network(network), m_writer(filename, true), m_keys(options.dedup_megabytes),
+      m_stop(false), m_duplicates(0), m_nodes(0), m_written(0), m_games(0)
+{
+}
+
+
+/*
+* NAME
+*      Run -- generates the positions
+*
+* SYNOPSYS
+*
+*      uint64_t DataGenerator::run();
+*
+* DESCRIPTION
+*
+*  This function starts a worker per thread, waits for them, flushes the output and prints the final report.
+*/
+uint64_t DataGenerator::run()
+{
+    m_start = m_last_flush = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int i = 0; i < m_options.threads; i++)
+        workers.emplace_back(&DataGenerator::worker, this, i);
+    for (auto& worker : workers)
+        worker.join();
+
+    lock_guard<mutex> lock(m_mutex);
+    m_writer.flush();
+    report();
+    return m_written;
+}
+
+
+/*
+* NAME
+*      Worker -- plays games until enough positions are written
+*
+* SYNOPSYS
+*
+*      void DataGenerator::worker(int index);
+*      index       ->  the thread number, which with the seed makes its random openings
+*/
+void DataGenerator::worker(int index)
+{
+    TRACE_THREAD("datagen worker");
+    Search search;
+    search.set_evaluation(m_network ? EVAL_NNUE : EVAL_HANDCRAFTED, m_network);
+    mt19937_64 random(m_options.seed * 0x9E3779B97F4A7C15ULL + index);
+    vector<PackedPosition> samples;
+    samples.reserve(m_options.max_plies);
+    while (!m_stop)
+    {
+        samples.clear();
+        int8_t result;
+        if (play_game(search, random, samples, result))
+            record_game(samples, result);
+    }
+}
+
+
+/*
+* NAME
+*      PlayGame -- plays one game and collects its quiet positions
+*
+* SYNOPSYS
+*
+*      bool DataGenerator::play_game(Search& search, mt19937_64& random, vector<PackedPosition>& samples, int8_t& result);
+*      samples     ->  receives the positions kept, scored from white's view
+*      result      ->  receives the result from white's view
+*
+* DESCRIPTION
+*
+*  The game starts with random_plies random legal moves, or one more, so that either side may be to move.
+ *  An opening that ends the game, or whose first search finds one side clearly better, is dropped.
+ *  Every move is then the best move of a search with the node budget. The game ends as in SelfPlay::play_game.
+ *  A position is kept if its side to move is not in check, the best move neither captures nor promotes,
+ *  the score is not a mate, and no thread kept it before.
+*/
+bool DataGenerator::play_game(Search& search, mt19937_64& random, vector<PackedPosition>& samples, int8_t& result)
+{
+    TRACE_SCOPE("datagen", "game");
+    // a thread's games depend on the seed only, not on what the search remembers of its earlier games
+    search.clear();
+    Position position;
+    position.set_start();
+    vector<uint64_t> keys(1, position.key());
+    MoveList legal;
+    int random_plies = m_options.random_plies + (int)(random() & 1);
+    for (int plies = 0; plies < random_plies; plies++)
+    {
+        legal.clear();
+        position.get_all_valids(legal);
+        if (legal.empty())
+            return false;
+        Undo undo;
+        position.make_move(legal[random() % legal.size()], undo);
+        keys.push_back(position.key());
+    }
+
+    SearchLimits limits;
+    limits.depth = 0;
+    limits.nodes = m_options.nodes;
+    result = 0;
+    for (int plies = 0; !m_stop; plies++)
+    {
+        legal.clear();
+        position.get_all_valids(legal);
+        if (legal.empty())
+        {
+            if (plies == 0)
+                return false;
+            if (position.in_check())
+                result = (position.side_to_move() == WHITE) ? -1 : 1;
+            return true;
+        }
+        if (position.halfmove() >= 100 || count_repetitions(keys, position.halfmove()) >= 3
+            || position.count_pieces() == 2 || plies >= m_options.max_plies)
+            return true;
+
+        SearchResult found = search.smart_guy(position, limits, keys);
+        m_nodes += found.nodes;
+        if (plies == 0 && abs(found.score) > m_options.max_opening_score)
+            return false;
+        Move move = (found.best_move != MOVE_NONE) ? found.best_move : legal[0];
+        if (!position.in_check() && !position.is_capture(move) && move_promotion(move) == NO_TYPE
+            && !is_mate_score(found.score))
+        {
+            if (m_keys.insert(position.key()))
+                samples.push_back(pack_position(position, (int16_t)found.score));
+            else
+                m_duplicates++;
+        }
+
+        Undo undo;
+        position.make_move(move, undo);
+        keys.push_back(position.key());
+    }
+    return false;
+}
+
+
+/*
+* NAME
+*      RecordGame -- writes a finished game's positions
+*
+* SYNOPSYS
+*
+*      void DataGenerator::record_game(vector<PackedPosition>& samples, int8_t result);
+*
+* DESCRIPTION
+*
+*  This function stamps the result on the positions and appends them. Every flush_seconds it flushes the file,
+ *  so the positions written so far survive an interrupted run, and reports. Once enough positions are written
+ *  the workers stop; the games they are playing are dropped.
+*/
+void DataGenerator::record_game(vector<PackedPosition>& samples, int8_t result)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_written >= m_options.positions)
+        return;
+    for (PackedPosition& record : samples)
+    {
+        if (m_written == m_options.positions)
+            break;
+        record.result = result;
+        m_writer.write(record);
+        m_written++;
+    }
+    m_games++;
+    if (m_written >= m_options.positions)
+        m_stop = true;
+
+    auto now = chrono::steady_clock::now();
+    if (now - m_last_flush >= chrono::seconds(m_options.flush_seconds))
+    {
+        m_writer.flush();
+        m_last_flush = now;
+        report();
+    }
+}
+
+
+/*
+* NAME
+*      Report -- prints the progress
+*
+* SYNOPSYS
+*
+*      void DataGenerator::report();
+*
+* DESCRIPTION
+*
+*  Prints positions and games written, duplicates skipped, and positions per second overall and per thread.
+ *  The caller holds m_mutex.
+*/
+void DataGenerator::report()
+{
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - m_start).count();
+    double rate = seconds > 0 ? m_written / seconds : 0;
+    cout << m_written << " positions, " << m_games << " games, " << m_duplicates << " duplicates, "
+         << fixed << setprecision(0) << rate << " positions/s, " << rate / m_options.threads << " per thread, "
+         << (seconds > 0 ? m_nodes / seconds / m_options.threads : 0) << " nodes/s per thread" << endl;
+}
+
+
+/*
+* NAME
+*      DatagenCommand -- generates training positions
+*
+* SYNOPSYS
+*
+*      int datagen_command(int argc, char* argv[]);
+*      argv        ->  the output file, then options with their values
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -positions <n>      positions to write, 1000000 by default
+ *     -threads <n>        games played at once, one per core by default
+ *     -nodes <n>          node budget of every move, 5000 by default
+ *     -random <n>         random plies starting each game, 8 or 9 by default
+ *     -maxplies <n>       draw games reaching n plies, 400 by default
+ *     -maxopen <cp>       drop openings scored beyond cp, 400 by default
+ *     -flush <s>          flush and report every s seconds, 10 by default
+ *     -dedup <MB>         size of the key set of positions kept, 256 by default
+ *     -seed <n>           seed of the random openings
+ *     -nnue <file>        search with the network
+ *  Positions are appended to the output file, so runs with different seeds can be added up.
+*/
+int datagen_command(int argc, char* argv[])
+{
+    if (argc < 1 || argc % 2 == 0)
+    {
+        cout << "usage: ChessAI datagen <out.bin> [options]" << endl;
+        return 1;
+    }
+    DataGenOptions options = { std::max(1, (int)thread::hardware_concurrency()), 1000000, 5000, 8, 400, 400, 10, 256,
+                               (uint64_t)chrono::steady_clock::now().time_since_epoch().count() };
+    string network_filename;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string option = argv[i], value = argv[i + 1];
+        if (option == "-positions")
+            options.positions = strtoull(value.c_str(), nullptr, 10);
+        else if (option == "-threads")
+            options.threads = std::max(1, atoi(value.c_str()));
+        else if (option == "-nodes")
+            options.nodes = std::max(1ULL, strtoull(value.c_str(), nullptr, 10));
+        else if (option == "-random")
+            options.random_plies = std::max(0, atoi(value.c_str()));
+        else if (option == "-maxplies")
+            options.max_plies = std::max(1, atoi(value.c_str()));
+        else if (option == "-maxopen")
+            options.max_opening_score = atoi(value.c_str());
+        else if (option == "-flush")
+            options.flush_seconds = std::max(1, atoi(value.c_str()));
+        else if (option == "-dedup")
+            options.dedup_megabytes = std::max(1, atoi(value.c_str()));
+        else if (option == "-seed")
+            options.seed = strtoull(value.c_str(), nullptr, 10);
+        else if (option == "-nnue")
+            network_filename = value;
+        else
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+
+    Network network;
+    if (!network_filename.empty() && !network.load(network_filename))
+        return 1;
+    DataGenerator generator(argv[0], options, network.is_loaded() ? &network : nullptr);
+    if (!generator.is_open())
+        return 1;
+    generator.run();
+    return 0;
+}
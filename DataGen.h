@@ -0,0 +1,94 @@
+/*
+DataGenerator class
+-- Generates training positions for the evaluation by self-play: many games at a time, one per thread,
+   each starting with a few random moves and searching every move with the same node budget.
+-- Quiet positions are kept, those not in check whose best move is neither a capture nor a promotion,
+   with the search score; once the game ends, its result is added and they are written as PackedPosition records.
+-- A position already kept by any thread is skipped, found in a lock-free key set shared by all threads.
+-- The output is flushed, and throughput reported, every few seconds, so an interrupted run keeps what it made.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "Position.h"
+#include "Search.h"
+#include "PackedPosition.h"
+
+using namespace std;
+
+// Set of position keys that threads add to concurrently, without locks
+class KeySet
+{
+private:
+    unique_ptr<atomic<uint64_t>[]> m_slots; // 0 marks an empty slot
+    size_t m_mask;                          // slots - 1, the slots are a power of two
+
+public:
+    // A set of the largest power of two of keys fitting in the megabytes
+    KeySet(size_t megabytes);
+
+    // Add the key, returns false if it was there already; a key whose slots are all taken counts as new
+    bool insert(uint64_t key);
+};
+
+struct DataGenOptions
+{
+    int threads;                            // games played at once
+    uint64_t positions;                     // positions to write
+    uint64_t nodes;                         // node budget of every search
+    int random_plies;                       // random moves starting each game, one more half of the time
+    int max_plies;                          // games reaching this length are drawn
+    int max_opening_score;                  // games whose first search scores beyond this are dropped, centipawns
+    int flush_seconds;                      // time between flushes and reports
+    size_t dedup_megabytes;                 // size of the key set
+    uint64_t seed;                          // seeds the random openings
+};
+
+class DataGenerator
+{
+private:
+    DataGenOptions m_options;
+    const Network* m_network;               // evaluation of the searches, nullptr for the handcrafted one
+    PackedWriter m_writer;
+    KeySet m_keys;                          // positions kept so far
+
+    atomic<bool> m_stop;                    // enough positions written
+    atomic<uint64_t> m_duplicates;          // quiet positions skipped as kept before
+    atomic<uint64_t> m_nodes;               // nodes searched by all threads
+    mutex m_mutex;                          // guards the writer and the counters below
+    uint64_t m_written, m_games;
+    chrono::steady_clock::time_point m_start, m_last_flush;
+
+    // Worker thread: plays games until enough positions are written
+    void worker(int index);
+
+    // Play one game from a random opening, appending its kept positions, scored but without a result yet;
+    // returns false if the opening was dropped
+    bool play_game(Search& search, mt19937_64& random, vector<PackedPosition>& samples, int8_t& result);
+
+    // Write a finished game's positions with its result, flushing and reporting when it is time
+    void record_game(vector<PackedPosition>& samples, int8_t result);
+
+    // Print positions written and the rates
+    void report();
+
+public:
+    DataGenerator(const string& filename, const DataGenOptions& options, const Network* network);
+
+    bool is_open() const { return m_writer.is_open(); }
+
+    // Generate the positions, returns how many were written
+    uint64_t run();
+};
+
+// Command line entry point: ChessAI datagen <out.bin> [options]
+int datagen_command(int argc, char* argv[]);
@@ -0,0 +1,106 @@
+#include "Difficulty.h"
+#include <algorithm>
+#include <cmath>
+
+// Budgets grow about threefold a level; level 5 spends what the four ply search did in a middlegame
+static const DifficultyLevel difficulty_levels[DIFFICULTY_LEVELS] = {
+    {    400, 5, 400, 200 },
+    {   1000, 5, 250, 120 },
+    {   2000, 4, 150,  70 },
+    {   4000, 3,  80,  40 },
+    {  10000, 3,  40,  20 },
+    {  30000, 2,  20,  10 },
+    { 100000, 1,   0,   0 },
+    { 500000, 1,   0,   0 }
+};
+
+
+/*
+* NAME
+*      DifficultyLevel -- returns the settings of a level
+*
+* SYNOPSYS
+*
+*      const DifficultyLevel& difficulty_level(int level);
+*
+* DESCRIPTION
+*
+*  Levels out of range are clamped to the weakest or the strongest.
+*/
+const DifficultyLevel& difficulty_level(int level)
+{
+    return difficulty_levels[std::min(std::max(level, 1), DIFFICULTY_LEVELS) - 1];
+}
+
+
+/*
+* NAME
+*      LevelLimits -- returns the search limits of a level
+*
+* SYNOPSYS
+*
+*      SearchLimits level_limits(int level);
+*
+* DESCRIPTION
+*
+*  The node budget is the only limit, the depth and time are left open so the cost is the same on any machine.
+*/
+SearchLimits level_limits(int level)
+{
+    SearchLimits limits;
+    limits.depth = 0;
+    limits.nodes = difficulty_level(level).nodes;
+    limits.multi_pv = difficulty_level(level).lines;
+    return limits;
+}
+
+
+/*
+* NAME
+*      ChooseLevelMove -- picks the level's move among the searched lines
+*
+* SYNOPSYS
+*
+*      Move choose_level_move(const SearchResult& result, const Position& position, int level, uint64_t seed);
+*      result      ->  the search of the position with the level's limits
+*      seed        ->  the game's seed
+*
+* DESCRIPTION
+*
+*  Lines scoring within the margin of the best, for the side to move, are the candidates, weighted by
+ *  e^(-loss / temperature). The draw is a splitmix64 hash of the seed and the position's key turned into
+ *  a fraction by hand, not a standard library distribution, so it is the same with every compiler.
+*/
+Move choose_level_move(const SearchResult& result, const Position& position, int level, uint64_t seed)
+{
+    const DifficultyLevel& settings = difficulty_level(level);
+    if (result.lines.empty())
+        return result.best_move;
+    if (settings.temperature <= 0 || result.lines.size() == 1)
+        return result.lines[0].pv[0];
+
+    int sign = (position.side_to_move() == WHITE) ? 1 : -1;
+    int best = sign * result.lines[0].score;
+    double weights[MAX_MOVES];
+    double total = 0;
+    for (size_t i = 0; i < result.lines.size(); i++)
+    {
+        int loss = best - sign * result.lines[i].score;
+        weights[i] = (loss <= settings.margin) ? exp(-(double)loss / settings.temperature) : 0;
+        total += weights[i];
+    }
+
+    uint64_t x = seed ^ position.key();
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    double draw = (double)(x >> 11) / 9007199254740992.0 * total;
+    for (size_t i = 0; i < result.lines.size(); i++)
+    {
+        if (draw < weights[i])
+            return result.lines[i].pv[0];
+        draw -= weights[i];
+    }
+    return result.lines[0].pv[0];
+}
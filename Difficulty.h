@@ -0,0 +1,41 @@
+/*
+Difficulty levels
+-- A level is a node budget per move and a rule for picking among the near-best moves, so a weaker level plays
+   weaker moves and also costs less: the CPU a move takes is bounded by its budget, whatever the position.
+-- The search runs with the level's node budget and no depth or time limit. A node limit stops it at exactly that
+   many nodes, so the same position searched from the same state always gives the same lines.
+-- Levels below the top search several root moves in multi-PV mode and pick one of those scoring within a margin of
+   the best, a move the margin worse being e^(-margin / temperature) times as likely. The random draw comes from the
+   game's seed and the position's key, so a game replayed with the same seed gets the same moves.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include "Position.h"
+#include "Search.h"
+
+using namespace std;
+
+struct DifficultyLevel
+{
+    uint64_t nodes;                         // node budget of a move
+    int lines;                              // root moves searched, the candidates of the pick
+    int margin;                             // candidates score within this many centipawns of the best
+    int temperature;                        // centipawns, 0 always picks the best
+};
+
+const int DIFFICULTY_LEVELS = 8;
+
+// Level of the GUI when none is chosen, about the strength of the old fixed four ply search
+const int DEFAULT_DIFFICULTY_LEVEL = 5;
+
+// Level 1 to DIFFICULTY_LEVELS, the weakest first
+const DifficultyLevel& difficulty_level(int level);
+
+// Search limits of the level
+SearchLimits level_limits(int level);
+
+// The level's pick among the result's lines for the position searched, MOVE_NONE if there are none
+Move choose_level_move(const SearchResult& result, const Position& position, int level, uint64_t seed);
@@ -0,0 +1,282 @@
+#include "EnginePool.h"
+#include "Difficulty.h"
+#include "Trace.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// Heap order of the queues: the job with the later deadline, or the newer of two with one deadline, ranks lower
+static bool less_urgent(const EngineJob& a, const EngineJob& b)
+{
+    if (a.deadline != b.deadline)
+        return a.deadline > b.deadline;
+    return a.sequence > b.sequence;
+}
+
+
+/*
+* NAME
+*      EnginePool -- starts the engine threads
+*
+* SYNOPSYS
+*
+*      EnginePool::EnginePool(int threads, size_t table_kilobytes, EvalKind evaluation, const Network* network);
+*      threads         ->  worker threads, at least one
+*      table_kilobytes ->  size of the transposition table they share
+*      evaluation      ->  evaluation of every worker's search, network being the one of EVAL_NNUE
+*/
+EnginePool::EnginePool(int threads, size_t table_kilobytes, EvalKind evaluation, const Network* network)
+    : m_table(table_kilobytes)
+{
+    m_evaluation = evaluation;
+    m_network = network;
+    m_queued = 0;
+    m_sequence = 0;
+    m_stop = false;
+    m_jobs = m_steals = 0;
+    m_wait_ms = m_max_wait_ms = 0;
+
+    threads = std::max(threads, 1);
+    for (int i = 0; i < threads; i++)
+        m_queues.emplace_back(new JobQueue());
+    for (int i = 0; i < threads; i++)
+        m_workers.emplace_back(&EnginePool::worker, this, i);
+}
+
+
+/*
+* NAME
+*      ~EnginePool -- stops the engine threads
+*
+* SYNOPSYS
+*
+*      EnginePool::~EnginePool();
+*
+* DESCRIPTION
+*
+*  Searches under way run to their limits, which a game's clock keeps short; jobs still queued are dropped
+ *  and their games get no reply.
+*/
+EnginePool::~EnginePool()
+{
+    {
+        lock_guard<mutex> lock(m_wake_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (thread& worker : m_workers)
+        worker.join();
+}
+
+
+/*
+* NAME
+*      Submit -- queues a search
+*
+* SYNOPSYS
+*
+*      void EnginePool::submit(EngineJob&& job);
+*
+* DESCRIPTION
+*
+*  The job goes to the queue of its game's worker, game modulo the number of threads, and wakes one waiting worker,
+ *  which is either that worker or one that will steal the job.
+*/
+void EnginePool::submit(EngineJob&& job)
+{
+    job.submitted = chrono::steady_clock::now();
+    job.sequence = m_sequence++;
+    JobQueue& queue = *m_queues[(size_t)std::max(job.game, 0) % m_queues.size()];
+    {
+        lock_guard<mutex> lock(queue.lock);
+        queue.jobs.push_back(std::move(job));
+        push_heap(queue.jobs.begin(), queue.jobs.end(), less_urgent);
+    }
+    {
+        lock_guard<mutex> lock(m_wake_mutex);
+        m_queued++;
+    }
+    m_wake.notify_one();
+}
+
+
+/*
+* NAME
+*      Collect -- takes the finished searches
+*
+* SYNOPSYS
+*
+*      void EnginePool::collect(vector<EngineReply>& replies);
+*
+* DESCRIPTION
+*
+*  This function never waits on a search, only on the short lock of the reply list, so the GUI thread
+ *  can call it every frame. The replies are appended in the order the searches finished.
+*/
+void EnginePool::collect(vector<EngineReply>& replies)
+{
+    lock_guard<mutex> lock(m_reply_mutex);
+    for (EngineReply& reply : m_replies)
+        replies.push_back(std::move(reply));
+    m_replies.clear();
+}
+
+
+/*
+* NAME
+*      Pop -- takes the most urgent job of a queue
+*
+* SYNOPSYS
+*
+*      bool EnginePool::pop(JobQueue& queue, EngineJob& job);
+*/
+bool EnginePool::pop(JobQueue& queue, EngineJob& job)
+{
+    lock_guard<mutex> lock(queue.lock);
+    if (queue.jobs.empty())
+        return false;
+    pop_heap(queue.jobs.begin(), queue.jobs.end(), less_urgent);
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    m_queued--;
+    return true;
+}
+
+
+/*
+* NAME
+*      Take -- finds the next job of a worker
+*
+* SYNOPSYS
+*
+*      bool EnginePool::take(int index, EngineJob& job);
+*
+* DESCRIPTION
+*
+*  The worker's own queue comes first. When it is empty the worker looks at the front of every other queue and steals
+ *  the most urgent of them; the queues are locked one at a time, so the victim may have been emptied meanwhile,
+ *  in which case the worker looks again. When every queue is empty it sleeps until a job is submitted.
+*/
+bool EnginePool::take(int index, EngineJob& job)
+{
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(m_wake_mutex);
+            m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+            if (m_stop)
+                return false;
+        }
+
+        if (pop(*m_queues[index], job))
+            return true;
+
+        int victim = -1;
+        EngineJob front;
+        for (size_t i = 1; i < m_queues.size(); i++)
+        {
+            int other = (int)((index + i) % m_queues.size());
+            lock_guard<mutex> lock(m_queues[other]->lock);
+            if (m_queues[other]->jobs.empty())
+                continue;
+            const EngineJob& candidate = m_queues[other]->jobs.front();
+            if (victim < 0 || less_urgent(front, candidate))
+            {
+                victim = other;
+                front.deadline = candidate.deadline;
+                front.sequence = candidate.sequence;
+            }
+        }
+        if (victim >= 0 && pop(*m_queues[victim], job))
+        {
+            lock_guard<mutex> lock(m_stats_mutex);
+            m_steals++;
+            return true;
+        }
+    }
+}
+
+
+/*
+* NAME
+*      Worker -- searches jobs until the pool stops
+*
+* SYNOPSYS
+*
+*      void EnginePool::worker(int index);
+*
+* DESCRIPTION
+*
+*  Each worker keeps one Search, with its own evaluation caches and the pool's transposition table.
+ *  A job's time limit becomes the smaller of its own and 1 / POOL_TIME_SHARE of the game's clock left at pickup,
+ *  at least a millisecond, so a game whose job waited in the queue spends less on it. The move is the level's pick,
+ *  and the first legal move when the search was stopped before finding one.
+*/
+void EnginePool::worker(int index)
+{
+    TRACE_THREAD("engine pool worker");
+    Search search;
+    search.set_evaluation(m_evaluation, m_network);
+    search.share_table(&m_table);
+
+    EngineJob job;
+    while (take(index, job))
+    {
+        auto started = chrono::steady_clock::now();
+        int left_ms = (int)chrono::duration_cast<chrono::milliseconds>(job.deadline - started).count();
+        int share_ms = std::max(left_ms / POOL_TIME_SHARE, 1);
+        if (job.limits.movetime_ms == 0 || job.limits.movetime_ms > share_ms)
+            job.limits.movetime_ms = share_ms;
+
+        EngineReply reply;
+        reply.game = job.game;
+        reply.key = job.position.key();
+        {
+            TRACE_SCOPE("search", "pool job");
+            reply.result = search.smart_guy(job.position, job.limits, job.history);
+        }
+        reply.move = job.level ? choose_level_move(reply.result, job.position, job.level, job.seed) : reply.result.best_move;
+        if (reply.move == MOVE_NONE)
+        {
+            MoveList legal;
+            job.position.get_all_valids(legal);
+            if (!legal.empty())
+                reply.move = legal[0];
+        }
+
+        {
+            lock_guard<mutex> lock(m_reply_mutex);
+            m_replies.push_back(std::move(reply));
+        }
+        {
+            lock_guard<mutex> lock(m_stats_mutex);
+            double wait_ms = chrono::duration<double, milli>(started - job.submitted).count();
+            m_jobs++;
+            m_wait_ms += wait_ms;
+            m_max_wait_ms = std::max(m_max_wait_ms, wait_ms);
+        }
+    }
+}
+
+
+/*
+* NAME
+*      Report -- formats the pool's statistics
+*
+* SYNOPSYS
+*
+*      string EnginePool::report();
+*
+* DESCRIPTION
+*
+*  Waits are from submitting a job to a worker starting its search.
+*/
+string EnginePool::report()
+{
+    lock_guard<mutex> lock(m_stats_mutex);
+    ostringstream out;
+    out << "jobs=" << m_jobs << " steals=" << m_steals;
+    if (m_jobs)
+        out << fixed << setprecision(2) << " mean_wait_ms=" << m_wait_ms / m_jobs << " max_wait_ms=" << m_max_wait_ms;
+    return out.str();
+}
@@ -0,0 +1,112 @@
+/*
+EnginePool class
+-- A fixed set of engine threads serving the searches of many games at once, so games wait for a free thread
+   instead of each owning one; the GUI thread only submits jobs and collects replies, and never blocks on a search.
+-- Every worker has its own queue, and a game's jobs always go to the same queue, so the worker's Search finds
+   that game's positions in its evaluation caches. A worker takes the most urgent job of its own queue and, when that
+   is empty, steals the most urgent job of the other queues, so no thread idles while any game waits.
+-- Urgency is the deadline of the job's game: the moment the engine's clock would run out. Earliest deadline first
+   keeps the games closest to losing on time moving, and a job's time limit is a share of the time left when a worker
+   picks it up, so time spent queued is paid by that game's clock.
+-- All workers' searches share one transposition table, as in Server.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Position.h"
+#include "Search.h"
+
+using namespace std;
+
+// A job may search for this fraction of its game's clock, 1 / POOL_TIME_SHARE
+const int POOL_TIME_SHARE = 20;
+
+struct EngineJob
+{
+    int game;                               // the game asking, it picks the queue
+    Position position;
+    vector<uint64_t> history;               // keys of the game's positions, the job's position last
+    SearchLimits limits;                    // the time limit is lowered to the clock's share when picked up
+    int level;                              // difficulty level picking the move, 0 for the best, see Difficulty.h
+    uint64_t seed;                          // seed of the level's pick
+    chrono::steady_clock::time_point deadline;  // when the game's engine clock runs out
+    chrono::steady_clock::time_point submitted;
+    uint64_t sequence;                      // submission number, the older of two jobs with one deadline goes first
+};
+
+struct EngineReply
+{
+    int game;
+    uint64_t key;                           // key of the position searched, to drop replies the game has moved past
+    Move move;                              // the move to play, MOVE_NONE if the position has none
+    SearchResult result;
+};
+
+class EnginePool
+{
+private:
+    // A worker's jobs, a heap with the most urgent job first
+    struct JobQueue
+    {
+        mutex lock;
+        vector<EngineJob> jobs;
+    };
+
+    vector<unique_ptr<JobQueue>> m_queues;  // one per worker
+    vector<thread> m_workers;
+    TranspositionTable m_table;             // shared by every worker's search
+    EvalKind m_evaluation;
+    const Network* m_network;
+
+    mutex m_wake_mutex;
+    condition_variable m_wake;              // signalled when a job is queued or the pool stops
+    atomic<int> m_queued;                   // jobs in all queues
+    atomic<uint64_t> m_sequence;
+    bool m_stop;                            // guarded by m_wake_mutex
+
+    mutex m_reply_mutex;
+    vector<EngineReply> m_replies;          // finished jobs not collected yet
+
+    mutex m_stats_mutex;
+    uint64_t m_jobs;                        // jobs searched
+    uint64_t m_steals;                      // of them taken from another worker's queue
+    double m_wait_ms;                       // total time queued
+    double m_max_wait_ms;
+
+    // Take the most urgent job of a queue, returns false if it is empty
+    bool pop(JobQueue& queue, EngineJob& job);
+
+    // Take a job for the worker, stealing if its queue is empty, waiting if all are; returns false once stopped
+    bool take(int index, EngineJob& job);
+
+    // Worker thread: searches jobs until the pool stops
+    void worker(int index);
+
+public:
+    // Start the threads; the table is shared by all of them
+    EnginePool(int threads, size_t table_kilobytes, EvalKind evaluation = EVAL_HANDCRAFTED, const Network* network = nullptr);
+
+    // Stop the threads once their current searches end, dropping the queued jobs
+    ~EnginePool();
+
+    // Queue a search of the job's position
+    void submit(EngineJob&& job);
+
+    // Move the replies finished since the last call into replies, without waiting
+    void collect(vector<EngineReply>& replies);
+
+    int threads() const { return (int)m_workers.size(); }
+
+    // "jobs=... steals=... mean_wait_ms=... max_wait_ms=..."
+    string report();
+};
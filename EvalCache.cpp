@@ -0,0 +1,83 @@
+#include "EvalCache.h"
+#include <cstring>
+
+
+/*
+* NAME
+*      EvalCache -- creates an empty evaluation cache
+*
+* SYNOPSYS
+*
+*      EvalCache::EvalCache(size_t kilobytes);
+*      kilobytes   ->  memory used by the cache
+*/
+EvalCache::EvalCache(size_t kilobytes)
+{
+    size_t entries = 1;
+    while (entries * 2 * sizeof(EvalCacheEntry) <= kilobytes * 1024)
+        entries *= 2;
+    m_entries.resize(entries);
+    clear();
+}
+
+
+/*
+* NAME
+*      Clear -- forgets every entry
+*
+* SYNOPSYS
+*
+*      void EvalCache::clear();
+*/
+void EvalCache::clear()
+{
+    memset(m_entries.data(), 0, m_entries.size() * sizeof(EvalCacheEntry));
+    m_hits = m_misses = 0;
+}
+
+
+/*
+* NAME
+*      Probe -- looks up a score
+*
+* SYNOPSYS
+*
+*      bool EvalCache::probe(uint64_t key, int& score);
+*      key         ->  Zobrist key of the position
+*      score       ->  receives the stored score on a hit
+*
+* DESCRIPTION
+*
+*  Returns true and the score if the slot of the key holds that same key, and counts the hit or miss.
+*/
+bool EvalCache::probe(uint64_t key, int& score)
+{
+    const EvalCacheEntry& entry = m_entries[key & (m_entries.size() - 1)];
+    if (entry.valid && entry.key == key)
+    {
+        m_hits++;
+        score = entry.score;
+        return true;
+    }
+    m_misses++;
+    return false;
+}
+
+
+/*
+* NAME
+*      Store -- remembers a score
+*
+* SYNOPSYS
+*
+*      void EvalCache::store(uint64_t key, int score);
+*      key         ->  Zobrist key of the position
+*      score       ->  its static evaluation
+*/
+void EvalCache::store(uint64_t key, int score)
+{
+    EvalCacheEntry& entry = m_entries[key & (m_entries.size() - 1)];
+    entry.key = key;
+    entry.score = score;
+    entry.valid = 1;
+}
@@ -0,0 +1,47 @@
+/*
+EvalCache class
+-- Small direct-mapped cache of static evaluations, indexed by the Zobrist key of the position.
+-- Positions reached again by transposition skip the evaluation, and with it the mobility generation.
+-- Every entry stores the full key, so a hit is always the score of the same position.
+-- Not thread safe: every Search owns its own cache.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+struct EvalCacheEntry
+{
+    uint64_t key;                           // Zobrist key of the position
+    int32_t score;                          // static evaluation, white's point of view
+    int32_t valid;                          // nonzero once the entry has been stored
+};
+
+class EvalCache
+{
+private:
+    vector<EvalCacheEntry> m_entries;       // power of two entries, indexed by the low bits of the key
+    uint64_t m_hits;
+    uint64_t m_misses;
+
+public:
+    // Cache of the given size in kilobytes, rounded down to a power of two entries
+    EvalCache(size_t kilobytes = 1024);
+
+    // Look up the score of a position, returns false on a miss
+    bool probe(uint64_t key, int& score);
+
+    // Remember the score of a position, replacing whatever shared its slot
+    void store(uint64_t key, int score);
+
+    // Forget every entry and reset the counters
+    void clear();
+
+    uint64_t hits() const { return m_hits; }
+    uint64_t misses() const { return m_misses; }
+};
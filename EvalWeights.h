@@ -0,0 +1,25 @@
+// Evaluation weights in centipawns, indexed by EvalParam (see Evaluation.h).
+// Generated by "ChessAI tune" -- rerun the tuner rather than editing by hand.
+// Initial hand-set values: pawn 1, knight 3, bishop 3, rook 5, queen 9; mobility 0.1 / 0.3 / 0.6 per move;
+// pawn structure, king attack and hanging piece terms set by hand until the tuner is rerun.
+
+#pragma once
+
+static const int eval_weights[] = {
+    100,    // pawn
+    300,    // knight
+    300,    // bishop
+    500,    // rook
+    900,    // queen
+    10,     // mobility_opening
+    30,     // mobility_middlegame
+    60,     // mobility_endgame
+    -15,    // doubled_pawn
+    -12,    // isolated_pawn
+    10,     // passed_pawn
+    8,      // passed_rank
+    -10,    // passed_blocked
+    8,      // pawn_shield
+    6,      // king_attack
+    -25,    // hanging
+};
@@ -0,0 +1,163 @@
+#include "Evaluation.h"
+#include "EvalWeights.h"
+#include "Bitboard.h"
+#include <cstring>
+
+static_assert(sizeof(eval_weights) / sizeof(eval_weights[0]) == EVAL_PARAMS, "EvalWeights.h does not match EvalParam");
+
+const char* const eval_param_names[EVAL_PARAMS] = {
+    "pawn", "knight", "bishop", "rook", "queen",
+    "mobility_opening", "mobility_middlegame", "mobility_endgame",
+    "doubled_pawn", "isolated_pawn", "passed_pawn", "passed_rank",
+    "passed_blocked", "pawn_shield", "king_attack", "hanging",
+};
+
+static_assert(PARAM_PASSED_RANK - PARAM_DOUBLED_PAWN + 1 == PAWN_FEATURES, "EvalParam does not match PawnFeature");
+
+
+/*
+* NAME
+*      PawnShield -- counts the pawns sheltering a king
+*
+* SYNOPSYS
+*
+*      static int pawn_shield(const Position& position, Color side);
+*
+* DESCRIPTION
+*
+*  Counts the side's pawns one and two rows in front of its king, on the king's file and the files next to it.
+*/
+static int pawn_shield(const Position& position, Color side)
+{
+    int king = position.king_square(side);
+    int step = (side == WHITE) ? 1 : -1;
+    int shield = 0;
+    for (int distance = 1; distance <= 2; distance++)
+    {
+        int row = row_of(king) + step * distance;
+        if (row < 0 || row > 7)
+            break;
+        for (int col = col_of(king) - 1; col <= col_of(king) + 1; col++)
+            if (col >= 0 && col < 8 && position.piece_on(make_square(row, col)) == make_piece(side, PAWN))
+                shield++;
+    }
+    return shield;
+}
+
+
+/*
+* NAME
+*      KingAttack -- counts the squares next to the opposing king a side attacks
+*
+* SYNOPSYS
+*
+*      static int king_attack(const Position& position, const AttackInfo& attacks, Color side);
+*/
+static int king_attack(const Position& position, const AttackInfo& attacks, Color side)
+{
+    int king = position.king_square((Color)(side ^ 1));
+    return popcount(king_attacks(king) & attacks.attacked[side]);
+}
+
+
+/*
+* NAME
+*      Hanging -- counts a side's undefended pieces under attack
+*
+* SYNOPSYS
+*
+*      static int hanging(const Position& position, const AttackInfo& attacks, Color side);
+*
+* DESCRIPTION
+*
+*  Counts the side's pieces other than pawns and the king that the opponent attacks and no piece of the side defends.
+*/
+static int hanging(const Position& position, const AttackInfo& attacks, Color side)
+{
+    Bitboard pieces = position.pieces(side) & ~position.pieces(side, PAWN) & ~position.pieces(side, KING);
+    return popcount(pieces & attacks.attacked[side ^ 1] & ~attacks.attacked[side]);
+}
+
+
+/*
+* NAME
+*      Evaluate - this function is the evaluation function that returns the utility of the position
+*
+* SYNOPSYS
+*
+*      int evaluate(const Position& position, EvalTrace* trace, PawnTable* pawns, const AttackInfo* attacks);
+ *      position    -> the position to be evaluated
+ *      trace       -> receives the feature counts if not nullptr
+ *      pawns       -> pawn structure cache, or nullptr to evaluate the pawns afresh
+ *      attacks     -> the position's attacks, or nullptr to find them
+*
+* DESCRIPTION
+*   Returns utility of the position in centipawns
+    Calculates utility by assigning values to each pieces (material value)
+    For white pieces, positive values are assigned
+    For black pieces, equal negative values are assigned
+    Hence, for white side, it would be optimal to have least important black pieces and most important white pieces
+    vice-versa for black pieces.
+
+    In addition, takes into account the mobility of the pieces: the squares each piece attacks or, for pawns, can move to,
+    that do not hold a piece of its own side.
+    The piece count picks the game phase, and mobilities' weight increases as the game progresses.
+    The squares around the opposing king a side attacks, and the pieces it leaves attacked and undefended, count too.
+    All of these come from the attack maps, found once per position, so each costs a few popcounts.
+
+    Pawn structure (doubled, isolated and passed pawns) is looked up in the pawn table.
+    Passed pawns with a piece in front of them and pawns sheltering the kings are counted here,
+    since they depend on more than the pawns.
+*/
+int evaluate(const Position& position, EvalTrace* trace, PawnTable* pawns, const AttackInfo* attacks)
+{
+    EvalTrace counts;
+    memset(&counts, 0, sizeof(counts));
+
+    // count pieces to determine game start, mid game, or end game
+    int num_pieces = position.count_pieces();
+    int mobility;
+    if (num_pieces <= 11)
+        mobility = PARAM_MOBILITY_ENDGAME;
+    else if (num_pieces <= 22)
+        mobility = PARAM_MOBILITY_MIDDLEGAME;
+    else
+        mobility = PARAM_MOBILITY_OPENING;
+
+    AttackInfo found;
+    if (!attacks)
+    {
+        position.compute_attacks(found);
+        attacks = &found;
+    }
+    // material value; mobility except for king
+    for (int type = PAWN; type <= QUEEN; type++)
+        counts.counts[PARAM_PAWN + type - PAWN] = popcount(position.pieces(WHITE, (PieceType)type))
+                                                - popcount(position.pieces(BLACK, (PieceType)type));
+    counts.counts[mobility] = attacks->mobility[WHITE] - attacks->mobility[BLACK];
+    counts.counts[PARAM_KING_ATTACK] = king_attack(position, *attacks, WHITE) - king_attack(position, *attacks, BLACK);
+    counts.counts[PARAM_HANGING] = hanging(position, *attacks, WHITE) - hanging(position, *attacks, BLACK);
+
+    PawnEntry fresh;
+    const PawnEntry* entry = &fresh;
+    if (pawns)
+        entry = &pawns->probe(position);
+    else
+        evaluate_pawns(position, fresh);
+    for (int feature = 0; feature < PAWN_FEATURES; feature++)
+        counts.counts[PARAM_DOUBLED_PAWN + feature] = entry->counts[feature];
+    // the square in front of a white pawn is 8 higher, of a black pawn 8 lower
+    counts.counts[PARAM_PASSED_BLOCKED] = popcount((entry->passed[WHITE] << 8) & position.occupancy())
+                                        - popcount((entry->passed[BLACK] >> 8) & position.occupancy());
+    counts.counts[PARAM_PAWN_SHIELD] = pawn_shield(position, WHITE) - pawn_shield(position, BLACK);
+
+    int utility = entry->score;
+    for (int param = 0; param < EVAL_PARAMS; param++)
+    {
+        if (param < PARAM_DOUBLED_PAWN || param > PARAM_PASSED_RANK)
+            utility += counts.counts[param] * eval_weights[param];
+    }
+    if (trace)
+        *trace = counts;
+    return utility;
+}
@@ -0,0 +1,38 @@
+/*
+Evaluation functions
+-- The handcrafted evaluation: material, mobility and pawn structure, from white's point of view in centipawns.
+-- The score is a weighted sum of feature counts, the weights live in the generated EvalWeights.h.
+-- An EvalTrace records the feature counts so the tuner can fit the weights.
+-- Pawn structure terms come from a PawnTable when one is given, and are computed afresh otherwise.
+-- Mobility, king attacks and hanging pieces are popcounts of the position's attack maps, see Position::compute_attacks.
+*/
+
+
+#pragma once
+
+#include "Position.h"
+#include "PawnTable.h"
+
+// Tunable evaluation parameters, in the order of EvalWeights.h
+enum EvalParam
+{
+    PARAM_PAWN, PARAM_KNIGHT, PARAM_BISHOP, PARAM_ROOK, PARAM_QUEEN,
+    PARAM_MOBILITY_OPENING, PARAM_MOBILITY_MIDDLEGAME, PARAM_MOBILITY_ENDGAME,
+    PARAM_DOUBLED_PAWN, PARAM_ISOLATED_PAWN, PARAM_PASSED_PAWN, PARAM_PASSED_RANK,     // in PawnFeature order
+    PARAM_PASSED_BLOCKED, PARAM_PAWN_SHIELD, PARAM_KING_ATTACK, PARAM_HANGING,
+    EVAL_PARAMS
+};
+
+// Names of the parameters as written to EvalWeights.h
+extern const char* const eval_param_names[EVAL_PARAMS];
+
+// Feature counts of a position, white's minus black's
+struct EvalTrace
+{
+    int counts[EVAL_PARAMS];
+};
+
+// Evaluation function: returns the utility of the position, optionally recording its features;
+// attacks, if given, are the position's, found otherwise
+int evaluate(const Position& position, EvalTrace* trace = nullptr, PawnTable* pawns = nullptr,
+             const AttackInfo* attacks = nullptr);
@@ -0,0 +1,270 @@
+#include "HashFile.h"
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char hash_file_magic[8] = { 'C', 'H', 'A', 'I', 'H', 'A', 'S', 'H' };
+static const uint32_t hash_file_version = 1;
+
+// check and data words of a bucket's slots
+static const size_t bucket_bytes = HASH_FILE_BUCKET_SLOTS * 2 * sizeof(uint64_t);
+
+static_assert(sizeof(HashFileHeader) == 64, "the buckets should start on a cache line");
+
+static uint64_t load_word(const uint64_t* word) { return __atomic_load_n(word, __ATOMIC_RELAXED); }
+static void store_word(uint64_t* word, uint64_t value) { __atomic_store_n(word, value, __ATOMIC_RELAXED); }
+
+
+/*
+* NAME
+*      HashFile -- creates a cache without a file
+*
+* SYNOPSYS
+*
+*      HashFile::HashFile();
+*/
+HashFile::HashFile()
+{
+    m_data = nullptr;
+    m_size = 0;
+    m_slots = nullptr;
+    m_buckets = 0;
+    m_writable = false;
+    m_min_depth = DEFAULT_HASH_FILE_MIN_DEPTH;
+}
+
+
+/*
+* NAME
+*      ~HashFile -- unmaps the file
+*
+* SYNOPSYS
+*
+*      HashFile::~HashFile();
+*
+* DESCRIPTION
+*
+*  The results stored are in the file already; the kernel writes the pages back.
+*/
+HashFile::~HashFile()
+{
+    close();
+}
+
+
+/*
+* NAME
+*      Open -- maps a hash file
+*
+* SYNOPSYS
+*
+*      bool HashFile::open(const string& filename, size_t megabytes, bool read_only);
+*      filename    ->  the file, created if missing unless read_only
+*      megabytes   ->  size of the slots of a new file, rounded down to a power of two buckets, with the header on top;
+ *                      an existing file keeps its size
+*      read_only   ->  map without write access
+*
+* DESCRIPTION
+*
+*  The file is locked while its header is written or checked, so processes starting together
+ *  do not see a half-created file. A file with a header that is not ours is refused.
+*/
+bool HashFile::open(const string& filename, size_t megabytes, bool read_only)
+{
+    close();
+    int fd = ::open(filename.c_str(), read_only ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        cout << "Could not open " << filename << endl;
+        return false;
+    }
+    if (flock(fd, read_only ? LOCK_SH : LOCK_EX) != 0)
+    {
+        cout << "Could not lock " << filename << endl;
+        ::close(fd);
+        return false;
+    }
+
+    HashFileHeader header;
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0;
+    if (valid && info.st_size == 0 && !read_only)
+    {
+        uint64_t buckets = 1;
+        while (buckets * 2 * bucket_bytes <= megabytes * 1024 * 1024)
+            buckets *= 2;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, hash_file_magic, sizeof(header.magic));
+        header.version = hash_file_version;
+        header.bucket_slots = HASH_FILE_BUCKET_SLOTS;
+        header.buckets = buckets;
+        info.st_size = (off_t)(sizeof(header) + buckets * bucket_bytes);
+        valid = ftruncate(fd, info.st_size) == 0 && pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    }
+    else
+    {
+        valid = valid && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+             && memcmp(header.magic, hash_file_magic, sizeof(header.magic)) == 0
+             && header.version == hash_file_version && header.bucket_slots == HASH_FILE_BUCKET_SLOTS
+             && header.buckets && (header.buckets & (header.buckets - 1)) == 0
+             && (uint64_t)info.st_size == sizeof(header) + header.buckets * bucket_bytes;
+    }
+    void* address = MAP_FAILED;
+    if (valid)
+        address = mmap(nullptr, (size_t)info.st_size, read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    if (!valid || address == MAP_FAILED)
+    {
+        cout << "Not a usable hash file: " << filename << endl;
+        return false;
+    }
+
+    m_data = (unsigned char*)address;
+    m_size = (size_t)info.st_size;
+    m_slots = (uint64_t*)(m_data + sizeof(header));
+    m_buckets = header.buckets;
+    m_writable = !read_only;
+    return true;
+}
+
+
+/*
+* NAME
+*      Close -- unmaps the file
+*
+* SYNOPSYS
+*
+*      void HashFile::close();
+*/
+void HashFile::close()
+{
+    if (m_data)
+        munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_slots = nullptr;
+    m_buckets = 0;
+    m_writable = false;
+}
+
+
+/*
+* NAME
+*      Probe -- looks up a position
+*
+* SYNOPSYS
+*
+*      bool HashFile::probe(uint64_t key, TTEntry& entry) const;
+*      key         ->  Zobrist key of the position
+*      entry       ->  receives a copy of the entry on a hit
+*
+* DESCRIPTION
+*
+*  Returns true if a slot of the key's bucket holds a result for that same key.
+*/
+bool HashFile::probe(uint64_t key, TTEntry& entry) const
+{
+    if (!m_data)
+        return false;
+    const uint64_t* bucket = m_slots + (key & (m_buckets - 1)) * HASH_FILE_BUCKET_SLOTS * 2;
+    for (int i = 0; i < HASH_FILE_BUCKET_SLOTS; i++)
+    {
+        uint64_t check = load_word(&bucket[2 * i]);
+        uint64_t data = load_word(&bucket[2 * i + 1]);
+        if ((check ^ data) == key && data)
+        {
+            memcpy(&entry, &data, sizeof(entry));
+            return entry.bound != BOUND_NONE;
+        }
+    }
+    return false;
+}
+
+
+/*
+* NAME
+*      Store -- remembers the result of a position's search
+*
+* SYNOPSYS
+*
+*      void HashFile::store(uint64_t key, Move move, int depth, int score, Bound bound);
+*      key         ->  Zobrist key of the position
+*      move        ->  best move found, or MOVE_NONE
+*      depth       ->  plies searched below the position
+*      score       ->  the utility found, mates counted from the position
+*      bound       ->  BOUND_EXACT, or the side from which score bounds the utility
+*
+* DESCRIPTION
+*
+*  Depth-preferred: a result of the same position is replaced by a deeper one, or an exact one of the same depth,
+ *  keeping the old move if the new search found none. Otherwise the shallowest slot of the bucket is taken
+ *  if it was searched no deeper. Results shallower than the minimum depth are dropped.
+*/
+void HashFile::store(uint64_t key, Move move, int depth, int score, Bound bound)
+{
+    if (!m_writable || depth < m_min_depth)
+        return;
+    uint64_t* bucket = m_slots + (key & (m_buckets - 1)) * HASH_FILE_BUCKET_SLOTS * 2;
+    int replace = -1, shallowest = INT_MAX;
+    bool same = false;
+    TTEntry old;
+    for (int i = 0; i < HASH_FILE_BUCKET_SLOTS; i++)
+    {
+        uint64_t check = load_word(&bucket[2 * i]);
+        uint64_t data = load_word(&bucket[2 * i + 1]);
+        memcpy(&old, &data, sizeof(old));
+        if (data && (check ^ data) == key)
+        {
+            if (old.depth > depth || (old.depth == depth && old.bound == BOUND_EXACT && bound != BOUND_EXACT))
+                return;
+            if (move == MOVE_NONE)
+                move = old.move;
+            replace = i;
+            same = true;
+            break;
+        }
+        int slot_depth = data ? old.depth : -1;
+        if (slot_depth < shallowest)
+        {
+            shallowest = slot_depth;
+            replace = i;
+        }
+    }
+    if (!same && shallowest > depth)
+        return;
+
+    TTEntry entry;
+    entry.move = move;
+    entry.score = (int16_t)score;
+    entry.depth = (uint8_t)depth;
+    entry.bound = bound;
+    entry.generation = 0;
+    entry.padding = 0;
+    uint64_t data;
+    memcpy(&data, &entry, sizeof(data));
+    store_word(&bucket[2 * replace + 1], data);
+    store_word(&bucket[2 * replace], key ^ data);
+}
+
+
+/*
+* NAME
+*      Used -- counts the slots in use
+*
+* SYNOPSYS
+*
+*      uint64_t HashFile::used() const;
+*/
+uint64_t HashFile::used() const
+{
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < slots(); i++)
+        count += load_word(&m_slots[2 * i + 1]) != 0;
+    return count;
+}
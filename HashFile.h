@@ -0,0 +1,81 @@
+/*
+HashFile class
+-- Persistent cache of deep search results, kept in a file mapped into memory, so the analysis of positions
+   revisited day after day survives the process.
+-- Holds the transposition table's entries: best move, depth, bound and score by Zobrist key, whose seed is fixed,
+   so the keys are the same in every run.
+-- Buckets of four slots, one cache line each; a result replaces the same position's shallower one, else an empty
+   or the shallowest slot of the bucket, unless every slot holds a deeper result.
+-- Results searched less than the minimum depth are not stored, so the file only collects deep work and is written rarely.
+-- Several processes may map the same file: each slot is written like a transposition table slot, the key xor the entry
+   next to the entry, so a slot torn by two writers fails the key check and reads as a miss. Read-only users map
+   the file without write access and never store.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "TranspositionTable.h"
+
+using namespace std;
+
+// Size of the slots of a new hash file unless given, the header comes on top
+const size_t DEFAULT_HASH_FILE_MEGABYTES = 32;
+
+// Results searched fewer plies than this are not stored unless asked otherwise
+const int DEFAULT_HASH_FILE_MIN_DEPTH = 5;
+
+// Plies from the root within which the search looks up and stores its results in the file
+const int HASH_FILE_PLIES = 4;
+
+const int HASH_FILE_BUCKET_SLOTS = 4;
+
+struct HashFileHeader
+{
+    char magic[8];                          // "CHAIHASH"
+    uint32_t version;
+    uint32_t bucket_slots;                  // HASH_FILE_BUCKET_SLOTS
+    uint64_t buckets;                       // a power of two, indexed by the low bits of the key
+    uint8_t padding[40];                    // the buckets start on a cache line
+};
+
+class HashFile
+{
+private:
+    unsigned char* m_data;                  // the mapping: header, then the buckets; nullptr if no file is open
+    size_t m_size;                          // size of the mapping in bytes
+    uint64_t* m_slots;                      // check and data words of every slot, bucket after bucket
+    uint64_t m_buckets;
+    bool m_writable;                        // false when mapped read-only
+    int m_min_depth;                        // shallowest result stored
+
+    HashFile(const HashFile&) = delete;
+    HashFile& operator=(const HashFile&) = delete;
+
+public:
+    HashFile();
+    ~HashFile();
+
+    // Map the file, creating it with the given size if it does not exist; with read_only set
+    // it must exist and is never written. Returns false if the file cannot be used
+    bool open(const string& filename, size_t megabytes = DEFAULT_HASH_FILE_MEGABYTES, bool read_only = false);
+    void close();
+
+    // Look up a position, returns false on a miss
+    bool probe(uint64_t key, TTEntry& entry) const;
+
+    // Remember the result of a position's search, if deep enough and the file is writable
+    void store(uint64_t key, Move move, int depth, int score, Bound bound);
+
+    void set_min_depth(int depth) { m_min_depth = depth; }
+
+    bool is_open() const { return m_data != nullptr; }
+    bool is_writable() const { return m_writable; }
+    uint64_t slots() const { return m_buckets * HASH_FILE_BUCKET_SLOTS; }
+
+    // Count the slots in use, reading the whole file
+    uint64_t used() const;
+};
@@ -0,0 +1,54 @@
+#include "HeapCounter.h"
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+
+static thread_local uint64_t allocations = 0;
+
+
+/*
+* NAME
+*      operator new, operator delete -- the counting global allocation functions
+*
+* SYNOPSYS
+*
+*      void* operator new(size_t size);
+*      void operator delete(void* p) noexcept;
+*
+* DESCRIPTION
+*
+*  These replace the standard ones for the whole program. The array and nothrow forms call them.
+*/
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+uint64_t heap_allocations()
+{
+    return allocations;
+}
+
+#else
+
+uint64_t heap_allocations()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,14 @@
+/*
+Heap allocation counter
+-- Debug builds replace the global operator new to count the heap allocations of every thread,
+   so code that must not allocate, like the search, can assert that it did not.
+-- Builds with NDEBUG keep the standard operator new and count nothing.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made so far by the calling thread, always 0 with NDEBUG
+uint64_t heap_allocations();
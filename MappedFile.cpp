@@ -0,0 +1,148 @@
+#include "MappedFile.h"
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/*
+* NAME
+*      MappedFile -- creates an empty mapping
+*
+* SYNOPSYS
+*
+*      MappedFile::MappedFile();
+*
+* DESCRIPTION
+*
+*  This function creates a mapping that is not attached to any file.
+*/
+MappedFile::MappedFile()
+{
+    m_data = nullptr;
+    m_size = 0;
+}
+
+
+/*
+* NAME
+*      MappedFile -- maps a file
+*
+* SYNOPSYS
+*
+*      MappedFile::MappedFile(const string& filename);
+*      filename    ->  the file to be mapped
+*
+* DESCRIPTION
+*
+*  This function maps the whole file read-only. Check is_open() for success.
+*/
+MappedFile::MappedFile(const string& filename)
+{
+    m_data = nullptr;
+    m_size = 0;
+    open(filename);
+}
+
+
+/*
+* NAME
+*      ~MappedFile -- unmaps the file
+*
+* SYNOPSYS
+*
+*      MappedFile::~MappedFile();
+*
+* DESCRIPTION
+*
+*  This function releases the mapping.
+*/
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+/*
+* NAME
+*      Open -- maps a file
+*
+* SYNOPSYS
+*
+*      bool MappedFile::open(const string& filename);
+*      filename    ->  the file to be mapped
+*
+* DESCRIPTION
+*
+*  This function maps the whole file read-only, releasing the previous mapping first.
+ *  The descriptor is closed right away, the mapping stays valid until close().
+ *  An empty file is not mapped and reported as failure.
+*/
+bool MappedFile::open(const string& filename)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        cout << "Could not open " << filename << endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+    {
+        cout << "Could not map " << filename << endl;
+        return false;
+    }
+    m_data = (const unsigned char*)address;
+    m_size = (size_t)info.st_size;
+    return true;
+}
+
+
+/*
+* NAME
+*      Close -- unmaps the file
+*
+* SYNOPSYS
+*
+*      void MappedFile::close();
+*
+* DESCRIPTION
+*
+*  This function releases the mapping, if any.
+*/
+void MappedFile::close()
+{
+    if (m_data)
+        munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+
+/*
+* NAME
+*      AdviseSequential -- hints the kernel about the access pattern
+*
+* SYNOPSYS
+*
+*      void MappedFile::advise_sequential();
+*
+* DESCRIPTION
+*
+*  This function tells the kernel the mapping is read front to back, so it reads ahead aggressively
+ *  and drops pages behind the reader.
+*/
+void MappedFile::advise_sequential()
+{
+    if (m_data)
+        madvise((void*)m_data, m_size, MADV_SEQUENTIAL);
+}
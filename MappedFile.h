@@ -0,0 +1,39 @@
+/*
+MappedFile class
+-- Read-only memory mapping of a whole file.
+-- Used by the tooling to stream large binary files without copying them into the heap.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+class MappedFile
+{
+private:
+    const unsigned char* m_data;            // start of the mapping, nullptr if the file could not be mapped
+    size_t m_size;                          // size of the mapping in bytes
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+    MappedFile();
+    MappedFile(const string& filename);
+    ~MappedFile();
+
+    // Map the file, unmapping any previous one, returns false if the file could not be mapped
+    bool open(const string& filename);
+    void close();
+
+    // Hint the kernel that the mapping will be read front to back
+    void advise_sequential();
+
+    bool is_open() const { return m_data != nullptr; }
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
@@ -0,0 +1,517 @@
+#include "MateSolver.h"
+#include "Notation.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Proof and disproof numbers of a settled node, sums saturate here
+static const uint32_t dfpn_infinity = 100000000;
+
+static const size_t bucket_entries = 4;
+
+// A collection runs once this fraction of the table has been overwritten by other nodes since the last one
+static const size_t replacement_fraction = 8;
+
+// A collection clears this fraction of the entries, those that took the least work
+static const size_t collected_fraction = 8;
+
+static uint32_t saturated_sum(uint32_t a, uint32_t b)
+{
+    return std::min(a + b, dfpn_infinity);
+}
+
+
+/*
+* NAME
+*      MateSolver -- creates a solver
+*
+* SYNOPSYS
+*
+*      MateSolver::MateSolver(size_t megabytes);
+*      megabytes   ->  size of the table, rounded down to a power of two of buckets
+*/
+MateSolver::MateSolver(size_t megabytes)
+{
+    size_t buckets = 1;
+    while (buckets * 2 * bucket_entries * sizeof(Entry) <= std::max<size_t>(megabytes, 1) << 20)
+        buckets *= 2;
+    m_table.assign(buckets * bucket_entries, Entry{ 0, 0, 0, 0 });
+    m_bucket_mask = buckets - 1;
+    m_used = 0;
+    m_replacements = 0;
+    m_collections = 0;
+    m_siblings = nullptr;
+    m_sibling_count = 0;
+    m_nodes = 0;
+    m_stopped = false;
+    m_attacker = WHITE;
+}
+
+
+static uint64_t moves_left_key(int moves_left)
+{
+    return (uint64_t)(moves_left + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+
+uint64_t MateSolver::node_key(int moves_left) const
+{
+    uint64_t key = m_position.key() ^ moves_left_key(moves_left);
+    return key ? key : 1;
+}
+
+
+const MateSolver::Entry* MateSolver::probe(uint64_t key) const
+{
+    const Entry* bucket = &m_table[(key & m_bucket_mask) * bucket_entries];
+    for (size_t i = 0; i < bucket_entries; i++)
+        if (bucket[i].key == key)
+            return &bucket[i];
+    return nullptr;
+}
+
+
+bool MateSolver::is_sibling(uint64_t key) const
+{
+    for (int i = 0; i < m_sibling_count; i++)
+        if (m_siblings[i] == key)
+            return true;
+    return false;
+}
+
+
+/*
+* NAME
+*      Store -- stores the numbers of a node
+*
+* SYNOPSYS
+*
+*      void MateSolver::store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work);
+*
+* DESCRIPTION
+*
+*  The node's entry is updated, or an empty one of its bucket taken, or else the one that took the least work
+ *  replaced, sparing the children of the node being expanded unless the bucket holds nothing else: the node
+ *  reads their numbers on every pass, and losing them makes it expand them again and again.
+ *  Garbage is collected when three quarters of the table are used, or once a table's eighth of entries has been
+ *  replaced since the last collection, which is what happens when the buckets fill unevenly.
+*/
+void MateSolver::store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work)
+{
+    Entry* bucket = &m_table[(key & m_bucket_mask) * bucket_entries];
+    Entry* replace = nullptr;
+    Entry* victim = nullptr;
+    bool victim_sibling = false;
+    for (size_t i = 0; i < bucket_entries; i++)
+    {
+        if (bucket[i].key == key)
+        {
+            replace = &bucket[i];
+            break;
+        }
+        if (bucket[i].key == 0)
+        {
+            if (!replace)
+                replace = &bucket[i];
+            continue;
+        }
+        bool sibling = is_sibling(bucket[i].key);
+        if (!victim || (victim_sibling && !sibling) || (victim_sibling == sibling && bucket[i].work < victim->work))
+        {
+            victim = &bucket[i];
+            victim_sibling = sibling;
+        }
+    }
+    bool fresh = false, replaced = false;
+    if (replace)
+        fresh = (replace->key == 0);
+    else
+    {
+        replace = victim;
+        replaced = true;
+    }
+    *replace = Entry{ key, pn, dn, work };
+    if ((fresh && ++m_used > m_table.size() / 4 * 3) || (replaced && ++m_replacements > m_table.size() / replacement_fraction))
+        collect_garbage();
+}
+
+
+/*
+* NAME
+*      CollectGarbage -- frees part of the table
+*
+* SYNOPSYS
+*
+*      void MateSolver::collect_garbage();
+*
+* DESCRIPTION
+*
+*  Entries whose subtrees took the least work are the cheapest to find again, so the eighth of the entries with
+ *  the least work is cleared, with every entry tying the last one. Clearing more throws away work a small table
+ *  needs back soon after. The children of the node being expanded are kept, as store spares them. The nodes
+ *  on the current line keep working; their entries are stored again.
+*/
+void MateSolver::collect_garbage()
+{
+    TRACE_SCOPE("mate", "collect garbage");
+    vector<Entry> siblings;
+    for (int i = 0; i < m_sibling_count; i++)
+        if (const Entry* entry = probe(m_siblings[i]))
+            siblings.push_back(*entry);
+
+    vector<uint64_t> works;
+    works.reserve(m_used);
+    for (const Entry& entry : m_table)
+        if (entry.key)
+            works.push_back(entry.work);
+    std::nth_element(works.begin(), works.begin() + works.size() / collected_fraction, works.end());
+    uint64_t threshold = works[works.size() / collected_fraction];
+    m_used = 0;
+    for (Entry& entry : m_table)
+    {
+        if (entry.key && entry.work <= threshold)
+            entry.key = 0;
+        else if (entry.key)
+            m_used++;
+    }
+    m_replacements = 0;
+    m_collections++;
+
+    for (const Entry& entry : siblings)
+    {
+        Entry* bucket = &m_table[(entry.key & m_bucket_mask) * bucket_entries];
+        for (size_t i = 0; i < bucket_entries; i++)
+        {
+            if (bucket[i].key == entry.key)
+                break;
+            if (bucket[i].key == 0)
+            {
+                bucket[i] = entry;
+                m_used++;
+                break;
+            }
+        }
+    }
+}
+
+
+/*
+* NAME
+*      Mid -- expands a node of the df-pn search
+*
+* SYNOPSYS
+*
+*      void MateSolver::mid(int moves_left, uint32_t thpn, uint32_t thdn);
+*      moves_left  ->  moves the attacker still has to mate
+*      thpn, thdn  ->  thresholds, the node returns once its proof number reaches thpn or its disproof number thdn
+*
+* DESCRIPTION
+*
+*  Leaves are settled at once: a side without moves is mated or stalemated, and the attacker without moves
+ *  left has failed. Otherwise the children's table keys are found once. Then, until a threshold is reached, the numbers are summed up from the children,
+ *  an OR node's proof number being its children's least and its disproof number their sum, an AND node's
+ *  the other way round, and the most proving child is expanded with thresholds that return to this node
+ *  once it is a quarter worse than the second best child (the 1 + epsilon trick), so a small table is not
+ *  refilled by switching between two children at every step.
+ *  A child without an entry keeps the numbers it had when last read, since a replaced child would otherwise
+ *  look unexpanded and be expanded again and again. It also counts as settled if the same position is
+ *  proven with a move less or disproven with a move more.
+*/
+void MateSolver::mid(int moves_left, uint32_t thpn, uint32_t thdn)
+{
+    uint64_t key = node_key(moves_left);
+    const Entry* entry = probe(key);
+    uint64_t base_work = entry ? entry->work : 0;
+    uint64_t start = m_nodes++;
+    if (m_limits.nodes && m_nodes >= m_limits.nodes)
+        m_stopped = true;
+
+    bool attacker = (m_position.side_to_move() == m_attacker);
+    if (attacker && moves_left == 0)
+    {
+        store(key, dfpn_infinity, 0, 1);
+        return;
+    }
+    MoveList moves;
+    m_position.get_all_valids(moves);
+    if (moves.empty() || (!attacker && moves_left == 0))
+    {
+        bool mated = !attacker && moves.empty() && m_position.in_check();
+        store(key, mated ? 0 : dfpn_infinity, mated ? dfpn_infinity : 0, 1);
+        return;
+    }
+
+    int child_left = attacker ? moves_left - 1 : moves_left;
+    Move children[MAX_MOVES];
+    uint64_t child_keys[MAX_MOVES];
+    int count = 0;
+    for (Move m : moves)
+    {
+        Undo undo;
+        m_position.make_move(m, undo);
+        if (!attacker || !m_limits.checks_only || m_position.in_check())
+        {
+            children[count] = m;
+            child_keys[count++] = node_key(child_left);
+        }
+        m_position.unmake_move(m, undo);
+    }
+    if (count == 0)
+    {
+        store(key, dfpn_infinity, 0, 1);
+        return;
+    }
+
+    // the children's numbers as last read, for a child whose entry was replaced since; 1 for an unexpanded one
+    uint32_t known_pn[MAX_MOVES], known_dn[MAX_MOVES];
+    std::fill(known_pn, known_pn + count, 1);
+    std::fill(known_dn, known_dn + count, 1);
+
+    // the children are spared by store while this node expands
+    const uint64_t* parent_siblings = m_siblings;
+    int parent_sibling_count = m_sibling_count;
+    m_siblings = child_keys;
+    m_sibling_count = count;
+    while (true)
+    {
+        // the numbers of this node from its children's, and the most proving child
+        uint32_t pn = attacker ? dfpn_infinity : 0, dn = attacker ? 0 : dfpn_infinity;
+        uint32_t best = dfpn_infinity, second = dfpn_infinity;
+        uint32_t best_pn = 0, best_dn = 0;
+        int best_index = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const Entry* child = probe(child_keys[i]);
+            if (child)
+            {
+                known_pn[i] = child->pn;
+                known_dn[i] = child->dn;
+            }
+            else if (known_pn[i] && known_dn[i])
+            {
+                // a child proven with a move less is proven, one disproven with a move more is disproven
+                uint64_t position_key = child_keys[i] ^ moves_left_key(child_left);
+                const Entry* fewer = child_left > 0 ? probe(position_key ^ moves_left_key(child_left - 1)) : nullptr;
+                const Entry* more = probe(position_key ^ moves_left_key(child_left + 1));
+                if (fewer && fewer->pn == 0)
+                    known_pn[i] = 0, known_dn[i] = dfpn_infinity;
+                else if (more && more->dn == 0)
+                    known_pn[i] = dfpn_infinity, known_dn[i] = 0;
+            }
+            uint32_t child_pn = known_pn[i], child_dn = known_dn[i];
+            uint32_t value = attacker ? child_pn : child_dn;
+            if (attacker)
+            {
+                pn = std::min(pn, child_pn);
+                dn = saturated_sum(dn, child_dn);
+            }
+            else
+            {
+                pn = saturated_sum(pn, child_pn);
+                dn = std::min(dn, child_dn);
+            }
+            if (value < best)
+            {
+                second = best;
+                best = value;
+                best_index = i;
+                best_pn = child_pn;
+                best_dn = child_dn;
+            }
+            else if (value < second)
+                second = value;
+        }
+        store(key, pn, dn, base_work + m_nodes - start);
+        if (pn >= thpn || dn >= thdn || m_stopped)
+            break;
+
+        uint32_t child_thpn, child_thdn;
+        if (attacker)
+        {
+            child_thpn = std::min(thpn, saturated_sum(second, second / 4 + 1));
+            child_thdn = std::min(dfpn_infinity, thdn - dn + best_dn);
+        }
+        else
+        {
+            child_thdn = std::min(thdn, saturated_sum(second, second / 4 + 1));
+            child_thpn = std::min(dfpn_infinity, thpn - pn + best_pn);
+        }
+        Undo undo;
+        m_position.make_move(children[best_index], undo);
+        mid(child_left, child_thpn, child_thdn);
+        m_position.unmake_move(children[best_index], undo);
+        m_siblings = child_keys;
+        m_sibling_count = count;
+    }
+    m_siblings = parent_siblings;
+    m_sibling_count = parent_sibling_count;
+}
+
+
+bool MateSolver::prove(int moves_left)
+{
+    mid(moves_left, dfpn_infinity, dfpn_infinity);
+    const Entry* entry = probe(node_key(moves_left));
+    return entry && entry->pn == 0;
+}
+
+
+/*
+* NAME
+*      Solve -- looks for a forced mate
+*
+* SYNOPSYS
+*
+*      MateResult MateSolver::solve(const Position& position, const MateLimits& limits);
+*
+* DESCRIPTION
+*
+*  The root is expanded until it is proven, disproven or the node limit is reached. Once proven, its distance,
+ *  the fewest moves left with which it is still proven, is found by bisection: that is the mate's length.
+ *  The mating line then follows children of known distance: from a node d moves from mate the attacker plays
+ *  a move still proven with d - 1 moves left, the defender a reply that is not, so the reply also needs d.
+ *  Children already settled in the table are tried first, the others are proven again, one proof per child.
+*/
+MateResult MateSolver::solve(const Position& position, const MateLimits& limits)
+{
+    TRACE_SCOPE("mate", "solve");
+    auto start = chrono::steady_clock::now();
+    m_position = position;
+    m_attacker = position.side_to_move();
+    m_limits = limits;
+    m_nodes = 0;
+    m_stopped = false;
+    MateResult result = { MATE_UNKNOWN, 0, vector<Move>(), 0, 0, 0 };
+
+    if (prove(limits.moves))
+    {
+        result.status = MATE_FOUND;
+        // no mate with no move left, a mate with limits.moves
+        int low = 0, high = limits.moves;
+        while (high - low > 1 && !m_stopped)
+        {
+            int middle = (low + high) / 2;
+            if (prove(middle))
+                high = middle;
+            else
+                low = middle;
+        }
+        result.moves = high;
+
+        int distance = high;
+        while (!m_stopped)
+        {
+            MoveList moves;
+            m_position.get_all_valids(moves);
+            if (moves.empty())
+                break;
+            bool attacker = (m_position.side_to_move() == m_attacker);
+            Move chosen = MOVE_NONE;
+            for (int pass = 0; pass < 2 && chosen == MOVE_NONE && !m_stopped; pass++)
+            {
+                for (Move m : moves)
+                {
+                    Undo undo;
+                    m_position.make_move(m, undo);
+                    bool wanted;
+                    if (pass == 0)
+                    {
+                        const Entry* entry = probe(node_key(distance - 1));
+                        wanted = entry && (attacker ? entry->pn == 0 : entry->dn == 0);
+                    }
+                    else
+                        wanted = (prove(distance - 1) == attacker);
+                    m_position.unmake_move(m, undo);
+                    if (wanted && !m_stopped)
+                    {
+                        chosen = m;
+                        break;
+                    }
+                }
+            }
+            if (chosen == MOVE_NONE)
+            {
+                result.status = MATE_UNKNOWN;
+                break;
+            }
+            Undo undo;
+            m_position.make_move(chosen, undo);
+            result.line.push_back(chosen);
+            if (attacker)
+                distance--;
+        }
+        if (m_stopped)
+            result.status = MATE_UNKNOWN;
+    }
+    else if (!m_stopped)
+        result.status = MATE_NONE;
+
+    result.nodes = m_nodes;
+    result.collections = m_collections;
+    result.time_ms = (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+
+/*
+* NAME
+*      MateCommand -- solves a mate problem
+*
+* SYNOPSYS
+*
+*      int mate_command(int argc, char* argv[]);
+*      argv        ->  the FEN, the number of moves, then options with their values
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -nodes <n>          give up after n nodes
+ *     -hash <MB>          size of the table, 64 by default
+ *     -checks <0|1>       the attacker only gives check
+ *  Prints the mating line in SAN or that there is none, then the nodes, time and garbage collections.
+*/
+int mate_command(int argc, char* argv[])
+{
+    Position position;
+    if (argc < 2 || atoi(argv[1]) < 1)
+    {
+        cout << "usage: ChessAI mate <fen> <moves> [-nodes <n>] [-hash <MB>] [-checks 1]" << endl;
+        return 1;
+    }
+    if (!position.set_fen(argv[0]))
+    {
+        cout << "Bad FEN " << argv[0] << endl;
+        return 1;
+    }
+    MateLimits limits;
+    limits.moves = atoi(argv[1]);
+    size_t megabytes = 64;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        string option = argv[i], value = argv[i + 1];
+        if (option == "-nodes")
+            limits.nodes = strtoull(value.c_str(), nullptr, 10);
+        else if (option == "-hash")
+            megabytes = std::max(1, atoi(value.c_str()));
+        else if (option == "-checks")
+            limits.checks_only = atoi(value.c_str()) != 0;
+        else
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+
+    MateSolver solver(megabytes);
+    MateResult result = solver.solve(position, limits);
+    if (result.status == MATE_FOUND)
+        cout << "mate in " << result.moves << ": " << line_to_san(position, result.line) << endl;
+    else if (result.status == MATE_NONE)
+        cout << "no mate in " << limits.moves << (limits.checks_only ? " by checks" : "") << endl;
+    else
+        cout << "unknown, node limit reached" << endl;
+    cout << result.nodes << " nodes, " << result.time_ms << " ms, " << result.collections << " collections" << endl;
+    return 0;
+}
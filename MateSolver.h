@@ -0,0 +1,103 @@
+/*
+MateSolver class
+-- Proves or disproves a forced mate by the side to move within a number of its moves, with depth-first
+   proof-number search (df-pn) instead of the alpha-beta of Search.
+-- Nodes where the attacker moves are OR nodes, one mating move proves them; nodes where the defender moves
+   are AND nodes, every reply must be mated. The proof and disproof numbers, the fewest leaves still to prove
+   or disprove a node, steer the search to the most forcing lines, so narrow mates are found deep and fast.
+-- Numbers are kept in a transposition table by position and moves left, in buckets of four entries.
+   Memory is bounded: a full bucket replaces its entry that took the least work, sparing the children of the
+   node being expanded, and once three quarters of the table are used or an eighth of it has been replaced,
+   the eighth of the entries that took the least work is collected.
+-- Every attacker move uses up one of its moves, so a position met again is a different node and the search has
+   no cycles: no repetition checks are needed, and no result depends on the path to it. The fifty-move rule is ignored.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Position.h"
+
+using namespace std;
+
+enum MateStatus { MATE_FOUND, MATE_NONE, MATE_UNKNOWN };
+
+struct MateLimits
+{
+    int moves;                              // mate in at most this many moves of the attacker
+    uint64_t nodes;                         // stop after this many nodes, 0 for no limit
+    bool checks_only;                       // the attacker only gives check, faster but misses quiet mating moves
+
+    MateLimits() : moves(5), nodes(0), checks_only(false) {}
+};
+
+struct MateResult
+{
+    MateStatus status;
+    int moves;                              // moves of the attacker in the shortest forced mate, when found
+    vector<Move> line;                      // the mating line when found, attacker's moves first, ending in mate
+    uint64_t nodes;                         // nodes expanded
+    int time_ms;
+    int collections;                        // garbage collections of the table
+};
+
+class MateSolver
+{
+private:
+    struct Entry
+    {
+        uint64_t key;                       // position key mixed with the moves left, 0 for an empty entry
+        uint32_t pn;                        // proof number, 0 once proven
+        uint32_t dn;                        // disproof number, 0 once disproven
+        uint64_t work;                      // nodes expanded below the entry, decides what is collected
+    };
+
+    vector<Entry> m_table;                  // buckets of four entries
+    size_t m_bucket_mask;                   // buckets - 1
+    size_t m_used;                          // entries in use
+    size_t m_replacements;                  // entries overwritten by other nodes since the last collection
+    int m_collections;
+    const uint64_t* m_siblings;             // keys of the children of the node being expanded, spared by store
+    int m_sibling_count;
+
+    Position m_position;                    // position of the node being expanded
+    Color m_attacker;                       // side to mate
+    MateLimits m_limits;
+    uint64_t m_nodes;
+    bool m_stopped;                         // the node limit was reached
+
+    // Table key of the current position with the attacker's moves left
+    uint64_t node_key(int moves_left) const;
+
+    // The entry of the key, nullptr if there is none
+    const Entry* probe(uint64_t key) const;
+
+    // Check if the key is one of m_siblings
+    bool is_sibling(uint64_t key) const;
+
+    // Store the numbers of the key, collecting garbage if the table is getting full or churning
+    void store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work);
+
+    // Clear the eighth of the entries that took the least work
+    void collect_garbage();
+
+    // Expand the current position until its proof number reaches thpn or its disproof number thdn
+    void mid(int moves_left, uint32_t thpn, uint32_t thdn);
+
+    // Prove the current position without thresholds, returns true if it is a mate
+    bool prove(int moves_left);
+
+public:
+    // A solver with a table of the megabytes
+    MateSolver(size_t megabytes = 64);
+
+    // Look for a mate by the side to move of the position
+    MateResult solve(const Position& position, const MateLimits& limits);
+};
+
+// Command line entry point: ChessAI mate <fen> <moves> [options]
+int mate_command(int argc, char* argv[]);
@@ -0,0 +1,431 @@
+#include "Mcts.h"
+#include "Evaluation.h"
+#include "Trace.h"
+#include <cmath>
+#include <thread>
+
+// Playouts of a search given neither a node nor a time limit
+static const uint64_t default_playouts = 10000;
+
+// How sharply the priors favour the children with the better static values
+static const float prior_sharpness = 4.0f;
+
+static const uint32_t no_node = UINT32_MAX;
+
+// A centipawn score as a value in [-1, 1]: twice the expected score by the logistic Elo curve, less one
+static float value_of_score(int score)
+{
+    return 2.0f / (1.0f + powf(10.0f, -score / 400.0f)) - 1.0f;
+}
+
+static int score_of_value(double value)
+{
+    value = std::min(std::max(value, -0.9999), 0.9999);
+    return (int)lround(400.0 * log10((1 + value) / (1 - value)));
+}
+
+
+/*
+* NAME
+*      Mcts -- creates a searcher
+*
+* SYNOPSYS
+*
+*      Mcts::Mcts(size_t megabytes);
+*      megabytes   ->  size of the node pool, allocated by the first search
+*/
+Mcts::Mcts(size_t megabytes)
+    : m_capacity((megabytes << 20) / sizeof(MctsNode)), m_used(0), m_root(0), m_has_tree(false),
+      m_evaluation(EVAL_HANDCRAFTED), m_network(nullptr), m_threads(1), m_cpuct(1.5f),
+      m_playouts(0), m_max_depth(0), m_stop(false)
+{
+}
+
+
+void Mcts::set_evaluation(EvalKind kind, const Network* network)
+{
+    m_network = network;
+    m_evaluation = (kind == EVAL_NNUE && network && network->is_loaded()) ? EVAL_NNUE : EVAL_HANDCRAFTED;
+    m_has_tree = false;
+}
+
+
+uint32_t Mcts::allocate(int count)
+{
+    size_t first = m_used.fetch_add(count, memory_order_relaxed);
+    return (first + count <= m_capacity) ? (uint32_t)first : no_node;
+}
+
+
+void Mcts::init_node(uint32_t index, uint64_t key, Move move, float prior, float value)
+{
+    MctsNode& node = m_pool[index];
+    node.key = key;
+    node.move = move;
+    node.child_count = 0;
+    node.first_child = no_node;
+    node.prior = prior;
+    node.value = value;
+    node.state.store(NODE_LEAF, memory_order_relaxed);
+    node.visits.store(0, memory_order_relaxed);
+    node.virtual_loss.store(0, memory_order_relaxed);
+    node.value_sum.store(0, memory_order_relaxed);
+}
+
+
+/*
+* NAME
+*      StaticValue -- values a position without searching it
+*
+* SYNOPSYS
+*
+*      float Mcts::static_value(const Position& position, PawnTable& pawns, Accumulator& accumulator) const;
+*
+* DESCRIPTION
+*
+*  The handcrafted evaluation or the network, refreshed for the position, scores it; the value is for the side to move.
+*/
+float Mcts::static_value(const Position& position, PawnTable& pawns, Accumulator& accumulator) const
+{
+    int score;
+    if (m_evaluation == EVAL_NNUE)
+    {
+        m_network->refresh(position, accumulator);
+        score = m_network->evaluate(accumulator, position.side_to_move());
+    }
+    else
+    {
+        score = evaluate(position, nullptr, &pawns);
+        if (position.side_to_move() == BLACK)
+            score = -score;
+    }
+    return value_of_score(score);
+}
+
+
+/*
+* NAME
+*      Expand -- creates the children of a leaf
+*
+* SYNOPSYS
+*
+*      void Mcts::expand(uint32_t index, Position& position, PawnTable& pawns, Accumulator& accumulator);
+*      index       ->  the leaf, claimed by this thread
+*      position    ->  the leaf's position
+*
+* DESCRIPTION
+*
+*  A leaf without moves, or with bare kings, becomes terminal: a win for the side that moved into it if it is
+ *  checkmate, a draw otherwise. Else every child is valued statically, for the side to move here, and gets a
+ *  prior from a softmax of the values. The children are published by storing NODE_EXPANDED after them.
+ *  If the pool is full the leaf is released unexpanded.
+*/
+void Mcts::expand(uint32_t index, Position& position, PawnTable& pawns, Accumulator& accumulator)
+{
+    MctsNode& node = m_pool[index];
+    MoveList moves;
+    position.get_all_valids(moves);
+    if (moves.empty() || position.count_pieces() == 2)
+    {
+        node.value = (moves.empty() && position.in_check()) ? 1.0f : 0.0f;
+        node.state.store(NODE_TERMINAL, memory_order_release);
+        return;
+    }
+    uint32_t first = allocate(moves.size());
+    if (first == no_node)
+    {
+        node.state.store(NODE_LEAF, memory_order_release);
+        return;
+    }
+
+    float values[MAX_MOVES];
+    uint64_t keys[MAX_MOVES];
+    float best = -1.0f, total = 0.0f;
+    for (int i = 0; i < moves.size(); i++)
+    {
+        Undo undo;
+        position.make_move(moves[i], undo);
+        keys[i] = position.key();
+        values[i] = -static_value(position, pawns, accumulator);
+        position.unmake_move(moves[i], undo);
+        best = std::max(best, values[i]);
+    }
+    for (int i = 0; i < moves.size(); i++)
+        total += expf((values[i] - best) * prior_sharpness);
+    for (int i = 0; i < moves.size(); i++)
+        init_node(first + i, keys[i], moves[i], expf((values[i] - best) * prior_sharpness) / total, values[i]);
+    node.first_child = first;
+    node.child_count = moves.size();
+    node.state.store(NODE_EXPANDED, memory_order_release);
+}
+
+
+/*
+* NAME
+*      Select -- picks the child to descend to
+*
+* SYNOPSYS
+*
+*      uint32_t Mcts::select(const MctsNode& node) const;
+*
+* DESCRIPTION
+*
+*  PUCT: the child's mean value plus cpuct * prior * sqrt(parent visits) / (1 + child visits). Every thread
+ *  descending through a child counts as a visit that lost. A child nobody visited yet is worth its static value.
+*/
+uint32_t Mcts::select(const MctsNode& node) const
+{
+    float sqrt_visits = sqrtf((float)std::max<uint32_t>(1, node.visits.load(memory_order_relaxed)
+                                                        + node.virtual_loss.load(memory_order_relaxed)));
+    uint32_t best = node.first_child;
+    float best_score = -1e9f;
+    for (uint32_t index = node.first_child; index < node.first_child + node.child_count; index++)
+    {
+        const MctsNode& child = m_pool[index];
+        uint32_t visits = child.visits.load(memory_order_relaxed);
+        int32_t losses = child.virtual_loss.load(memory_order_relaxed);
+        float q = child.value;
+        if (visits + losses > 0)
+            q = (float)((child.value_sum.load(memory_order_relaxed) / 1e6 - losses) / (visits + losses));
+        float score = q + m_cpuct * child.prior * sqrt_visits / (1 + visits + losses);
+        if (score > best_score)
+        {
+            best_score = score;
+            best = index;
+        }
+    }
+    return best;
+}
+
+
+/*
+* NAME
+*      SetRoot -- finds or creates the root node
+*
+* SYNOPSYS
+*
+*      void Mcts::set_root(const Position& position);
+*
+* DESCRIPTION
+*
+*  The kept tree is searched on if the position is its root, or a child or grandchild of it, as after the
+ *  engine's move and the opponent's reply. Otherwise, or once 3/4 of the pool are used, the pool is emptied
+ *  and a new root created.
+*/
+void Mcts::set_root(const Position& position)
+{
+    if (!m_pool)
+        m_pool.reset(new MctsNode[m_capacity]);
+    if (m_has_tree && m_used.load() < m_capacity / 4 * 3)
+    {
+        const MctsNode& root = m_pool[m_root];
+        if (root.key == position.key())
+            return;
+        if (root.state.load() == NODE_EXPANDED)
+        {
+            for (uint32_t child = root.first_child; child < root.first_child + root.child_count; child++)
+            {
+                if (m_pool[child].key == position.key())
+                {
+                    m_root = child;
+                    return;
+                }
+                if (m_pool[child].state.load() != NODE_EXPANDED)
+                    continue;
+                const MctsNode& node = m_pool[child];
+                for (uint32_t grandchild = node.first_child; grandchild < node.first_child + node.child_count; grandchild++)
+                {
+                    if (m_pool[grandchild].key == position.key())
+                    {
+                        m_root = grandchild;
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    m_used = 0;
+    m_root = allocate(1);
+    init_node(m_root, position.key(), MOVE_NONE, 1.0f, 0.0f);
+    m_has_tree = true;
+}
+
+
+/*
+* NAME
+*      Worker -- runs playouts
+*
+* SYNOPSYS
+*
+*      void Mcts::worker();
+*
+* DESCRIPTION
+*
+*  Each playout descends from the root by PUCT, adding a virtual loss to every child it enters, to a leaf,
+ *  a terminal node, or a position repeating an earlier one or drawn by the fifty-move rule. A leaf this thread
+ *  claims is expanded; the value of the leaf for the side that moved into it is then backed up the path,
+ *  negated at every ply, and the virtual losses are taken back.
+*/
+void Mcts::worker()
+{
+    TRACE_THREAD("mcts worker");
+    PawnTable pawns;
+    Accumulator accumulator;
+    Position position;
+    vector<uint64_t> keys;
+    keys.reserve(m_history.size() + MAX_SEARCH_DEPTH * 4);
+    vector<uint32_t> path;
+    path.reserve(MAX_SEARCH_DEPTH * 4);
+    while (!m_stop)
+    {
+        position = m_root_position;
+        keys = m_history;
+        path.assign(1, m_root);
+        uint32_t index = m_root;
+        float value;
+        while (true)
+        {
+            MctsNode& node = m_pool[index];
+            uint8_t state = node.state.load(memory_order_acquire);
+            if (state == NODE_TERMINAL)
+            {
+                value = node.value;
+                break;
+            }
+            if (path.size() > 1 && (position.halfmove() >= 100 || count_repetitions(keys, position.halfmove()) >= 2))
+            {
+                value = 0;
+                break;
+            }
+            if (state != NODE_EXPANDED)
+            {
+                uint8_t leaf = NODE_LEAF;
+                if (state == NODE_LEAF && node.state.compare_exchange_strong(leaf, NODE_EXPANDING, memory_order_acquire))
+                    expand(index, position, pawns, accumulator);
+                value = node.value;
+                break;
+            }
+            index = select(node);
+            m_pool[index].virtual_loss.fetch_add(1, memory_order_relaxed);
+            Undo undo;
+            position.make_move(m_pool[index].move, undo);
+            keys.push_back(position.key());
+            path.push_back(index);
+        }
+
+        for (size_t i = path.size(); i-- > 0; )
+        {
+            MctsNode& node = m_pool[path[i]];
+            node.value_sum.fetch_add(llround(value * 1e6), memory_order_relaxed);
+            node.visits.fetch_add(1, memory_order_relaxed);
+            if (i > 0)
+                node.virtual_loss.fetch_sub(1, memory_order_relaxed);
+            value = -value;
+        }
+        int depth = (int)path.size() - 1;
+        int deepest = m_max_depth.load(memory_order_relaxed);
+        while (depth > deepest && !m_max_depth.compare_exchange_weak(deepest, depth, memory_order_relaxed))
+            ;
+
+        uint64_t playouts = ++m_playouts;
+        if (m_limits.nodes && playouts >= m_limits.nodes)
+            m_stop = true;
+        else if (m_limits.movetime_ms && (playouts & 63) == 0
+                 && chrono::steady_clock::now() - m_start >= chrono::milliseconds(m_limits.movetime_ms))
+            m_stop = true;
+    }
+}
+
+
+void Mcts::principal_variation(uint32_t index, vector<Move>& pv) const
+{
+    pv.assign(1, m_pool[index].move);
+    while (pv.size() <= MAX_SEARCH_DEPTH && m_pool[index].state.load() == NODE_EXPANDED)
+    {
+        const MctsNode& node = m_pool[index];
+        uint32_t best = no_node, best_visits = 0;
+        for (uint32_t child = node.first_child; child < node.first_child + node.child_count; child++)
+        {
+            if (m_pool[child].visits.load() > best_visits)
+            {
+                best = child;
+                best_visits = m_pool[child].visits.load();
+            }
+        }
+        if (best == no_node)
+            break;
+        pv.push_back(m_pool[best].move);
+        index = best;
+    }
+}
+
+
+/*
+* NAME
+*      Search -- searches a position
+*
+* SYNOPSYS
+*
+*      SearchResult Mcts::search(const Position& position, const SearchLimits& limits, const vector<uint64_t>& history);
+*
+* DESCRIPTION
+*
+*  This function finds the root, runs the workers until the playout or time limit and reports like Search::smart_guy:
+ *  the moves are ranked by visits, the score of a line is its mean value as centipawns from white's point of view,
+ *  the depth is the deepest playout and the nodes are the playouts. A checkmate in one scores as a mate.
+*/
+SearchResult Mcts::search(const Position& position, const SearchLimits& limits, const vector<uint64_t>& history)
+{
+    TRACE_SCOPE("mcts", "search");
+    m_start = chrono::steady_clock::now();
+    m_root_position = position;
+    m_history = history;
+    if (m_history.empty() || m_history.back() != position.key())
+        m_history.push_back(position.key());
+    m_limits = limits;
+    if (!m_limits.nodes && !m_limits.movetime_ms)
+        m_limits.nodes = default_playouts;
+    m_playouts = 0;
+    m_max_depth = 0;
+    m_stop = false;
+    set_root(position);
+
+    if (m_threads == 1)
+        worker();
+    else
+    {
+        vector<thread> workers;
+        for (int i = 0; i < m_threads; i++)
+            workers.emplace_back(&Mcts::worker, this);
+        for (thread& t : workers)
+            t.join();
+    }
+
+    SearchResult result = { MOVE_NONE, 0, m_max_depth, m_playouts, 0, vector<Move>(), vector<PvLine>() };
+    const MctsNode& root = m_pool[m_root];
+    if (root.state.load() == NODE_EXPANDED)
+    {
+        vector<uint32_t> children;
+        for (uint32_t child = root.first_child; child < root.first_child + root.child_count; child++)
+            children.push_back(child);
+        std::stable_sort(children.begin(), children.end(), [this](uint32_t a, uint32_t b) {
+            return m_pool[a].visits.load() > m_pool[b].visits.load();
+        });
+        int lines = std::min<int>(std::max(limits.multi_pv, 1), children.size());
+        for (int i = 0; i < lines; i++)
+        {
+            const MctsNode& child = m_pool[children[i]];
+            uint32_t visits = child.visits.load();
+            double value = visits ? child.value_sum.load() / 1e6 / visits : child.value;
+            int score = (child.state.load() == NODE_TERMINAL && child.value == 1.0f) ? MATE_SCORE - 1 : score_of_value(value);
+            PvLine line = { position.side_to_move() == WHITE ? score : -score, result.depth, vector<Move>() };
+            principal_variation(children[i], line.pv);
+            result.lines.push_back(line);
+        }
+        result.pv = result.lines[0].pv;
+        result.best_move = result.pv[0];
+        result.score = result.lines[0].score;
+    }
+    result.time_ms = (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - m_start).count();
+    return result;
+}
@@ -0,0 +1,107 @@
+/*
+Mcts class
+-- Monte Carlo tree search, the engine's second searcher next to the minimax of Search, selected at runtime.
+-- No random playouts: a node is valued by the static evaluation when it is created, mapped to [-1, 1] by the
+   logistic curve, and the priors of PUCT selection are a softmax of the children's evaluations.
+-- Tree parallelism: all threads descend the same tree. A child being descended carries a virtual loss,
+   steering the other threads to other lines, and visit counts and value sums are atomics, so no node is locked.
+   The thread that claims a leaf expands it; the others meanwhile take its static value.
+-- Nodes come from a pool allocated once: a node's children are one contiguous run taken with an atomic add.
+-- The tree is kept between searches: when the new root is the old root, a child or a grandchild of it,
+   its subtree is searched on. The pool is only reclaimed as a whole, when a search starts with it 3/4 full.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Position.h"
+#include "Search.h"
+
+using namespace std;
+
+// The searcher playing the engine's moves
+enum EngineKind { ENGINE_ALPHABETA, ENGINE_MCTS };
+
+enum NodeState : uint8_t { NODE_LEAF, NODE_EXPANDING, NODE_EXPANDED, NODE_TERMINAL };
+
+struct MctsNode
+{
+    uint64_t key;                           // Zobrist key of the node's position
+    Move move;                              // move leading to the node
+    uint16_t child_count;
+    uint32_t first_child;                   // index of the first child in the pool
+    float prior;                            // PUCT prior of the move
+    float value;                            // static value for the side that played the move, in [-1, 1]
+    atomic<uint8_t> state;                  // NodeState, NODE_EXPANDED is published after the children
+    atomic<uint32_t> visits;
+    atomic<int32_t> virtual_loss;           // threads descending through the node right now
+    atomic<int64_t> value_sum;              // backed up values for the side that played the move, in millionths
+};
+
+class Mcts
+{
+private:
+    unique_ptr<MctsNode[]> m_pool;
+    size_t m_capacity;                      // nodes in the pool
+    atomic<size_t> m_used;                  // nodes handed out, may run past m_capacity once the pool is full
+    uint32_t m_root;                        // root of the tree, its index in the pool
+    bool m_has_tree;                        // a tree from the last search is kept
+
+    EvalKind m_evaluation;
+    const Network* m_network;
+    int m_threads;
+    float m_cpuct;                          // exploration constant of PUCT
+
+    Position m_root_position;
+    vector<uint64_t> m_history;             // keys of the game's positions, the root's last
+    SearchLimits m_limits;
+    chrono::steady_clock::time_point m_start;
+    atomic<uint64_t> m_playouts;            // playouts of the current search
+    atomic<int> m_max_depth;                // deepest node reached by the current search
+    atomic<bool> m_stop;
+
+    // Take count consecutive nodes, returns UINT32_MAX if the pool is full
+    uint32_t allocate(int count);
+
+    // Initialise a node of the pool
+    void init_node(uint32_t index, uint64_t key, Move move, float prior, float value);
+
+    // Static value of the position for its side to move, in [-1, 1]
+    float static_value(const Position& position, PawnTable& pawns, Accumulator& accumulator) const;
+
+    // Create the children of the claimed leaf in its position, or mark it terminal if it has no moves
+    void expand(uint32_t index, Position& position, PawnTable& pawns, Accumulator& accumulator);
+
+    // The child of an expanded node with the highest PUCT score
+    uint32_t select(const MctsNode& node) const;
+
+    // Find the root's node in the kept tree, or start a new tree
+    void set_root(const Position& position);
+
+    // Worker thread: runs playouts until a limit is reached
+    void worker();
+
+    // The most visited children from the node down, starting with its move's line
+    void principal_variation(uint32_t index, vector<Move>& pv) const;
+
+public:
+    // A searcher with a pool of the megabytes
+    Mcts(size_t megabytes = 256);
+
+    void set_evaluation(EvalKind kind, const Network* network = nullptr);
+    void set_threads(int threads) { m_threads = threads < 1 ? 1 : threads; }
+
+    // Search the position: limits.nodes counts playouts, limits.movetime_ms bounds the time, the depth is ignored;
+    // history holds the keys of the game's positions up to this one, repetitions of them are draws
+    SearchResult search(const Position& position, const SearchLimits& limits,
+                        const vector<uint64_t>& history = vector<uint64_t>());
+
+    // Nodes of the pool in use
+    size_t used() const { return std::min(m_used.load(), m_capacity); }
+};
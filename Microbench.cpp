@@ -0,0 +1,344 @@
+#include "Microbench.h"
+#include "Bitboard.h"
+#include "Evaluation.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// The positions every benchmark works through: openings, middlegames with pins and castling rights,
+// perft positions full of promotions and en passant, and endgames. Changing them changes every checksum.
+static const char* const micro_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkb1r/pp3ppp/2nppn2/8/3NP3/2N5/PPP2PPP/R1BQKB1R w KQkq - 0 6",
+    "rnbqkb1r/ppp2ppp/4pn2/3p2B1/2PP4/2N5/PP2PPPP/R2QKBNR b KQkq - 3 4",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PN1PN2/PB2BPPP/R2Q1RK1 w - - 0 10",
+    "r1b1k2r/ppppqppp/2n2n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQK2R w KQkq - 1 6",
+    "2r3k1/5ppp/p3p3/1p1nP3/3N4/P4P2/1P4PP/2R3K1 w - - 0 25",
+    "8/5pk1/6p1/R7/5P2/6PK/r7/8 b - - 0 40",
+    "6k1/5pp1/7p/8/3Q4/8/5PPP/q5K1 w - - 0 35",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1"
+};
+
+// Passes are set so that a run takes around a tenth of a second on a current desktop core
+static const MicroBenchmark micro_benchmarks[] = {
+    { "movegen pawn",   MICRO_MOVEGEN_PIECE, PAWN,    200000 },
+    { "movegen knight", MICRO_MOVEGEN_PIECE, KNIGHT,  200000 },
+    { "movegen bishop", MICRO_MOVEGEN_PIECE, BISHOP,  200000 },
+    { "movegen rook",   MICRO_MOVEGEN_PIECE, ROOK,    200000 },
+    { "movegen queen",  MICRO_MOVEGEN_PIECE, QUEEN,   200000 },
+    { "movegen king",   MICRO_MOVEGEN_PIECE, KING,    200000 },
+    { "movegen all",    MICRO_MOVEGEN,       NO_TYPE,  30000 },
+    { "attacks",        MICRO_ATTACKS,       NO_TYPE,  70000 },
+    { "make unmake",    MICRO_MAKE_UNMAKE,   NO_TYPE,   5000 },
+    { "hash",           MICRO_HASH,          NO_TYPE, 200000 },
+    { "eval",           MICRO_EVAL,          NO_TYPE,  40000 },
+    { "nnue refresh",   MICRO_NNUE_REFRESH,  NO_TYPE,   8000 },
+    { "nnue update",    MICRO_NNUE_UPDATE,   NO_TYPE,   2500 },
+    { "nnue eval",      MICRO_NNUE_EVAL,     NO_TYPE,  15000 },
+    { "tt store",       MICRO_TT_STORE,      NO_TYPE,      1 },
+    { "tt probe",       MICRO_TT_PROBE,      NO_TYPE,      2 }
+};
+
+// Keys stored in the table per pass, twice its slots so the replacement works too
+static const size_t micro_table_kilobytes = 16384;
+static const size_t micro_keys = (micro_table_kilobytes << 10) / sizeof(TTSlot) * 2;
+
+// Every this many keys one is probed after the stores, for the checksum, a small part of the pass's time
+static const size_t micro_store_check_step = 256;
+
+
+/*
+* NAME
+*      Microbench -- sets up the positions and keys
+*
+* SYNOPSYS
+*
+*      Microbench::Microbench(const Network* network);
+*      network     ->  network of the nnue benchmarks, nullptr to skip them
+*
+* DESCRIPTION
+*
+*  The attacks, legal moves and accumulator of every position are found here, so each benchmark times
+ *  its own function only. The keys come from a fixed seed.
+*/
+Microbench::Microbench(const Network* network)
+    : m_table(micro_table_kilobytes), m_network(network)
+{
+    for (const char* fen : micro_fens)
+    {
+        MicroPosition entry;
+        entry.position.set_fen(fen);
+        entry.position.compute_attacks(entry.attacks);
+        entry.position.get_all_valids(entry.moves);
+        if (m_network)
+            m_network->refresh(entry.position, entry.accumulator);
+        m_positions.push_back(entry);
+    }
+
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    m_keys.resize(micro_keys);
+    for (uint64_t& key : m_keys)
+    {
+        // xorshift64*
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        key = seed * 2685821657736338717ULL;
+    }
+}
+
+
+/*
+* NAME
+*      Prepare -- sets up the state a run starts from
+*
+* SYNOPSYS
+*
+*      void Microbench::prepare(const MicroBenchmark& benchmark);
+*
+* DESCRIPTION
+*
+*  Stores start from an empty table; probes find it filled by one pass of stores, so about half of them hit.
+ *  The evaluation starts from an empty pawn table, which the first pass fills.
+*/
+void Microbench::prepare(const MicroBenchmark& benchmark)
+{
+    if (benchmark.kind == MICRO_TT_STORE || benchmark.kind == MICRO_TT_PROBE)
+    {
+        m_table.clear();
+        if (benchmark.kind == MICRO_TT_PROBE)
+        {
+            for (size_t i = 0; i < m_keys.size(); i++)
+                m_table.store(m_keys[i], (Move)(i & 0xFFF), (int)(i % 32), (int)(i % 1000) - 500, BOUND_EXACT);
+        }
+    }
+    if (benchmark.kind == MICRO_EVAL)
+        m_pawns.clear();
+}
+
+
+/*
+* NAME
+*      Pass -- runs one pass of a benchmark
+*
+* SYNOPSYS
+*
+*      uint64_t Microbench::pass(const MicroBenchmark& benchmark, uint64_t& ops);
+*      ops         ->  operations done are added to it
+*
+* DESCRIPTION
+*
+*  An operation is a call of the function timed: one generation or evaluation of a position,
+ *  one make and unmake of a move, one store or probe. Its results are folded into the returned checksum,
+ *  which also keeps the compiler from dropping the calls.
+*/
+uint64_t Microbench::pass(const MicroBenchmark& benchmark, uint64_t& ops)
+{
+    uint64_t checksum = 0;
+    MoveList moves;
+    switch (benchmark.kind)
+    {
+    case MICRO_MOVEGEN_PIECE:
+        for (MicroPosition& entry : m_positions)
+        {
+            moves.clear();
+            entry.position.get_moves_from(entry.position.pieces(entry.position.side_to_move(), benchmark.type),
+                                          moves, &entry.attacks);
+            checksum = checksum * 31 + moves.size();
+        }
+        ops += m_positions.size();
+        break;
+    case MICRO_MOVEGEN:
+        for (MicroPosition& entry : m_positions)
+        {
+            moves.clear();
+            entry.position.get_all_valids(moves);
+            checksum = checksum * 31 + moves.size();
+        }
+        ops += m_positions.size();
+        break;
+    case MICRO_ATTACKS:
+        for (MicroPosition& entry : m_positions)
+        {
+            AttackInfo attacks;
+            entry.position.compute_attacks(attacks);
+            checksum = checksum * 31 + (attacks.attacked[WHITE] ^ attacks.attacked[BLACK]);
+        }
+        ops += m_positions.size();
+        break;
+    case MICRO_MAKE_UNMAKE:
+        for (MicroPosition& entry : m_positions)
+        {
+            for (Move m : entry.moves)
+            {
+                Undo undo;
+                entry.position.make_move(m, undo);
+                checksum += entry.position.key();
+                entry.position.unmake_move(m, undo);
+            }
+            ops += entry.moves.size();
+        }
+        break;
+    case MICRO_HASH:
+        for (MicroPosition& entry : m_positions)
+            checksum = checksum * 31 + entry.position.compute_key();
+        ops += m_positions.size();
+        break;
+    case MICRO_EVAL:
+        for (MicroPosition& entry : m_positions)
+            checksum = checksum * 31 + (uint64_t)evaluate(entry.position, nullptr, &m_pawns);
+        ops += m_positions.size();
+        break;
+    case MICRO_NNUE_REFRESH:
+        for (MicroPosition& entry : m_positions)
+        {
+            Accumulator accumulator;
+            m_network->refresh(entry.position, accumulator);
+            checksum = checksum * 31 + (uint16_t)accumulator.values[WHITE][0];
+        }
+        ops += m_positions.size();
+        break;
+    case MICRO_NNUE_UPDATE:
+        for (MicroPosition& entry : m_positions)
+        {
+            for (Move m : entry.moves)
+            {
+                Accumulator after;
+                m_network->update(entry.accumulator, after, m, entry.position.piece_on(move_from(m)),
+                                  entry.position.piece_on(move_to(m)));
+                checksum = checksum * 31 + (uint16_t)after.values[BLACK][0];
+            }
+            ops += entry.moves.size();
+        }
+        break;
+    case MICRO_NNUE_EVAL:
+        for (MicroPosition& entry : m_positions)
+            checksum = checksum * 31 + (uint64_t)m_network->evaluate(entry.accumulator, entry.position.side_to_move());
+        ops += m_positions.size();
+        break;
+    case MICRO_TT_STORE:
+        for (size_t i = 0; i < m_keys.size(); i++)
+            m_table.store(m_keys[i], (Move)(i & 0xFFF), (int)(i % 32), (int)(i % 1000) - 500, BOUND_EXACT);
+        // what a sample of the keys left in the table checks the stores and keeps them from being dropped
+        for (size_t i = 0; i < m_keys.size(); i += micro_store_check_step)
+        {
+            TTEntry found;
+            if (m_table.probe(m_keys[i], found))
+                checksum = checksum * 31 + found.move + ((uint64_t)found.depth << 16) + ((uint64_t)(found.score + 500) << 24);
+        }
+        ops += m_keys.size();
+        break;
+    case MICRO_TT_PROBE:
+        for (uint64_t key : m_keys)
+        {
+            TTEntry found;
+            if (m_table.probe(key, found))
+                checksum = checksum * 31 + found.move;
+        }
+        ops += m_keys.size();
+        break;
+    }
+    return checksum;
+}
+
+
+/*
+* NAME
+*      Run -- runs and reports the benchmarks
+*
+* SYNOPSYS
+*
+*      void Microbench::run(const string& filter, int repeat);
+*      filter      ->  only benchmarks whose names contain it are run, all for an empty filter
+*      repeat      ->  runs per benchmark, the fastest is reported
+*
+* DESCRIPTION
+*
+*  Prints the kernels in use, then a line per benchmark: operations per run, ns per operation,
+ *  millions of operations per second and the checksum of a run. The network benchmarks need a network.
+*/
+void Microbench::run(const string& filter, int repeat)
+{
+    cout << "kernels " << cpu_tier_name(cpu_tier()) << ": " << slider_kernel_name() << " attacks, network "
+         << nnue_simd_name() << ", " << m_positions.size() << " positions" << endl;
+    cout << left << setw(16) << "benchmark" << right << setw(12) << "ops/run" << setw(12) << "ns/op"
+         << setw(12) << "Mops/s" << "  checksum" << endl;
+    for (const MicroBenchmark& benchmark : micro_benchmarks)
+    {
+        if (!filter.empty() && string(benchmark.name).find(filter) == string::npos)
+            continue;
+        bool needs_network = benchmark.kind == MICRO_NNUE_REFRESH || benchmark.kind == MICRO_NNUE_UPDATE
+                          || benchmark.kind == MICRO_NNUE_EVAL;
+        if (needs_network && !m_network)
+            continue;
+
+        double best = 0;
+        uint64_t ops = 0, checksum = 0;
+        for (int run = 0; run < repeat; run++)
+        {
+            prepare(benchmark);
+            ops = checksum = 0;
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < benchmark.passes; i++)
+                checksum += pass(benchmark, ops);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+        cout << left << setw(16) << benchmark.name << right << setw(12) << ops << fixed << setprecision(2)
+             << setw(12) << best * 1e9 / ops << setw(12) << ops / best / 1e6 << "  " << hex << setw(16)
+             << setfill('0') << checksum << dec << setfill(' ') << endl;
+    }
+}
+
+
+/*
+* NAME
+*      MicrobenchCommand -- runs the microbenchmarks
+*
+* SYNOPSYS
+*
+*      int microbench_command(int argc, char* argv[]);
+*      argv        ->  options with their values
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -repeat <n>         runs per benchmark, the fastest is reported, 5 by default
+ *     -filter <text>      run the benchmarks whose names contain the text only
+ *     -nnue <file>        run the network benchmarks with the network
+ *  Force a kernel tier with ChessAI -cpu <tier> microbench to compare tiers.
+*/
+int microbench_command(int argc, char* argv[])
+{
+    int repeat = 5;
+    string filter, network_filename;
+    for (int i = 0; i < argc; i += 2)
+    {
+        string option = argv[i], value = (i + 1 < argc) ? argv[i + 1] : "";
+        if (option == "-repeat" && i + 1 < argc)
+            repeat = std::max(1, atoi(value.c_str()));
+        else if (option == "-filter" && i + 1 < argc)
+            filter = value;
+        else if (option == "-nnue" && i + 1 < argc)
+            network_filename = value;
+        else
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+
+    Network network;
+    if (!network_filename.empty() && !network.load(network_filename))
+        return 1;
+    Microbench bench(network.is_loaded() ? &network : nullptr);
+    bench.run(filter, repeat);
+    return 0;
+}
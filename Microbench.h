@@ -0,0 +1,72 @@
+/*
+Microbench class
+-- Times the engine's hot functions one at a time, so a regression in one kernel shows even when a whole search
+   hides it: move generation per piece type and in full, the attack maps, make / unmake, hashing, the static
+   evaluation, the network and the transposition table.
+-- Every benchmark works through a fixed set of positions, or a fixed sequence of keys for the table, a fixed number
+   of passes per run. The fastest of the runs is reported, in ns per operation and millions of operations per second.
+-- Each line carries a checksum of the results, which only changes when the function's output does, so the
+   timings of two commits are only compared when their checksums match. The kernel tier is printed first, see Cpu.h.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Position.h"
+#include "Nnue.h"
+#include "PawnTable.h"
+#include "TranspositionTable.h"
+
+using namespace std;
+
+enum MicroKind
+{
+    MICRO_MOVEGEN_PIECE, MICRO_MOVEGEN, MICRO_ATTACKS, MICRO_MAKE_UNMAKE, MICRO_HASH, MICRO_EVAL,
+    MICRO_NNUE_REFRESH, MICRO_NNUE_UPDATE, MICRO_NNUE_EVAL, MICRO_TT_STORE, MICRO_TT_PROBE
+};
+
+struct MicroBenchmark
+{
+    const char* name;
+    MicroKind kind;
+    PieceType type;                         // the piece moved by MICRO_MOVEGEN_PIECE
+    int passes;                             // passes over the positions or keys per run
+};
+
+// A position of the set with what the benchmarks of other functions need ready
+struct MicroPosition
+{
+    Position position;
+    AttackInfo attacks;
+    MoveList moves;                         // the legal moves
+    Accumulator accumulator;                // filled when a network is given
+};
+
+class Microbench
+{
+private:
+    vector<MicroPosition> m_positions;
+    vector<uint64_t> m_keys;                // random keys stored in and probed from the table
+    PawnTable m_pawns;
+    TranspositionTable m_table;
+    const Network* m_network;
+
+    // Get the state a benchmark starts each run from, untimed
+    void prepare(const MicroBenchmark& benchmark);
+
+    // One pass of the benchmark, returns the checksum of its results and adds the operations done to ops
+    uint64_t pass(const MicroBenchmark& benchmark, uint64_t& ops);
+
+public:
+    // Set up the positions, network may be nullptr to skip the network benchmarks
+    Microbench(const Network* network);
+
+    // Run the benchmarks whose names contain the filter, each repeat times, and print a line for each
+    void run(const string& filter, int repeat);
+};
+
+// Command line entry point: ChessAI microbench [-repeat n] [-filter text] [-nnue file]
+int microbench_command(int argc, char* argv[]);
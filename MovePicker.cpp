@@ -0,0 +1,235 @@
+#include "MovePicker.h"
+
+// Rough piece values for ordering captures, by PieceType
+static const int order_values[7] = { 0, 1, 3, 3, 5, 9, 100 };
+
+
+/*
+* NAME
+*      MovePicker -- creates a move picker
+*
+* SYNOPSYS
+*
+*      MovePicker::MovePicker(const Position& position, const AttackInfo& attacks, Move hash_move, const Move killers[2],
+*                             PickerLists& lists);
+*      position    ->  position whose moves are picked, must not change while picking
+*      attacks     ->  the position's attacks, see Position::compute_attacks
+*      hash_move   ->  move to search first, usually from the transposition table, or MOVE_NONE
+*      killers     ->  the two killer moves of the ply
+*      lists       ->  storage for the generated moves, not shared with another picker in use
+*
+* DESCRIPTION
+*
+*  Nothing is generated yet; the hash move is checked for legality only when it is asked for.
+*/
+MovePicker::MovePicker(const Position& position, const AttackInfo& attacks, Move hash_move, const Move killers[2],
+                       PickerLists& lists)
+    : m_position(position), m_attacks(attacks), m_lists(lists)
+{
+    m_hash_move = hash_move;
+    m_killers[0] = killers[0];
+    m_killers[1] = killers[1];
+    m_stage = STAGE_HASH;
+    m_killer_index = 0;
+    m_index = 0;
+    m_lists.moves.clear();
+    m_lists.bad_captures.clear();
+}
+
+
+/*
+* NAME
+*      CaptureScore -- scores a capture or promotion for ordering
+*
+* SYNOPSYS
+*
+*      int MovePicker::capture_score(Move m) const;
+*
+* DESCRIPTION
+*
+*  Taking a queen with a pawn scores highest and taking a pawn with the king lowest.
+ *  A promotion adds the promoted piece, so a promotion to a queen comes before most captures.
+*/
+int MovePicker::capture_score(Move m) const
+{
+    uint8_t victim = m_position.piece_on(move_to(m));
+    int score = m_position.is_capture(m) ? 16 * order_values[victim ? type_of(victim) : PAWN] : 0;
+    score -= order_values[type_of(m_position.piece_on(move_from(m)))];
+    if (move_promotion(m) != NO_TYPE)
+        score += 16 * order_values[move_promotion(m)];
+    return score;
+}
+
+
+/*
+* NAME
+*      LosesMaterial -- tells a bad capture
+*
+* SYNOPSYS
+*
+*      bool MovePicker::loses_material(Move m) const;
+*
+* DESCRIPTION
+*
+*  A capture by a more valuable piece than its victim loses material if the opponent can take back on the square.
+ *  Promotions never do.
+*/
+bool MovePicker::loses_material(Move m) const
+{
+    if (move_promotion(m) != NO_TYPE)
+        return false;
+    uint8_t victim = m_position.piece_on(move_to(m));
+    int taken = order_values[victim ? type_of(victim) : PAWN];
+    int risked = order_values[type_of(m_position.piece_on(move_from(m)))];
+    return risked > taken && (m_attacks.attacked[m_position.side_to_move() ^ 1] & square_bb(move_to(m)));
+}
+
+
+/*
+* NAME
+*      PickBest -- takes the best scored move of the stage
+*
+* SYNOPSYS
+*
+*      Move MovePicker::pick_best();
+*
+* DESCRIPTION
+*
+*  A selection step rather than a sort: when an early move cuts off, the rest is never ordered.
+*/
+Move MovePicker::pick_best()
+{
+    MoveList& moves = m_lists.moves;
+    int* scores = m_lists.scores;
+    int best = 0;
+    for (int i = 1; i < moves.size(); i++)
+    {
+        if (scores[i] > scores[best])
+            best = i;
+    }
+    Move m = moves[best];
+    int last = moves.size() - 1;
+    moves[best] = moves[last];
+    scores[best] = scores[last];
+    moves.pop_back();
+    return m;
+}
+
+
+/*
+* NAME
+*      IsPicked -- checks for a move returned by an earlier stage
+*
+* SYNOPSYS
+*
+*      bool MovePicker::is_picked(Move m) const;
+*/
+bool MovePicker::is_picked(Move m) const
+{
+    if (m == m_hash_move)
+        return true;
+    for (int i = 0; i < m_killer_index; i++)
+    {
+        if (m == m_killers[i])
+            return true;
+    }
+    return false;
+}
+
+
+/*
+* NAME
+*      Next -- returns the next move to search
+*
+* SYNOPSYS
+*
+*      Move MovePicker::next();
+*
+* DESCRIPTION
+*
+*  This function moves through the stages, generating a stage's moves when it is entered:
+ *     STAGE_HASH             the hash move, if legal
+ *     STAGE_GOOD_CAPTURES    captures and promotions, best first, putting aside those that lose material
+ *     STAGE_KILLERS          the killers, if legal quiet moves here
+ *     STAGE_QUIETS           the other moves, in generation order
+ *     STAGE_BAD_CAPTURES     the captures put aside, in the order they were met
+ *  No move is returned twice; m_hash_move and the killers are set to MOVE_NONE when they are not legal.
+*/
+Move MovePicker::next()
+{
+    while (true)
+    {
+        switch (m_stage)
+        {
+        case STAGE_HASH:
+            m_stage = STAGE_CAPTURES_INIT;
+            if (m_hash_move != MOVE_NONE && m_position.is_legal(m_hash_move, &m_attacks))
+                return m_hash_move;
+            m_hash_move = MOVE_NONE;
+            break;
+
+        case STAGE_CAPTURES_INIT:
+            m_position.get_captures(m_lists.moves, &m_attacks);
+            for (int i = 0; i < m_lists.moves.size(); i++)
+                m_lists.scores[i] = capture_score(m_lists.moves[i]);
+            m_stage = STAGE_GOOD_CAPTURES;
+            break;
+
+        case STAGE_GOOD_CAPTURES:
+            while (!m_lists.moves.empty())
+            {
+                Move m = pick_best();
+                if (m == m_hash_move)
+                    continue;
+                if (loses_material(m))
+                    m_lists.bad_captures.push_back(m);
+                else
+                    return m;
+            }
+            m_stage = STAGE_KILLERS;
+            break;
+
+        case STAGE_KILLERS:
+            while (m_killer_index < 2)
+            {
+                Move m = m_killers[m_killer_index];
+                bool repeated = m_killer_index == 1 && m == m_killers[0];
+                m_killer_index++;
+                if (m == MOVE_NONE || repeated || m == m_hash_move)
+                    continue;
+                if (m_position.is_legal(m, &m_attacks) && !m_position.is_capture(m) && move_promotion(m) == NO_TYPE)
+                    return m;
+                m_killers[m_killer_index - 1] = MOVE_NONE;
+            }
+            m_stage = STAGE_QUIETS_INIT;
+            break;
+
+        case STAGE_QUIETS_INIT:
+            m_lists.moves.clear();
+            m_position.get_quiets(m_lists.moves, &m_attacks);
+            m_index = 0;
+            m_stage = STAGE_QUIETS;
+            break;
+
+        case STAGE_QUIETS:
+            while (m_index < m_lists.moves.size())
+            {
+                Move m = m_lists.moves[m_index++];
+                if (!is_picked(m))
+                    return m;
+            }
+            m_index = 0;
+            m_stage = STAGE_BAD_CAPTURES;
+            break;
+
+        case STAGE_BAD_CAPTURES:
+            if (m_index < m_lists.bad_captures.size())
+                return m_lists.bad_captures[m_index++];
+            m_stage = STAGE_DONE;
+            break;
+
+        default:
+            return MOVE_NONE;
+        }
+    }
+}
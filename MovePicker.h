@@ -0,0 +1,61 @@
+/*
+MovePicker class
+-- Hands the search the legal moves of a position one at a time, generating them in stages only when they are asked for.
+-- The hash move comes first and is only checked for legality, then the captures and promotions that do not lose material,
+   most valuable victim first, then the killer moves, the quiet moves and last the captures that lose material.
+-- A cutoff on an early move saves generating the later stages at all.
+-- The move lists live in a PickerLists the caller provides, normally a ply of the search stack, so picking allocates nothing.
+*/
+
+
+#pragma once
+
+#include "Position.h"
+
+using namespace std;
+
+enum PickStage
+{
+    STAGE_HASH, STAGE_CAPTURES_INIT, STAGE_GOOD_CAPTURES, STAGE_KILLERS,
+    STAGE_QUIETS_INIT, STAGE_QUIETS, STAGE_BAD_CAPTURES, STAGE_DONE
+};
+
+// Move lists of one picker
+struct PickerLists
+{
+    MoveList moves;                         // moves of the current stage
+    int scores[MAX_MOVES];                  // ordering score of each of moves
+    MoveList bad_captures;                  // captures put off until after the quiet moves
+};
+
+class MovePicker
+{
+private:
+    const Position& m_position;
+    const AttackInfo& m_attacks;            // the position's attacks, for legality and whether a capture is defended
+    Move m_hash_move;                       // searched first, MOVE_NONE if there is none
+    Move m_killers[2];                      // quiet moves that cut off at the same ply elsewhere
+    int m_stage;                            // PickStage of the next move
+    int m_killer_index;                     // next killer to try
+    PickerLists& m_lists;                   // the moves of the current stage and the bad captures
+    int m_index;                            // next of the quiet moves or bad captures to return
+
+    // Order value of a capture or promotion: most valuable victim, then least valuable attacker
+    int capture_score(Move m) const;
+
+    // Check if a capture gives up more than it takes, the target being defended
+    bool loses_material(Move m) const;
+
+    // Remove the highest scored move of the stage and return it
+    Move pick_best();
+
+    // Check if the move was returned by the hash or killer stage already
+    bool is_picked(Move m) const;
+
+public:
+    // Picker for the side to move, whose attacks have been computed; killers may be MOVE_NONE or moves of other positions
+    MovePicker(const Position& position, const AttackInfo& attacks, Move hash_move, const Move killers[2], PickerLists& lists);
+
+    // The next legal move, MOVE_NONE once every move has been returned
+    Move next();
+};
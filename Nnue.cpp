@@ -0,0 +1,452 @@
+#include "Nnue.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if !defined(NNUE_NO_SIMD) && defined(CHESS_DISPATCH)
+#include <immintrin.h>
+#define NNUE_SIMD
+#endif
+
+static size_t align64(size_t offset) { return (offset + 63) & ~(size_t)63; }
+
+// Byte offsets of the weight arrays in a network file
+static const size_t feature_weights_offset = align64(sizeof(NnueHeader));
+static const size_t feature_biases_offset = align64(feature_weights_offset + sizeof(int16_t) * NNUE_FEATURES * NNUE_L1);
+static const size_t l2_weights_offset = align64(feature_biases_offset + sizeof(int16_t) * NNUE_L1);
+static const size_t l2_biases_offset = align64(l2_weights_offset + sizeof(int8_t) * NNUE_L2 * 2 * NNUE_L1);
+static const size_t output_weights_offset = align64(l2_biases_offset + sizeof(int32_t) * NNUE_L2);
+static const size_t output_bias_offset = align64(output_weights_offset + sizeof(int8_t) * NNUE_L2);
+static const size_t network_file_size = align64(output_bias_offset + sizeof(int32_t));
+
+
+/*
+* NAME
+*      FeatureIndex -- returns the input feature of a piece seen from one side
+*
+* SYNOPSYS
+*
+*      int feature_index(Color perspective, uint8_t code, int sq);
+*
+* DESCRIPTION
+*
+*  Pieces of the perspective come first, then the opponent's, each ordered by type and square.
+ *  For black the rows are mirrored so black's pieces look like white's.
+*/
+static inline int feature_index(Color perspective, uint8_t code, int sq)
+{
+    int relative_color = (color_of(code) == perspective) ? 0 : 1;
+    int relative_sq = (perspective == WHITE) ? sq : (sq ^ 56);
+    return ((relative_color * 6) + (type_of(code) - 1)) * 64 + relative_sq;
+}
+
+
+/*
+ * Kernels start
+ */
+
+// accumulator += weight row
+static void add_row_scalar(int16_t* accumulator, const int16_t* row)
+{
+    for (int i = 0; i < NNUE_L1; i++)
+        accumulator[i] += row[i];
+}
+
+// accumulator -= weight row
+static void sub_row_scalar(int16_t* accumulator, const int16_t* row)
+{
+    for (int i = 0; i < NNUE_L1; i++)
+        accumulator[i] -= row[i];
+}
+
+// output[i] = clamp(input[i], 0, 127) for one side of the accumulator
+static void clipped_relu_scalar(const int16_t* input, uint8_t* output)
+{
+    for (int i = 0; i < NNUE_L1; i++)
+        output[i] = (uint8_t)std::min(std::max((int)input[i], 0), 127);
+}
+
+// sum of input[i] * weights[i] over the 2 * NNUE_L1 clipped inputs
+static int32_t dot_product_scalar(const uint8_t* input, const int8_t* weights)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < 2 * NNUE_L1; i++)
+        sum += input[i] * weights[i];
+    return sum;
+}
+
+#ifdef NNUE_SIMD
+__attribute__((target("sse4.1"))) static void add_row_sse41(int16_t* accumulator, const int16_t* row)
+{
+    for (int i = 0; i < NNUE_L1; i += 8)
+    {
+        __m128i sum = _mm_add_epi16(_mm_load_si128((const __m128i*)(accumulator + i)), _mm_loadu_si128((const __m128i*)(row + i)));
+        _mm_store_si128((__m128i*)(accumulator + i), sum);
+    }
+}
+
+__attribute__((target("sse4.1"))) static void sub_row_sse41(int16_t* accumulator, const int16_t* row)
+{
+    for (int i = 0; i < NNUE_L1; i += 8)
+    {
+        __m128i difference = _mm_sub_epi16(_mm_load_si128((const __m128i*)(accumulator + i)), _mm_loadu_si128((const __m128i*)(row + i)));
+        _mm_store_si128((__m128i*)(accumulator + i), difference);
+    }
+}
+
+__attribute__((target("sse4.1"))) static void clipped_relu_sse41(const int16_t* input, uint8_t* output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < NNUE_L1; i += 16)
+    {
+        __m128i low = _mm_max_epi16(_mm_load_si128((const __m128i*)(input + i)), zero);
+        __m128i high = _mm_max_epi16(_mm_load_si128((const __m128i*)(input + i + 8)), zero);
+        _mm_store_si128((__m128i*)(output + i), _mm_packs_epi16(low, high));
+    }
+}
+
+__attribute__((target("sse4.1"))) static int32_t dot_product_sse41(const uint8_t* input, const int8_t* weights)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < 2 * NNUE_L1; i += 16)
+    {
+        __m128i products = _mm_maddubs_epi16(_mm_load_si128((const __m128i*)(input + i)), _mm_loadu_si128((const __m128i*)(weights + i)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2"))) static void add_row_avx2(int16_t* accumulator, const int16_t* row)
+{
+    for (int i = 0; i < NNUE_L1; i += 16)
+    {
+        __m256i sum = _mm256_add_epi16(_mm256_load_si256((const __m256i*)(accumulator + i)), _mm256_loadu_si256((const __m256i*)(row + i)));
+        _mm256_store_si256((__m256i*)(accumulator + i), sum);
+    }
+}
+
+__attribute__((target("avx2"))) static void sub_row_avx2(int16_t* accumulator, const int16_t* row)
+{
+    for (int i = 0; i < NNUE_L1; i += 16)
+    {
+        __m256i difference = _mm256_sub_epi16(_mm256_load_si256((const __m256i*)(accumulator + i)), _mm256_loadu_si256((const __m256i*)(row + i)));
+        _mm256_store_si256((__m256i*)(accumulator + i), difference);
+    }
+}
+
+__attribute__((target("avx2"))) static void clipped_relu_avx2(const int16_t* input, uint8_t* output)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_L1; i += 32)
+    {
+        __m256i low = _mm256_max_epi16(_mm256_load_si256((const __m256i*)(input + i)), zero);
+        __m256i high = _mm256_max_epi16(_mm256_load_si256((const __m256i*)(input + i + 16)), zero);
+        // packs works within 128-bit lanes, the permute restores the element order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+        _mm256_store_si256((__m256i*)(output + i), packed);
+    }
+}
+
+__attribute__((target("avx2"))) static int32_t dot_product_avx2(const uint8_t* input, const int8_t* weights)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < 2 * NNUE_L1; i += 32)
+    {
+        __m256i products = _mm256_maddubs_epi16(_mm256_load_si256((const __m256i*)(input + i)), _mm256_loadu_si256((const __m256i*)(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+#endif
+
+/*
+ * Kernels end
+ */
+
+// The kernels of one instruction set tier
+struct NnueKernels
+{
+    const char* name;
+    void (*add_row)(int16_t* accumulator, const int16_t* row);
+    void (*sub_row)(int16_t* accumulator, const int16_t* row);
+    void (*clipped_relu)(const int16_t* input, uint8_t* output);
+    int32_t (*dot_product)(const uint8_t* input, const int8_t* weights);
+};
+
+static const NnueKernels scalar_kernels = { "scalar", add_row_scalar, sub_row_scalar, clipped_relu_scalar, dot_product_scalar };
+#ifdef NNUE_SIMD
+static const NnueKernels sse41_kernels = { "sse41", add_row_sse41, sub_row_sse41, clipped_relu_sse41, dot_product_sse41 };
+static const NnueKernels avx2_kernels = { "avx2", add_row_avx2, sub_row_avx2, clipped_relu_avx2, dot_product_avx2 };
+#endif
+
+static const NnueKernels* kernels = &scalar_kernels;
+
+
+/*
+* NAME
+*      SelectNnueKernels -- selects the kernels of a tier
+*
+* SYNOPSYS
+*
+*      void select_nnue_kernels(CpuTier tier);
+*/
+void select_nnue_kernels(CpuTier tier)
+{
+    kernels = &scalar_kernels;
+#ifdef NNUE_SIMD
+    if (tier >= CPU_AVX2)
+        kernels = &avx2_kernels;
+    else if (tier >= CPU_SSE41)
+        kernels = &sse41_kernels;
+#endif
+}
+
+
+/*
+* NAME
+*      NnueSimdName -- returns the name of the kernels in use
+*
+* SYNOPSYS
+*
+*      const char* nnue_simd_name();
+*/
+const char* nnue_simd_name()
+{
+    return kernels->name;
+}
+
+
+/*
+* NAME
+*      Network -- creates a network without weights
+*
+* SYNOPSYS
+*
+*      Network::Network();
+*/
+Network::Network()
+{
+    m_feature_weights = nullptr;
+    m_feature_biases = nullptr;
+    m_l2_weights = nullptr;
+    m_l2_biases = nullptr;
+    m_output_weights = nullptr;
+    m_output_bias = nullptr;
+}
+
+
+/*
+* NAME
+*      Load -- maps a network file
+*
+* SYNOPSYS
+*
+*      bool Network::load(const string& filename);
+*
+* DESCRIPTION
+*
+*  This function maps the file, checks the header and size, and points the weight arrays into the mapping.
+ *  Returns false and leaves the network unloaded if anything does not match.
+*/
+bool Network::load(const string& filename)
+{
+    TRACE_SCOPE("load", "network");
+    m_feature_weights = nullptr;
+    if (!m_file.open(filename))
+        return false;
+
+    const NnueHeader* header = (const NnueHeader*)m_file.data();
+    if (m_file.size() < network_file_size || memcmp(header->magic, "CNN1", 4) != 0
+        || header->features != NNUE_FEATURES || header->l1 != NNUE_L1 || header->l2 != NNUE_L2)
+    {
+        cout << filename << " is not a network file of this engine" << endl;
+        m_file.close();
+        return false;
+    }
+
+    const unsigned char* data = m_file.data();
+    m_feature_weights = (const int16_t*)(data + feature_weights_offset);
+    m_feature_biases = (const int16_t*)(data + feature_biases_offset);
+    m_l2_weights = (const int8_t*)(data + l2_weights_offset);
+    m_l2_biases = (const int32_t*)(data + l2_biases_offset);
+    m_output_weights = (const int8_t*)(data + output_weights_offset);
+    m_output_bias = (const int32_t*)(data + output_bias_offset);
+    return true;
+}
+
+
+/*
+* NAME
+*      Refresh -- computes the accumulator from scratch
+*
+* SYNOPSYS
+*
+*      void Network::refresh(const Position& position, Accumulator& accumulator) const;
+*
+* DESCRIPTION
+*
+*  This function starts both sides from the biases and adds the weight row of every piece.
+*/
+void Network::refresh(const Position& position, Accumulator& accumulator) const
+{
+    const NnueKernels& simd = *kernels;
+    for (int perspective = WHITE; perspective <= BLACK; perspective++)
+    {
+        int16_t* values = accumulator.values[perspective];
+        memcpy(values, m_feature_biases, sizeof(accumulator.values[perspective]));
+        Bitboard occupied = position.occupancy();
+        while (occupied)
+        {
+            int sq = __builtin_ctzll(occupied);
+            occupied &= occupied - 1;
+            simd.add_row(values, m_feature_weights + feature_index((Color)perspective, position.piece_on(sq), sq) * NNUE_L1);
+        }
+    }
+}
+
+
+/*
+* NAME
+*      Update -- derives the accumulator after a move
+*
+* SYNOPSYS
+*
+*      void Network::update(const Accumulator& before, Accumulator& after, Move m, uint8_t moved, uint8_t captured) const;
+*      before      ->  accumulator of the position before the move
+*      after       ->  receives the accumulator of the position after it
+*      moved       ->  piece code on the from square before the move
+*      captured    ->  piece code on the to square before the move, NO_PIECE if none
+*
+* DESCRIPTION
+*
+*  This function copies the accumulator and removes / adds the weight rows of the few features that changed:
+ *  the moving piece leaves its square, arrives (possibly promoted) on the target, and the captured piece disappears.
+ *  A pawn moving diagonally to an empty square captures en passant, the pawn behind the target disappears;
+ *  a king stepping two squares castles, and its rook moves too.
+*/
+void Network::update(const Accumulator& before, Accumulator& after, Move m, uint8_t moved, uint8_t captured) const
+{
+    int from = move_from(m), to = move_to(m);
+    uint8_t arrived = (move_promotion(m) != NO_TYPE) ? make_piece(color_of(moved), move_promotion(m)) : moved;
+    int captured_sq = to;
+    if (type_of(moved) == PAWN && captured == NO_PIECE && col_of(from) != col_of(to))
+    {
+        captured = make_piece((Color)(color_of(moved) ^ 1), PAWN);
+        captured_sq = make_square(row_of(from), col_of(to));
+    }
+    bool castling = type_of(moved) == KING && (to - from == 2 || from - to == 2);
+    uint8_t rook = make_piece(color_of(moved), ROOK);
+    int rook_from = (to > from) ? from + 3 : from - 4, rook_to = (from + to) / 2;
+
+    const NnueKernels& simd = *kernels;
+    for (int perspective = WHITE; perspective <= BLACK; perspective++)
+    {
+        int16_t* values = after.values[perspective];
+        memcpy(values, before.values[perspective], sizeof(after.values[perspective]));
+        simd.sub_row(values, m_feature_weights + feature_index((Color)perspective, moved, from) * NNUE_L1);
+        simd.add_row(values, m_feature_weights + feature_index((Color)perspective, arrived, to) * NNUE_L1);
+        if (captured != NO_PIECE)
+            simd.sub_row(values, m_feature_weights + feature_index((Color)perspective, captured, captured_sq) * NNUE_L1);
+        if (castling)
+        {
+            simd.sub_row(values, m_feature_weights + feature_index((Color)perspective, rook, rook_from) * NNUE_L1);
+            simd.add_row(values, m_feature_weights + feature_index((Color)perspective, rook, rook_to) * NNUE_L1);
+        }
+    }
+}
+
+
+/*
+* NAME
+*      Evaluate -- runs the network on an accumulator
+*
+* SYNOPSYS
+*
+*      int Network::evaluate(const Accumulator& accumulator, Color side_to_move) const;
+*
+* DESCRIPTION
+*
+*  This function clips the side to move's accumulator followed by the other side's into 512 bytes,
+ *  runs the second layer (int8 weights, shifted and clipped to 0..127) and the output neuron.
+ *  Returns centipawns from the side to move's point of view.
+*/
+int Network::evaluate(const Accumulator& accumulator, Color side_to_move) const
+{
+    const NnueKernels& simd = *kernels;
+    alignas(64) uint8_t input[2 * NNUE_L1];
+    simd.clipped_relu(accumulator.values[side_to_move], input);
+    simd.clipped_relu(accumulator.values[side_to_move ^ 1], input + NNUE_L1);
+
+    int32_t output = *m_output_bias;
+    for (int neuron = 0; neuron < NNUE_L2; neuron++)
+    {
+        int32_t sum = m_l2_biases[neuron] + simd.dot_product(input, m_l2_weights + neuron * 2 * NNUE_L1);
+        int32_t activation = std::min(std::max(sum >> NNUE_L2_SHIFT, 0), 127);
+        output += activation * m_output_weights[neuron];
+    }
+    return output / NNUE_OUTPUT_DIVISOR;
+}
+
+
+/*
+* NAME
+*      WriteMaterialNetwork -- writes a network that evaluates material
+*
+* SYNOPSYS
+*
+*      bool write_material_network(const string& filename);
+*
+* DESCRIPTION
+*
+*  Accumulator lane 0 sums the own material and lane 1 the opponent's, at 3 units per pawn
+ *  (knight, bishop 9, rook 15, queen 27, so a full set stays below the clipping point of 127).
+ *  Four second layer neurons copy each lane and the output takes their difference,
+ *  which comes to about 100 centipawns per pawn. All other weights are zero.
+*/
+bool write_material_network(const string& filename)
+{
+    static const int16_t lane_values[7] = { 0, 3, 9, 9, 15, 27, 0 };
+
+    vector<unsigned char> data(network_file_size, 0);
+    NnueHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "CNN1", 4);
+    header.features = NNUE_FEATURES;
+    header.l1 = NNUE_L1;
+    header.l2 = NNUE_L2;
+    memcpy(data.data(), &header, sizeof(header));
+
+    int16_t* feature_weights = (int16_t*)(data.data() + feature_weights_offset);
+    for (int relative_color = 0; relative_color < 2; relative_color++)
+        for (int type = PAWN; type <= KING; type++)
+            for (int sq = 0; sq < 64; sq++)
+                feature_weights[((relative_color * 6 + type - 1) * 64 + sq) * NNUE_L1 + relative_color] = lane_values[type];
+
+    int8_t* l2_weights = (int8_t*)(data.data() + l2_weights_offset);
+    int8_t* output_weights = (int8_t*)(data.data() + output_weights_offset);
+    for (int neuron = 0; neuron < 8; neuron++)
+    {
+        l2_weights[neuron * 2 * NNUE_L1 + neuron / 4] = 1 << NNUE_L2_SHIFT;
+        output_weights[neuron] = (neuron < 4) ? 67 : -67;
+    }
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+        cout << "Could not open " << filename << " for writing" << endl;
+        return false;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return written;
+}
@@ -0,0 +1,81 @@
+/*
+Network class and Accumulator
+-- Efficiently updatable neural network evaluation, run on the CPU.
+-- Input features are (piece, square) pairs seen from each side: 2 relative colors x 6 types x 64 squares.
+   Black's view flips the board so both sides share the weights.
+-- The first layer is kept in an Accumulator per side and updated incrementally as moves are made,
+   the rest of the network (512 -> 32 -> 1, int8 weights) is run on evaluation.
+-- Weights are used straight from a memory-mapped file.
+-- The kernels come in AVX2, SSE4.1 and plain C++ versions, and the best one the CPU runs is selected at startup, see Cpu.h.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Cpu.h"
+#include "MappedFile.h"
+#include "Position.h"
+
+using namespace std;
+
+const int NNUE_FEATURES = 768;
+const int NNUE_L1 = 256;                    // accumulator width per side
+const int NNUE_L2 = 32;
+const int NNUE_L2_SHIFT = 6;                // second layer sums are divided by 64 before clipping
+const int NNUE_OUTPUT_DIVISOR = 8;          // output sum to centipawns
+
+// First layer output of both sides
+struct alignas(64) Accumulator
+{
+    int16_t values[2][NNUE_L1];
+};
+
+// Header of a network file, the weight arrays follow, each starting at a multiple of 64 bytes:
+// feature weights int16[768][256], feature biases int16[256], second layer weights int8[32][512],
+// second layer biases int32[32], output weights int8[32], output bias int32
+struct NnueHeader
+{
+    char magic[4];                          // "CNN1"
+    uint32_t features, l1, l2;              // must match the constants above
+    uint32_t reserved[4];
+};
+
+class Network
+{
+private:
+    MappedFile m_file;
+    const int16_t* m_feature_weights;
+    const int16_t* m_feature_biases;
+    const int8_t* m_l2_weights;
+    const int32_t* m_l2_biases;
+    const int8_t* m_output_weights;
+    const int32_t* m_output_bias;
+
+public:
+    Network();
+
+    // Map a network file, returns false if it is missing or malformed
+    bool load(const string& filename);
+    bool is_loaded() const { return m_feature_weights != nullptr; }
+
+    // Compute both sides of the accumulator from scratch
+    void refresh(const Position& position, Accumulator& accumulator) const;
+
+    // Derive the accumulator after a move from the one before it
+    // moved and captured are the piece codes on the from and to squares before the move, en passant and castling are inferred
+    void update(const Accumulator& before, Accumulator& after, Move m, uint8_t moved, uint8_t captured) const;
+
+    // Score in centipawns from the side to move's point of view
+    int evaluate(const Accumulator& accumulator, Color side_to_move) const;
+};
+
+// Point the network kernels at the tier's versions
+void select_nnue_kernels(CpuTier tier);
+
+// Name of the kernels in use: avx2, sse41 or scalar
+const char* nnue_simd_name();
+
+// Write a network whose output is the material balance, a starting point for training and a test fixture
+bool write_material_network(const string& filename);
@@ -0,0 +1,207 @@
+#include "Notation.h"
+#include <cctype>
+#include <cstring>
+
+static const char san_piece_chars[] = "  NBRQK";
+
+
+/*
+* NAME
+*      MoveToSan -- returns the standard algebraic notation of a move
+*
+* SYNOPSYS
+*
+*      string move_to_san(Position& position, Move m);
+*      position    ->  the position before the move, left unchanged
+*      m           ->  a legal move in the position
+*
+* DESCRIPTION
+*
+*  This function writes O-O or O-O-O for castling. Otherwise it writes the piece letter, the file and/or row needed
+ *  to tell it apart from another piece of the same kind reaching the same square, the capture mark,
+ *  the target square and the promotion.
+ *  A + is appended if the move gives check, a # if it gives checkmate.
+*/
+string move_to_san(Position& position, Move m)
+{
+    int from = move_from(m), to = move_to(m);
+    uint8_t piece = position.piece_on(from);
+    bool capture = position.piece_on(to) != NO_PIECE || (type_of(piece) == PAWN && col_of(from) != col_of(to));
+    string san;
+
+    if (type_of(piece) == KING && (to - from == 2 || from - to == 2))
+        san = (to > from) ? "O-O" : "O-O-O";
+    else if (type_of(piece) == PAWN)
+    {
+        if (capture)
+            san += (char)('a' + col_of(from));
+    }
+    else
+    {
+        san += san_piece_chars[type_of(piece)];
+
+        // disambiguate among pieces of the same kind that can reach the target square
+        MoveList moves;
+        position.get_all_valids(moves);
+        bool ambiguous = false, same_col = false, same_row = false;
+        for (Move other : moves)
+        {
+            int other_from = move_from(other);
+            if (other_from == from || move_to(other) != to || position.piece_on(other_from) != piece)
+                continue;
+            ambiguous = true;
+            same_col |= col_of(other_from) == col_of(from);
+            same_row |= row_of(other_from) == row_of(from);
+        }
+        if (ambiguous && !same_col)
+            san += (char)('a' + col_of(from));
+        else if (ambiguous && !same_row)
+            san += (char)('1' + row_of(from));
+        else if (ambiguous)
+            san += square_name(from);
+    }
+
+    if (san[0] != 'O')
+    {
+        if (capture)
+            san += 'x';
+        san += square_name(to);
+        if (move_promotion(m) != NO_TYPE)
+            san += string("=") + san_piece_chars[move_promotion(m)];
+    }
+
+    Undo undo;
+    position.make_move(m, undo);
+    if (position.in_check())
+    {
+        MoveList replies;
+        position.get_all_valids(replies);
+        san += replies.empty() ? '#' : '+';
+    }
+    position.unmake_move(m, undo);
+    return san;
+}
+
+
+/*
+* NAME
+*      LineToSan -- returns a line of moves in standard algebraic notation
+*
+* SYNOPSYS
+*
+*      string line_to_san(const Position& position, const vector<Move>& line);
+*      position    ->  the position the line starts from
+*      line        ->  legal moves played one after the other
+*
+* DESCRIPTION
+*
+*  This function numbers the moves as in a game score, e.g. "12. Nf3 d5 13. c4", or "12... d5 13. c4"
+ *  when black moves first.
+*/
+string line_to_san(const Position& position, const vector<Move>& line)
+{
+    Position current = position;
+    string san;
+    for (size_t i = 0; i < line.size(); i++)
+    {
+        if (i > 0)
+            san += ' ';
+        if (current.side_to_move() == WHITE)
+            san += to_string(current.fullmove()) + ". ";
+        else if (i == 0)
+            san += to_string(current.fullmove()) + "... ";
+        san += move_to_san(current, line[i]);
+        Undo undo;
+        current.make_move(line[i], undo);
+    }
+    return san;
+}
+
+
+/*
+* NAME
+*      SanToMove -- reads a move in standard algebraic notation
+*
+* SYNOPSYS
+*
+*      Move san_to_move(const Position& position, const string& san);
+*      position    ->  the position the move is played in
+*      san         ->  e.g. Nbd7, exd5, O-O, e8=Q+, also e8Q
+*
+* DESCRIPTION
+*
+*  This function reads the piece, the target square, the promotion and the file or row given to disambiguate,
+ *  then looks for the one legal move that fits them. Returns MOVE_NONE if there is none, or more than one.
+*/
+Move san_to_move(const Position& position, const string& san)
+{
+    string text = san;
+    while (!text.empty() && strchr("+#!?", text.back()))
+        text.pop_back();
+    MoveList moves;
+    position.get_all_valids(moves);
+
+    if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0")
+    {
+        bool king_side = text.size() == 3;
+        for (Move m : moves)
+        {
+            int from = move_from(m), to = move_to(m);
+            if (type_of(position.piece_on(from)) == KING && (to - from == 2 || from - to == 2) && (to > from) == king_side)
+                return m;
+        }
+        return MOVE_NONE;
+    }
+
+    PieceType promotion = NO_TYPE;
+    size_t equals = text.find('=');
+    if (equals != string::npos && equals + 1 < text.size())
+    {
+        const char* piece = strchr(san_piece_chars + 2, text[equals + 1]);
+        promotion = piece ? (PieceType)(piece - san_piece_chars) : KING;
+        text.erase(equals);
+    }
+    else if (text.size() >= 3 && strchr("NBRQ", text.back()) && isdigit((unsigned char)text[text.size() - 2]))
+    {
+        promotion = (PieceType)(strchr(san_piece_chars, text.back()) - san_piece_chars);
+        text.pop_back();
+    }
+    if (text.size() < 2 || promotion == KING)
+        return MOVE_NONE;
+
+    int to_col = text[text.size() - 2] - 'a', to_row = text[text.size() - 1] - '1';
+    if (to_col < 0 || to_col > 7 || to_row < 0 || to_row > 7)
+        return MOVE_NONE;
+    PieceType piece = PAWN;
+    size_t start = 0;
+    if (isupper((unsigned char)text[0]))
+    {
+        const char* letter = strchr(san_piece_chars + 2, text[0]);
+        if (!letter)
+            return MOVE_NONE;
+        piece = (PieceType)(letter - san_piece_chars);
+        start = 1;
+    }
+    int from_col = -1, from_row = -1;
+    for (size_t i = start; i + 2 < text.size(); i++)
+    {
+        if (text[i] >= 'a' && text[i] <= 'h')
+            from_col = text[i] - 'a';
+        else if (text[i] >= '1' && text[i] <= '8')
+            from_row = text[i] - '1';
+    }
+
+    Move found = MOVE_NONE;
+    for (Move m : moves)
+    {
+        int from = move_from(m);
+        if (move_to(m) != make_square(to_row, to_col) || type_of(position.piece_on(from)) != piece
+            || move_promotion(m) != promotion || (from_col >= 0 && col_of(from) != from_col)
+            || (from_row >= 0 && row_of(from) != from_row))
+            continue;
+        if (found != MOVE_NONE)
+            return MOVE_NONE;
+        found = m;
+    }
+    return found;
+}
@@ -0,0 +1,24 @@
+/*
+Notation functions
+-- Standard algebraic notation (SAN) for the engine's moves, as written to PGN files and shown for analysis lines,
+   and read back from PGN files.
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Position.h"
+
+using namespace std;
+
+// SAN of a legal move in the position, e.g. Nbd7, exd5, O-O, e8=Q+
+string move_to_san(Position& position, Move m);
+
+// SAN of a line of legal moves from the position, with move numbers, e.g. 12... d5 13. c4 e6
+string line_to_san(const Position& position, const vector<Move>& line);
+
+// Legal move of the position written in SAN, MOVE_NONE if the text is not one; check marks and annotations
+// are ignored and castling may be written with zeros
+Move san_to_move(const Position& position, const string& san);
@@ -0,0 +1,313 @@
+#include "PackedPosition.h"
+#include <iostream>
+#include <cstring>
+
+// Records buffered by PackedWriter before they hit the file
+static const size_t writer_buffer_records = 1 << 15;
+
+
+/*
+* NAME
+*      PackPosition -- packs a position into a 32 byte record
+*
+* SYNOPSYS
+*
+*      PackedPosition pack_position(const Position& position, int16_t score, int8_t result);
+*      position    ->  the position to be packed
+*      score       ->  search score from white's point of view, SCORE_NONE if there is none
+*      result      ->  game result from white's point of view, RESULT_NONE if there is none
+*
+* DESCRIPTION
+*
+*  This function stores the occupancy bitboard followed by the piece codes of the occupied squares,
+ *  in square order, two codes per byte. Positions with more than 32 pieces are not representable,
+ *  the extra pieces are dropped.
+*/
+PackedPosition pack_position(const Position& position, int16_t score, int8_t result)
+{
+    PackedPosition record;
+    memset(&record, 0, sizeof(record));
+
+    int index = 0;
+    for (int sq = 0; sq < 64 && index < 32; sq++)
+    {
+        uint8_t code = position.piece_on(sq);
+        if (code == NO_PIECE)
+            continue;
+        record.occupancy |= square_bb(sq);
+        record.pieces[index / 2] |= (uint8_t)(code << ((index % 2) * 4));
+        index++;
+    }
+
+    record.flags = (uint8_t)(position.side_to_move() | (position.castling() << 1));
+    record.ep_square = position.ep_square();
+    record.halfmove = (uint8_t)(position.halfmove() > 255 ? 255 : position.halfmove());
+    record.fullmove = (uint16_t)(position.fullmove() > 65535 ? 65535 : position.fullmove());
+    record.score = score;
+    record.result = result;
+    return record;
+}
+
+
+/*
+* NAME
+*      UnpackPosition -- unpacks a 32 byte record into a position
+*
+* SYNOPSYS
+*
+*      bool unpack_position(const PackedPosition& record, Position& position);
+*      record      ->  the record to be unpacked
+*      position    ->  the position to be filled
+*
+* DESCRIPTION
+*
+*  This function walks the set bits of the occupancy and assigns them the piece codes in order.
+ *  Returns false, leaving the position empty, if the record is corrupt: more than 32 pieces, a code that is
+ *  no piece, unknown flag bits, or a position that fails Position::is_valid.
+*/
+bool unpack_position(const PackedPosition& record, Position& position)
+{
+    position = Position();
+    if (__builtin_popcountll(record.occupancy) > 32 || (record.flags >> 5) || record.ep_square > NO_SQUARE)
+        return false;
+
+    Bitboard occupancy = record.occupancy;
+    int index = 0;
+    while (occupancy)
+    {
+        int sq = __builtin_ctzll(occupancy);
+        occupancy &= occupancy - 1;
+        uint8_t code = (record.pieces[index / 2] >> ((index % 2) * 4)) & 15;
+        if (type_of(code) < PAWN || type_of(code) > KING)
+        {
+            position = Position();
+            return false;
+        }
+        position.put_piece(sq, code);
+        index++;
+    }
+
+    position.set_side_to_move((Color)(record.flags & 1));
+    position.set_castling((uint8_t)(record.flags >> 1));
+    position.set_ep_square(record.ep_square);
+    position.set_halfmove(record.halfmove);
+    position.set_fullmove(record.fullmove == 0 ? 1 : record.fullmove);
+    if (!position.is_valid())
+    {
+        position = Position();
+        return false;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      PackedFromFen -- packs a FEN string
+*
+* SYNOPSYS
+*
+*      bool packed_from_fen(const string& fen, PackedPosition& record, int16_t score, int8_t result);
+*      fen         ->  the FEN string
+*      record      ->  the record to be filled
+*
+* DESCRIPTION
+*
+*  This function parses the FEN and packs it. Returns false if the FEN is malformed.
+*/
+bool packed_from_fen(const string& fen, PackedPosition& record, int16_t score, int8_t result)
+{
+    Position position;
+    if (!position.set_fen(fen))
+        return false;
+    record = pack_position(position, score, result);
+    return true;
+}
+
+
+/*
+* NAME
+*      PackedToFen -- returns the FEN string of a record
+*
+* SYNOPSYS
+*
+*      string packed_to_fen(const PackedPosition& record);
+*
+* DESCRIPTION
+*
+*  This function unpacks the record and returns its FEN string, or an empty string if the record is corrupt.
+*/
+string packed_to_fen(const PackedPosition& record)
+{
+    Position position;
+    if (!unpack_position(record, position))
+        return string();
+    return position.get_fen();
+}
+
+
+/*
+* NAME
+*      PackedWriter -- opens a record file for writing
+*
+* SYNOPSYS
+*
+*      PackedWriter::PackedWriter(const string& filename, bool append);
+*      filename    ->  the output file
+*      append      ->  append to an existing file instead of truncating it
+*
+* DESCRIPTION
+*
+*  This function opens the file and reserves the record buffer. Check is_open() for success.
+*/
+PackedWriter::PackedWriter(const string& filename, bool append)
+{
+    m_count = 0;
+    m_file = fopen(filename.c_str(), append ? "ab" : "wb");
+    if (!m_file)
+        cout << "Could not open " << filename << " for writing" << endl;
+    m_buffer.reserve(writer_buffer_records);
+}
+
+
+/*
+* NAME
+*      ~PackedWriter -- flushes and closes the file
+*
+* SYNOPSYS
+*
+*      PackedWriter::~PackedWriter();
+*
+* DESCRIPTION
+*
+*  This function writes the remaining buffered records and closes the file.
+*/
+PackedWriter::~PackedWriter()
+{
+    flush();
+    if (m_file)
+        fclose(m_file);
+}
+
+
+/*
+* NAME
+*      Write -- queues a record
+*
+* SYNOPSYS
+*
+*      void PackedWriter::write(const PackedPosition& record);
+*      void PackedWriter::write(const Position& position, int16_t score, int8_t result);
+*
+* DESCRIPTION
+*
+*  This function adds the record, or the packed position, to the buffer and flushes when the buffer is full.
+*/
+void PackedWriter::write(const PackedPosition& record)
+{
+    m_buffer.push_back(record);
+    m_count++;
+    if (m_buffer.size() >= writer_buffer_records)
+        flush();
+}
+
+void PackedWriter::write(const Position& position, int16_t score, int8_t result)
+{
+    write(pack_position(position, score, result));
+}
+
+
+/*
+* NAME
+*      Flush -- writes the buffered records
+*
+* SYNOPSYS
+*
+*      void PackedWriter::flush();
+*
+* DESCRIPTION
+*
+*  This function writes all buffered records to the file in one call.
+*/
+void PackedWriter::flush()
+{
+    if (m_file && !m_buffer.empty())
+    {
+        if (fwrite(m_buffer.data(), sizeof(PackedPosition), m_buffer.size(), m_file) != m_buffer.size())
+            cout << "Error writing position records" << endl;
+        fflush(m_file);
+    }
+    m_buffer.clear();
+}
+
+
+/*
+* NAME
+*      PackedReader -- maps a record file
+*
+* SYNOPSYS
+*
+*      PackedReader::PackedReader(const string& filename);
+*      filename    ->  the record file
+*
+* DESCRIPTION
+*
+*  This function maps the file and counts the whole records in it.
+ *  A trailing partial record, e.g. from a writer that is still running, is ignored.
+*/
+PackedReader::PackedReader(const string& filename) : m_file(filename)
+{
+    m_records = nullptr;
+    m_count = 0;
+    if (!m_file.is_open())
+        return;
+    m_file.advise_sequential();
+    m_records = (const PackedPosition*)m_file.data();
+    m_count = m_file.size() / sizeof(PackedPosition);
+    if (m_file.size() % sizeof(PackedPosition))
+        cout << filename << " ends with a partial record, ignoring it" << endl;
+}
+
+
+/*
+* NAME
+*      Position -- returns the position of a record
+*
+* SYNOPSYS
+*
+*      bool PackedReader::position(size_t index, Position& position) const;
+*      index       ->  the record number
+*      position    ->  the position to be filled
+*
+* DESCRIPTION
+*
+*  This function unpacks the record at the index. Returns false if the record is corrupt.
+*/
+bool PackedReader::position(size_t index, Position& position) const
+{
+    return unpack_position(m_records[index], position);
+}
+
+
+/*
+* NAME
+*      Skip -- moves the iterator to the next sound record
+*
+* SYNOPSYS
+*
+*      void PackedReader::iterator::skip();
+*
+* DESCRIPTION
+*
+*  This function unpacks records from the current one on until one is sound, reporting each corrupt one
+ *  by its record number, so the loop over the reader never sees a corrupt record.
+*/
+void PackedReader::iterator::skip()
+{
+    for (; m_record != m_end; m_record++)
+    {
+        if (unpack_position(*m_record, m_position))
+            return;
+        cout << "record " << (m_record - m_first) << " is corrupt, skipping it" << endl;
+    }
+}
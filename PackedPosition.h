@@ -0,0 +1,125 @@
+/*
+PackedPosition record, PackedWriter and PackedReader classes
+-- PackedPosition is a fixed-size 32 byte binary position record, so record i starts at byte 32 * i.
+-- The occupancy bitboard says which squares hold a piece; their 4-bit piece codes follow in square order,
+   two per byte, low nibble first. A legal position never has more than 32 pieces.
+-- Records are stored in host byte order (little-endian on every machine we run on).
+-- PackedWriter buffers records and appends them to a file.
+-- PackedReader memory-maps a file and hands out Positions straight from the mapping. Records are checked as
+   they are unpacked, so a corrupt or hostile file is reported record by record instead of trusted.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Position.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+const int16_t SCORE_NONE = INT16_MIN;      // the record carries no search score
+const int8_t RESULT_NONE = INT8_MIN;       // the record carries no game result
+
+struct PackedPosition
+{
+    uint64_t occupancy;                     // bit sq set if square sq holds a piece
+    uint8_t pieces[16];                     // piece codes of the occupied squares, in square order
+    uint8_t flags;                          // bit 0 side to move, bits 1-4 castling rights
+    uint8_t ep_square;                      // en passant target square or NO_SQUARE
+    uint8_t halfmove;                       // halfmove clock, saturated at 255
+    int8_t result;                          // game result from white's view: 1, 0, -1 or RESULT_NONE
+    uint16_t fullmove;                      // fullmove number
+    int16_t score;                          // search score from white's view or SCORE_NONE
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
+
+// Pack a position together with an optional score and result
+PackedPosition pack_position(const Position& position, int16_t score = SCORE_NONE, int8_t result = RESULT_NONE);
+
+// Unpack a record into a position, returns false if the record is corrupt
+bool unpack_position(const PackedPosition& record, Position& position);
+
+// FEN conversions, packed_from_fen returns false if the FEN is malformed
+bool packed_from_fen(const string& fen, PackedPosition& record, int16_t score = SCORE_NONE, int8_t result = RESULT_NONE);
+string packed_to_fen(const PackedPosition& record);
+
+
+class PackedWriter
+{
+private:
+    FILE* m_file;                           // output file
+    vector<PackedPosition> m_buffer;        // records not yet written
+    size_t m_count;                         // records written so far, including buffered ones
+
+    PackedWriter(const PackedWriter&) = delete;
+    PackedWriter& operator=(const PackedWriter&) = delete;
+
+public:
+    // Open the file for writing, appending to it if append is true
+    PackedWriter(const string& filename, bool append = false);
+    ~PackedWriter();
+
+    bool is_open() const { return m_file != nullptr; }
+    size_t count() const { return m_count; }
+
+    void write(const PackedPosition& record);
+    void write(const Position& position, int16_t score = SCORE_NONE, int8_t result = RESULT_NONE);
+
+    // Write the buffered records to the file
+    void flush();
+};
+
+
+class PackedReader
+{
+private:
+    MappedFile m_file;                      // the mapped record file
+    const PackedPosition* m_records;        // first record in the mapping
+    size_t m_count;                         // number of whole records
+
+public:
+    // Iterates the records in file order, unpacking each one into a Position as it is reached
+    // and skipping the corrupt ones
+    class iterator
+    {
+    private:
+        const PackedPosition* m_record;
+        const PackedPosition* m_end;
+        const PackedPosition* m_first;      // record 0, to report corrupt records by number
+        Position m_position;
+
+        void skip();
+
+    public:
+        iterator(const PackedPosition* record, const PackedPosition* end, const PackedPosition* first)
+            : m_record(record), m_end(end), m_first(first) { skip(); }
+
+        const Position& operator*() const { return m_position; }
+        const Position* operator->() const { return &m_position; }
+        iterator& operator++() { m_record++; skip(); return *this; }
+        bool operator!=(const iterator& other) const { return m_record != other.m_record; }
+        bool operator==(const iterator& other) const { return m_record == other.m_record; }
+
+        // The raw record, its score and result
+        const PackedPosition& record() const { return *m_record; }
+        int16_t score() const { return m_record->score; }
+        int8_t result() const { return m_record->result; }
+    };
+
+    PackedReader(const string& filename);
+
+    bool is_open() const { return m_records != nullptr; }
+    size_t size() const { return m_count; }
+
+    // Random access to a record and the position it holds, position returns false if the record is corrupt
+    const PackedPosition& record(size_t index) const { return m_records[index]; }
+    bool position(size_t index, Position& position) const;
+
+    iterator begin() const { return iterator(m_records, m_records + m_count, m_records); }
+    iterator end() const { return iterator(m_records + m_count, m_records + m_count, m_records); }
+};
@@ -0,0 +1,153 @@
+#include "PawnTable.h"
+#include "Evaluation.h"
+#include "EvalWeights.h"
+#include <cstring>
+
+static const Bitboard file_a_bb = 0x0101010101010101ULL;
+
+static Bitboard file_bb(int col) { return file_a_bb << col; }
+
+// Files next to the column
+static Bitboard adjacent_files_bb(int col)
+{
+    return (col > 0 ? file_bb(col - 1) : 0) | (col < 7 ? file_bb(col + 1) : 0);
+}
+
+// Rows strictly in front of the row, seen from the side
+static Bitboard forward_rows_bb(Color side, int row)
+{
+    if (side == WHITE)
+        return (row == 7) ? 0 : ~0ULL << (8 * (row + 1));
+    return (row == 0) ? 0 : ~0ULL >> (8 * (8 - row));
+}
+
+
+/*
+* NAME
+*      PawnTable -- creates an empty pawn table
+*
+* SYNOPSYS
+*
+*      PawnTable::PawnTable(size_t kilobytes);
+*      kilobytes   ->  memory used by the table
+*/
+PawnTable::PawnTable(size_t kilobytes)
+{
+    size_t entries = 1;
+    while (entries * 2 * sizeof(PawnEntry) <= kilobytes * 1024)
+        entries *= 2;
+    m_entries.resize(entries);
+    clear();
+}
+
+
+/*
+* NAME
+*      Clear -- forgets every entry
+*
+* SYNOPSYS
+*
+*      void PawnTable::clear();
+*
+* DESCRIPTION
+*
+*  This function zeroes the entries and the statistics. A zeroed entry is the correct one for
+ *  a position without pawns, whose pawn key is zero.
+*/
+void PawnTable::clear()
+{
+    memset(m_entries.data(), 0, m_entries.size() * sizeof(PawnEntry));
+    m_probes = m_hits = 0;
+}
+
+
+/*
+* NAME
+*      Probe -- looks up the pawn structure of a position
+*
+* SYNOPSYS
+*
+*      const PawnEntry& PawnTable::probe(const Position& position);
+*      position    ->  the position being evaluated
+*
+* DESCRIPTION
+*
+*  This function returns the entry of the position's pawn key. On a miss the entry is overwritten
+ *  with a fresh evaluation of the pawns.
+*/
+const PawnEntry& PawnTable::probe(const Position& position)
+{
+    uint64_t key = position.pawn_key();
+    PawnEntry& entry = m_entries[key & (m_entries.size() - 1)];
+    m_probes++;
+    if (entry.key == key)
+    {
+        m_hits++;
+        return entry;
+    }
+    evaluate_pawns(position, entry);
+    return entry;
+}
+
+
+/*
+* NAME
+*      EvaluatePawns -- evaluates the pawn structure
+*
+* SYNOPSYS
+*
+*      void evaluate_pawns(const Position& position, PawnEntry& entry);
+*      position    ->  the position whose pawns are evaluated
+*      entry       ->  receives the key, counts, score and passed pawns
+*
+* DESCRIPTION
+*
+*  Counts for each side, white's counts positive and black's negative:
+ *     doubled pawns       every pawn beyond the first on a file
+ *     isolated pawns      pawns without a friendly pawn on the files next to them
+ *     passed pawns        pawns without an enemy pawn in front of them on their own or the next files
+ *     passed pawn rank    the ranks passed pawns have advanced beyond their starting rank
+*/
+void evaluate_pawns(const Position& position, PawnEntry& entry)
+{
+    memset(&entry, 0, sizeof(entry));
+    entry.key = position.pawn_key();
+
+    int counts[PAWN_FEATURES] = {};
+    for (int c = WHITE; c <= BLACK; c++)
+    {
+        Color side = (Color)c;
+        int sign = (side == WHITE) ? 1 : -1;
+        Bitboard own = position.pieces(side, PAWN);
+        Bitboard enemy = position.pieces((Color)(side ^ 1), PAWN);
+
+        for (int col = 0; col < 8; col++)
+        {
+            int on_file = __builtin_popcountll(own & file_bb(col));
+            if (on_file > 1)
+                counts[PAWN_DOUBLED] += sign * (on_file - 1);
+        }
+
+        for (Bitboard pawns = own; pawns; pawns &= pawns - 1)
+        {
+            int sq = __builtin_ctzll(pawns);
+            int row = row_of(sq), col = col_of(sq);
+            if (!(own & adjacent_files_bb(col)))
+                counts[PAWN_ISOLATED] += sign;
+            if (!(enemy & forward_rows_bb(side, row) & (file_bb(col) | adjacent_files_bb(col))))
+            {
+                entry.passed[side] |= square_bb(sq);
+                counts[PAWN_PASSED] += sign;
+                counts[PAWN_PASSED_RANK] += sign * ((side == WHITE) ? row - 1 : 6 - row);
+            }
+        }
+    }
+
+    int score = 0;
+    for (int feature = 0; feature < PAWN_FEATURES; feature++)
+    {
+        entry.counts[feature] = (int8_t)counts[feature];
+        score += counts[feature] * eval_weights[PARAM_DOUBLED_PAWN + feature];
+    }
+    entry.score = (int16_t)score;
+}
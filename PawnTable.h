@@ -0,0 +1,54 @@
+/*
+PawnTable class
+-- Cache of pawn structure evaluations, indexed by the pawn-only Zobrist key of a position.
+-- The pawn skeleton changes on few moves, so most leaves of a search find their entry here
+   instead of rescanning doubled, isolated and passed pawns.
+-- An entry keeps the pawn feature counts, their score and the passed pawns of each side,
+   which the rest of the evaluation uses for terms that depend on other pieces too.
+-- Not thread safe: every Search owns its own table.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Position.h"
+
+using namespace std;
+
+// Pawn structure features, white's minus black's, in the order of the matching EvalParams
+enum PawnFeature { PAWN_DOUBLED, PAWN_ISOLATED, PAWN_PASSED, PAWN_PASSED_RANK, PAWN_FEATURES };
+
+struct PawnEntry
+{
+    uint64_t key;                           // pawn key of the position
+    Bitboard passed[2];                     // passed pawns of each side
+    int16_t score;                          // weighted sum of the counts, white's point of view
+    int8_t counts[PAWN_FEATURES];           // feature counts for the evaluation trace
+};
+
+class PawnTable
+{
+private:
+    vector<PawnEntry> m_entries;            // power of two entries, indexed by the low bits of the key
+    uint64_t m_probes;
+    uint64_t m_hits;
+
+public:
+    // Table of the given size in kilobytes, rounded down to a power of two entries
+    PawnTable(size_t kilobytes = 512);
+
+    // Return the entry of the position's pawns, evaluating them on a miss
+    const PawnEntry& probe(const Position& position);
+
+    // Forget every entry
+    void clear();
+
+    uint64_t probes() const { return m_probes; }
+    uint64_t hits() const { return m_hits; }
+};
+
+// Evaluate the pawn structure of the position into an entry
+void evaluate_pawns(const Position& position, PawnEntry& entry);
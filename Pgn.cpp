@@ -0,0 +1,269 @@
+#include "Pgn.h"
+#include "Notation.h"
+#include "PackedPosition.h"
+#include <cctype>
+#include <cstring>
+
+static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+
+/*
+* NAME
+*      StartsGame -- checks for the first tag line of a game
+*
+* SYNOPSYS
+*
+*      static bool starts_game(const char* data, size_t offset);
+*      offset      ->  start of a line
+*
+* DESCRIPTION
+*
+*  A game starts with a tag line that does not follow another tag line, blank lines aside.
+*/
+static bool starts_game(const char* data, size_t offset)
+{
+    if (data[offset] != '[')
+        return false;
+    size_t before = offset;
+    while (before > 0 && is_space(data[before - 1]))
+        before--;
+    if (before == 0)
+        return true;
+    while (before > 0 && data[before - 1] != '\n')
+        before--;
+    return data[before] != '[';
+}
+
+
+/*
+* NAME
+*      NextPgnGame -- finds the start of a game
+*
+* SYNOPSYS
+*
+*      size_t next_pgn_game(const char* data, size_t size, size_t from);
+*      data, size  ->  the PGN text
+*      from        ->  offset to search from
+*
+* DESCRIPTION
+*
+*  Returns the offset of the first line at or after from that starts a game's tags, or size if there is none.
+*/
+size_t next_pgn_game(const char* data, size_t size, size_t from)
+{
+    size_t offset = from;
+    while (offset < size)
+    {
+        if ((offset == 0 || data[offset - 1] == '\n') && starts_game(data, offset))
+            return offset;
+        const char* newline = (const char*)memchr(data + offset, '\n', size - offset);
+        if (!newline)
+            break;
+        offset = newline - data + 1;
+    }
+    return size;
+}
+
+
+/*
+* NAME
+*      PgnParser -- creates a parser of a chunk of PGN text
+*
+* SYNOPSYS
+*
+*      PgnParser::PgnParser(const char* data, size_t size, size_t begin, size_t end, size_t max_plies);
+*      data, size  ->  the whole PGN text
+*      begin, end  ->  the chunk: the games starting at or after begin and before end
+*      max_plies   ->  moves replayed per game, the rest of its movetext is skipped
+*/
+PgnParser::PgnParser(const char* data, size_t size, size_t begin, size_t end, size_t max_plies)
+{
+    m_data = data;
+    m_size = size;
+    m_end = end;
+    m_max_plies = max_plies;
+    m_position = next_pgn_game(data, size, begin);
+}
+
+
+/*
+* NAME
+*      Next -- parses the next game of the chunk
+*
+* SYNOPSYS
+*
+*      bool PgnParser::next(PgnGame& game);
+*
+* DESCRIPTION
+*
+*  The game's vectors are reused, so parsing a chunk allocates little once the first games are read.
+*/
+bool PgnParser::next(PgnGame& game)
+{
+    if (m_position >= m_end || m_position >= m_size)
+        return false;
+    game.offset = m_position;
+    game.fen.clear();
+    game.result = RESULT_NONE;
+    game.moves.clear();
+    game.keys.clear();
+    game.complete = true;
+    size_t end = read_moves(game, read_tags(game, m_position));
+    m_position = next_pgn_game(m_data, m_size, end);
+    return true;
+}
+
+
+/*
+* NAME
+*      ReadTags -- reads the tag pairs of a game
+*
+* SYNOPSYS
+*
+*      size_t PgnParser::read_tags(PgnGame& game, size_t offset) const;
+*
+* DESCRIPTION
+*
+*  Reads the lines starting with '[' and keeps the FEN and Result tags. Returns the offset after the last tag line.
+*/
+size_t PgnParser::read_tags(PgnGame& game, size_t offset) const
+{
+    while (offset < m_size)
+    {
+        while (offset < m_size && is_space(m_data[offset]))
+            offset++;
+        if (offset >= m_size || m_data[offset] != '[')
+            break;
+        const char* line_end = (const char*)memchr(m_data + offset, '\n', m_size - offset);
+        size_t end = line_end ? line_end - m_data : m_size;
+        string line(m_data + offset + 1, end - offset - 1);
+        offset = end;
+
+        size_t space = line.find(' '), open = line.find('"'), close = line.rfind('"');
+        if (space == string::npos || open == string::npos || close <= open)
+            continue;
+        string name = line.substr(0, space), value = line.substr(open + 1, close - open - 1);
+        if (name == "FEN")
+            game.fen = value;
+        else if (name == "Result")
+            game.result = (value == "1-0") ? 1 : (value == "0-1") ? -1 : (value == "1/2-1/2") ? 0 : RESULT_NONE;
+    }
+    return offset;
+}
+
+
+/*
+* NAME
+*      ReadMoves -- replays the movetext of a game
+*
+* SYNOPSYS
+*
+*      size_t PgnParser::read_moves(PgnGame& game, size_t offset) const;
+*
+* DESCRIPTION
+*
+*  Tokens are read up to the game termination marker, or the next game's tags if it is missing.
+ *  {comments}, ; comments, (variations) and $NAGs are skipped, and move numbers are stripped from the moves.
+ *  The moves are replayed from the FEN tag's position, or the standard start, until one does not parse
+ *  or max_plies moves are made; the rest is skipped. Returns the offset just past the game.
+*/
+size_t PgnParser::read_moves(PgnGame& game, size_t offset) const
+{
+    Position position;
+    if (game.fen.empty())
+        position.set_start();
+    else if (!position.set_fen(game.fen))
+        game.complete = false;
+    bool replaying = game.complete;
+    if (replaying)
+        game.keys.push_back(position.key());
+
+    string token;
+    while (offset < m_size)
+    {
+        char c = m_data[offset];
+        if (is_space(c))
+        {
+            offset++;
+            continue;
+        }
+        if (c == '[' && m_data[offset - 1] == '\n')
+            break;
+        if (c == '{')
+        {
+            const char* close = (const char*)memchr(m_data + offset, '}', m_size - offset);
+            offset = close ? close - m_data + 1 : m_size;
+            continue;
+        }
+        if (c == ';' || (c == '%' && m_data[offset - 1] == '\n'))
+        {
+            const char* newline = (const char*)memchr(m_data + offset, '\n', m_size - offset);
+            offset = newline ? newline - m_data + 1 : m_size;
+            continue;
+        }
+        if (c == '(')
+        {
+            int depth = 0;
+            for (; offset < m_size; offset++)
+            {
+                if (m_data[offset] == '{')
+                {
+                    const char* close = (const char*)memchr(m_data + offset, '}', m_size - offset);
+                    offset = close ? close - m_data : m_size - 1;
+                }
+                else if (m_data[offset] == '(')
+                    depth++;
+                else if (m_data[offset] == ')' && --depth == 0)
+                    break;
+            }
+            offset++;
+            continue;
+        }
+
+        size_t start = offset;
+        while (offset < m_size && !is_space(m_data[offset]) && !strchr("{}();", m_data[offset]))
+            offset++;
+        if (offset == start)
+        {
+            offset++;
+            continue;
+        }
+        token.assign(m_data + start, offset - start);
+        if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*")
+        {
+            if (game.result == RESULT_NONE && token != "*")
+                game.result = (token == "1-0") ? 1 : (token == "0-1") ? -1 : 0;
+            break;
+        }
+        if (token[0] == '$' || !replaying)
+            continue;
+        // a move number, alone or glued to the move, but not castling written with zeros
+        size_t move_start = 0;
+        while (move_start < token.size() && isdigit((unsigned char)token[move_start]))
+            move_start++;
+        if (move_start < token.size() && token[move_start] == '.')
+        {
+            while (move_start < token.size() && token[move_start] == '.')
+                move_start++;
+        }
+        else
+            move_start = 0;
+        if (move_start == token.size())
+            continue;
+
+        Move m = san_to_move(position, token.substr(move_start));
+        if (m == MOVE_NONE)
+        {
+            game.complete = false;
+            replaying = false;
+            continue;
+        }
+        Undo undo;
+        position.make_move(m, undo);
+        game.moves.push_back(m);
+        game.keys.push_back(position.key());
+        if (game.moves.size() >= m_max_plies)
+            replaying = false;
+    }
+    return offset;
+}
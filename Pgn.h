@@ -0,0 +1,55 @@
+/*
+PgnParser class
+-- Reads games from PGN text in memory, normally a MappedFile: the FEN and Result tags and the movetext,
+   whose SAN moves are replayed on a Position into legal moves and the keys of the positions reached.
+-- Comments, variations, NAGs and move numbers are skipped. A move that does not parse ends the game's moves there.
+-- A game starts at its first tag line, one that does not follow another tag line, so a large file can be cut
+   into chunks at game starts (see next_pgn_game) and the chunks parsed on several threads at once.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Position.h"
+
+using namespace std;
+
+struct PgnGame
+{
+    size_t offset;                          // where the game's text starts
+    string fen;                             // starting position from the FEN tag, empty for the standard one
+    int8_t result;                          // from white's view: 1, 0, -1, or RESULT_NONE for "*" or none
+    vector<Move> moves;                     // the moves replayed, at most the parser's ply limit
+    vector<uint64_t> keys;                  // key of the position before each move, then of the position reached
+    bool complete;                          // false if a move did not parse or the start position was bad
+};
+
+// Offset of the first game starting at or after from, size if there is none
+size_t next_pgn_game(const char* data, size_t size, size_t from);
+
+class PgnParser
+{
+private:
+    const char* m_data;
+    size_t m_position;                      // offset of the next game
+    size_t m_end;                           // games starting at or after this offset belong to the next chunk
+    size_t m_size;                          // size of the whole text, the last game may run past m_end
+    size_t m_max_plies;                     // moves replayed per game
+
+    // Parse the tags of the game starting at m_position, returning the offset of its movetext
+    size_t read_tags(PgnGame& game, size_t offset) const;
+
+    // Replay the movetext from the offset, returning the offset just past the game
+    size_t read_moves(PgnGame& game, size_t offset) const;
+
+public:
+    // Parser of the games starting in [begin, end) of the text
+    PgnParser(const char* data, size_t size, size_t begin, size_t end, size_t max_plies = SIZE_MAX);
+
+    // Parse the next game, returns false when there is none left
+    bool next(PgnGame& game);
+};
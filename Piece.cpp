@@ -1,4 +1,5 @@
 #include "Piece.h"
+#include "Trace.h"
 
 /*
 * NAME
@@ -17,6 +18,7 @@
 */
 Piece::Piece(string a_filename, unsigned int a_space_size)
 {
+    TRACE_SCOPE("load", "texture");
     m_filename = new string(a_filename);
     auto texture = new sf::Texture();
     if (!texture->loadFromFile(a_filename))
@@ -0,0 +1,1128 @@
+#include "Position.h"
+#include "Bitboard.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <cstring>
+
+static const char piece_chars[] = " PNBRQK  pnbrqk";
+
+// Zobrist keys, filled once from a fixed seed so keys are stable across runs
+struct ZobristTables
+{
+    uint64_t psq[16][64];
+    uint64_t side;
+    uint64_t castling[16];
+    uint64_t ep[8];
+
+    ZobristTables()
+    {
+        uint64_t seed = 0x9E3779B97F4A7C15ULL;
+        auto next = [&seed]() {
+            // xorshift64*
+            seed ^= seed >> 12;
+            seed ^= seed << 25;
+            seed ^= seed >> 27;
+            return seed * 2685821657736338717ULL;
+        };
+        for (auto& piece : psq)
+            for (auto& key : piece)
+                key = next();
+        side = next();
+        castling[0] = 0;
+        for (int i = 1; i < 16; i++)
+            castling[i] = next();
+        for (auto& key : ep)
+            key = next();
+    }
+};
+static const ZobristTables zobrist;
+
+// Castling rights that survive a move from or to the square
+static uint8_t castling_mask(int sq)
+{
+    switch (sq)
+    {
+    case 0: return 15 & ~WHITE_OOO;
+    case 4: return 15 & ~(WHITE_OO | WHITE_OOO);
+    case 7: return 15 & ~WHITE_OO;
+    case 56: return 15 & ~BLACK_OOO;
+    case 60: return 15 & ~(BLACK_OO | BLACK_OOO);
+    case 63: return 15 & ~BLACK_OO;
+    default: return 15;
+    }
+}
+
+
+/*
+* NAME
+*      SquareName -- returns the name of a square
+*
+* SYNOPSYS
+*
+*      string square_name(int sq);
+*      sq      ->  square index, row * 8 + col
+*
+* DESCRIPTION
+*
+*  This function returns the algebraic name of the square (a1, e4, ...), the same naming Square uses.
+ *  Returns "-" for NO_SQUARE, which is what FEN expects for a missing en passant square.
+*/
+string square_name(int sq)
+{
+    if (sq < 0 || sq >= 64)
+        return "-";
+    return string(1, (char)('a' + col_of(sq))) + to_string(row_of(sq) + 1);
+}
+
+
+/*
+* NAME
+*      MoveToUci -- returns the coordinate notation of a move
+*
+* SYNOPSYS
+*
+*      string move_to_uci(Move m);
+*
+* DESCRIPTION
+*
+*  This function returns the from and to squares followed by the promotion piece, e.g. e7e8q.
+ *  Returns 0000 for MOVE_NONE.
+*/
+string move_to_uci(Move m)
+{
+    if (m == MOVE_NONE)
+        return "0000";
+    string uci = square_name(move_from(m)) + square_name(move_to(m));
+    if (move_promotion(m) != NO_TYPE)
+        uci += piece_chars[8 + move_promotion(m)];
+    return uci;
+}
+
+
+/*
+* NAME
+*      CountRepetitions -- counts the occurrences of the current position
+*
+* SYNOPSYS
+*
+*      int count_repetitions(const vector<uint64_t>& keys, unsigned int halfmove);
+*      keys        ->  keys of the game's positions, the current one last
+*      halfmove    ->  halfmove clock of the current position
+*
+* DESCRIPTION
+*
+*  This function compares the current key with the keys of the earlier positions with the same side to move,
+ *  going back no further than the halfmove clock: no position before a capture or pawn move can come back.
+ *  Returns 1 if the position has not occurred before.
+*/
+int count_repetitions(const vector<uint64_t>& keys, unsigned int halfmove)
+{
+    if (keys.empty())
+        return 0;
+    int last = (int)keys.size() - 1;
+    int oldest = std::max(0, last - (int)halfmove);
+    int repetitions = 1;
+    for (int i = last - 2; i >= oldest; i -= 2)
+        repetitions += keys[i] == keys[last];
+    return repetitions;
+}
+
+
+/*
+* NAME
+*      Position -- creates an empty position
+*
+* SYNOPSYS
+*
+*      Position::Position();
+*
+* DESCRIPTION
+*
+*  This function creates an empty board with white to move and no castling or en passant rights.
+*/
+Position::Position()
+{
+    memset(m_squares, NO_PIECE, sizeof(m_squares));
+    m_by_color[WHITE] = m_by_color[BLACK] = 0;
+    memset(m_by_type, 0, sizeof(m_by_type));
+    m_side = WHITE;
+    m_castling = 0;
+    m_ep_square = NO_SQUARE;
+    m_halfmove = 0;
+    m_fullmove = 1;
+    m_key = 0;
+    m_pawn_key = 0;
+    m_king_square[WHITE] = m_king_square[BLACK] = NO_SQUARE;
+}
+
+
+/*
+* NAME
+*      SetStart -- sets up the starting position
+*
+* SYNOPSYS
+*
+*      void Position::set_start();
+*
+* DESCRIPTION
+*
+*  This function sets up the standard starting position.
+*/
+void Position::set_start()
+{
+    set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+}
+
+
+/*
+* NAME
+*      PutPiece -- places a piece on a square
+*
+* SYNOPSYS
+*
+*      void Position::put_piece(int sq, uint8_t code);
+*      sq      ->  square index
+*      code    ->  piece code to be placed
+*
+* DESCRIPTION
+*
+*  This function places the piece on the square, replacing whatever was there, and keeps the occupancy and keys in sync.
+*/
+void Position::put_piece(int sq, uint8_t code)
+{
+    clear_square(sq);
+    if (code == NO_PIECE)
+        return;
+    m_squares[sq] = code;
+    m_by_color[color_of(code)] |= square_bb(sq);
+    m_by_type[type_of(code)] |= square_bb(sq);
+    m_key ^= zobrist.psq[code][sq];
+    if (type_of(code) == PAWN)
+        m_pawn_key ^= zobrist.psq[code][sq];
+    else if (type_of(code) == KING)
+        m_king_square[color_of(code)] = (uint8_t)sq;
+}
+
+
+/*
+* NAME
+*      ClearSquare -- removes the piece from a square
+*
+* SYNOPSYS
+*
+*      void Position::clear_square(int sq);
+*      sq      ->  square index
+*
+* DESCRIPTION
+*
+*  This function removes the piece on the square, if any, and keeps the occupancy and keys in sync.
+*/
+void Position::clear_square(int sq)
+{
+    uint8_t code = m_squares[sq];
+    if (code == NO_PIECE)
+        return;
+    m_by_color[color_of(code)] &= ~square_bb(sq);
+    m_by_type[type_of(code)] &= ~square_bb(sq);
+    m_key ^= zobrist.psq[code][sq];
+    if (type_of(code) == PAWN)
+        m_pawn_key ^= zobrist.psq[code][sq];
+    else if (type_of(code) == KING && m_king_square[color_of(code)] == sq)
+        m_king_square[color_of(code)] = NO_SQUARE;
+    m_squares[sq] = NO_PIECE;
+}
+
+
+/*
+* NAME
+*      SetSideToMove, SetCastling, SetEpSquare -- set the state of the position
+*
+* SYNOPSYS
+*
+*      void Position::set_side_to_move(Color c);
+*      void Position::set_castling(uint8_t rights);
+*      void Position::set_ep_square(uint8_t sq);
+*
+* DESCRIPTION
+*
+*  These functions change the side to move, castling rights and en passant square, keeping the key in sync.
+*/
+void Position::set_side_to_move(Color c)
+{
+    if (c != m_side)
+        m_key ^= zobrist.side;
+    m_side = c;
+}
+
+void Position::set_castling(uint8_t rights)
+{
+    m_key ^= zobrist.castling[m_castling] ^ zobrist.castling[rights & 15];
+    m_castling = rights & 15;
+}
+
+void Position::set_ep_square(uint8_t sq)
+{
+    if (m_ep_square != NO_SQUARE)
+        m_key ^= zobrist.ep[col_of(m_ep_square)];
+    m_ep_square = (sq < 64) ? sq : NO_SQUARE;
+    if (m_ep_square != NO_SQUARE)
+        m_key ^= zobrist.ep[col_of(m_ep_square)];
+}
+
+
+/*
+* NAME
+*      ComputeKey -- computes the Zobrist key from scratch
+*
+* SYNOPSYS
+*
+*      uint64_t Position::compute_key() const;
+*
+* DESCRIPTION
+*
+*  This function xors the keys of every piece, the side to move, castling rights and en passant square,
+ *  as put_piece and the setters do one at a time.
+*/
+uint64_t Position::compute_key() const
+{
+    uint64_t key = zobrist.castling[m_castling];
+    for (Bitboard occupied = occupancy(); occupied; occupied &= occupied - 1)
+    {
+        int sq = __builtin_ctzll(occupied);
+        key ^= zobrist.psq[m_squares[sq]][sq];
+    }
+    if (m_side == BLACK)
+        key ^= zobrist.side;
+    if (m_ep_square != NO_SQUARE)
+        key ^= zobrist.ep[col_of(m_ep_square)];
+    return key;
+}
+
+
+/*
+* NAME
+*      IsValid -- checks the state of the position
+*
+* SYNOPSYS
+*
+*      bool Position::is_valid() const;
+*
+* DESCRIPTION
+*
+*  This function checks what the move generator takes for granted: each side has exactly one king, no pawn
+ *  stands on the first or last row, the side not to move is not in check, every castling right has its king
+ *  and rook at home, and the en passant square lies behind a pawn that has just made its double step, with
+ *  a pawn of the side to move able to capture there, as make_move leaves it.
+*/
+bool Position::is_valid() const
+{
+    if (popcount(pieces(WHITE, KING)) != 1 || popcount(pieces(BLACK, KING)) != 1)
+        return false;
+    if (m_by_type[PAWN] & (row_bb(0) | row_bb(7)))
+        return false;
+    Color them = (Color)(m_side ^ 1);
+    if (is_attacked(m_king_square[them], m_side))
+        return false;
+
+    if ((m_castling & (WHITE_OO | WHITE_OOO)) && m_squares[4] != W_KING)
+        return false;
+    if ((m_castling & (BLACK_OO | BLACK_OOO)) && m_squares[60] != B_KING)
+        return false;
+    if (((m_castling & WHITE_OO) && m_squares[7] != W_ROOK) || ((m_castling & WHITE_OOO) && m_squares[0] != W_ROOK)
+        || ((m_castling & BLACK_OO) && m_squares[63] != B_ROOK) || ((m_castling & BLACK_OOO) && m_squares[56] != B_ROOK))
+        return false;
+
+    if (m_ep_square != NO_SQUARE)
+    {
+        int forward = (m_side == WHITE) ? 8 : -8;
+        if (row_of(m_ep_square) != ((m_side == WHITE) ? 5 : 2) || m_squares[m_ep_square] != NO_PIECE
+            || m_squares[m_ep_square + forward] != NO_PIECE || m_squares[m_ep_square - forward] != make_piece(them, PAWN)
+            || !(pawn_attacks(them, m_ep_square) & pieces(m_side, PAWN)))
+            return false;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      SetFen -- sets up the position from a FEN string
+*
+* SYNOPSYS
+*
+*      bool Position::set_fen(const string& fen);
+*      fen     ->  the FEN string, the move counters are optional
+*
+* DESCRIPTION
+*
+*  This function parses the piece placement, side to move, castling rights, en passant square
+ *  and the move counters.
+ *  Castling rights whose king or rook is not at home are dropped, as is an en passant square no pawn can
+ *  capture on. Returns false and leaves the position empty if the FEN is malformed or the position
+ *  fails is_valid, e.g. the side not to move is in check.
+*/
+bool Position::set_fen(const string& fen)
+{
+    *this = Position();
+
+    istringstream stream(fen);
+    string placement, side, castling, ep;
+    if (!(stream >> placement >> side))
+        return false;
+    if (!(stream >> castling))
+        castling = "-";
+    if (!(stream >> ep))
+        ep = "-";
+
+    int row = 7, col = 0;
+    for (char c : placement)
+    {
+        if (c == '/')
+        {
+            if (col != 8 || row == 0)
+            {
+                *this = Position();
+                return false;
+            }
+            row--;
+            col = 0;
+        }
+        else if (c >= '1' && c <= '8')
+            col += c - '0';
+        else
+        {
+            const char* found = strchr(piece_chars, c);
+            if (c == ' ' || found == nullptr || col > 7)
+            {
+                *this = Position();
+                return false;
+            }
+            put_piece(make_square(row, col), (uint8_t)(found - piece_chars));
+            col++;
+        }
+        if (col > 8)
+        {
+            *this = Position();
+            return false;
+        }
+    }
+    if (row != 0 || col != 8 || (side != "w" && side != "b"))
+    {
+        *this = Position();
+        return false;
+    }
+    set_side_to_move((side == "w") ? WHITE : BLACK);
+
+    // rights whose king or rook has left home are dropped
+    uint8_t rights = 0;
+    for (char c : castling)
+    {
+        if (c == 'K' && m_squares[4] == W_KING && m_squares[7] == W_ROOK) rights |= WHITE_OO;
+        else if (c == 'Q' && m_squares[4] == W_KING && m_squares[0] == W_ROOK) rights |= WHITE_OOO;
+        else if (c == 'k' && m_squares[60] == B_KING && m_squares[63] == B_ROOK) rights |= BLACK_OO;
+        else if (c == 'q' && m_squares[60] == B_KING && m_squares[56] == B_ROOK) rights |= BLACK_OOO;
+    }
+    set_castling(rights);
+
+    // as in make_move, keep the en passant square only behind a double step a pawn can capture
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] >= '1' && ep[1] <= '8')
+    {
+        set_ep_square((uint8_t)make_square(ep[1] - '1', ep[0] - 'a'));
+        if (!is_valid())
+            set_ep_square(NO_SQUARE);
+    }
+
+    // a game never reaches a position without both kings, or one where the side that just moved is in check
+    if (!is_valid())
+    {
+        *this = Position();
+        return false;
+    }
+
+    unsigned int halfmove = 0, fullmove = 1;
+    if (stream >> halfmove)
+    {
+        m_halfmove = halfmove;
+        if (stream >> fullmove)
+            m_fullmove = (fullmove == 0) ? 1 : fullmove;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      GetFen -- returns the FEN string of the position
+*
+* SYNOPSYS
+*
+*      string Position::get_fen() const;
+*
+* DESCRIPTION
+*
+*  This function writes the piece placement from the 8th row down to the 1st,
+ *  followed by side to move, castling rights, en passant square and move counters.
+*/
+string Position::get_fen() const
+{
+    string fen;
+    for (int row = 7; row >= 0; row--)
+    {
+        int empty = 0;
+        for (int col = 0; col < 8; col++)
+        {
+            uint8_t code = m_squares[make_square(row, col)];
+            if (code == NO_PIECE)
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+                fen += (char)('0' + empty);
+            empty = 0;
+            fen += piece_chars[code];
+        }
+        if (empty)
+            fen += (char)('0' + empty);
+        if (row > 0)
+            fen += '/';
+    }
+
+    fen += (m_side == WHITE) ? " w " : " b ";
+    if (m_castling == 0)
+        fen += '-';
+    if (m_castling & WHITE_OO) fen += 'K';
+    if (m_castling & WHITE_OOO) fen += 'Q';
+    if (m_castling & BLACK_OO) fen += 'k';
+    if (m_castling & BLACK_OOO) fen += 'q';
+
+    fen += ' ' + square_name(m_ep_square);
+    fen += ' ' + to_string(m_halfmove) + ' ' + to_string(m_fullmove);
+    return fen;
+}
+
+
+/*
+* NAME
+*      GetValidMoves - adds the legal moves of the piece on a square
+*
+* SYNOPSYS
+*
+*      void Position::get_valid_moves(int sq, MoveList& moves) const;
+*      sq          ->  the square of a piece of the side to move
+*      moves       ->  the list to which the legal moves are added
+*
+* DESCRIPTION
+*
+*  This function generates the legal moves of the side to move for the piece on the square only.
+*/
+void Position::get_valid_moves(int sq, MoveList& moves) const
+{
+    generate(GEN_ALL, square_bb(sq), moves, nullptr);
+}
+
+
+/*
+* NAME
+*      GetAllValids - adds all legal moves of the side to move
+*
+* SYNOPSYS
+*
+*      void Position::get_all_valids(MoveList& moves) const;
+*      moves       ->  the list to which the legal moves are added
+*
+* DESCRIPTION
+*
+*  An empty list means checkmate or stalemate, see Generate.
+*/
+void Position::get_all_valids(MoveList& moves) const
+{
+    generate(GEN_ALL, ~0ULL, moves, nullptr);
+}
+
+
+/*
+* NAME
+*      IsLegal - checks a move that was not generated in this position
+*
+* SYNOPSYS
+*
+*      bool Position::is_legal(Move m, const AttackInfo* attacks) const;
+*      m           ->  the move to be checked
+*      attacks     ->  the position's attacks, or nullptr to find them
+*
+* DESCRIPTION
+*
+*  This function generates the moves of the piece on the move's from square only and looks the move up among them,
+ *  which is cheap enough to check a hash move or a killer before searching it.
+*/
+bool Position::is_legal(Move m, const AttackInfo* attacks) const
+{
+    uint8_t code = m_squares[move_from(m)];
+    if (m == MOVE_NONE || code == NO_PIECE || color_of(code) != m_side)
+        return false;
+    MoveList moves;
+    generate(GEN_ALL, square_bb(move_from(m)), moves, attacks);
+    for (Move legal : moves)
+    {
+        if (legal == m)
+            return true;
+    }
+    return false;
+}
+
+
+/*
+* NAME
+*      Generate - adds legal moves of the side to move
+*
+* SYNOPSYS
+*
+*      void Position::generate(GenKind kind, Bitboard from, MoveList& moves, const AttackInfo* attacks) const;
+*      kind        ->  GEN_CAPTURES, GEN_QUIETS or GEN_ALL
+*      from        ->  squares of the pieces whose moves are wanted
+*      moves       ->  the list to which the legal moves are added
+*      attacks     ->  the position's attacks, or nullptr to find them here
+*
+* DESCRIPTION
+*
+*  This function calls the generator compiled for the side to move, see GenerateFor.
+*/
+void Position::generate(GenKind kind, Bitboard from, MoveList& moves, const AttackInfo* attacks) const
+{
+    TRACE_SCOPE_FINE("search", "movegen");
+    AttackInfo found;
+    if (!attacks)
+    {
+        compute_attacks(found);
+        attacks = &found;
+    }
+    if (m_side == WHITE)
+        generate_for<WHITE>(kind, from, moves, *attacks);
+    else
+        generate_for<BLACK>(kind, from, moves, *attacks);
+}
+
+
+/*
+* NAME
+*      GenerateFor - adds legal moves of the side Us
+*
+* SYNOPSYS
+*
+*      template <Color Us> void Position::generate_for(GenKind kind, Bitboard from, MoveList& moves,
+*                                                       const AttackInfo& attacks) const;
+*
+* DESCRIPTION
+*
+*  This function generates only moves that leave the own king safe, taking the checkers and pins from the attacks.
+ *  The king steps to squares the opponent does not attack once the king has left its square.
+ *  In double check nothing else can help. In single check the other pieces must capture the checker
+ *  or move between it and the king. Pinned pieces stay on the line through their king and the pinner.
+ *  Pawns promote to any of queen, rook, bishop and knight. Castling needs the king and the squares it crosses to be safe.
+ *  Captures land on enemy pieces and quiet moves on empty squares, except for pawns, see AddPawnMoves.
+*/
+template <Color Us>
+void Position::generate_for(GenKind kind, Bitboard from, MoveList& moves, const AttackInfo& attacks) const
+{
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    int king = m_king_square[Us];
+    assert(king != NO_SQUARE && "positions are checked for their kings as they are set up");
+    Bitboard own = m_by_color[Us], enemy = m_by_color[Them], occupied = own | enemy;
+    Bitboard checking = attacks.checkers;
+    Bitboard kind_target = (kind == GEN_CAPTURES) ? enemy : (kind == GEN_QUIETS) ? ~occupied : ~own;
+
+    if (from & square_bb(king))
+    {
+        Bitboard steps = king_attacks(king) & kind_target & ~attacks.king_danger;
+        while (steps)
+            moves.push_back(encode_move(king, pop_lsb(steps)));
+    }
+    if (popcount(checking) > 1)
+        return;
+
+    Bitboard target = checking ? (between_bb(king, lsb(checking)) | checking) : ~own;
+    Bitboard pinned = attacks.pinned;
+
+    add_pawn_moves<Us>(kind, from, target, pinned, moves);
+
+    target &= kind_target;
+    Bitboard pieces = own & from & ~m_by_type[PAWN] & ~m_by_type[KING];
+    while (pieces)
+    {
+        int sq = pop_lsb(pieces);
+        Bitboard piece_moves;
+        switch (type_of(m_squares[sq]))
+        {
+        case KNIGHT: piece_moves = knight_attacks(sq); break;
+        case BISHOP: piece_moves = bishop_attacks(sq, occupied); break;
+        case ROOK: piece_moves = rook_attacks(sq, occupied); break;
+        default: piece_moves = queen_attacks(sq, occupied); break;
+        }
+        piece_moves &= target;
+        if (pinned & square_bb(sq))
+            piece_moves &= line_bb(king, sq);
+        while (piece_moves)
+            moves.push_back(encode_move(sq, pop_lsb(piece_moves)));
+    }
+
+    if (!checking && kind != GEN_CAPTURES && (from & square_bb(king)))
+        add_castling<Us>(moves, attacks);
+}
+
+
+/*
+* NAME
+*      PinnedPieces - helper for GenerateFor, finds the pieces pinned to a king
+*
+* SYNOPSYS
+*
+*      template <Color Us> Bitboard Position::pinned_pieces() const;
+*
+* DESCRIPTION
+*
+*  This function looks from the side's king for opposing sliders on an empty board.
+ *  A slider with exactly one piece between it and the king pins that piece if it belongs to the side.
+*/
+template <Color Us>
+Bitboard Position::pinned_pieces() const
+{
+    int king = m_king_square[Us];
+    Bitboard enemy = m_by_color[Us ^ 1];
+    Bitboard snipers = ((rook_attacks(king, 0) & (m_by_type[ROOK] | m_by_type[QUEEN]))
+                      | (bishop_attacks(king, 0) & (m_by_type[BISHOP] | m_by_type[QUEEN]))) & enemy;
+    Bitboard pinned = 0;
+    while (snipers)
+    {
+        Bitboard blockers = between_bb(king, pop_lsb(snipers)) & occupancy();
+        if (blockers && !(blockers & (blockers - 1)) && (blockers & m_by_color[Us]))
+            pinned |= blockers;
+    }
+    return pinned;
+}
+
+
+/*
+* NAME
+*      AddPawnTargets - helper for AddPawnMoves, adds the moves of a set of pawns in one direction
+*
+* SYNOPSYS
+*
+*      static void add_pawn_targets(Bitboard targets, int delta, bool promotion, Bitboard pinned, int king, MoveList& moves);
+*      targets     ->  squares reached by the pawns
+*      delta       ->  the square difference of the move, the from square being to - delta
+*      promotion   ->  true to add one move per promotion piece
+*
+* DESCRIPTION
+*
+*  Pinned pawns only move along the line through their king.
+*/
+static inline void add_pawn_targets(Bitboard targets, int delta, bool promotion, Bitboard pinned, int king,
+                                    MoveList& moves)
+{
+    static const PieceType promotions[4] = { QUEEN, ROOK, BISHOP, KNIGHT };
+
+    while (targets)
+    {
+        int to = pop_lsb(targets);
+        int from = to - delta;
+        if ((pinned & square_bb(from)) && !(line_bb(king, from) & square_bb(to)))
+            continue;
+        if (promotion)
+        {
+            for (PieceType piece : promotions)
+                moves.push_back(encode_move(from, to, piece));
+        }
+        else
+            moves.push_back(encode_move(from, to));
+    }
+}
+
+
+/*
+* NAME
+*      AddPawnMoves - helper for GenerateFor, adds the legal pawn moves
+*
+* SYNOPSYS
+*
+*      template <Color Us> void Position::add_pawn_moves(GenKind kind, Bitboard from, Bitboard target, Bitboard pinned,
+*                                                         MoveList& moves) const;
+*      kind        ->  GEN_CAPTURES, GEN_QUIETS or GEN_ALL
+*      from        ->  squares of the pawns whose moves are wanted
+*      target      ->  squares a move must land on to deal with a check, every other square otherwise
+*      pinned      ->  the side's pinned pieces
+*
+* DESCRIPTION
+*
+*  This function moves all the pawns at once by shifting their bitboard: the forward step, the double step
+ *  from the pawn's first row, the diagonal captures, then en passant. White pawns go up the rows, black pawns go down.
+ *  A pawn reaching the last row adds one move for each promotion piece, queen first.
+ *  Promotions count as captures even without taking a piece.
+*/
+template <Color Us>
+void Position::add_pawn_moves(GenKind kind, Bitboard from, Bitboard target, Bitboard pinned, MoveList& moves) const
+{
+    constexpr int forward = pawn_forward<Us>();
+    int king = m_king_square[Us];
+    Bitboard empty = ~occupancy(), enemy = m_by_color[Us ^ 1];
+    Bitboard pawns = pieces(Us, PAWN) & from;
+    Bitboard promoting = pawns & row_bb(relative_row<Us>(6));
+    Bitboard others = pawns & ~promoting & ~row_bb(relative_row<Us>(7));
+
+    if (kind != GEN_CAPTURES)
+    {
+        Bitboard one_step = pawn_push<Us>(others) & empty;
+        Bitboard two_steps = pawn_push<Us>(one_step & row_bb(relative_row<Us>(2))) & empty & target;
+        add_pawn_targets(one_step & target, forward, false, pinned, king, moves);
+        add_pawn_targets(two_steps, 2 * forward, false, pinned, king, moves);
+    }
+    if (kind == GEN_QUIETS)
+        return;
+
+    add_pawn_targets(pawn_attacks_west<Us>(others) & enemy & target, forward - 1, false, pinned, king, moves);
+    add_pawn_targets(pawn_attacks_east<Us>(others) & enemy & target, forward + 1, false, pinned, king, moves);
+    add_pawn_targets(pawn_push<Us>(promoting) & empty & target, forward, true, pinned, king, moves);
+    add_pawn_targets(pawn_attacks_west<Us>(promoting) & enemy & target, forward - 1, true, pinned, king, moves);
+    add_pawn_targets(pawn_attacks_east<Us>(promoting) & enemy & target, forward + 1, true, pinned, king, moves);
+
+    if (m_ep_square != NO_SQUARE)
+    {
+        // the pawns that attack the en passant square are those a pawn of the other side there would attack
+        Bitboard capturers = pawn_attacks((Color)(Us ^ 1), m_ep_square) & others;
+        while (capturers)
+        {
+            int sq = pop_lsb(capturers);
+            if (is_legal_en_passant<Us>(sq))
+                moves.push_back(encode_move(sq, m_ep_square));
+        }
+    }
+}
+
+
+/*
+* NAME
+*      IsLegalEnPassant - helper for AddPawnMoves, checks an en passant capture
+*
+* SYNOPSYS
+*
+*      template <Color Us> bool Position::is_legal_en_passant(int from) const;
+*      from        ->  square of the capturing pawn
+*
+* DESCRIPTION
+*
+*  En passant removes two pawns from a row at once, which can expose the king along that row,
+ *  so the capture is checked by looking for attackers of the king on the board after it.
+*/
+template <Color Us>
+bool Position::is_legal_en_passant(int from) const
+{
+    int captured = m_ep_square - pawn_forward<Us>();
+    Bitboard occupied = (occupancy() ^ square_bb(from) ^ square_bb(captured)) | square_bb(m_ep_square);
+    return !(attackers_to(m_king_square[Us], occupied) & m_by_color[Us ^ 1] & ~square_bb(captured));
+}
+
+
+/*
+* NAME
+*      AddCastling - helper for GenerateFor, adds the castling moves
+*
+* SYNOPSYS
+*
+*      template <Color Us> void Position::add_castling(MoveList& moves, const AttackInfo& attacks) const;
+*
+* DESCRIPTION
+*
+*  For each right the side still has, this function adds the king's two square step if the rook is in its corner,
+ *  the squares between king and rook are empty and the squares the king crosses are not attacked.
+*/
+template <Color Us>
+void Position::add_castling(MoveList& moves, const AttackInfo& attacks) const
+{
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr int king = (Us == WHITE) ? 4 : 60;
+    constexpr uint8_t king_side = (Us == WHITE) ? WHITE_OO : BLACK_OO;
+    constexpr uint8_t queen_side = (Us == WHITE) ? WHITE_OOO : BLACK_OOO;
+    if (m_king_square[Us] != king)
+        return;
+    Bitboard occupied = occupancy();
+
+    if ((m_castling & king_side) && m_squares[king + 3] == make_piece(Us, ROOK) && !(occupied & between_bb(king, king + 3))
+        && !(attacks.attacked[Them] & (square_bb(king + 1) | square_bb(king + 2))))
+        moves.push_back(encode_move(king, king + 2));
+    if ((m_castling & queen_side) && m_squares[king - 4] == make_piece(Us, ROOK) && !(occupied & between_bb(king, king - 4))
+        && !(attacks.attacked[Them] & (square_bb(king - 1) | square_bb(king - 2))))
+        moves.push_back(encode_move(king, king - 2));
+}
+
+
+/*
+* NAME
+*      AttackersTo - finds the pieces attacking a square
+*
+* SYNOPSYS
+*
+*      Bitboard Position::attackers_to(int sq, Bitboard occupied) const;
+*      sq          ->  the square to be checked
+*      occupied    ->  the pieces that block sliding attacks
+*
+* DESCRIPTION
+*
+*  This function looks outward from the square with the moves of each piece: a piece of that kind found there attacks it.
+*/
+Bitboard Position::attackers_to(int sq, Bitboard occupied) const
+{
+    return (pawn_attacks(WHITE, sq) & pieces(BLACK, PAWN))
+         | (pawn_attacks(BLACK, sq) & pieces(WHITE, PAWN))
+         | (knight_attacks(sq) & m_by_type[KNIGHT])
+         | (king_attacks(sq) & m_by_type[KING])
+         | (bishop_attacks(sq, occupied) & (m_by_type[BISHOP] | m_by_type[QUEEN]))
+         | (rook_attacks(sq, occupied) & (m_by_type[ROOK] | m_by_type[QUEEN]));
+}
+
+
+/*
+* NAME
+*      IsAttacked - checks if a square is attacked by a side
+*
+* SYNOPSYS
+*
+*      bool Position::is_attacked(int sq, Color by) const;
+*      sq          ->  the square to be checked
+*      by          ->  the attacking side
+*/
+bool Position::is_attacked(int sq, Color by) const
+{
+    return (attackers_to(sq, occupancy()) & m_by_color[by]) != 0;
+}
+
+
+/*
+* NAME
+*      Checkers - finds the pieces giving check
+*
+* SYNOPSYS
+*
+*      Bitboard Position::checkers() const;
+*
+* DESCRIPTION
+*
+*  This function returns the opposing pieces attacking the side to move's king.
+*/
+Bitboard Position::checkers() const
+{
+    int king = m_king_square[m_side];
+    assert(king != NO_SQUARE && "positions are checked for their kings as they are set up");
+    return attackers_to(king, occupancy()) & m_by_color[m_side ^ 1];
+}
+
+
+/*
+* NAME
+*      ComputeAttacks - finds the squares both sides attack
+*
+* SYNOPSYS
+*
+*      void Position::compute_attacks(AttackInfo& attacks) const;
+*      attacks     ->  receives the attacks, checkers, pins and mobility of the position
+*
+* DESCRIPTION
+*
+*  Every piece's attacks are looked up once, for the move generator, the move ordering and the evaluation alike.
+ *  The squares behind the king on the line of a checking slider are added to the king's danger squares,
+ *  since the king does not block the slider once it steps away.
+*/
+void Position::compute_attacks(AttackInfo& attacks) const
+{
+    add_side_attacks<WHITE>(attacks);
+    add_side_attacks<BLACK>(attacks);
+    attacks.checkers = checkers();
+    attacks.pinned = (m_side == WHITE) ? pinned_pieces<WHITE>() : pinned_pieces<BLACK>();
+    attacks.king_danger = attacks.attacked[m_side ^ 1];
+
+    Bitboard sliders = attacks.checkers & ~m_by_type[PAWN] & ~m_by_type[KNIGHT];
+    if (!sliders)
+        return;
+    Bitboard occupied = occupancy() ^ square_bb(m_king_square[m_side]);
+    while (sliders)
+    {
+        int sq = pop_lsb(sliders);
+        PieceType type = type_of(m_squares[sq]);
+        if (type == BISHOP || type == QUEEN)
+            attacks.king_danger |= bishop_attacks(sq, occupied);
+        if (type == ROOK || type == QUEEN)
+            attacks.king_danger |= rook_attacks(sq, occupied);
+    }
+}
+
+
+/*
+* NAME
+*      AddSideAttacks - helper for ComputeAttacks, finds the attacks and mobility of one side
+*
+* SYNOPSYS
+*
+*      template <Color Us> void Position::add_side_attacks(AttackInfo& attacks) const;
+*
+* DESCRIPTION
+*
+*  Pawns are handled all at once by shifts. The mobility counts the squares each piece but the king attacks
+ *  that do not hold a piece of its own side; pawns count their steps forward and their captures instead.
+*/
+template <Color Us>
+void Position::add_side_attacks(AttackInfo& attacks) const
+{
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    Bitboard own = m_by_color[Us], occupied = occupancy();
+    Bitboard pawns = pieces(Us, PAWN);
+    Bitboard west = pawn_attacks_west<Us>(pawns), east = pawn_attacks_east<Us>(pawns);
+    Bitboard one_step = pawn_push<Us>(pawns) & ~occupied;
+    Bitboard two_steps = pawn_push<Us>(one_step & row_bb(relative_row<Us>(2))) & ~occupied;
+    int mobility = popcount(west & m_by_color[Them]) + popcount(east & m_by_color[Them])
+                 + popcount(one_step) + popcount(two_steps);
+    Bitboard attacked = west | east, twice = west & east;
+
+    for (Bitboard pieces = own & ~m_by_type[PAWN] & ~m_by_type[KING]; pieces; )
+    {
+        int sq = pop_lsb(pieces);
+        Bitboard piece_attacks;
+        switch (type_of(m_squares[sq]))
+        {
+        case KNIGHT: piece_attacks = knight_attacks(sq); break;
+        case BISHOP: piece_attacks = bishop_attacks(sq, occupied); break;
+        case ROOK: piece_attacks = rook_attacks(sq, occupied); break;
+        default: piece_attacks = queen_attacks(sq, occupied); break;
+        }
+        mobility += popcount(piece_attacks & ~own);
+        twice |= attacked & piece_attacks;
+        attacked |= piece_attacks;
+    }
+    twice |= attacked & king_attacks(m_king_square[Us]);
+    attacked |= king_attacks(m_king_square[Us]);
+    attacks.attacked[Us] = attacked;
+    attacks.attacked_twice[Us] = twice;
+    attacks.mobility[Us] = mobility;
+}
+
+
+/*
+* NAME
+*      CountPieces - counts the pieces on the board
+*
+* SYNOPSYS
+*
+*      int Position::count_pieces() const;
+*/
+int Position::count_pieces() const
+{
+    return popcount(occupancy());
+}
+
+
+/*
+* NAME
+*      MakeMove - makes a move on the position
+*
+* SYNOPSYS
+*
+*      void Position::make_move(Move m, Undo& undo);
+*      m           ->  a move from get_all_valids
+*      undo        ->  receives what unmake_move needs to restore the position
+*
+* DESCRIPTION
+*
+*  This function moves the piece, capturing whatever is on the target square or, en passant, behind it,
+ *  promotes pawns, brings the rook along when castling, and updates castling rights, en passant square,
+ *  move counters, side to move and the keys.
+ *  The en passant square is only set when an opposing pawn can capture there, so positions that
+ *  differ in nothing else share a key.
+*/
+void Position::make_move(Move m, Undo& undo)
+{
+    int from = move_from(m), to = move_to(m);
+    uint8_t piece = m_squares[from];
+    int captured = to;
+    if (type_of(piece) == PAWN && to == m_ep_square && col_of(from) != col_of(to))
+        captured = make_square(row_of(from), col_of(to));
+
+    undo.captured = m_squares[captured];
+    undo.castling = m_castling;
+    undo.ep_square = m_ep_square;
+    undo.halfmove = m_halfmove;
+    undo.key = m_key;
+    undo.pawn_key = m_pawn_key;
+
+    clear_square(captured);
+    clear_square(from);
+    put_piece(to, move_promotion(m) != NO_TYPE ? make_piece(m_side, move_promotion(m)) : piece);
+    if (type_of(piece) == KING && (to - from == 2 || from - to == 2))
+    {
+        int rook_from = (to > from) ? from + 3 : from - 4, rook_to = (from + to) / 2;
+        put_piece(rook_to, m_squares[rook_from]);
+        clear_square(rook_from);
+    }
+
+    uint8_t ep_square = NO_SQUARE;
+    if (type_of(piece) == PAWN && (to - from == 16 || from - to == 16)
+        && (pawn_attacks(m_side, (from + to) / 2) & pieces((Color)(m_side ^ 1), PAWN)))
+        ep_square = (uint8_t)((from + to) / 2);
+    set_ep_square(ep_square);
+    set_castling(m_castling & castling_mask(from) & castling_mask(to));
+
+    if (type_of(piece) == PAWN || undo.captured != NO_PIECE)
+        m_halfmove = 0;
+    else
+        m_halfmove++;
+    if (m_side == BLACK)
+        m_fullmove++;
+    set_side_to_move((Color)(m_side ^ 1));
+}
+
+
+/*
+* NAME
+*      UnmakeMove - takes back a move
+*
+* SYNOPSYS
+*
+*      void Position::unmake_move(Move m, const Undo& undo);
+*      m           ->  the move last made
+*      undo        ->  the record filled by make_move
+*
+* DESCRIPTION
+*
+*  This function moves the piece back, demoting promoted pawns and returning a castled rook to its corner,
+ *  puts back the captured piece and restores the rest of the state from the undo record.
+*/
+void Position::unmake_move(Move m, const Undo& undo)
+{
+    int from = move_from(m), to = move_to(m);
+    Color mover = (Color)(m_side ^ 1);
+    uint8_t piece = (move_promotion(m) != NO_TYPE) ? make_piece(mover, PAWN) : m_squares[to];
+
+    clear_square(to);
+    put_piece(from, piece);
+    if (type_of(piece) == KING && (to - from == 2 || from - to == 2))
+    {
+        int rook_from = (to > from) ? from + 3 : from - 4, rook_to = (from + to) / 2;
+        put_piece(rook_from, m_squares[rook_to]);
+        clear_square(rook_to);
+    }
+    if (undo.captured != NO_PIECE)
+    {
+        int captured = to;
+        if (type_of(piece) == PAWN && to == undo.ep_square && col_of(from) != col_of(to))
+            captured = make_square(row_of(from), col_of(to));
+        put_piece(captured, undo.captured);
+    }
+
+    m_side = mover;
+    if (m_side == BLACK)
+        m_fullmove--;
+    m_castling = undo.castling;
+    m_ep_square = undo.ep_square;
+    m_halfmove = undo.halfmove;
+    m_key = undo.key;
+    m_pawn_key = undo.pawn_key;
+}
@@ -0,0 +1,250 @@
+/*
+Position class
+-- Compact, graphics independent description of a chess position used by the engine and the tooling.
+-- Squares are indexed row * 8 + col with the same (row, col) layout as Board, so a1 = 0 and h8 = 63.
+-- Every square holds a 4-bit piece code: bit 3 is the color, the low three bits are the piece type.
+-- Generates the legal moves, with code specialized at compile time for each side to move, makes and unmakes them and keeps a Zobrist key of the position,
+   plus one of the pawns alone for the pawn structure cache.
+-- Reads and writes FEN.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef uint64_t Bitboard;
+
+enum Color : uint8_t { WHITE = 0, BLACK = 1 };
+
+enum PieceType : uint8_t { NO_TYPE = 0, PAWN = 1, KNIGHT = 2, BISHOP = 3, ROOK = 4, QUEEN = 5, KING = 6 };
+
+enum PieceCode : uint8_t
+{
+    NO_PIECE = 0,
+    W_PAWN = 1, W_KNIGHT = 2, W_BISHOP = 3, W_ROOK = 4, W_QUEEN = 5, W_KING = 6,
+    B_PAWN = 9, B_KNIGHT = 10, B_BISHOP = 11, B_ROOK = 12, B_QUEEN = 13, B_KING = 14
+};
+
+// Castling right bits
+enum CastlingRight : uint8_t { WHITE_OO = 1, WHITE_OOO = 2, BLACK_OO = 4, BLACK_OOO = 8 };
+
+const uint8_t NO_SQUARE = 64;
+
+inline Color color_of(uint8_t code) { return (Color)(code >> 3); }
+inline PieceType type_of(uint8_t code) { return (PieceType)(code & 7); }
+inline uint8_t make_piece(Color c, PieceType t) { return (uint8_t)((c << 3) | t); }
+inline int make_square(int row, int col) { return row * 8 + col; }
+inline int row_of(int sq) { return sq >> 3; }
+inline int col_of(int sq) { return sq & 7; }
+inline Bitboard square_bb(int sq) { return 1ULL << sq; }
+
+// a1, e4, ... for a square index; "-" for NO_SQUARE
+string square_name(int sq);
+
+// Moves are packed into 16 bits: from square, to square and the promotion piece type
+typedef uint16_t Move;
+const Move MOVE_NONE = 0;
+
+inline Move encode_move(int from, int to, PieceType promotion = NO_TYPE) { return (Move)(from | (to << 6) | (promotion << 12)); }
+inline int move_from(Move m) { return m & 63; }
+inline int move_to(Move m) { return (m >> 6) & 63; }
+inline PieceType move_promotion(Move m) { return (PieceType)((m >> 12) & 7); }
+
+// Castling is encoded as the king's two square step, en passant as the pawn's diagonal step to the en passant square
+// e2e4, e7e8q, ... for a move
+string move_to_uci(Move m);
+
+// Number of times the last key occurs in a game's key history, counting only positions since the last
+// irreversible move; keys ends with the current position and halfmove is its halfmove clock
+int count_repetitions(const vector<uint64_t>& keys, unsigned int halfmove);
+
+// Most moves a position can have is 218
+const int MAX_MOVES = 256;
+
+// Fixed capacity list of moves, which the move generator fills without touching the heap
+class MoveList
+{
+private:
+    Move m_moves[MAX_MOVES];
+    int m_size;
+
+public:
+    MoveList() : m_size(0) {}
+
+    void push_back(Move m) { m_moves[m_size++] = m; }
+    void pop_back() { m_size--; }
+    void clear() { m_size = 0; }
+    int size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    Move& operator[](int i) { return m_moves[i]; }
+    Move operator[](int i) const { return m_moves[i]; }
+    Move back() const { return m_moves[m_size - 1]; }
+    Move* begin() { return m_moves; }
+    Move* end() { return m_moves + m_size; }
+    const Move* begin() const { return m_moves; }
+    const Move* end() const { return m_moves + m_size; }
+};
+
+// Moves a generator call adds: captures include en passant and every promotion, quiets are all the other moves
+enum GenKind { GEN_CAPTURES, GEN_QUIETS, GEN_ALL };
+
+// Squares each side attacks, found once per position and shared by the move generator, check detection,
+// move ordering and the evaluation, so terms that depend on attacks cost popcounts
+struct AttackInfo
+{
+    Bitboard attacked[2];                   // squares attacked by any piece of the side
+    Bitboard attacked_twice[2];             // squares attacked by two or more pieces of the side
+    Bitboard king_danger;                   // squares the opponent attacks through the side to move's king
+    Bitboard checkers;                      // pieces giving check to the side to move
+    Bitboard pinned;                        // side to move's pieces pinned to its king
+    int mobility[2];                        // moves of the side's pieces but the king to squares without own pieces
+};
+
+// State make_move destroys and unmake_move needs back
+struct Undo
+{
+    uint8_t captured;
+    uint8_t castling;
+    uint8_t ep_square;
+    unsigned int halfmove;
+    uint64_t key;
+    uint64_t pawn_key;
+};
+
+class Position
+{
+private:
+    uint8_t m_squares[64];                  // piece code on every square
+    Bitboard m_by_color[2];                 // occupancy of each side
+    Bitboard m_by_type[7];                  // occupancy of each piece type, both sides
+    Color m_side;                           // side to move
+    uint8_t m_castling;                     // CastlingRight bits
+    uint8_t m_ep_square;                    // en passant target square or NO_SQUARE
+    unsigned int m_halfmove;                // halfmove clock for the fifty-move rule
+    unsigned int m_fullmove;                // fullmove number, starts at 1
+    uint64_t m_key;                         // Zobrist key, updated incrementally
+    uint64_t m_pawn_key;                    // Zobrist key of the pawns only
+    uint8_t m_king_square[2];               // square of each king, NO_SQUARE if there is none
+
+    /*
+     * Helper functions for generate start
+     */
+
+    // Add the legal moves of the kind of the side to move's pieces on the from squares,
+    // finding the attacks first unless given
+    void generate(GenKind kind, Bitboard from, MoveList& moves, const AttackInfo* attacks) const;
+
+    // generate for the side to move Us, specialized on its color
+    template <Color Us> void generate_for(GenKind kind, Bitboard from, MoveList& moves, const AttackInfo& attacks) const;
+
+    // Fill the attacked squares and mobility of the side Us
+    template <Color Us> void add_side_attacks(AttackInfo& attacks) const;
+
+    // Pieces of the side Us that are pinned to its king
+    template <Color Us> Bitboard pinned_pieces() const;
+
+    // Add the pawn moves of the kind of the pawns on the from squares that land on the target squares,
+    // skipping pinned pawns leaving their line
+    template <Color Us> void add_pawn_moves(GenKind kind, Bitboard from, Bitboard target, Bitboard pinned, MoveList& moves) const;
+
+    // Check if the en passant capture by the pawn on the square leaves its own king safe
+    template <Color Us> bool is_legal_en_passant(int from) const;
+
+    // Add the castling moves of the side Us, which must not be in check
+    template <Color Us> void add_castling(MoveList& moves, const AttackInfo& attacks) const;
+
+    /*
+     * Helper functions for generate end
+     */
+
+public:
+    // Empty board, white to move
+    Position();
+
+    // Set up the standard starting position
+    void set_start();
+
+    // Set up the position from a FEN string, returns false if the FEN is malformed or fails is_valid
+    bool set_fen(const string& fen);
+
+    // Return the FEN string of the position
+    string get_fen() const;
+
+    // Check if each side has one king, no pawn is on a back row, the side not to move is safe
+    // and the castling rights and en passant square fit the pieces
+    bool is_valid() const;
+
+    // Place a piece on an empty square / clear a square
+    void put_piece(int sq, uint8_t code);
+    void clear_square(int sq);
+
+    uint8_t piece_on(int sq) const { return m_squares[sq]; }
+    Bitboard pieces(Color c) const { return m_by_color[c]; }
+    Bitboard pieces(Color c, PieceType t) const { return m_by_color[c] & m_by_type[t]; }
+    Bitboard occupancy() const { return m_by_color[WHITE] | m_by_color[BLACK]; }
+    Color side_to_move() const { return m_side; }
+    uint8_t castling() const { return m_castling; }
+    uint8_t ep_square() const { return m_ep_square; }
+    unsigned int halfmove() const { return m_halfmove; }
+    unsigned int fullmove() const { return m_fullmove; }
+    uint64_t key() const { return m_key; }
+    uint64_t pawn_key() const { return m_pawn_key; }
+
+    // Zobrist key computed from scratch, equal to key() unless the incremental updates went wrong
+    uint64_t compute_key() const;
+
+    // Add the legal moves of the side to move's piece on the square / of every piece of the side to move
+    void get_valid_moves(int sq, MoveList& moves) const;
+    void get_all_valids(MoveList& moves) const;
+
+    // Add the legal moves of the side to move's pieces on the from squares
+    void get_moves_from(Bitboard from, MoveList& moves, const AttackInfo* attacks = nullptr) const { generate(GEN_ALL, from, moves, attacks); }
+
+    // Add the legal captures and promotions / the other legal moves of the side to move;
+    // attacks, if given, are those of this position, see compute_attacks
+    void get_captures(MoveList& moves, const AttackInfo* attacks = nullptr) const { generate(GEN_CAPTURES, ~0ULL, moves, attacks); }
+    void get_quiets(MoveList& moves, const AttackInfo* attacks = nullptr) const { generate(GEN_QUIETS, ~0ULL, moves, attacks); }
+
+    // Check if a move, from a hash table or another position, is legal here
+    bool is_legal(Move m, const AttackInfo* attacks = nullptr) const;
+
+    // Find the squares both sides attack, the checkers and pins of the side to move and the mobility
+    void compute_attacks(AttackInfo& attacks) const;
+
+    // Check if a move captures a piece, en passant included
+    bool is_capture(Move m) const
+    {
+        return m_squares[move_to(m)] != NO_PIECE || (move_to(m) == m_ep_square && type_of(m_squares[move_from(m)]) == PAWN);
+    }
+
+    // Pieces of both sides attacking the square, with the given occupancy for the sliding pieces
+    Bitboard attackers_to(int sq, Bitboard occupied) const;
+
+    // Check if the square is attacked by a piece of the given side
+    bool is_attacked(int sq, Color by) const;
+
+    // Pieces giving check to the side to move / whether there are any
+    Bitboard checkers() const;
+    bool in_check() const { return checkers() != 0; }
+
+    // Square of the side's king, NO_SQUARE only on the empty board of a position not set up yet
+    int king_square(Color c) const { return m_king_square[c]; }
+
+    // Count pieces on the board
+    int count_pieces() const;
+
+    // Make a legal move, including castling, en passant and promotions / take it back
+    void make_move(Move m, Undo& undo);
+    void unmake_move(Move m, const Undo& undo);
+
+    void set_side_to_move(Color c);
+    void set_castling(uint8_t rights);
+    void set_ep_square(uint8_t sq);
+    void set_halfmove(unsigned int clock) { m_halfmove = clock; }
+    void set_fullmove(unsigned int number) { m_fullmove = number; }
+};
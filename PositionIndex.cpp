@@ -0,0 +1,386 @@
+#include "PositionIndex.h"
+#include "Pgn.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// the version 2 records of a key are ordered by result first, so summarize can count them by binary search
+static const char index_magic[8] = { 'C', 'H', 'A', 'I', 'I', 'D', 'X', '2' };
+
+// Bytes of PGN text a thread takes at a time
+static const size_t chunk_bytes = 4 << 20;
+
+// Records read or written at a time while merging
+static const size_t merge_buffer_records = 1 << 14;
+
+struct IndexHeader
+{
+    char magic[8];
+    uint64_t count;                         // records following the header
+};
+
+static_assert(sizeof(IndexHeader) == sizeof(IndexRecord), "the header keeps the records aligned");
+
+// Order of the records: by key, then by result, then by game offset
+static bool record_less(const IndexRecord& a, const IndexRecord& b)
+{
+    if (a.key != b.key)
+        return a.key < b.key;
+    if (game_result(a.game) != game_result(b.game))
+        return game_result(a.game) < game_result(b.game);
+    return a.game < b.game;
+}
+
+
+/*
+* NAME
+*      Open -- maps an index
+*
+* SYNOPSYS
+*
+*      bool PositionIndex::open(const string& filename);
+*/
+bool PositionIndex::open(const string& filename)
+{
+    m_records = nullptr;
+    m_count = 0;
+    if (!m_file.open(filename))
+        return false;
+    const IndexHeader* header = (const IndexHeader*)m_file.data();
+    if (m_file.size() < sizeof(IndexHeader) || memcmp(header->magic, index_magic, sizeof(index_magic)) != 0
+        || m_file.size() != sizeof(IndexHeader) + header->count * sizeof(IndexRecord))
+    {
+        cout << filename << " is not a position index" << endl;
+        m_file.close();
+        return false;
+    }
+    m_records = (const IndexRecord*)(m_file.data() + sizeof(IndexHeader));
+    m_count = header->count;
+    return true;
+}
+
+
+/*
+* NAME
+*      Find -- finds the games reaching a position
+*
+* SYNOPSYS
+*
+*      void PositionIndex::find(uint64_t key, const IndexRecord*& first, const IndexRecord*& last) const;
+*      key         ->  Zobrist key of the position
+*      first, last ->  receive the range of its records in the mapping
+*/
+void PositionIndex::find(uint64_t key, const IndexRecord*& first, const IndexRecord*& last) const
+{
+    first = std::lower_bound(m_records, m_records + m_count, key,
+                             [](const IndexRecord& record, uint64_t k) { return record.key < k; });
+    last = std::upper_bound(first, m_records + m_count, key,
+                            [](uint64_t k, const IndexRecord& record) { return k < record.key; });
+}
+
+
+/*
+* NAME
+*      Summarize -- counts the games reaching a position by result
+*
+* SYNOPSYS
+*
+*      IndexSummary PositionIndex::summarize(uint64_t key) const;
+*
+* DESCRIPTION
+*
+*  The records of a key are ordered by result, so each result's count is the distance between two binary searches
+ *  in the key's range, however many games reached the position.
+*/
+IndexSummary PositionIndex::summarize(uint64_t key) const
+{
+    IndexSummary summary = {};
+    const IndexRecord *first, *last;
+    find(key, first, last);
+    const IndexRecord* start = first;
+    for (int result = GAME_UNFINISHED; result <= GAME_BLACK_WINS; result++)
+    {
+        const IndexRecord* end = std::lower_bound(start, last, result + 1,
+                                                  [](const IndexRecord& record, int r) { return (int)game_result(record.game) < r; });
+        summary.results[result] = end - start;
+        start = end;
+    }
+    summary.games = last - first;
+    return summary;
+}
+
+
+/*
+* NAME
+*      MergeRuns -- merges sorted runs into the index
+*
+* SYNOPSYS
+*
+*      static bool merge_runs(const vector<string>& runs, const string& filename, uint64_t count);
+*      runs        ->  files of sorted records
+*      filename    ->  the index to write
+*      count       ->  records in all the runs
+*
+* DESCRIPTION
+*
+*  A heap holds the next record of every run; each run is read through a small buffer.
+*/
+static bool merge_runs(const vector<string>& runs, const string& filename, uint64_t count)
+{
+    struct Run
+    {
+        ifstream in;
+        vector<IndexRecord> buffer;
+        size_t next;
+
+        bool refill()
+        {
+            buffer.resize(merge_buffer_records);
+            in.read((char*)buffer.data(), buffer.size() * sizeof(IndexRecord));
+            buffer.resize(in.gcount() / sizeof(IndexRecord));
+            next = 0;
+            return !buffer.empty();
+        }
+    };
+
+    vector<unique_ptr<Run>> readers;
+    auto later = [&readers](size_t a, size_t b) {
+        return record_less(readers[b]->buffer[readers[b]->next], readers[a]->buffer[readers[a]->next]);
+    };
+    priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+    for (const string& name : runs)
+    {
+        readers.emplace_back(new Run());
+        readers.back()->in.open(name, ios::binary);
+        if (readers.back()->refill())
+            heap.push(readers.size() - 1);
+    }
+
+    ofstream out(filename, ios::binary);
+    IndexHeader header;
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.count = count;
+    out.write((const char*)&header, sizeof(header));
+    vector<IndexRecord> output;
+    output.reserve(merge_buffer_records);
+    while (!heap.empty())
+    {
+        size_t index = heap.top();
+        heap.pop();
+        Run& run = *readers[index];
+        output.push_back(run.buffer[run.next++]);
+        if (run.next < run.buffer.size() || run.refill())
+            heap.push(index);
+        if (output.size() == merge_buffer_records)
+        {
+            out.write((const char*)output.data(), output.size() * sizeof(IndexRecord));
+            output.clear();
+        }
+    }
+    out.write((const char*)output.data(), output.size() * sizeof(IndexRecord));
+    if (!out)
+        cout << "Could not write " << filename << endl;
+    return (bool)out;
+}
+
+
+/*
+* NAME
+*      BuildPositionIndex -- indexes a PGN file by position
+*
+* SYNOPSYS
+*
+*      bool build_position_index(const string& pgn_filename, const string& index_filename, const IndexOptions& options);
+*
+* DESCRIPTION
+*
+*  Each thread takes 4 MB chunks of the mapped PGN file and records every position of every game once,
+ *  including the last one, however often the game repeats it. A thread holding run_records records sorts them
+ *  and writes them as a run next to the index; the runs are merged into the index and removed.
+*/
+bool build_position_index(const string& pgn_filename, const string& index_filename, const IndexOptions& options)
+{
+    MappedFile file(pgn_filename);
+    if (!file.is_open())
+        return false;
+    file.advise_sequential();
+    const char* data = (const char*)file.data();
+    size_t size = file.size();
+
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next_chunk(0), next_run(0);
+    atomic<uint64_t> total_games(0), total_records(0);
+    atomic<bool> failed(false);
+    mutex runs_mutex;
+    vector<string> runs;
+    auto write_run = [&](vector<IndexRecord>& records) {
+        if (records.empty())
+            return;
+        std::sort(records.begin(), records.end(), record_less);
+        string name = index_filename + ".run" + to_string(next_run++);
+        ofstream out(name, ios::binary);
+        out.write((const char*)records.data(), records.size() * sizeof(IndexRecord));
+        if (!out)
+        {
+            cout << "Could not write " << name << endl;
+            failed = true;
+        }
+        total_records += records.size();
+        records.clear();
+        lock_guard<mutex> lock(runs_mutex);
+        runs.push_back(name);
+    };
+
+    vector<thread> threads;
+    for (int i = 0; i < options.threads; i++)
+    {
+        threads.emplace_back([&]() {
+            vector<IndexRecord> records;
+            records.reserve(options.run_records);
+            vector<uint64_t> keys;
+            PgnGame game;
+            uint64_t games = 0;
+            for (size_t chunk = next_chunk++; chunk * chunk_bytes < size; chunk = next_chunk++)
+            {
+                PgnParser parser(data, size, chunk * chunk_bytes, std::min(size, (chunk + 1) * chunk_bytes), options.max_plies);
+                while (parser.next(game))
+                {
+                    games++;
+                    keys = game.keys;
+                    std::sort(keys.begin(), keys.end());
+                    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+                    if (records.size() + keys.size() > options.run_records)
+                        write_run(records);
+                    for (uint64_t key : keys)
+                        records.push_back(IndexRecord{ key, index_game(game.offset, game.result) });
+                }
+            }
+            write_run(records);
+            total_games += games;
+        });
+    }
+    for (thread& t : threads)
+        t.join();
+
+    bool written = !failed && merge_runs(runs, index_filename, total_records);
+    for (const string& name : runs)
+        remove(name.c_str());
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (written)
+        cout << index_filename << ": " << total_games << " games, " << total_records << " positions, " << runs.size()
+             << " runs, " << fixed << setprecision(1) << seconds << " s" << endl;
+    return written;
+}
+
+
+/*
+* NAME
+*      IndexCommand -- builds or queries a position index
+*
+* SYNOPSYS
+*
+*      int index_command(int argc, char* argv[]);
+*
+* DESCRIPTION
+*
+*  index build <games.pgn> <index.bin> [options]
+ *     -threads <n>        parsing threads, one per core by default
+ *     -plies <n>          moves of each game indexed, all by default
+ *     -run <n>            records a thread sorts in memory, 4000000 (64 MB) by default
+ *  index query <index.bin> <fen> [options]
+ *     -pgn <games.pgn>    the indexed file, to print the games
+ *     -show <n>           games listed, 10 by default
+ *  The query prints the number of games reaching the position by result, the time the lookup took,
+ *  and the offsets and results of the first games, or their text when the PGN file is given.
+*/
+int index_command(int argc, char* argv[])
+{
+    string action = (argc >= 1) ? argv[0] : "";
+    if (action == "build" && argc >= 3)
+    {
+        IndexOptions options = { std::max(1, (int)thread::hardware_concurrency()), SIZE_MAX, 4000000 };
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            string option = argv[i], value = argv[i + 1];
+            if (option == "-threads")
+                options.threads = std::max(1, atoi(value.c_str()));
+            else if (option == "-plies")
+                options.max_plies = std::max(1, atoi(value.c_str()));
+            else if (option == "-run")
+                options.run_records = std::max(1024ULL, strtoull(value.c_str(), nullptr, 10));
+            else
+            {
+                cout << "Bad option " << option << " " << value << endl;
+                return 1;
+            }
+        }
+        return build_position_index(argv[1], argv[2], options) ? 0 : 1;
+    }
+    if (action == "query" && argc >= 3)
+    {
+        string pgn_filename;
+        size_t show = 10;
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            string option = argv[i], value = argv[i + 1];
+            if (option == "-pgn")
+                pgn_filename = value;
+            else if (option == "-show")
+                show = atoi(value.c_str());
+            else
+            {
+                cout << "Bad option " << option << " " << value << endl;
+                return 1;
+            }
+        }
+        PositionIndex index;
+        Position position;
+        MappedFile pgn;
+        if (!index.open(argv[1]) || (!pgn_filename.empty() && !pgn.open(pgn_filename)))
+            return 1;
+        if (!position.set_fen(argv[2]))
+        {
+            cout << "Bad FEN " << argv[2] << endl;
+            return 1;
+        }
+
+        auto start = chrono::steady_clock::now();
+        IndexSummary summary = index.summarize(position.key());
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        cout << summary.games << " games: 1-0 " << summary.results[GAME_WHITE_WINS] << ", 1/2-1/2 " << summary.results[GAME_DRAWN]
+             << ", 0-1 " << summary.results[GAME_BLACK_WINS] << ", unfinished " << summary.results[GAME_UNFINISHED]
+             << " (" << fixed << setprecision(1) << micros << " us)" << endl;
+
+        static const char* const result_names[4] = { "*", "1-0", "1/2-1/2", "0-1" };
+        const IndexRecord *first, *last;
+        index.find(position.key(), first, last);
+        for (const IndexRecord* record = first; record < last && record < first + show; record++)
+        {
+            size_t offset = game_offset(record->game);
+            if (!pgn.is_open())
+            {
+                cout << offset << " " << result_names[game_result(record->game)] << endl;
+                continue;
+            }
+            const char* text = (const char*)pgn.data();
+            size_t end = next_pgn_game(text, pgn.size(), std::min(offset + 1, pgn.size()));
+            if (offset < pgn.size())
+                cout.write(text + offset, end - offset);
+        }
+        return 0;
+    }
+    cout << "usage: ChessAI index build <games.pgn> <index.bin> [options]" << endl
+         << "       ChessAI index query <index.bin> <fen> [options]" << endl;
+    return 1;
+}
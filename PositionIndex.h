@@ -0,0 +1,77 @@
+/*
+PositionIndex class
+-- Index of a PGN game database by position: sorted 16 byte records of a position's Zobrist key and a game reaching it,
+   the game given by the offset of its text in the PGN file, with its result in the low two bits.
+-- A lookup is a binary search in the memory-mapped file, touching a few pages; nothing is loaded into memory.
+-- Built in parallel: threads parse chunks of the mapped PGN file (see PgnParser) and write sorted runs of bounded
+   size to temporary files, which are merged into the index at the end, so building needs memory for the runs only.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+
+using namespace std;
+
+struct IndexRecord
+{
+    uint64_t key;                           // Zobrist key of the position
+    uint64_t game;                          // offset of the game's text << 2 | GameResult
+};
+
+enum GameResult { GAME_UNFINISHED = 0, GAME_WHITE_WINS = 1, GAME_DRAWN = 2, GAME_BLACK_WINS = 3 };
+
+inline uint64_t index_game(size_t offset, int8_t result)
+{
+    int code = (result == 1) ? GAME_WHITE_WINS : (result == 0) ? GAME_DRAWN : (result == -1) ? GAME_BLACK_WINS : GAME_UNFINISHED;
+    return ((uint64_t)offset << 2) | code;
+}
+inline size_t game_offset(uint64_t game) { return (size_t)(game >> 2); }
+inline GameResult game_result(uint64_t game) { return (GameResult)(game & 3); }
+
+// Games reaching a position, by result
+struct IndexSummary
+{
+    uint64_t games;
+    uint64_t results[4];                    // indexed by GameResult
+};
+
+class PositionIndex
+{
+private:
+    MappedFile m_file;
+    const IndexRecord* m_records;           // the records, after the header
+    size_t m_count;
+
+public:
+    PositionIndex() : m_records(nullptr), m_count(0) {}
+
+    // Map the index, returns false if it is not one
+    bool open(const string& filename);
+
+    // The records of the position, ordered by result, then game offset; first == last if no game reached it
+    void find(uint64_t key, const IndexRecord*& first, const IndexRecord*& last) const;
+
+    // Count the games reaching the position and their results
+    IndexSummary summarize(uint64_t key) const;
+
+    bool is_open() const { return m_records != nullptr; }
+    size_t size() const { return m_count; }
+};
+
+struct IndexOptions
+{
+    int threads;                            // parsing threads
+    size_t max_plies;                       // moves of each game indexed
+    size_t run_records;                     // records a thread sorts in memory before writing a run
+};
+
+// Index the games of the PGN file, returns false if a file cannot be read or written
+bool build_position_index(const string& pgn_filename, const string& index_filename, const IndexOptions& options);
+
+// Command line entry point: ChessAI index build <games.pgn> <index.bin> [options] / ChessAI index query <index.bin> <fen> [options]
+int index_command(int argc, char* argv[]);
@@ -0,0 +1,569 @@
+#include "Search.h"
+#include "Evaluation.h"
+#include "HeapCounter.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+static int score_to_table(int score, int steps)
+{
+    return (score >= MATE_BOUND) ? score + steps : (score <= -MATE_BOUND) ? score - steps : score;
+}
+
+static int score_from_table(int score, int steps)
+{
+    return (score >= MATE_BOUND) ? score - steps : (score <= -MATE_BOUND) ? score + steps : score;
+}
+
+// Check if utility a is better than b for the side Us: higher for white, lower for black
+template <Color Us> static inline bool better(int a, int b) { return (Us == WHITE) ? a > b : a < b; }
+
+
+/*
+* NAME
+*      ScoreToString -- writes a utility for people
+*
+* SYNOPSYS
+*
+*      string score_to_string(int score);
+*
+* DESCRIPTION
+*
+*  Mate scores count the plies from the root, so the mating side needs (plies + 1) / 2 of its moves.
+*/
+string score_to_string(int score)
+{
+    if (is_mate_score(score))
+    {
+        int moves = (MATE_SCORE - abs(score) + 1) / 2;
+        return (score > 0 ? "#" : "#-") + to_string(moves);
+    }
+    char text[16];
+    snprintf(text, sizeof(text), "%+.2f", score / 100.0);
+    return text;
+}
+
+
+/*
+* NAME
+*      Search -- creates a search
+*
+* SYNOPSYS
+*
+*      Search::Search();
+*/
+Search::Search()
+{
+    m_max_steps = 0;
+    m_best_action = MOVE_NONE;
+    m_previous_best = MOVE_NONE;
+    m_nodes = 0;
+    m_stopped = false;
+    m_evaluation = EVAL_HANDCRAFTED;
+    m_network = nullptr;
+    m_ply = 0;
+    m_excluded_count = 0;
+    m_stack.resize(MAX_SEARCH_DEPTH + 2);
+    m_table = &m_own_table;
+    m_hash_file = nullptr;
+}
+
+
+/*
+* NAME
+*      ShareTable - searches with a table other searches use too
+*
+* SYNOPSYS
+*
+*      void Search::share_table(TranspositionTable* table);
+*      table       ->  the shared table, or nullptr to use the search's own table again
+*
+* DESCRIPTION
+*
+*  Each search finds the others' results in a shared table. The own table shrinks to a single slot while
+ *  a shared one is used and comes back empty, in the default size.
+*/
+void Search::share_table(TranspositionTable* table)
+{
+    m_table = table ? table : &m_own_table;
+    m_own_table.resize(table ? 0 : DEFAULT_TABLE_KILOBYTES);
+}
+
+
+/*
+* NAME
+*      Clear - forgets what earlier searches found
+*
+* SYNOPSYS
+*
+*      void Search::clear();
+*
+* DESCRIPTION
+*
+*  Empties the transposition table in use, shared or not, the evaluation cache and the pawn table, so the next
+ *  search plays as if it were the first. Games that must come out the same whatever was played before call it.
+*/
+void Search::clear()
+{
+    m_table->clear();
+    m_eval_cache.clear();
+    m_pawns.clear();
+}
+
+
+/*
+* NAME
+*      SetEvaluation - selects the evaluation function
+*
+* SYNOPSYS
+*
+*      void Search::set_evaluation(EvalKind kind, const Network* network);
+ *
+ *      kind        -> EVAL_HANDCRAFTED or EVAL_NNUE
+ *      network     -> the network to use for EVAL_NNUE
+*
+* DESCRIPTION
+*
+*  This function switches the evaluation used by later searches and empties the evaluation cache and transposition table.
+ *  Asking for the network without a loaded one keeps the handcrafted evaluation.
+*/
+void Search::set_evaluation(EvalKind kind, const Network* network)
+{
+    m_network = network;
+    m_evaluation = (kind == EVAL_NNUE && network && network->is_loaded()) ? EVAL_NNUE : EVAL_HANDCRAFTED;
+    if (m_evaluation == EVAL_NNUE && m_accumulators.empty())
+        m_accumulators.resize(MAX_SEARCH_DEPTH + 2);
+    m_eval_cache.clear();
+    m_table->clear();
+}
+
+
+/*
+* NAME
+*      MakeMove, UnmakeMove - make and take back a move during the search
+*
+* SYNOPSYS
+*
+*      void Search::make_move(Move m, Undo& undo);
+*      void Search::unmake_move(Move m, const Undo& undo);
+*
+* DESCRIPTION
+*
+*  These functions make the move on the position, push its key on the key history and, with the network evaluation,
+ *  derive the next ply's accumulator from the current one. Taking the move back just drops that ply.
+*/
+void Search::make_move(Move m, Undo& undo)
+{
+    if (m_evaluation == EVAL_NNUE)
+    {
+        m_network->update(m_accumulators[m_ply], m_accumulators[m_ply + 1], m,
+                          m_position.piece_on(move_from(m)), m_position.piece_on(move_to(m)));
+    }
+    m_position.make_move(m, undo);
+    m_keys.push_back(m_position.key());
+    m_ply++;
+}
+
+void Search::unmake_move(Move m, const Undo& undo)
+{
+    m_position.unmake_move(m, undo);
+    m_keys.pop_back();
+    m_ply--;
+}
+
+
+/*
+* NAME
+*      SmartGuy - this function starts the minimax.
+*
+* SYNOPSYS
+*
+*      SearchResult Search::smart_guy(const Position& position, const SearchLimits& limits, const vector<uint64_t>& history);
+ *
+ *      position    -> the position to be searched, white maximizes
+ *      limits      -> depth, node and time limits, and the number of lines to report
+ *      history     -> keys of the game's positions, ending with this one, for repetition detection
+*
+* DESCRIPTION
+*
+*  This function runs the minimax with depth 1, 2, ... up to the depth limit, without allocating any memory.
+ *  Each iteration searches the best move of the previous one first, and finds the results of the previous ones
+ *  in the transposition table, which keeps them for the next search too.
+ *  With limits.multi_pv above one, each iteration searches the root once per line, leaving out the root moves
+ *  of the lines found before, and the lines come out best first.
+ *  When a node or time limit stops an iteration, the result of the last completed iteration is returned;
+ *  only if the first iteration did not complete is its partial result used.
+*/
+SearchResult Search::smart_guy(const Position& position, const SearchLimits& limits, const vector<uint64_t>& history)
+{
+    TRACE_SCOPE("search", "search");
+    m_position = position;
+    m_keys = history;
+    if (m_keys.empty() || m_keys.back() != position.key())
+        m_keys.push_back(position.key());
+    m_keys.reserve(m_keys.size() + MAX_SEARCH_DEPTH + 2);
+    m_limits = limits;
+    m_nodes = 0;
+    m_stopped = false;
+    m_previous_best = MOVE_NONE;
+    m_start = chrono::steady_clock::now();
+    m_ply = 0;
+    for (SearchFrame& frame : m_stack)
+        frame.killers[0] = frame.killers[1] = MOVE_NONE;
+    m_table->new_search();
+    if (m_evaluation == EVAL_NNUE)
+        m_network->refresh(m_position, m_accumulators[0]);
+
+    int lines = (limits.multi_pv > 1) ? std::min(limits.multi_pv, MAX_MOVES) : 1;
+    m_lines.resize(lines);
+    SearchResult result = { MOVE_NONE, 0, 0, 0, 0, vector<Move>(), vector<PvLine>(lines) };
+    for (int index = 0; index < lines; index++)
+    {
+        m_lines[index].pv.reserve(MAX_SEARCH_DEPTH + 1);
+        result.lines[index].pv.reserve(MAX_SEARCH_DEPTH + 1);
+    }
+    int max_depth = (limits.depth > 0 && limits.depth < MAX_SEARCH_DEPTH) ? limits.depth : MAX_SEARCH_DEPTH;
+    int found = 0, result_lines = 0;
+    uint64_t allocations = heap_allocations();
+    for (m_max_steps = 1; m_max_steps <= max_depth; m_max_steps++)
+    {
+        TRACE_SCOPE("search", "iteration");
+        int previous_found = found;
+        int utility = 0;
+        found = 0;
+        m_excluded_count = 0;
+        for (int index = 0; index < lines; index++)
+        {
+            int steps = 0;
+            m_best_action = MOVE_NONE;
+            m_previous_best = (index < previous_found) ? m_lines[index].pv[0] : MOVE_NONE;
+            if (m_position.side_to_move() == WHITE)
+                utility = minimax<WHITE>(steps, std::numeric_limits<int>::max());
+            else
+                utility = minimax<BLACK>(steps, std::numeric_limits<int>::min());
+            // no root moves left, or stopped before the first was searched
+            if (m_best_action == MOVE_NONE)
+                break;
+
+            PvLine& line = m_lines[index];
+            line.score = utility;
+            line.depth = m_max_steps;
+            line.pv.assign(m_stack[1].pv, m_stack[1].pv + m_stack[1].pv_length);
+            m_excluded[m_excluded_count++] = m_best_action;
+            found++;
+            if (m_stopped)
+                break;
+        }
+
+        if (m_stopped && result_lines > 0)
+            break;
+        for (int index = 0; index < found; index++)
+        {
+            result.lines[index].score = m_lines[index].score;
+            result.lines[index].depth = m_lines[index].depth;
+            result.lines[index].pv.assign(m_lines[index].pv.begin(), m_lines[index].pv.end());
+        }
+        result_lines = found;
+        result.score = found ? m_lines[0].score : utility;
+        result.depth = m_max_steps;
+        if (m_stopped || found == 0)
+            break;
+    }
+    assert(heap_allocations() == allocations && "the search allocated heap memory");
+    (void)allocations;
+
+    result.lines.resize(result_lines);
+    if (result_lines)
+    {
+        result.pv = result.lines[0].pv;
+        result.best_move = result.pv[0];
+    }
+    result.nodes = m_nodes;
+    result.time_ms = (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - m_start).count();
+    return result;
+}
+
+
+/*
+* NAME
+*      ShouldStop - checks the node and time limits
+*
+* SYNOPSYS
+*
+*      bool Search::should_stop();
+*
+* DESCRIPTION
+*
+*  This function sets m_stopped once a limit is reached. The clock is read every 1024 nodes only.
+*/
+bool Search::should_stop()
+{
+    if (m_stopped)
+        return true;
+    if (m_limits.nodes && m_nodes >= m_limits.nodes)
+        m_stopped = true;
+    else if (m_limits.movetime_ms && (m_nodes & 1023) == 0
+             && chrono::steady_clock::now() - m_start >= chrono::milliseconds(m_limits.movetime_ms))
+        m_stopped = true;
+    return m_stopped;
+}
+
+
+/*
+* NAME
+*      IsDraw - checks for a draw by the fifty-move rule or repetition
+*
+* SYNOPSYS
+*
+*      bool Search::is_draw() const;
+*
+* DESCRIPTION
+*
+*  Within the search a single repetition is scored as a draw: if the line was good for a side,
+ *  the side could repeat it again, so searching it further gains nothing.
+*/
+bool Search::is_draw() const
+{
+    return m_position.halfmove() >= 100 || count_repetitions(m_keys, m_position.halfmove()) > 1;
+}
+
+
+/*
+* NAME
+*      IsExcluded - checks for a root move of a line already found
+*
+* SYNOPSYS
+*
+*      bool Search::is_excluded(Move m) const;
+*/
+bool Search::is_excluded(Move m) const
+{
+    for (int i = 0; i < m_excluded_count; i++)
+    {
+        if (m_excluded[i] == m)
+            return true;
+    }
+    return false;
+}
+
+
+/*
+* NAME
+*      StoreKiller - remembers a quiet move that cut off
+*
+* SYNOPSYS
+*
+*      void Search::store_killer(int steps, Move m);
+*
+* DESCRIPTION
+*
+*  Positions at the same depth of the tree are often alike, so a quiet move that refuted one is tried early in the others.
+ *  The two most recent distinct killers are kept.
+*/
+void Search::store_killer(int steps, Move m)
+{
+    Move* killers = m_stack[steps].killers;
+    if (killers[0] != m)
+    {
+        killers[1] = killers[0];
+        killers[0] = m;
+    }
+}
+
+
+/*
+* NAME
+*      TableLine - rebuilds the line of a position cut off by the transposition table
+*
+* SYNOPSYS
+*
+*      void Search::table_line(int steps, Move move, int depth);
+*      steps       ->  the ply whose frame receives the line
+*      move        ->  the table's move of the position
+*      depth       ->  the depth the table's result was searched to, the longest line it stands for
+*
+* DESCRIPTION
+*
+*  An exact result taken from the table has no line of its own, so this function follows the table's moves from
+ *  the position, as long as they are legal, and takes them back. The undo states of the deeper frames are free
+ *  at this point and hold the moves made.
+*/
+void Search::table_line(int steps, Move move, int depth)
+{
+    SearchFrame& frame = m_stack[steps];
+    frame.pv_length = 0;
+    while (move != MOVE_NONE && frame.pv_length < depth && steps + frame.pv_length + 1 < (int)m_stack.size()
+           && m_position.is_legal(move))
+    {
+        m_position.make_move(move, m_stack[steps + frame.pv_length + 1].undo);
+        frame.pv[frame.pv_length++] = move;
+        TTEntry entry;
+        move = m_table->probe(m_position.key(), entry) ? entry.move : MOVE_NONE;
+    }
+    for (int i = frame.pv_length - 1; i >= 0; i--)
+        m_position.unmake_move(frame.pv[i], m_stack[steps + i + 1].undo);
+}
+
+
+/*
+* NAME
+*      Minimax - this function is recursive and attempts to maximize the utility of the board for the white side,
+*                or to minimize it for the black side
+*
+* SYNOPSYS
+*
+*      template <Color Us> int Search::minimax(int &steps, int alpha_comp_util);
+ *
+ *     Us               -> the side to move, the function is compiled once for each
+ *     steps            -> the depth of minimax tree
+ *     alpha_comp_util  -> alpha_beta value: the search stops once Us reaches it, the opponent having a better move before
+*
+* DESCRIPTION
+*
+*  Returns a draw for positions repeated or past the fifty-move rule.
+ * Checks if the depth is reached, if so, calls the evaluation function SmartGuysHelper.
+ * Below the root, returns the transposition table's score if it was searched as deep and is exact,
+ * with the line of the table's moves, or is a bound that already reaches alpha_comp_util.
+ * Within HASH_FILE_PLIES of the root the hash file's result
+ * is used instead when it is deeper, and the result is stored in the file too.
+ * Otherwise picks the legal moves for the side, the table's move first; without any, the side is checkmated or stalemated.
+ * For each valid move
+        * makes the move on the same position, and passes to minimax for the opponent
+        * to see what the utility the opponent reaches for current valid move or action.
+        * Takes the move back.
+* Finds the action with the best utility for the side saving it to m_best_action at the root, and to the table,
+ * and the line it leads to in the ply's frame.
+ * A quiet move that cuts off becomes a killer.
+*/
+template <Color Us>
+int Search::minimax(int& steps, int alpha_comp_util)
+{
+    constexpr Color Them = (Us == WHITE) ? BLACK : WHITE;
+    constexpr Bound cut_bound = (Us == WHITE) ? BOUND_LOWER : BOUND_UPPER;
+    steps++;
+    m_nodes++;
+    SearchFrame& frame = m_stack[steps];
+    frame.pv_length = 0;
+    if (should_stop() || (steps > 1 && is_draw()))
+    {
+        steps--;
+        return 0;
+    }
+    if (steps > m_max_steps)
+    {
+        steps--;
+        return smart_guys_helper();
+    }
+    int depth = m_max_steps - steps + 1;
+    Move hash_move = MOVE_NONE;
+    TTEntry entry;
+    bool found = m_table->probe(m_position.key(), entry);
+    bool near_root = m_hash_file && steps <= HASH_FILE_PLIES;
+    TTEntry stored;
+    if (near_root && m_hash_file->probe(m_position.key(), stored) && (!found || stored.depth > entry.depth))
+    {
+        entry = stored;
+        found = true;
+    }
+    if (found)
+    {
+        hash_move = entry.move;
+        int score = score_from_table(entry.score, steps);
+        if (steps > 1 && entry.depth >= depth
+            && (entry.bound == BOUND_EXACT || (entry.bound == cut_bound && !better<Us>(alpha_comp_util, score))))
+        {
+            // only an exact result can become part of the parent's line
+            if (entry.bound == BOUND_EXACT)
+                table_line(steps, entry.move, entry.depth);
+            steps--;
+            return score;
+        }
+    }
+    if (steps == 1 && m_previous_best != MOVE_NONE)
+        hash_move = m_previous_best;
+
+    Move best_action = MOVE_NONE;
+    int utility = (Us == WHITE) ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max();
+    m_position.compute_attacks(frame.attacks);
+    MovePicker picker(m_position, frame.attacks, hash_move, frame.killers, frame.lists);
+    for (Move move = picker.next(); move != MOVE_NONE; move = picker.next())
+    {
+        if (steps == 1 && is_excluded(move))
+            continue;
+        make_move(move, frame.undo);
+        int temp_utility = minimax<Them>(steps, utility);
+        unmake_move(move, frame.undo);
+        if (better<Us>(temp_utility, utility))
+        {
+            utility = temp_utility;
+            best_action = move;
+            const SearchFrame& child = m_stack[steps + 1];
+            frame.pv[0] = move;
+            for (int i = 0; i < child.pv_length; i++)
+                frame.pv[i + 1] = child.pv[i];
+            frame.pv_length = child.pv_length + 1;
+        }
+        if (m_stopped)
+            break;
+        if (!better<Us>(alpha_comp_util, utility))
+        {
+            if (!m_position.is_capture(move) && move_promotion(move) == NO_TYPE)
+                store_killer(steps, move);
+            break;
+        }
+    }
+    // a root without the moves of the lines found has no result of the position's to give or store
+    bool excluding = steps == 1 && m_excluded_count;
+    if (best_action == MOVE_NONE && !m_stopped && !excluding)
+    {
+        // checkmate, the sooner the better for the winner, or stalemate
+        utility = frame.attacks.checkers ? ((Us == WHITE) ? -(MATE_SCORE - steps) : MATE_SCORE - steps) : 0;
+    }
+    else if (!m_stopped && !excluding)
+    {
+        Bound bound = better<Us>(alpha_comp_util, utility) ? BOUND_EXACT : cut_bound;
+        m_table->store(m_position.key(), best_action, depth, score_to_table(utility, steps), bound);
+        if (near_root)
+            m_hash_file->store(m_position.key(), best_action, depth, score_to_table(utility, steps), bound);
+    }
+    if (steps == 1)
+        m_best_action = best_action;
+    steps--;
+    return utility;
+}
+
+
+/*
+* NAME
+*      SmartGuysHelper - this function is the evaluation function that returns the utility of the position
+*
+* SYNOPSYS
+*
+*      int Search::smart_guys_helper();
+*
+* DESCRIPTION
+*   Returns utility of the position in centipawns, from white's point of view.
+    With the network evaluation selected, the network scores the position,
+    otherwise the handcrafted material and mobility evaluation in Evaluation.cpp does.
+    Scores are cached by position key, so a position reached again is not evaluated twice.
+*/
+int Search::smart_guys_helper()
+{
+    int score;
+    if (m_eval_cache.probe(m_position.key(), score))
+        return score;
+    TRACE_SCOPE_FINE("search", "eval");
+    if (m_evaluation == EVAL_NNUE)
+    {
+        score = m_network->evaluate(m_accumulators[m_ply], m_position.side_to_move());
+        if (m_position.side_to_move() == BLACK)
+            score = -score;
+    }
+    else
+        score = evaluate(m_position, nullptr, &m_pawns);
+    m_eval_cache.store(m_position.key(), score);
+    return score;
+}
@@ -0,0 +1,172 @@
+/*
+Search class
+-- Graphics independent minimax with alpha-beta pruning, the engine behind Board::smart_guy.
+-- White maximizes and black minimizes the utility returned by the evaluation function SmartGuysHelper.
+-- Only legal moves are searched; a side without any is checkmated or stalemated.
+-- Positions repeated from the game or the current line, or past the fifty-move rule, are draws.
+-- Deepens iteratively up to the depth limit and stops early when a node or time limit is reached;
+   a node limit stops it at exactly that many nodes, so node limited searches are reproducible.
+-- In multi-PV mode every iteration searches the root again for each line, leaving out the root moves already found,
+   so that it reports the best few moves with their lines; the passes share the transposition table.
+-- Finished positions go into a transposition table, whose best move is searched first when the position comes back
+   and whose score can end its search. Moves are picked in stages, see MovePicker.
+-- The evaluation is either the handcrafted SmartGuysHelper or a neural network, chosen at runtime.
+-- Every ply works in its own frame of a stack allocated with the Search, so searching allocates no heap memory;
+   debug builds assert it, see HeapCounter.h.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Position.h"
+#include "Nnue.h"
+#include "PawnTable.h"
+#include "EvalCache.h"
+#include "TranspositionTable.h"
+#include "HashFile.h"
+#include "MovePicker.h"
+
+using namespace std;
+
+// Utility of a checkmate for the winner, less the plies it takes
+const int MATE_SCORE = 32000;
+
+// Deepest iteration when only a node or time limit is given
+const int MAX_SEARCH_DEPTH = 64;
+
+// Scores this close to MATE_SCORE are mates, counted from the root in the search and from the position in the table
+const int MATE_BOUND = MATE_SCORE - 2 * MAX_SEARCH_DEPTH;
+
+// Check if a utility is a mate for either side rather than an evaluation
+inline bool is_mate_score(int score) { return score >= MATE_BOUND || score <= -MATE_BOUND; }
+
+// Limits of one search, a zero means no limit
+struct SearchLimits
+{
+    int depth;                              // max number of depth for minimax
+    uint64_t nodes;                         // max number of nodes
+    int movetime_ms;                        // max time in milliseconds
+    int multi_pv;                           // number of best root moves to report, 1 for the best one only
+
+    SearchLimits() : depth(4), nodes(0), movetime_ms(0), multi_pv(1) {}
+};
+
+// One of the best root moves and the line it starts
+struct PvLine
+{
+    int score;                              // utility, from white's point of view
+    int depth;                              // depth of the iteration that found it
+    vector<Move> pv;                        // the line, starting with the root move
+};
+
+struct SearchResult
+{
+    Move best_move;                         // best move of the deepest completed iteration
+    int score;                              // its utility, from white's point of view
+    int depth;                              // depth of that iteration
+    uint64_t nodes;                         // nodes visited by the whole search
+    int time_ms;                            // time spent
+    vector<Move> pv;                        // principal variation, starting with best_move
+    vector<PvLine> lines;                   // the multi_pv best root moves, best first; lines[0] is best_move's
+};
+
+// What one ply of the search works with, preallocated for every ply
+struct SearchFrame
+{
+    PickerLists lists;                      // the move picker's lists
+    Undo undo;                              // state to take the move being searched back
+    AttackInfo attacks;                     // attacks of the ply's position, for the picker and the mate check
+    Move killers[2];                        // the last two quiet moves that cut off at this ply
+    Move pv[MAX_SEARCH_DEPTH + 2];          // best line found from this ply
+    int pv_length;
+};
+
+enum EvalKind { EVAL_HANDCRAFTED, EVAL_NNUE };
+
+// A utility as text: pawns from white's point of view, e.g. +0.35, or #3 / #-3 for white / black mating in 3 moves
+string score_to_string(int score);
+
+class Search
+{
+private:
+    Position m_position;                    // position being searched, moves are made and unmade on it
+    SearchLimits m_limits;
+    int m_max_steps;                        // depth of the current iteration
+    Move m_best_action;                     // best root move found by the current iteration
+    Move m_previous_best;                   // best root move of the previous iteration, searched first
+    Move m_excluded[MAX_MOVES];             // root moves of the lines found, left out by the later passes
+    int m_excluded_count;
+    vector<PvLine> m_lines;                 // lines of the current iteration
+    uint64_t m_nodes;
+    bool m_stopped;                         // a limit was hit, the current iteration is incomplete
+    chrono::steady_clock::time_point m_start;
+    EvalKind m_evaluation;                  // evaluation used by SmartGuysHelper
+    const Network* m_network;               // network for EVAL_NNUE
+    vector<Accumulator> m_accumulators;     // network accumulator of every ply on the current line
+    int m_ply;                              // moves made since the root
+    vector<uint64_t> m_keys;                // keys of the game's positions and the current line, the current position last
+    PawnTable m_pawns;                      // pawn structure cache of the handcrafted evaluation, kept across searches
+    EvalCache m_eval_cache;                 // static evaluations of positions seen before, kept across searches
+    TranspositionTable m_own_table;         // results of finished positions, kept across searches
+    TranspositionTable* m_table;            // m_own_table, or a table shared with other searches
+    HashFile* m_hash_file;                  // persistent results near the root, nullptr if none
+    vector<SearchFrame> m_stack;            // frame of every ply, indexed by steps
+
+    // Check if the move is the root move of a line found by an earlier multi-PV pass
+    bool is_excluded(Move m) const;
+
+    // Remember a quiet move that cut off at the given steps
+    void store_killer(int steps, Move m);
+
+    // Fill the ply's line with the table's moves from the current position, at most depth of them
+    void table_line(int steps, Move move, int depth);
+
+    // Make / unmake a move on m_position, keeping the network accumulators in step
+    void make_move(Move m, Undo& undo);
+    void unmake_move(Move m, const Undo& undo);
+
+    // Check the node and time limits
+    bool should_stop();
+
+    // Check if the current position is drawn by the fifty-move rule or has occurred before
+    bool is_draw() const;
+
+    // Utility maximizer for Us == WHITE, minimizer for Us == BLACK
+    template <Color Us> int minimax(int& steps, int alpha_comp_util);
+
+    // Evaluation function: returns the utility of the position
+    int smart_guys_helper();
+
+public:
+    Search();
+
+    // Select the evaluation; EVAL_NNUE needs a loaded network and falls back to the handcrafted one otherwise
+    void set_evaluation(EvalKind kind, const Network* network = nullptr);
+    EvalKind evaluation() const { return m_evaluation; }
+
+    const PawnTable& pawn_table() const { return m_pawns; }
+    const EvalCache& eval_cache() const { return m_eval_cache; }
+    const TranspositionTable& table() const { return *m_table; }
+
+    // Change the transposition table's size in kilobytes, which empties it
+    void set_table_size(size_t kilobytes) { m_table->resize(kilobytes); }
+
+    // Empty the transposition table, the evaluation cache and the pawn table
+    void clear();
+
+    // Use a table shared with searches on other threads, or the search's own one again for nullptr;
+    // the own table is freed while sharing
+    void share_table(TranspositionTable* table);
+
+    // Look up and store the results near the root in a persistent hash file too, none for nullptr
+    void set_hash_file(HashFile* file) { m_hash_file = file; }
+
+    // Minimax originator: search the position within the limits and return the best move
+    // history holds the keys of the game's positions up to this one, repetitions of them are draws
+    SearchResult smart_guy(const Position& position, const SearchLimits& limits,
+                           const vector<uint64_t>& history = vector<uint64_t>());
+};
@@ -0,0 +1,575 @@
+#include "SelfPlay.h"
+#include "Notation.h"
+#include "Difficulty.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Openings used when no suite is given: a few plies into common lines
+static const char* default_openings[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pppp1ppp/4p3/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pp1ppppp/2p5/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2",
+    "rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b KQkq - 0 1",
+    "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R b KQkq - 1 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pppp1ppp/4pn2/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq - 0 3",
+};
+
+
+/*
+* NAME
+*      ParseEngineConfig -- parses an engine configuration
+*
+* SYNOPSYS
+*
+*      bool parse_engine_config(const string& spec, EngineConfig& config);
+*      spec        ->  comma separated key=value pairs: name, depth, nodes, movetime, eval (hce or nnue), level
+*      config      ->  the configuration to be changed, keys not in spec keep their value
+*
+* DESCRIPTION
+*
+*  This function applies the pairs to the configuration. Returns false on an unknown key or a missing value.
+ *  A level sets the limits to its own, so limits given after it override them.
+*/
+bool parse_engine_config(const string& spec, EngineConfig& config)
+{
+    istringstream stream(spec);
+    string pair;
+    while (getline(stream, pair, ','))
+    {
+        size_t equals = pair.find('=');
+        if (equals == string::npos)
+            return false;
+        string key = pair.substr(0, equals);
+        string value = pair.substr(equals + 1);
+        if (key == "name")
+            config.name = value;
+        else if (key == "depth")
+            config.limits.depth = atoi(value.c_str());
+        else if (key == "nodes")
+            config.limits.nodes = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "movetime")
+            config.limits.movetime_ms = atoi(value.c_str());
+        else if (key == "eval" && (value == "hce" || value == "nnue"))
+            config.evaluation = (value == "nnue") ? EVAL_NNUE : EVAL_HANDCRAFTED;
+        else if (key == "level" && atoi(value.c_str()) >= 1 && atoi(value.c_str()) <= DIFFICULTY_LEVELS)
+        {
+            config.level = atoi(value.c_str());
+            config.limits = level_limits(config.level);
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      EloFromScore -- converts a score fraction into an Elo difference
+*
+* SYNOPSYS
+*
+*      double elo_from_score(double score);
+*
+* DESCRIPTION
+*
+*  This function inverts the logistic Elo curve. Scores are clamped away from 0 and 1.
+*/
+double elo_from_score(double score)
+{
+    score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+
+/*
+* NAME
+*      EloErrorMargin -- returns the 95% error bar of the Elo difference
+*
+* SYNOPSYS
+*
+*      double elo_error_margin(int wins, int draws, int losses);
+*
+* DESCRIPTION
+*
+*  This function takes the standard error of the mean game score from the win/draw/loss counts
+ *  and maps score +- 1.96 standard errors through the Elo curve.
+*/
+double elo_error_margin(int wins, int draws, int losses)
+{
+    int games = wins + draws + losses;
+    if (games == 0)
+        return 0;
+    double score = (wins + 0.5 * draws) / games;
+    double variance = (wins * pow(1 - score, 2) + draws * pow(0.5 - score, 2) + losses * pow(score, 2)) / games;
+    double margin = 1.96 * sqrt(variance / games);
+    return (elo_from_score(score + margin) - elo_from_score(score - margin)) / 2;
+}
+
+
+/*
+* NAME
+*      SelfPlay -- sets up a match
+*
+* SYNOPSYS
+*
+*      SelfPlay::SelfPlay(const EngineConfig& engine1, const EngineConfig& engine2, const vector<string>& openings);
+*      engine1, engine2    ->  the two sides, results are reported from engine 1's point of view
+*      openings            ->  opening FENs, the built-in suite is used if empty
+*/
+SelfPlay::SelfPlay(const EngineConfig& engine1, const EngineConfig& engine2, const vector<string>& openings)
+{
+    m_engines[0] = engine1;
+    m_engines[1] = engine2;
+    m_openings = openings;
+    if (m_openings.empty())
+        m_openings.assign(begin(default_openings), end(default_openings));
+    m_games = 2 * (int)m_openings.size();
+    m_concurrency = std::max(1u, thread::hardware_concurrency());
+    m_max_plies = 300;
+    m_sprt = { false, 0, 5, 0.05, 0.05 };
+    m_network = nullptr;
+    m_next_game = 0;
+    m_stop = false;
+    m_wins = m_draws = m_losses = 0;
+    m_nodes[0] = m_nodes[1] = 0;
+    m_seconds[0] = m_seconds[1] = 0;
+}
+
+
+/*
+* NAME
+*      SetSprt -- enables the sequential probability ratio test
+*
+* SYNOPSYS
+*
+*      void SelfPlay::set_sprt(double elo0, double elo1, double alpha, double beta);
+*      elo0, elo1      ->  the null and alternative Elo hypotheses
+*      alpha, beta     ->  the false positive and false negative rates
+*/
+void SelfPlay::set_sprt(double elo0, double elo1, double alpha, double beta)
+{
+    m_sprt = { true, elo0, elo1, alpha, beta };
+}
+
+
+/*
+* NAME
+*      OpenPgn -- opens the PGN output file
+*
+* SYNOPSYS
+*
+*      bool SelfPlay::open_pgn(const string& filename);
+*
+* DESCRIPTION
+*
+*  This function opens the file for appending. Returns false if it cannot be opened.
+*/
+bool SelfPlay::open_pgn(const string& filename)
+{
+    m_pgn.open(filename, ios::app);
+    if (!m_pgn)
+        cout << "Could not open " << filename << endl;
+    return (bool)m_pgn;
+}
+
+
+/*
+* NAME
+*      Run -- plays the match
+*
+* SYNOPSYS
+*
+*      int SelfPlay::run();
+*
+* DESCRIPTION
+*
+*  This function starts the worker threads, waits for them and prints the final report.
+ *  Returns the number of games played.
+*/
+int SelfPlay::run()
+{
+    vector<thread> workers;
+    for (int i = 0; i < std::min(m_concurrency, m_games); i++)
+        workers.emplace_back(&SelfPlay::worker, this);
+    for (auto& worker : workers)
+        worker.join();
+
+    report();
+    for (int engine = 0; engine < 2; engine++)
+    {
+        cout << m_engines[engine].name << ": " << m_nodes[engine] << " nodes, "
+             << (long long)(m_seconds[engine] > 0 ? m_nodes[engine] / m_seconds[engine] : 0) << " nodes/s per thread" << endl;
+    }
+    return m_wins + m_draws + m_losses;
+}
+
+
+/*
+* NAME
+*      Worker -- plays games until there are no more
+*
+* SYNOPSYS
+*
+*      void SelfPlay::worker();
+*
+* DESCRIPTION
+*
+*  This function takes the next game index, plays it with the worker's own searches and records it.
+*/
+void SelfPlay::worker()
+{
+    Search searches[2];
+    for (int engine = 0; engine < 2; engine++)
+        searches[engine].set_evaluation(m_engines[engine].evaluation, m_network);
+    while (!m_stop)
+    {
+        int index = m_next_game++;
+        if (index >= m_games)
+            break;
+        GameRecord game;
+        play_game(index, searches, game);
+        if (record_game(index, game))
+            m_stop = true;
+    }
+}
+
+
+/*
+* NAME
+*      PlayGame -- plays one game of the match
+*
+* SYNOPSYS
+*
+*      void SelfPlay::play_game(int index, Search searches[2], GameRecord& game);
+*      index       ->  the game number, picks the opening and who plays white
+*      searches    ->  the searches of engine 1 and engine 2
+*      game        ->  receives the result, the PGN and search statistics
+*
+* DESCRIPTION
+*
+*  Game 2k and 2k + 1 start from opening k with engine 1 playing white and black respectively.
+ *  Checkmate wins. The game is drawn by stalemate, threefold repetition, the fifty-move rule, bare kings,
+ *  or after m_max_plies plies.
+*/
+void SelfPlay::play_game(int index, Search searches[2], GameRecord& game)
+{
+    const string& opening = m_openings[(index / 2) % m_openings.size()];
+    int white_engine = index % 2;
+    // the games a worker played before must not change this one's moves
+    searches[0].clear();
+    searches[1].clear();
+
+    Position position;
+    if (!position.set_fen(opening))
+        position.set_start();
+    string start_fen = position.get_fen();
+
+    vector<uint64_t> keys(1, position.key());
+    string movetext;
+    int result = 0;
+    string termination = "adjudication";
+    game.nodes[0] = game.nodes[1] = 0;
+    game.seconds[0] = game.seconds[1] = 0;
+
+    for (int plies = 0; ; plies++)
+    {
+        Color side = position.side_to_move();
+        MoveList legal;
+        position.get_all_valids(legal);
+        if (legal.empty())
+        {
+            if (position.in_check())
+            {
+                result = (side == WHITE) ? -1 : 1;
+                termination = "checkmate";
+            }
+            else
+                termination = "stalemate";
+            break;
+        }
+        if (position.halfmove() >= 100)
+        {
+            termination = "fifty moves";
+            break;
+        }
+        if (count_repetitions(keys, position.halfmove()) >= 3)
+        {
+            termination = "repetition";
+            break;
+        }
+        if (position.count_pieces() == 2)
+        {
+            termination = "insufficient material";
+            break;
+        }
+        if (plies >= m_max_plies)
+            break;
+
+        int engine = (side == WHITE) ? white_engine : 1 - white_engine;
+        SearchResult search = searches[engine].smart_guy(position, m_engines[engine].limits, keys);
+        game.nodes[engine] += search.nodes;
+        game.seconds[engine] += search.time_ms / 1000.0;
+        // a level picks among the lines with the game's number as seed; a search stopped before its first move
+        // still has to play something
+        Move move = m_engines[engine].level ? choose_level_move(search, position, m_engines[engine].level, index)
+                                            : search.best_move;
+        if (move == MOVE_NONE)
+            move = legal[0];
+
+        if (side == WHITE)
+            movetext += to_string(position.fullmove()) + ". ";
+        else if (plies == 0)
+            movetext += to_string(position.fullmove()) + "... ";
+        movetext += move_to_san(position, move) + " ";
+
+        Undo undo;
+        position.make_move(move, undo);
+        keys.push_back(position.key());
+    }
+
+    string result_text = (result == 1) ? "1-0" : (result == -1) ? "0-1" : "1/2-1/2";
+    ostringstream pgn;
+    pgn << "[Round \"" << index + 1 << "\"]\n"
+        << "[White \"" << m_engines[white_engine].name << "\"]\n"
+        << "[Black \"" << m_engines[1 - white_engine].name << "\"]\n"
+        << "[Result \"" << result_text << "\"]\n";
+    if (start_fen != "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
+        pgn << "[FEN \"" << start_fen << "\"]\n[SetUp \"1\"]\n";
+    pgn << "[Termination \"" << termination << "\"]\n\n" << movetext << result_text << "\n\n";
+
+    game.pgn = pgn.str();
+    game.engine1_result = (white_engine == 0) ? result : -result;
+}
+
+
+/*
+* NAME
+*      RecordGame -- adds a finished game to the match
+*
+* SYNOPSYS
+*
+*      bool SelfPlay::record_game(int index, const GameRecord& game);
+*
+* DESCRIPTION
+*
+*  This function updates the counters, appends the PGN and reports.
+ *  Returns true if the SPRT reached a decision.
+*/
+bool SelfPlay::record_game(int index, const GameRecord& game)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (game.engine1_result == 1)
+        m_wins++;
+    else if (game.engine1_result == -1)
+        m_losses++;
+    else
+        m_draws++;
+    for (int engine = 0; engine < 2; engine++)
+    {
+        m_nodes[engine] += game.nodes[engine];
+        m_seconds[engine] += game.seconds[engine];
+    }
+    if (m_pgn.is_open())
+    {
+        m_pgn << game.pgn;
+        m_pgn.flush();
+    }
+
+    cout << "Game " << index + 1 << ": ";
+    report();
+
+    if (!m_sprt.enabled)
+        return false;
+    double llr = sprt_llr();
+    double lower = log(m_sprt.beta / (1 - m_sprt.alpha));
+    double upper = log((1 - m_sprt.beta) / m_sprt.alpha);
+    if (llr >= upper)
+        cout << "SPRT: H1 accepted (elo >= " << m_sprt.elo1 << ")" << endl;
+    else if (llr <= lower)
+        cout << "SPRT: H0 accepted (elo <= " << m_sprt.elo0 << ")" << endl;
+    return llr >= upper || llr <= lower;
+}
+
+
+/*
+* NAME
+*      Report -- prints the match state
+*
+* SYNOPSYS
+*
+*      void SelfPlay::report();
+*
+* DESCRIPTION
+*
+*  This function prints wins, draws and losses of engine 1, its score, the Elo difference with
+ *  its error bar, and the SPRT log likelihood ratio with its bounds.
+*/
+void SelfPlay::report()
+{
+    int games = m_wins + m_draws + m_losses;
+    if (games == 0)
+        return;
+    double score = (m_wins + 0.5 * m_draws) / games;
+    cout << fixed << setprecision(1)
+         << "+" << m_wins << " =" << m_draws << " -" << m_losses
+         << "  score " << 100 * score << "%"
+         << "  elo " << elo_from_score(score) << " +- " << elo_error_margin(m_wins, m_draws, m_losses);
+    if (m_sprt.enabled)
+    {
+        cout << setprecision(2) << "  llr " << sprt_llr()
+             << " [" << log(m_sprt.beta / (1 - m_sprt.alpha)) << ", " << log((1 - m_sprt.beta) / m_sprt.alpha) << "]";
+    }
+    cout << defaultfloat << endl;
+}
+
+
+/*
+* NAME
+*      SprtLlr -- returns the log likelihood ratio of the SPRT
+*
+* SYNOPSYS
+*
+*      double SelfPlay::sprt_llr() const;
+*
+* DESCRIPTION
+*
+*  This function uses the normal approximation of the game score: with expected scores s0 and s1
+ *  under the two hypotheses, LLR = N (s1 - s0) (2 s - s0 - s1) / (2 var), where s and var are the
+ *  observed mean and variance of the per game score.
+*/
+double SelfPlay::sprt_llr() const
+{
+    int games = m_wins + m_draws + m_losses;
+    if (games == 0)
+        return 0;
+    double score = (m_wins + 0.5 * m_draws) / games;
+    double variance = (m_wins * pow(1 - score, 2) + m_draws * pow(0.5 - score, 2) + m_losses * pow(score, 2)) / games;
+    if (variance <= 0)
+        return 0;
+    double s0 = 1 / (1 + pow(10, -m_sprt.elo0 / 400));
+    double s1 = 1 / (1 + pow(10, -m_sprt.elo1 / 400));
+    return games * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance);
+}
+
+
+/*
+* NAME
+*      SelfPlayCommand -- command line entry point of the match runner
+*
+* SYNOPSYS
+*
+*      int self_play_command(int argc, char* argv[]);
+*      argv        ->  the options following "selfplay"
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -engine1 <spec>, -engine2 <spec>  engine configurations, see parse_engine_config
+ *     -games <n>                        number of games, default two per opening
+ *     -concurrency <n>                  games played at once, default one per core
+ *     -openings <file>                  one FEN or EPD per line
+ *     -pgn <file>                       append the games to the file
+ *     -maxplies <n>                     adjudicate a draw after n plies
+ *     -sprt <elo0>,<elo1>               stop once the SPRT decides, alpha = beta = 0.05
+ *     -nnue <file>                      network for engines with eval=nnue
+*/
+int self_play_command(int argc, char* argv[])
+{
+    EngineConfig engine1, engine2;
+    engine1.name = "engine1";
+    engine2.name = "engine2";
+    vector<string> openings;
+    int games = 0, concurrency = 0, max_plies = 0;
+    string pgn_filename, sprt, network_filename;
+
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        string option = argv[i], value = argv[i + 1];
+        bool ok = true;
+        if (option == "-engine1")
+            ok = parse_engine_config(value, engine1);
+        else if (option == "-engine2")
+            ok = parse_engine_config(value, engine2);
+        else if (option == "-games")
+            games = atoi(value.c_str());
+        else if (option == "-concurrency")
+            concurrency = atoi(value.c_str());
+        else if (option == "-maxplies")
+            max_plies = atoi(value.c_str());
+        else if (option == "-pgn")
+            pgn_filename = value;
+        else if (option == "-sprt")
+            sprt = value;
+        else if (option == "-nnue")
+            network_filename = value;
+        else if (option == "-openings")
+        {
+            ifstream in(value);
+            if (!in)
+            {
+                cout << "Could not open " << value << endl;
+                return 1;
+            }
+            string line;
+            while (getline(in, line))
+                if (!line.empty() && line[0] != '#')
+                    openings.push_back(line);
+        }
+        else
+            ok = false;
+        if (!ok)
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+    if (argc % 2)
+    {
+        cout << "Missing value for " << argv[argc - 1] << endl;
+        return 1;
+    }
+
+    Network network;
+    if (!network_filename.empty() && !network.load(network_filename))
+        return 1;
+    if ((engine1.evaluation == EVAL_NNUE || engine2.evaluation == EVAL_NNUE) && !network.is_loaded())
+    {
+        cout << "eval=nnue needs -nnue <file>" << endl;
+        return 1;
+    }
+
+    SelfPlay match(engine1, engine2, openings);
+    match.set_network(&network);
+    if (games > 0)
+        match.set_games(games);
+    if (concurrency > 0)
+        match.set_concurrency(concurrency);
+    if (max_plies > 0)
+        match.set_max_plies(max_plies);
+    if (!sprt.empty())
+    {
+        double elo0 = 0, elo1 = 5;
+        if (sscanf(sprt.c_str(), "%lf,%lf", &elo0, &elo1) != 2)
+        {
+            cout << "Bad SPRT bounds " << sprt << endl;
+            return 1;
+        }
+        match.set_sprt(elo0, elo1, 0.05, 0.05);
+    }
+    if (!pgn_filename.empty() && !match.open_pgn(pgn_filename))
+        return 1;
+    match.run();
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+SelfPlay class
+-- Plays engine-versus-engine matches between two engine configurations, several games at a time.
+-- Every opening of the suite is played twice with colors reversed.
+-- Games are appended to a compact PGN file as they finish.
+-- Reports the Elo difference with a 95% error bar and stops early once an SPRT reaches a decision.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Position.h"
+#include "Search.h"
+
+using namespace std;
+
+// One side of a match: a name, the limits of its searches and its evaluation
+struct EngineConfig
+{
+    string name;
+    SearchLimits limits;
+    EvalKind evaluation;
+    int level;                              // difficulty level picking the moves, 0 to play the best, see Difficulty.h
+
+    EngineConfig() : evaluation(EVAL_HANDCRAFTED), level(0) {}
+};
+
+// Parse "name=fast,depth=3,nodes=20000,movetime=50,eval=nnue,level=3" into a configuration, returns false on an unknown key
+bool parse_engine_config(const string& spec, EngineConfig& config);
+
+// Sequential probability ratio test between elo0 and elo1
+struct SprtConfig
+{
+    bool enabled;
+    double elo0, elo1;
+    double alpha, beta;
+};
+
+// Outcome of one game
+struct GameRecord
+{
+    int engine1_result;                     // 1 win, 0 draw, -1 loss for engine 1
+    string pgn;                             // the game in PGN
+    uint64_t nodes[2];                      // nodes searched by each engine
+    double seconds[2];                      // search time of each engine
+};
+
+class SelfPlay
+{
+private:
+    EngineConfig m_engines[2];              // engine 1 and engine 2, results are from engine 1's view
+    vector<string> m_openings;              // opening FENs
+    int m_games;                            // number of games to play
+    int m_concurrency;                      // games played at the same time
+    int m_max_plies;                        // games reaching this length are adjudicated a draw
+    SprtConfig m_sprt;
+    const Network* m_network;               // network for engines using EVAL_NNUE
+    ofstream m_pgn;
+
+    atomic<int> m_next_game;                // next game index to hand to a worker
+    atomic<bool> m_stop;                    // SPRT decided, no new games are started
+    mutex m_mutex;                          // guards the counters and the PGN file
+    int m_wins, m_draws, m_losses;
+    uint64_t m_nodes[2];                    // nodes searched by each engine
+    double m_seconds[2];                    // search time of each engine
+
+    // Play the game with the index using the searches of engine 1 and engine 2
+    void play_game(int index, Search searches[2], GameRecord& game);
+
+    // Worker thread: plays games until all are handed out or the SPRT decided
+    void worker();
+
+    // Record a finished game, returns true when the SPRT reached a decision
+    bool record_game(int index, const GameRecord& game);
+
+    // Print the current score, Elo and SPRT state
+    void report();
+
+    // Log likelihood ratio of the SPRT for the current results
+    double sprt_llr() const;
+
+public:
+    SelfPlay(const EngineConfig& engine1, const EngineConfig& engine2, const vector<string>& openings);
+
+    void set_games(int games) { m_games = games; }
+    void set_concurrency(int threads) { m_concurrency = threads; }
+    void set_max_plies(int plies) { m_max_plies = plies; }
+    void set_sprt(double elo0, double elo1, double alpha, double beta);
+    void set_network(const Network* network) { m_network = network; }
+    bool open_pgn(const string& filename);
+
+    // Play the match, returns the number of games played
+    int run();
+};
+
+// Elo difference for a score fraction, and its 95% error bar from the game results
+double elo_from_score(double score);
+double elo_error_margin(int wins, int draws, int losses);
+
+// Command line entry point: ChessAI selfplay [options]
+int self_play_command(int argc, char* argv[]);
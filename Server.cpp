@@ -0,0 +1,968 @@
+#include "Server.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Requests whose latency the percentiles are taken over
+static const size_t recent_requests = 4096;
+
+// Longest request line accepted
+static const size_t max_line_length = 4096;
+
+// Requests of one connection queued or searched at a time
+static const unsigned int max_requests_in_flight = 32;
+
+// Reply bytes a connection may leave unread before it is dropped
+static const size_t max_pending_output = 256 * 1024;
+
+// Time the replies left at shutdown may take without any progress before their client is given up
+static const int shutdown_flush_ms = 5000;
+
+// Requests the client leaves unanswered at a time
+static const size_t client_window = 16;
+
+
+/*
+* NAME
+*      ~Connection -- closes the client's socket
+*
+* SYNOPSYS
+*
+*      Connection::~Connection();
+*
+* DESCRIPTION
+*
+*  The last owner of the connection, the reader or the worker of its last request, closes the socket.
+ *  The reader keeps it until every reply is written, so a client that has closed its writing side sees
+ *  the end of the replies once every request is answered.
+*/
+Connection::~Connection()
+{
+    close(m_fd);
+}
+
+
+/*
+* NAME
+*      Send, Flush, Drop -- write reply lines to the client
+*
+* SYNOPSYS
+*
+*      bool Connection::send(const string& text);
+*      bool Connection::flush();
+*      void Connection::drop();
+*
+* DESCRIPTION
+*
+*  Send adds the whole text to the output at once with respect to the other workers, so replies do not interleave,
+ *  and writes what the socket takes without waiting; flush writes more when the reader finds room in the socket.
+ *  Neither ever blocks on the client. A client that went away, or that leaves more than max_pending_output bytes
+ *  unread, fails: its output is dropped and both return false, without raising SIGPIPE.
+*/
+bool Connection::send(const string& text)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_failed)
+        return false;
+    m_output += text;
+    write_output();
+    return !m_failed;
+}
+
+bool Connection::flush()
+{
+    lock_guard<mutex> lock(m_mutex);
+    write_output();
+    return !m_failed;
+}
+
+void Connection::drop()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_failed = true;
+    m_output.clear();
+}
+
+void Connection::write_output()
+{
+    size_t sent = 0;
+    while (!m_failed && sent < m_output.size())
+    {
+        ssize_t n = ::send(m_fd, m_output.data() + sent, m_output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            m_failed = true;
+        else
+            sent += n;
+    }
+    m_output.erase(0, sent);
+    if (m_output.size() > max_pending_output)
+        m_failed = true;
+    if (m_failed)
+        m_output.clear();
+}
+
+
+/*
+* NAME
+*      HasOutput, Failed, BeginRequest, EndRequest, Finished -- the state of a connection
+*
+* SYNOPSYS
+*
+*      bool Connection::has_output();
+*      bool Connection::failed();
+*      bool Connection::begin_request(unsigned int limit);
+*      void Connection::end_request();
+*      bool Connection::finished();
+*
+* DESCRIPTION
+*
+*  The reader counts a request in before queueing it and the worker counts it out after replying. The reader
+ *  lets go of the connection once it is finished: failed, or with its side closed, no request in flight
+ *  and every reply written.
+*/
+bool Connection::has_output()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return !m_output.empty();
+}
+
+bool Connection::failed()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_failed;
+}
+
+bool Connection::begin_request(unsigned int limit)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_in_flight >= limit)
+        return false;
+    m_in_flight++;
+    return true;
+}
+
+void Connection::end_request()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_in_flight--;
+}
+
+bool Connection::finished()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_failed || (input_closed && m_in_flight == 0 && m_output.empty());
+}
+
+
+/*
+* NAME
+*      Push, Pop, Close, Size -- the request queue
+*
+* SYNOPSYS
+*
+*      bool RequestQueue::push(ServerRequest&& request);
+*      bool RequestQueue::pop(ServerRequest& request);
+*      void RequestQueue::close();
+*      size_t RequestQueue::size();
+*
+* DESCRIPTION
+*
+*  Push never waits: when the queue holds its capacity it returns false and the reader refuses the request.
+ *  Pop waits for a request; after close it still hands out the queued ones and then returns false.
+*/
+bool RequestQueue::push(ServerRequest&& request)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_requests.size() >= m_capacity)
+        return false;
+    m_requests.push_back(std::move(request));
+    m_not_empty.notify_one();
+    return true;
+}
+
+bool RequestQueue::pop(ServerRequest& request)
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_not_empty.wait(lock, [this] { return !m_requests.empty() || m_closed; });
+    if (m_requests.empty())
+        return false;
+    request = std::move(m_requests.front());
+    m_requests.pop_front();
+    return true;
+}
+
+void RequestQueue::close()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_closed = true;
+    m_not_empty.notify_all();
+}
+
+size_t RequestQueue::size()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_requests.size();
+}
+
+
+/*
+* NAME
+*      LatencyStats -- creates empty statistics
+*
+* SYNOPSYS
+*
+*      LatencyStats::LatencyStats();
+*/
+LatencyStats::LatencyStats()
+{
+    m_requests = 0;
+    m_eval_probes = m_eval_hits = m_pawn_probes = m_pawn_hits = 0;
+    m_wait_ms = m_service_ms = m_max_ms = 0;
+    m_next = 0;
+    m_recent.reserve(recent_requests);
+}
+
+
+/*
+* NAME
+*      Add -- records an answered request
+*
+* SYNOPSYS
+*
+*      void LatencyStats::add(double wait_ms, double service_ms);
+*      wait_ms     ->  time from reading the request to a worker taking it
+*      service_ms  ->  time the worker took to search and reply
+*/
+void LatencyStats::add(double wait_ms, double service_ms)
+{
+    lock_guard<mutex> lock(m_mutex);
+    double total = wait_ms + service_ms;
+    m_requests++;
+    m_wait_ms += wait_ms;
+    m_service_ms += service_ms;
+    m_max_ms = std::max(m_max_ms, total);
+    if (m_recent.size() < recent_requests)
+        m_recent.push_back((float)total);
+    else
+        m_recent[m_next] = (float)total;
+    m_next = (m_next + 1) % recent_requests;
+}
+
+
+/*
+* NAME
+*      AddCaches -- records cache lookups
+*
+* SYNOPSYS
+*
+*      void LatencyStats::add_caches(uint64_t eval_probes, uint64_t eval_hits, uint64_t pawn_probes, uint64_t pawn_hits);
+*/
+void LatencyStats::add_caches(uint64_t eval_probes, uint64_t eval_hits, uint64_t pawn_probes, uint64_t pawn_hits)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_eval_probes += eval_probes;
+    m_eval_hits += eval_hits;
+    m_pawn_probes += pawn_probes;
+    m_pawn_hits += pawn_hits;
+}
+
+
+/*
+* NAME
+*      Report -- formats the statistics
+*
+* SYNOPSYS
+*
+*      string LatencyStats::report();
+*
+* DESCRIPTION
+*
+*  Means are over every request, percentiles of the latency from reading to replying over the last 4096 requests.
+ *  Hit rates are over every lookup; the pawn table is only used by the handcrafted evaluation.
+*/
+string LatencyStats::report()
+{
+    lock_guard<mutex> lock(m_mutex);
+    ostringstream out;
+    out << "requests=" << m_requests;
+    if (!m_requests)
+        return out.str();
+
+    vector<float> sorted = m_recent;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double fraction) { return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))]; };
+    out << fixed << setprecision(2)
+        << " mean_wait_ms=" << m_wait_ms / m_requests << " mean_service_ms=" << m_service_ms / m_requests
+        << " p50_ms=" << percentile(0.50) << " p90_ms=" << percentile(0.90) << " p99_ms=" << percentile(0.99)
+        << " max_ms=" << m_max_ms << setprecision(3)
+        << " eval_hit_rate=" << (m_eval_probes ? (double)m_eval_hits / m_eval_probes : 0.0)
+        << " pawn_hit_rate=" << (m_pawn_probes ? (double)m_pawn_hits / m_pawn_probes : 0.0);
+    return out.str();
+}
+
+
+/*
+* NAME
+*      ParseRequest -- reads a request line
+*
+* SYNOPSYS
+*
+*      bool parse_request(const string& line, ServerRequest& request, string& error);
+*      line        ->  "<fen> ; key=value ..."
+*      request     ->  receives the position, the limits and, if given, the id
+*      error       ->  receives the reason a line is rejected
+*
+* DESCRIPTION
+*
+*  The keys are depth, nodes, movetime, multipv and id. Without a depth, node or time limit the search
+ *  is as deep as SearchLimits' default.
+*/
+bool parse_request(const string& line, ServerRequest& request, string& error)
+{
+    size_t semicolon = line.find(';');
+    string fen = line.substr(0, semicolon);
+    fen.erase(fen.find_last_not_of(" \t") + 1);
+    if (!request.position.set_fen(fen))
+    {
+        error = "bad FEN";
+        return false;
+    }
+
+    request.limits = SearchLimits();
+    request.limits.depth = 0;
+    istringstream options(semicolon == string::npos ? string() : line.substr(semicolon + 1));
+    string option;
+    while (options >> option)
+    {
+        size_t equals = option.find('=');
+        string key = option.substr(0, equals);
+        string value = (equals == string::npos) ? string() : option.substr(equals + 1);
+        if (value.empty())
+        {
+            error = "bad option " + option;
+            return false;
+        }
+        if (key == "depth")
+            request.limits.depth = std::min(atoi(value.c_str()), MAX_SEARCH_DEPTH);
+        else if (key == "nodes")
+            request.limits.nodes = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "movetime")
+            request.limits.movetime_ms = atoi(value.c_str());
+        else if (key == "multipv")
+            request.limits.multi_pv = atoi(value.c_str());
+        else if (key == "id")
+            request.id = value;
+        else
+        {
+            error = "bad option " + option;
+            return false;
+        }
+    }
+    if (request.limits.depth <= 0 && !request.limits.nodes && !request.limits.movetime_ms)
+        request.limits.depth = SearchLimits().depth;
+    return true;
+}
+
+
+/*
+* NAME
+*      Server -- creates a server
+*
+* SYNOPSYS
+*
+*      Server::Server(int threads, size_t queue_capacity, size_t table_kilobytes);
+*      threads         ->  number of worker threads
+*      queue_capacity  ->  requests queued before new ones are refused
+*      table_kilobytes ->  size of the shared transposition table
+*/
+Server::Server(int threads, size_t queue_capacity, size_t table_kilobytes)
+    : m_table(table_kilobytes), m_queue(queue_capacity)
+{
+    m_listen_fd = -1;
+    m_threads = threads;
+    m_evaluation = EVAL_HANDCRAFTED;
+    m_network = nullptr;
+    m_hash_file = nullptr;
+    m_shutdown = false;
+    m_wake[0] = m_wake[1] = -1;
+}
+
+
+/*
+* NAME
+*      ~Server -- stops listening
+*
+* SYNOPSYS
+*
+*      Server::~Server();
+*
+* DESCRIPTION
+*
+*  Closes the listening socket and removes its file, and closes the wake pipe.
+*/
+Server::~Server()
+{
+    if (m_listen_fd >= 0)
+    {
+        close(m_listen_fd);
+        unlink(m_socket_path.c_str());
+    }
+    for (int fd : m_wake)
+        if (fd >= 0)
+            close(fd);
+}
+
+
+/*
+* NAME
+*      Open -- starts listening
+*
+* SYNOPSYS
+*
+*      bool Server::open(const string& socket_path);
+*
+* DESCRIPTION
+*
+*  A socket file left behind by a server that did not stop cleanly is removed first.
+ *  The wake pipe is made here too, non-blocking at both ends, so a worker never waits on a full pipe.
+*/
+bool Server::open(const string& socket_path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        cout << "Socket path too long: " << socket_path << endl;
+        return false;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+
+    if (pipe2(m_wake, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        cout << "Could not create a pipe: " << strerror(errno) << endl;
+        m_wake[0] = m_wake[1] = -1;
+        return false;
+    }
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0)
+    {
+        cout << "Could not create a socket: " << strerror(errno) << endl;
+        return false;
+    }
+    m_socket_path = socket_path;
+    unlink(socket_path.c_str());
+    if (bind(m_listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(m_listen_fd, 64) < 0)
+    {
+        cout << "Could not listen on " << socket_path << ": " << strerror(errno) << endl;
+        close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+
+/*
+* NAME
+*      Run -- serves requests
+*
+* SYNOPSYS
+*
+*      void Server::run();
+*
+* DESCRIPTION
+*
+*  This function starts the workers and polls the listening socket, the wake pipe and the connections, reading
+ *  what arrives and writing replies the sockets did not take at once. A connection is polled for reading until
+ *  the client closes its side, and for writing while it has output; finished connections are let go.
+ *  After a shutdown request the workers answer what is queued, their replies are written out, then the final
+ *  statistics are printed.
+*/
+void Server::run()
+{
+    TRACE_THREAD("server io");
+    vector<thread> workers;
+    for (int i = 0; i < m_threads; i++)
+        workers.emplace_back(&Server::worker, this);
+
+    vector<shared_ptr<Connection>> connections;
+    vector<pollfd> fds;
+    while (!m_shutdown)
+    {
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                         [](const shared_ptr<Connection>& connection) { return connection->finished(); }),
+                          connections.end());
+        fds.assign({ pollfd{ m_listen_fd, POLLIN, 0 }, pollfd{ m_wake[0], POLLIN, 0 } });
+        for (auto& connection : connections)
+        {
+            short events = (connection->input_closed ? 0 : POLLIN) | (connection->has_output() ? POLLOUT : 0);
+            fds.push_back(pollfd{ connection->fd(), events, 0 });
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            cout << "poll failed: " << strerror(errno) << endl;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            char data[256];
+            while (read(m_wake[0], data, sizeof(data)) > 0)
+                ;
+        }
+        for (size_t i = 0; i < connections.size() && !m_shutdown; i++)
+        {
+            Connection& connection = *connections[i];
+            short revents = fds[i + 2].revents;
+            if (revents & POLLOUT)
+                connection.flush();
+            if (!connection.input_closed && (revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                if (!read_connection(connections[i]))
+                {
+                    connection.input_closed = true;
+                    connection.buffer.clear();
+                }
+            }
+            else if (revents & (POLLHUP | POLLERR))
+                connection.drop();
+        }
+        if (!m_shutdown && (fds[0].revents & POLLIN))
+        {
+            int fd = accept(m_listen_fd, nullptr, nullptr);
+            if (fd >= 0)
+                connections.push_back(make_shared<Connection>(fd));
+        }
+    }
+
+    m_queue.close();
+    for (auto& worker : workers)
+        worker.join();
+    flush_connections(connections);
+    connections.clear();
+    cout << m_stats.report() << endl;
+}
+
+
+/*
+* NAME
+*      FlushConnections -- writes the replies left at shutdown
+*
+* SYNOPSYS
+*
+*      void Server::flush_connections(vector<shared_ptr<Connection>>& connections);
+*
+* DESCRIPTION
+*
+*  With the workers stopped, this function polls the connections that still have output until it is written,
+ *  giving up on all of them once shutdown_flush_ms pass without any socket taking more.
+*/
+void Server::flush_connections(vector<shared_ptr<Connection>>& connections)
+{
+    vector<pollfd> fds;
+    while (true)
+    {
+        fds.clear();
+        for (auto& connection : connections)
+            if (connection->has_output())
+                fds.push_back(pollfd{ connection->fd(), POLLOUT, 0 });
+        if (fds.empty())
+            return;
+        int ready = poll(fds.data(), fds.size(), shutdown_flush_ms);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            return;
+        for (auto& connection : connections)
+        {
+            auto found = std::find_if(fds.begin(), fds.end(), [&](const pollfd& fd) { return fd.fd == connection->fd(); });
+            if (found == fds.end())
+                continue;
+            if (found->revents & POLLOUT)
+                connection->flush();
+            else if (found->revents & (POLLHUP | POLLERR))
+                connection->drop();
+        }
+    }
+}
+
+
+/*
+* NAME
+*      ReadConnection -- reads from a client
+*
+* SYNOPSYS
+*
+*      bool Server::read_connection(const shared_ptr<Connection>& connection);
+*
+* DESCRIPTION
+*
+*  This function reads what the client sent and handles every full line. When the client closes its side,
+ *  a last line without a newline is handled too and false is returned. A line longer than 4096 bytes
+ *  gets an error and false is returned as well, so nothing more is read from that client.
+*/
+bool Server::read_connection(const shared_ptr<Connection>& connection)
+{
+    char data[4096];
+    ssize_t n = recv(connection->fd(), data, sizeof(data), MSG_DONTWAIT);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+    if (n > 0)
+        connection->buffer.append(data, n);
+    else
+        connection->buffer += '\n';
+
+    string& buffer = connection->buffer;
+    size_t start = 0, end;
+    while (!m_shutdown && (end = buffer.find('\n', start)) != string::npos)
+    {
+        string line = buffer.substr(start, end - start);
+        start = end + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            handle_line(connection, line);
+    }
+    buffer.erase(0, start);
+    if (buffer.size() > max_line_length)
+    {
+        connection->send("error line too long\n");
+        return false;
+    }
+    return n > 0;
+}
+
+
+/*
+* NAME
+*      HandleLine -- answers or queues one line
+*
+* SYNOPSYS
+*
+*      void Server::handle_line(const shared_ptr<Connection>& connection, const string& line);
+*
+* DESCRIPTION
+*
+*  Statistics and shutdown are answered by the reader at once. A request is numbered, parsed and queued;
+ *  a malformed one, one beyond the connection's max_requests_in_flight, or one finding the queue full
+ *  gets its error reply right away instead.
+*/
+void Server::handle_line(const shared_ptr<Connection>& connection, const string& line)
+{
+    if (line == "stats")
+    {
+        connection->send("stats queued=" + to_string(m_queue.size()) + " " + m_stats.report() + "\n");
+        return;
+    }
+    if (line == "shutdown")
+    {
+        connection->send("shutdown\n");
+        m_shutdown = true;
+        return;
+    }
+
+    ServerRequest request;
+    request.connection = connection;
+    request.id = to_string(++connection->requests);
+    request.received = chrono::steady_clock::now();
+    string error;
+    if (!parse_request(line, request, error))
+    {
+        connection->send(request.id + " error " + error + "\n");
+        return;
+    }
+    if (!connection->begin_request(max_requests_in_flight))
+    {
+        connection->send(request.id + " error too many requests in flight\n");
+        return;
+    }
+    string id = request.id;
+    if (!m_queue.push(std::move(request)))
+    {
+        connection->end_request();
+        connection->send(id + " error queue full\n");
+    }
+}
+
+
+/*
+* NAME
+*      Worker -- searches requests until the server stops
+*
+* SYNOPSYS
+*
+*      void Server::worker();
+*
+* DESCRIPTION
+*
+*  Each worker keeps one Search, with its own evaluation caches and the server's transposition table,
+ *  so results of earlier requests, of any worker, speed up the later ones. Requests of a client that has
+ *  failed are not searched. After every request the worker wakes the reader, which may have output to write
+ *  or a finished connection to let go.
+*/
+void Server::worker()
+{
+    TRACE_THREAD("server worker");
+    Search search;
+    search.set_evaluation(m_evaluation, m_network);
+    search.share_table(&m_table);
+    search.set_hash_file(m_hash_file);
+
+    ServerRequest request;
+    uint64_t eval_probes = 0, eval_hits = 0, pawn_probes = 0, pawn_hits = 0;
+    while (m_queue.pop(request))
+    {
+        if (request.connection->failed())
+        {
+            request.connection->end_request();
+            request.connection.reset();
+            wake();
+            continue;
+        }
+
+        auto started = chrono::steady_clock::now();
+        SearchResult result = search.smart_guy(request.position, request.limits);
+
+        string reply;
+        for (size_t i = 0; i < result.lines.size(); i++)
+        {
+            const PvLine& line = result.lines[i];
+            reply += request.id + " line " + to_string(i + 1) + " " + to_string(line.score) + " " + to_string(line.depth);
+            for (Move m : line.pv)
+                reply += " " + move_to_uci(m);
+            reply += "\n";
+        }
+        reply += request.id + " done " + (result.best_move == MOVE_NONE ? string("none") : move_to_uci(result.best_move))
+               + " " + to_string(result.nodes) + " " + to_string(result.time_ms) + "\n";
+        request.connection->send(reply);
+        request.connection->end_request();
+        request.connection.reset();
+        wake();
+
+        auto finished = chrono::steady_clock::now();
+        m_stats.add(chrono::duration<double, milli>(started - request.received).count(),
+                    chrono::duration<double, milli>(finished - started).count());
+        // the search's counters run on from request to request, the statistics take what this one added
+        const EvalCache& cache = search.eval_cache();
+        const PawnTable& pawns = search.pawn_table();
+        m_stats.add_caches(cache.hits() + cache.misses() - eval_probes, cache.hits() - eval_hits,
+                           pawns.probes() - pawn_probes, pawns.hits() - pawn_hits);
+        eval_probes = cache.hits() + cache.misses();
+        eval_hits = cache.hits();
+        pawn_probes = pawns.probes();
+        pawn_hits = pawns.hits();
+    }
+}
+
+
+/*
+* NAME
+*      Wake -- makes the reader poll again
+*
+* SYNOPSYS
+*
+*      void Server::wake();
+*
+* DESCRIPTION
+*
+*  Writes a byte to the wake pipe. A full pipe already wakes the reader, so a failed write is ignored.
+*/
+void Server::wake()
+{
+    char byte = 0;
+    ssize_t written = write(m_wake[1], &byte, 1);
+    (void)written;
+}
+
+
+/*
+* NAME
+*      ServerCommand -- runs the analysis server
+*
+* SYNOPSYS
+*
+*      int server_command(int argc, char* argv[]);
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -socket <path>      socket to listen on, /tmp/chessai.sock by default
+ *     -threads <n>        worker threads, one per core by default
+ *     -queue <n>          requests queued before new ones are refused, 64 by default
+ *     -hash <mb>          shared transposition table size, 64 MB by default
+ *     -nnue <file>        evaluate with the network
+ *     -hashfile <file>    keep deep results in a persistent hash file, created if missing
+ *     -hashsize <mb>      size of the slots of a new hash file, 32 MB by default
+*/
+int server_command(int argc, char* argv[])
+{
+    string socket_path = "/tmp/chessai.sock", network_filename, hash_filename;
+    int threads = std::max(1, (int)thread::hardware_concurrency());
+    size_t queue_capacity = 64, hash_mb = 64, hash_file_mb = DEFAULT_HASH_FILE_MEGABYTES;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        string option = argv[i], value = argv[i + 1];
+        if (option == "-socket")
+            socket_path = value;
+        else if (option == "-threads")
+            threads = std::max(1, atoi(value.c_str()));
+        else if (option == "-queue")
+            queue_capacity = std::max(1, atoi(value.c_str()));
+        else if (option == "-hash")
+            hash_mb = std::max(1, atoi(value.c_str()));
+        else if (option == "-nnue")
+            network_filename = value;
+        else if (option == "-hashfile")
+            hash_filename = value;
+        else if (option == "-hashsize")
+            hash_file_mb = std::max(1, atoi(value.c_str()));
+        else
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+
+    Network network;
+    HashFile hash_file;
+    Server server(threads, queue_capacity, hash_mb * 1024);
+    if (!network_filename.empty())
+    {
+        if (!network.load(network_filename))
+            return 1;
+        server.set_evaluation(EVAL_NNUE, &network);
+    }
+    if (!hash_filename.empty())
+    {
+        if (!hash_file.open(hash_filename, hash_file_mb))
+            return 1;
+        server.set_hash_file(&hash_file);
+    }
+    if (!server.open(socket_path))
+        return 1;
+    cout << "Listening on " << socket_path << " with " << threads << " threads" << endl;
+    server.run();
+    return 0;
+}
+
+
+/*
+* NAME
+*      ClientCommand -- sends requests to a server and prints the replies
+*
+* SYNOPSYS
+*
+*      int client_command(int argc, char* argv[]);
+*      argv        ->  the socket, then -repeat <n> to send the requests n times
+*
+* DESCRIPTION
+*
+*  A stand-in for the tools using the server: it sends the request lines read from the standard input
+ *  while a second thread prints the replies, and ends when the server has answered everything and closed
+ *  the connection. At most client_window requests are left unanswered at a time, which keeps a long
+ *  -repeat run below the server's limit of requests in flight.
+*/
+int client_command(int argc, char* argv[])
+{
+    if (argc < 1)
+    {
+        cout << "usage: ChessAI client <socket> [-repeat <n>]" << endl;
+        return 1;
+    }
+    int repeat = (argc >= 3 && string(argv[1]) == "-repeat") ? std::max(1, atoi(argv[2])) : 1;
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, argv[0], sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        cout << "Could not connect to " << argv[0] << ": " << strerror(errno) << endl;
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    vector<string> lines;
+    string line;
+    while (getline(cin, line))
+        if (!line.empty())
+            lines.push_back(line + "\n");
+
+    auto start = chrono::steady_clock::now();
+    size_t replies = 0, answered = 0;
+    bool closed = false;
+    mutex answered_mutex;
+    condition_variable answered_more;
+    thread reader([&] {
+        char data[4096];
+        string partial;
+        ssize_t n;
+        while ((n = recv(fd, data, sizeof(data), 0)) > 0)
+        {
+            replies += std::count(data, data + n, '\n');
+            cout.write(data, n);
+            // a request is answered by its done or error line, stats and shutdown by their one line
+            partial.append(data, n);
+            size_t begin = 0, end, count = 0;
+            while ((end = partial.find('\n', begin)) != string::npos)
+            {
+                istringstream reply(partial.substr(begin, end - begin));
+                begin = end + 1;
+                string first, second;
+                reply >> first >> second;
+                if (second == "done" || second == "error" || first == "stats" || first == "shutdown")
+                    count++;
+            }
+            partial.erase(0, begin);
+            lock_guard<mutex> lock(answered_mutex);
+            answered += count;
+            answered_more.notify_one();
+        }
+        cout.flush();
+        lock_guard<mutex> lock(answered_mutex);
+        closed = true;
+        answered_more.notify_one();
+    });
+    size_t sent = 0;
+    bool sending = true;
+    for (int round = 0; round < repeat && sending; round++)
+    {
+        for (size_t i = 0; i < lines.size() && sending; i++)
+        {
+            {
+                unique_lock<mutex> lock(answered_mutex);
+                answered_more.wait(lock, [&] { return closed || sent - answered < client_window; });
+                sending = !closed;
+            }
+            if (sending && send(fd, lines[i].data(), lines[i].size(), MSG_NOSIGNAL) != (ssize_t)lines[i].size())
+                sending = false;
+            sent++;
+        }
+    }
+    shutdown(fd, SHUT_WR);
+    reader.join();
+    close(fd);
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << lines.size() * repeat << " requests, " << replies << " reply lines in " << (long long)ms << " ms" << endl;
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+Server class
+-- Long-running analysis service on a Unix domain socket, so tools need not start a process per request.
+-- A request is a line "<fen> ; depth=<n> nodes=<n> movetime=<ms> multipv=<k> id=<token>", every key optional;
+   without limits the search goes 4 plies deep, and without an id the request is numbered within its connection.
+-- The reply lines start with the request's id: "<id> line <k> <score> <depth> <uci moves>" for every line found,
+   then "<id> done <best move> <nodes> <ms>", or "<id> error <message>" instead.
+-- "stats" is answered at once with the latency statistics and the hit rates of the workers' evaluation caches,
+   "shutdown" stops the server after the queued requests.
+-- One thread reads the connections and queues the requests; a fixed pool of workers searches them,
+   every worker with its own Search and all of them sharing one transposition table.
+-- Nothing waits on a client: replies are written without blocking, what the socket does not take is kept per
+   connection and written by the reader when there is room, and a client that lets too much pile up is dropped.
+-- The queue is bounded and so are the requests of one connection in flight: beyond either limit a request
+   gets an error reply at once.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Position.h"
+#include "Search.h"
+
+using namespace std;
+
+// One client connection, kept by the reader until the client has closed its side and every reply is written
+class Connection
+{
+private:
+    int m_fd;
+    mutex m_mutex;                          // guards the members below, keeps the replies of different workers apart
+    string m_output;                        // reply bytes the socket has not taken yet
+    unsigned int m_in_flight;               // requests queued or being searched
+    bool m_failed;                          // the client went away or stopped reading its replies
+
+    // Write what the socket takes of the output without waiting, with m_mutex held
+    void write_output();
+
+public:
+    string buffer;                          // bytes read that do not make a full line yet
+    unsigned int requests;                  // requests read, numbering those without an id
+    bool input_closed;                      // the client closed its side or was cut off, only the reader reads on
+
+    Connection(int fd) : m_fd(fd), m_in_flight(0), m_failed(false), requests(0), input_closed(false) {}
+    ~Connection();
+
+    int fd() const { return m_fd; }
+
+    // Add one or more full lines to the output and write what the socket takes; returns false if the client is gone
+    bool send(const string& text);
+
+    // Write more of the output once the socket has room; returns false if the client is gone
+    bool flush();
+
+    // Give up on the client, dropping its unwritten replies
+    void drop();
+
+    bool has_output();
+    bool failed();
+
+    // Count a request in, false if the client already has limit requests in flight / count it out
+    bool begin_request(unsigned int limit);
+    void end_request();
+
+    // Check if the reader can let go: the client failed, or closed its side and has every reply
+    bool finished();
+};
+
+struct ServerRequest
+{
+    shared_ptr<Connection> connection;      // where the reply goes
+    string id;                              // starts every reply line
+    Position position;
+    SearchLimits limits;
+    chrono::steady_clock::time_point received;
+};
+
+// Bounded queue of requests between the reader and the workers
+class RequestQueue
+{
+private:
+    deque<ServerRequest> m_requests;
+    size_t m_capacity;
+    bool m_closed;                          // no more requests, workers stop once the queue is empty
+    mutex m_mutex;
+    condition_variable m_not_empty;
+
+public:
+    RequestQueue(size_t capacity) : m_capacity(capacity), m_closed(false) {}
+
+    // Add a request; returns false, leaving the request alone, if the queue is full
+    bool push(ServerRequest&& request);
+
+    // Take the oldest request, waiting while the queue is empty; returns false once it is closed and empty
+    bool pop(ServerRequest& request);
+
+    void close();
+    size_t size();
+};
+
+// Time requests spent queued and searched, and how often the workers' evaluation caches hit
+class LatencyStats
+{
+private:
+    mutex m_mutex;
+    uint64_t m_requests;
+    uint64_t m_eval_probes, m_eval_hits;    // evaluation cache lookups of every worker
+    uint64_t m_pawn_probes, m_pawn_hits;    // pawn table lookups of every worker
+    double m_wait_ms;                       // total time in the queue
+    double m_service_ms;                    // total time searching
+    double m_max_ms;                        // longest time from reading to replying
+    vector<float> m_recent;                 // time from reading to replying of the last requests, a ring
+    size_t m_next;                          // slot of m_recent for the next request
+
+public:
+    LatencyStats();
+
+    void add(double wait_ms, double service_ms);
+
+    // Count the lookups of a worker's evaluation cache and pawn table since its last call
+    void add_caches(uint64_t eval_probes, uint64_t eval_hits, uint64_t pawn_probes, uint64_t pawn_hits);
+
+    // "requests=... mean_wait_ms=... mean_service_ms=... p50_ms=... p90_ms=... p99_ms=... max_ms=...
+    // eval_hit_rate=... pawn_hit_rate=..."
+    string report();
+};
+
+class Server
+{
+private:
+    string m_socket_path;
+    int m_listen_fd;
+    int m_threads;                          // number of workers
+    TranspositionTable m_table;             // shared by every worker's search
+    EvalKind m_evaluation;
+    const Network* m_network;
+    HashFile* m_hash_file;                  // persistent results shared by the workers, nullptr if none
+    RequestQueue m_queue;
+    LatencyStats m_stats;
+    bool m_shutdown;                        // a client asked to stop
+    int m_wake[2];                          // pipe the workers write to so the reader polls again after a reply
+
+    // Worker thread: searches queued requests until the queue is closed
+    void worker();
+
+    // Wake the reader from its poll
+    void wake();
+
+    // Read what the client sent, queueing the full lines; returns false once the client closed its side
+    // or has to be cut off
+    bool read_connection(const shared_ptr<Connection>& connection);
+
+    // Write the replies left after the workers stopped, giving up on clients that take none for a while
+    void flush_connections(vector<shared_ptr<Connection>>& connections);
+
+    // Answer stats or shutdown, or parse a request and queue it
+    void handle_line(const shared_ptr<Connection>& connection, const string& line);
+
+public:
+    Server(int threads, size_t queue_capacity, size_t table_kilobytes);
+    ~Server();
+
+    // Select the evaluation of the workers' searches
+    void set_evaluation(EvalKind kind, const Network* network) { m_evaluation = kind; m_network = network; }
+
+    // Have the workers' searches use a persistent hash file
+    void set_hash_file(HashFile* file) { m_hash_file = file; }
+
+    // Listen on the socket, replacing a stale socket file; returns false if that fails
+    bool open(const string& socket_path);
+
+    // Serve until a client asks for shutdown, then answer the queued requests and stop the workers
+    void run();
+};
+
+// Parse a request line into the request's position, limits and id; returns false with a message if it is malformed
+bool parse_request(const string& line, ServerRequest& request, string& error);
+
+// Command line entry points: ChessAI server [options], ChessAI client <socket> [options]
+int server_command(int argc, char* argv[]);
+int client_command(int argc, char* argv[]);
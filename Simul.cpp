@@ -0,0 +1,598 @@
+#include "Simul.h"
+#include "Difficulty.h"
+#include "Nnue.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// Time between frames, about 60 a second
+static const chrono::milliseconds frame_time(16);
+
+// Same colors as Square
+static const sf::Color light_color(205, 133, 63);
+static const sf::Color dark_color(101, 67, 33);
+static const sf::Color valid_color(173, 216, 230);
+static const sf::Color last_move_color(186, 202, 68);
+
+
+/*
+* NAME
+*      Simul -- sets up the games and opens the windows
+*
+* SYNOPSYS
+*
+*      Simul::Simul(EnginePool& pool, int boards, bool grid, Color human, bool alternate, int minutes,
+*                   int increment_seconds, int level, uint64_t seed);
+*      pool        ->  the engine threads, shared by every game
+*      grid        ->  all the boards in one window, otherwise a window for each
+*
+* DESCRIPTION
+*
+*  The grid is as square as it can be and sized to fit the desktop. Separate windows are sized so four fit side by
+ *  side and are placed in rows across the desktop. The first engine moves are submitted at once.
+*/
+Simul::Simul(EnginePool& pool, int boards, bool grid, Color human, bool alternate, int minutes, int increment_seconds,
+             int level, uint64_t seed)
+    : m_pool(pool)
+{
+    m_level = level;
+    m_seed = seed;
+    m_increment_ms = increment_seconds * 1000;
+    boards = std::max(boards, 1);
+
+    unsigned int width = sf::VideoMode::getDesktopMode().width;
+    unsigned int height = sf::VideoMode::getDesktopMode().height;
+    int columns = grid ? (int)ceil(sqrt((double)boards)) : std::min(boards, 4);
+    int rows = grid ? (boards + columns - 1) / columns : 1;
+    m_square = std::max(8u, std::min(width * 9 / 10 / (8 * columns), height * 85 / 100 / (9 * rows)));
+
+    {
+        TRACE_SCOPE("load", "texture");
+        static const char* const colors[2] = { "white", "black" };
+        static const char* const types[7] = { "", "pawn", "knight", "bishop", "rook", "queen", "king" };
+        for (int c = WHITE; c <= BLACK; c++)
+        {
+            for (int t = PAWN; t <= KING; t++)
+            {
+                uint8_t code = make_piece((Color)c, (PieceType)t);
+                string filename = string(colors[c]) + "_" + types[t] + ".png";
+                if (!m_textures[code].loadFromFile(filename))
+                    cout << "Error loading " << filename << endl;
+                m_pieces[code].setTexture(m_textures[code]);
+                m_pieces[code].setScale(m_square * 0.45f / m_pieces[code].getLocalBounds().width,
+                                        m_square * 0.45f / m_pieces[code].getLocalBounds().height);
+            }
+        }
+    }
+    {
+        TRACE_SCOPE("load", "font");
+        if (!m_font.loadFromFile("Arial Unicode.ttf"))
+            cout << "Could not load font." << endl;
+    }
+    m_text.setFont(m_font);
+    m_text.setCharacterSize(m_square / 4);
+    m_text.setFillColor(sf::Color::White);
+    m_square_shape.setSize(sf::Vector2f((float)m_square, (float)m_square));
+
+    auto now = chrono::steady_clock::now();
+    m_games.resize(boards);
+    for (int i = 0; i < boards; i++)
+    {
+        SimulGame& game = m_games[i];
+        game.position.set_start();
+        game.history.assign(1, game.position.key());
+        game.human = (alternate && i % 2) ? (Color)(1 - human) : human;
+        game.clock_ms[WHITE] = game.clock_ms[BLACK] = minutes * 60000;
+        game.turn_start = now;
+        game.thinking = false;
+        game.selected = -1;
+        game.last_move = MOVE_NONE;
+        game.view = grid ? 0 : i;
+        game.cell = grid ? i : 0;
+    }
+
+    int views = grid ? 1 : boards;
+    m_views.resize(views);
+    for (int v = 0; v < views; v++)
+    {
+        SimulView& view = m_views[v];
+        view.columns = grid ? columns : 1;
+        for (int i = 0; i < boards; i++)
+            if (m_games[i].view == v)
+                view.games.push_back(i);
+        int cells = (int)view.games.size();
+        int view_rows = (cells + view.columns - 1) / view.columns;
+        string title = grid ? string("Simul") : "Simul board " + to_string(v + 1);
+        view.window.reset(new sf::RenderWindow(sf::VideoMode(8 * m_square * view.columns, 9 * m_square * view_rows), title,
+                                               sf::Style::Close | sf::Style::Resize));
+        if (!grid)
+        {
+            // rows of windows go down the desktop, those that do not fit stay at its bottom
+            int top = std::max(0, std::min((v / columns) * 9 * (int)m_square, (int)height - 9 * (int)m_square));
+            view.window->setPosition(sf::Vector2i((v % columns) * 8 * m_square, top));
+        }
+    }
+
+    for (int i = 0; i < boards; i++)
+        start_turn(i);
+}
+
+
+/*
+* NAME
+*      TimeLeft -- returns a side's clock
+*
+* SYNOPSYS
+*
+*      int Simul::time_left(const SimulGame& game, Color side) const;
+*
+* DESCRIPTION
+*
+*  Milliseconds, negative once the flag has fallen. The clocks stop when the game is over.
+*/
+int Simul::time_left(const SimulGame& game, Color side) const
+{
+    int left = game.clock_ms[side];
+    if (side == game.position.side_to_move() && game.result.empty())
+        left -= (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - game.turn_start).count();
+    return left;
+}
+
+
+/*
+* NAME
+*      CheckOver -- ends a game that can go no further
+*
+* SYNOPSYS
+*
+*      bool Simul::check_over(SimulGame& game);
+*
+* DESCRIPTION
+*
+*  The rules are those of SelfPlay: checkmate wins, stalemate, the fifty-move rule, threefold repetition
+ *  and bare kings draw.
+*/
+bool Simul::check_over(SimulGame& game)
+{
+    if (!game.result.empty())
+        return true;
+    MoveList legal;
+    game.position.get_all_valids(legal);
+    if (legal.empty())
+    {
+        if (game.position.in_check())
+            game.result = (game.position.side_to_move() == WHITE) ? "0-1 checkmate" : "1-0 checkmate";
+        else
+            game.result = "1/2-1/2 stalemate";
+    }
+    else if (game.position.halfmove() >= 100)
+        game.result = "1/2-1/2 fifty moves";
+    else if (count_repetitions(game.history, game.position.halfmove()) >= 3)
+        game.result = "1/2-1/2 repetition";
+    else if (game.position.count_pieces() == 2)
+        game.result = "1/2-1/2 insufficient material";
+    return !game.result.empty();
+}
+
+
+/*
+* NAME
+*      StartTurn -- asks the pool for the engine's move
+*
+* SYNOPSYS
+*
+*      void Simul::start_turn(int index);
+*
+* DESCRIPTION
+*
+*  The job searches with the level's limits; its deadline is when the engine's clock would run out,
+ *  which orders it among the other games' jobs and caps its search time, see EnginePool.
+*/
+void Simul::start_turn(int index)
+{
+    SimulGame& game = m_games[index];
+    if (check_over(game) || game.position.side_to_move() == game.human || game.thinking)
+        return;
+
+    EngineJob job;
+    job.game = index;
+    job.position = game.position;
+    job.history = game.history;
+    job.limits = level_limits(m_level);
+    job.level = m_level;
+    job.seed = m_seed + index;
+    job.deadline = game.turn_start + chrono::milliseconds(game.clock_ms[game.position.side_to_move()]);
+    game.thinking = true;
+    m_pool.submit(std::move(job));
+}
+
+
+/*
+* NAME
+*      Play -- plays a move and switches the clocks
+*
+* SYNOPSYS
+*
+*      void Simul::play(int index, Move m);
+*      m           ->  a legal move of the side to move
+*/
+void Simul::play(int index, Move m)
+{
+    SimulGame& game = m_games[index];
+    auto now = chrono::steady_clock::now();
+    Color side = game.position.side_to_move();
+    game.clock_ms[side] -= (int)chrono::duration_cast<chrono::milliseconds>(now - game.turn_start).count();
+    game.clock_ms[side] += m_increment_ms;
+    game.turn_start = now;
+
+    Undo undo;
+    game.position.make_move(m, undo);
+    game.history.push_back(game.position.key());
+    game.last_move = m;
+    game.selected = -1;
+
+    if (check_over(game))
+        cout << "board " << index + 1 << ": " << game.result << endl;
+    else
+        start_turn(index);
+}
+
+
+/*
+* NAME
+*      ApplyReplies -- plays the engine's finished moves
+*
+* SYNOPSYS
+*
+*      void Simul::apply_replies();
+*
+* DESCRIPTION
+*
+*  Replies for games that ended meanwhile, on time or by closing their window, are dropped.
+*/
+void Simul::apply_replies()
+{
+    vector<EngineReply> replies;
+    m_pool.collect(replies);
+    for (const EngineReply& reply : replies)
+    {
+        SimulGame& game = m_games[reply.game];
+        game.thinking = false;
+        if (!game.result.empty() || game.position.key() != reply.key)
+            continue;
+        MoveList legal;
+        game.position.get_all_valids(legal);
+        if (std::find(legal.begin(), legal.end(), reply.move) != legal.end())
+            play(reply.game, reply.move);
+    }
+}
+
+
+/*
+* NAME
+*      CheckFlags -- ends the games lost on time
+*
+* SYNOPSYS
+*
+*      void Simul::check_flags();
+*/
+void Simul::check_flags()
+{
+    for (size_t i = 0; i < m_games.size(); i++)
+    {
+        SimulGame& game = m_games[i];
+        if (!game.result.empty() || time_left(game, game.position.side_to_move()) > 0)
+            continue;
+        Color side = game.position.side_to_move();
+        game.clock_ms[side] = 0;
+        game.result = (side == WHITE) ? "0-1 time" : "1-0 time";
+        cout << "board " << i + 1 << ": " << game.result << endl;
+    }
+}
+
+
+/*
+* NAME
+*      Click -- handles a mouse click on a board
+*
+* SYNOPSYS
+*
+*      void Simul::click(int view, int x, int y);
+*      x, y        ->  pixel of the window clicked
+*
+* DESCRIPTION
+*
+*  The pixel is mapped through the window's view, so the boards stay clickable after resizing.
+ *  Clicks on a game that is over or waiting for the engine, or on the status line under a board, do nothing.
+*/
+void Simul::click(int view, int x, int y)
+{
+    SimulView& simul_view = m_views[view];
+    sf::Vector2f point = simul_view.window->mapPixelToCoords(sf::Vector2i(x, y));
+    if (point.x < 0 || point.y < 0)
+        return;
+    int column = (int)point.x / (8 * m_square), row = (int)point.y / (9 * m_square);
+    size_t cell = (size_t)(row * simul_view.columns + column);
+    if (column >= simul_view.columns || cell >= simul_view.games.size())
+        return;
+    int index = simul_view.games[cell];
+    SimulGame& game = m_games[index];
+    if (!game.result.empty() || game.position.side_to_move() != game.human)
+        return;
+
+    int file = ((int)point.x % (8 * m_square)) / m_square;
+    int rank = ((int)point.y % (9 * m_square)) / m_square;
+    if (rank >= 8)
+        return;
+    int square = (game.human == WHITE) ? make_square(7 - rank, file) : make_square(rank, 7 - file);
+
+    if (game.selected >= 0)
+    {
+        MoveList moves;
+        game.position.get_valid_moves(game.selected, moves);
+        Move chosen = MOVE_NONE;
+        for (Move m : moves)
+            if (move_to(m) == square && (chosen == MOVE_NONE || move_promotion(m) == QUEEN))
+                chosen = m;
+        if (chosen != MOVE_NONE)
+        {
+            play(index, chosen);
+            return;
+        }
+    }
+    uint8_t piece = game.position.piece_on(square);
+    game.selected = (piece != NO_PIECE && color_of(piece) == game.human && square != game.selected) ? square : -1;
+}
+
+
+/*
+* NAME
+*      Draw -- draws the games of a window
+*
+* SYNOPSYS
+*
+*      void Simul::draw(SimulView& view);
+*
+* DESCRIPTION
+*
+*  Every cell is the board, the human's side at the bottom, and a status line under it with the board number,
+ *  both clocks and whether the engine is thinking, or the result. The last move is highlighted, and the piece
+ *  the human picked up with its legal moves.
+*/
+void Simul::draw(SimulView& view)
+{
+    sf::RenderWindow& window = *view.window;
+    window.clear(sf::Color(40, 40, 40));
+    for (size_t cell = 0; cell < view.games.size(); cell++)
+    {
+        int index = view.games[cell];
+        const SimulGame& game = m_games[index];
+        float x0 = (float)((int)cell % view.columns * 8 * m_square), y0 = (float)((int)cell / view.columns * 9 * m_square);
+
+        Bitboard targets = 0;
+        if (game.selected >= 0)
+        {
+            MoveList moves;
+            game.position.get_valid_moves(game.selected, moves);
+            for (Move m : moves)
+                targets |= square_bb(move_to(m));
+        }
+
+        for (int rank = 0; rank < 8; rank++)
+        {
+            for (int file = 0; file < 8; file++)
+            {
+                int square = (game.human == WHITE) ? make_square(7 - rank, file) : make_square(rank, 7 - file);
+                float x = x0 + file * m_square, y = y0 + rank * m_square;
+                if (square == game.selected || (targets & square_bb(square)))
+                    m_square_shape.setFillColor(valid_color);
+                else if (game.last_move != MOVE_NONE && (square == move_from(game.last_move) || square == move_to(game.last_move)))
+                    m_square_shape.setFillColor(last_move_color);
+                else
+                    m_square_shape.setFillColor((row_of(square) + col_of(square)) % 2 == 0 ? dark_color : light_color);
+                m_square_shape.setPosition(x, y);
+                window.draw(m_square_shape);
+
+                uint8_t piece = game.position.piece_on(square);
+                if (piece != NO_PIECE)
+                {
+                    m_pieces[piece].setPosition(x + m_square / 4, y + m_square / 4);
+                    window.draw(m_pieces[piece]);
+                }
+            }
+        }
+
+        auto clock = [](int ms)
+        {
+            int seconds = std::max(ms, 0) / 1000;
+            string text = to_string(seconds / 60) + ":" + (seconds % 60 < 10 ? "0" : "") + to_string(seconds % 60);
+            return text;
+        };
+        Color engine = (Color)(1 - game.human);
+        string status = "Board " + to_string(index + 1) + "   you " + clock(time_left(game, game.human))
+                      + "   engine " + clock(time_left(game, engine)) + "\n";
+        if (!game.result.empty())
+            status += game.result;
+        else if (game.position.side_to_move() == game.human)
+            status += "your move";
+        else
+            status += game.thinking ? "engine thinking" : "engine to move";
+        m_text.setString(status);
+        m_text.setPosition(x0 + m_square / 8, y0 + 8 * m_square + m_square / 16);
+        window.draw(m_text);
+    }
+    window.display();
+}
+
+
+/*
+* NAME
+*      Score -- formats the engine's score
+*
+* SYNOPSYS
+*
+*      string Simul::score() const;
+*/
+string Simul::score() const
+{
+    int wins = 0, draws = 0, losses = 0;
+    for (const SimulGame& game : m_games)
+    {
+        if (game.result.empty() || game.result[0] == '*')
+            continue;
+        if (game.result.compare(0, 7, "1/2-1/2") == 0)
+            draws++;
+        else if ((game.result[0] == '1') == (game.human == BLACK))
+            wins++;
+        else
+            losses++;
+    }
+    return "Simul: engine +" + to_string(wins) + " =" + to_string(draws) + " -" + to_string(losses);
+}
+
+
+/*
+* NAME
+*      Run -- plays the simul
+*
+* SYNOPSYS
+*
+*      void Simul::run();
+*
+* DESCRIPTION
+*
+*  Every frame polls the events of all windows, applies the engine's finished moves, checks the flags and redraws,
+ *  then sleeps out the rest of the frame; nothing in it waits on a search. Closing a window abandons its
+ *  unfinished games, and the simul ends when the last window is closed.
+*/
+void Simul::run()
+{
+    string title;
+    for (;;)
+    {
+        TRACE_SCOPE("gui", "frame");
+        auto frame_start = chrono::steady_clock::now();
+        bool open = false;
+        for (size_t v = 0; v < m_views.size(); v++)
+        {
+            SimulView& view = m_views[v];
+            if (!view.window->isOpen())
+                continue;
+            sf::Event event;
+            while (view.window->pollEvent(event))
+            {
+                if (event.type == sf::Event::Closed)
+                {
+                    view.window->close();
+                    for (int index : view.games)
+                        if (m_games[index].result.empty())
+                            m_games[index].result = "* abandoned";
+                }
+                else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left)
+                    click((int)v, event.mouseButton.x, event.mouseButton.y);
+            }
+            open = open || view.window->isOpen();
+        }
+        if (!open)
+            break;
+
+        apply_replies();
+        check_flags();
+        string current = score();
+        for (SimulView& view : m_views)
+        {
+            if (!view.window->isOpen())
+                continue;
+            if (current != title)
+                view.window->setTitle(current);
+            draw(view);
+        }
+        title = current;
+        this_thread::sleep_until(frame_start + frame_time);
+    }
+
+    for (size_t i = 0; i < m_games.size(); i++)
+        cout << "board " << i + 1 << " (human " << (m_games[i].human == WHITE ? "white" : "black") << "): "
+             << (m_games[i].result.empty() ? string("* unfinished") : m_games[i].result) << endl;
+    cout << score() << endl;
+    cout << "pool: " << m_pool.report() << endl;
+}
+
+
+/*
+* NAME
+*      SimulCommand -- runs a simul against the engine
+*
+* SYNOPSYS
+*
+*      int simul_command(int argc, char* argv[]);
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -boards <n>                 games played at once, 4 by default
+ *     -layout grid|windows        all boards in one window, the default, or a window for each
+ *     -human white|black|alternate    the humans' side, alternate by default: white on board 1, black on board 2...
+ *     -minutes <n>                clock of each side, 10 by default
+ *     -increment <s>              seconds added after each move, 5 by default
+ *     -level <1-8>                the engine's difficulty level, 5 by default
+ *     -seed <n>                   seed of the level's move picks, the time by default
+ *     -threads <n>                engine threads shared by the games, one less than the cores by default
+ *     -hash <mb>                  shared transposition table size, 64 MB by default
+ *     -nnue <file>                evaluate with the network
+ *  One core is left to the windows by default so they stay responsive while every game thinks.
+*/
+int simul_command(int argc, char* argv[])
+{
+    int boards = 4, minutes = 10, increment = 5, level = DEFAULT_DIFFICULTY_LEVEL;
+    int threads = std::max(1, (int)thread::hardware_concurrency() - 1);
+    size_t hash_mb = 64;
+    bool grid = true, alternate = true;
+    Color human = WHITE;
+    uint64_t seed = (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+    string network_filename;
+    for (int i = 0; i < argc; i += 2)
+    {
+        string option = argv[i], value = (i + 1 < argc) ? argv[i + 1] : "";
+        if (option == "-boards" && i + 1 < argc)
+            boards = std::max(1, atoi(value.c_str()));
+        else if (option == "-layout" && (value == "grid" || value == "windows"))
+            grid = (value == "grid");
+        else if (option == "-human" && (value == "white" || value == "black" || value == "alternate"))
+        {
+            alternate = (value == "alternate");
+            human = (value == "black") ? BLACK : WHITE;
+        }
+        else if (option == "-minutes" && i + 1 < argc)
+            minutes = std::max(1, atoi(value.c_str()));
+        else if (option == "-increment" && i + 1 < argc)
+            increment = std::max(0, atoi(value.c_str()));
+        else if (option == "-level" && i + 1 < argc)
+            level = std::min(std::max(atoi(value.c_str()), 1), DIFFICULTY_LEVELS);
+        else if (option == "-seed" && i + 1 < argc)
+            seed = strtoull(value.c_str(), nullptr, 10);
+        else if (option == "-threads" && i + 1 < argc)
+            threads = std::max(1, atoi(value.c_str()));
+        else if (option == "-hash" && i + 1 < argc)
+            hash_mb = std::max(1, atoi(value.c_str()));
+        else if (option == "-nnue" && i + 1 < argc)
+            network_filename = value;
+        else
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+
+    Network network;
+    if (!network_filename.empty() && !network.load(network_filename))
+        return 1;
+    EnginePool pool(threads, hash_mb * 1024, network.is_loaded() ? EVAL_NNUE : EVAL_HANDCRAFTED,
+                    network.is_loaded() ? &network : nullptr);
+    Simul simul(pool, boards, grid, human, alternate, minutes, increment, level, seed);
+    simul.run();
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+Simul class
+-- A simultaneous exhibition: the engine plays many games at once against one or more humans, every game with its
+   own chess clock. The boards are laid out in a grid in one window, or one board to a window so several people
+   can each take a window.
+-- The engine's moves come from an EnginePool, whose threads are shared by every game and serve first the game whose
+   engine clock runs out soonest. The GUI thread only submits jobs and collects replies, so the boards keep redrawing
+   and taking clicks while the engine thinks on all of them.
+-- Every board shows the human's side at the bottom. A click on a piece of the human's picks it up and shows its legal
+   moves, a click on one of them plays it; pawns reaching the last rank become queens.
+-- A game ends by checkmate, stalemate, the fifty-move rule, threefold repetition, bare kings, or a flag falling;
+   closing a board's window abandons it. The results go to the console and the score to the window titles.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "EnginePool.h"
+#include "Position.h"
+
+using namespace std;
+
+struct SimulGame
+{
+    Position position;
+    vector<uint64_t> history;               // keys of the game's positions, the current one last
+    Color human;                            // the human's side, shown at the bottom
+    int clock_ms[2];                        // time left of white and black when the current turn started
+    chrono::steady_clock::time_point turn_start;
+    bool thinking;                          // the engine's job is in the pool
+    int selected;                           // square of the piece the human picked up, -1 if none
+    Move last_move;                         // highlighted, MOVE_NONE before the first move
+    string result;                          // "1-0 checkmate" and the like once over, empty while playing
+    int view;                               // window showing the game
+    int cell;                               // its cell in that window, row by row
+};
+
+// A window and the games laid out in it
+struct SimulView
+{
+    unique_ptr<sf::RenderWindow> window;
+    vector<int> games;
+    int columns;                            // cells per row
+};
+
+class Simul
+{
+private:
+    EnginePool& m_pool;
+    vector<SimulGame> m_games;
+    vector<SimulView> m_views;
+    int m_level;                            // difficulty level of the engine, see Difficulty.h
+    uint64_t m_seed;                        // seed of game 0's level picks, game i uses m_seed + i
+    int m_increment_ms;                     // added to a side's clock after each of its moves
+    unsigned int m_square;                  // square size in pixels; a cell is 8 squares wide and 9 high
+    sf::Texture m_textures[16];             // piece images by piece code
+    sf::Sprite m_pieces[16];
+    sf::Font m_font;
+    sf::RectangleShape m_square_shape;
+    sf::Text m_text;
+
+    // Time the side has left now, its clock running while it is to move
+    int time_left(const SimulGame& game, Color side) const;
+
+    // Set the result if the game is over, returns true if it is
+    bool check_over(SimulGame& game);
+
+    // Hand the game to the pool if the engine is to move
+    void start_turn(int index);
+
+    // Play a legal move of the side to move, stopping its clock and starting the other's
+    void play(int index, Move m);
+
+    // Apply the engine moves the pool has finished
+    void apply_replies();
+
+    // End the games whose side to move has run out of time
+    void check_flags();
+
+    // Handle a click at pixel x, y of a window
+    void click(int view, int x, int y);
+
+    // Draw every game of a window
+    void draw(SimulView& view);
+
+    // "Simul: engine +w =d -l" with the finished games so far
+    string score() const;
+
+public:
+    // Lay out the games and open the windows; human is the human's side on board 0, alternating if alternate is set
+    Simul(EnginePool& pool, int boards, bool grid, Color human, bool alternate, int minutes, int increment_seconds,
+          int level, uint64_t seed);
+
+    // Play until every window is closed, then print the results
+    void run();
+};
+
+// Command line entry point: ChessAI simul [-boards n] [-layout grid|windows] [-human white|black|alternate] ...
+int simul_command(int argc, char* argv[]);
@@ -1,5 +1,6 @@
 
 #include "Square.h"
+#include "Trace.h"
 
 
 /*
@@ -120,6 +121,7 @@ void Square::create_sprite()
 */
 void Square::create_id()
 {
+    TRACE_SCOPE("load", "font");
     // create square ID
     m_font = new sf::Font();
     if (!m_font->loadFromFile("Arial Unicode.ttf"))
@@ -0,0 +1,147 @@
+#include "Trace.h"
+
+#ifdef CHESS_TRACE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent
+{
+    const char* category;
+    const char* name;
+    uint64_t start;                         // nanoseconds since the program started
+    uint64_t duration;
+};
+
+struct TraceBuffer
+{
+    unique_ptr<TraceEvent[]> events;        // TRACE_BUFFER_EVENTS of them, a ring
+    uint64_t recorded;                      // events recorded so far, the next goes to recorded % TRACE_BUFFER_EVENTS
+    int thread;                             // track number in the timeline
+    const char* name;                       // track name, nullptr for a numbered one
+};
+
+// Owns the buffers of all threads, so that the events of finished threads are written too
+struct TraceRegistry
+{
+    mutex lock;
+    vector<unique_ptr<TraceBuffer>> buffers;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ~TraceRegistry()
+    {
+        const char* filename = getenv("CHESS_TRACE_FILE");
+        trace_write(filename ? filename : "chess_trace.json");
+    }
+};
+
+static TraceRegistry registry;
+static thread_local TraceBuffer* current_buffer = nullptr;
+
+
+/*
+* NAME
+*      TraceBuffer -- returns the calling thread's trace buffer
+*
+* SYNOPSYS
+*
+*      TraceBuffer* trace_buffer();
+*
+* DESCRIPTION
+*
+*  The first call of a thread allocates its ring and registers it; later calls only read a thread-local pointer.
+*/
+TraceBuffer* trace_buffer()
+{
+    if (current_buffer)
+        return current_buffer;
+    unique_ptr<TraceBuffer> buffer(new TraceBuffer());
+    buffer->events.reset(new TraceEvent[TRACE_BUFFER_EVENTS]);
+    buffer->recorded = 0;
+    buffer->name = nullptr;
+    lock_guard<mutex> guard(registry.lock);
+    buffer->thread = (int)registry.buffers.size() + 1;
+    current_buffer = buffer.get();
+    registry.buffers.push_back(move(buffer));
+    return current_buffer;
+}
+
+
+uint64_t trace_now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - registry.start).count();
+}
+
+
+void trace_record(TraceBuffer* buffer, const char* category, const char* name, uint64_t start, uint64_t end)
+{
+    TraceEvent& event = buffer->events[buffer->recorded++ % TRACE_BUFFER_EVENTS];
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+}
+
+
+void trace_thread_name(const char* name)
+{
+    trace_buffer()->name = name;
+}
+
+
+/*
+* NAME
+*      TraceWrite -- writes the recorded events as Chrome trace JSON
+*
+* SYNOPSYS
+*
+*      bool trace_write(const string& filename);
+*
+* DESCRIPTION
+*
+*  Every thread becomes a track named by its thread_name metadata event, its surviving events following
+ *  oldest first as complete ("X") events with microsecond times. Threads still recording may tear the events
+ *  being written, so this runs at exit, after the worker threads have been joined.
+*/
+bool trace_write(const string& filename)
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (!file)
+    {
+        cout << "Could not write " << filename << endl;
+        return false;
+    }
+    lock_guard<mutex> guard(registry.lock);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const unique_ptr<TraceBuffer>& buffer : registry.buffers)
+    {
+        uint64_t kept = std::min<uint64_t>(buffer->recorded, TRACE_BUFFER_EVENTS);
+        string name = buffer->name ? buffer->name : "thread " + to_string(buffer->thread);
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\",\"dropped\":%llu}}",
+                first ? "" : ",\n", buffer->thread, name.c_str(), (unsigned long long)(buffer->recorded - kept));
+        first = false;
+        for (uint64_t i = buffer->recorded - kept; i < buffer->recorded; i++)
+        {
+            const TraceEvent& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event.name, event.category, buffer->thread, event.start / 1000.0, event.duration / 1000.0);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    bool written = !ferror(file);
+    if (fclose(file) != 0 || !written)
+    {
+        cout << "Could not write " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
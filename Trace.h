@@ -0,0 +1,74 @@
+/*
+Trace functions and TraceScope class
+-- A timeline of scoped events in the Chrome trace event format, to open in chrome://tracing or ui.perfetto.dev:
+   GUI frames, windows, search iterations and resource loading, and at level 2 every move generation and evaluation.
+-- Compiled in with -DCHESS_TRACE (level 1) or -DCHESS_TRACE=2 only. Otherwise the macros expand to nothing.
+-- Every thread records into its own ring buffer of TRACE_BUFFER_EVENTS events, allocated when it records its first
+   event. Recording takes no lock and allocates nothing; when a buffer wraps, the oldest events are overwritten.
+-- The buffers are written when the program exits, to the file named by the CHESS_TRACE_FILE environment variable,
+   chess_trace.json by default. Event names and categories must be string literals.
+*/
+
+
+#pragma once
+
+#ifdef CHESS_TRACE
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS (1 << 20)
+#endif
+
+struct TraceBuffer;
+
+// The calling thread's buffer, registered on its first call
+TraceBuffer* trace_buffer();
+
+// Nanoseconds since the program started
+uint64_t trace_now();
+
+// Add a complete event to the buffer
+void trace_record(TraceBuffer* buffer, const char* category, const char* name, uint64_t start, uint64_t end);
+
+// Name the calling thread's track in the timeline
+void trace_thread_name(const char* name);
+
+// Write every thread's events, returns false if the file cannot be written
+bool trace_write(const string& filename);
+
+// Records an event lasting from its construction to the end of its scope
+class TraceScope
+{
+private:
+    TraceBuffer* m_buffer;
+    const char* m_category;
+    const char* m_name;
+    uint64_t m_start;
+
+public:
+    TraceScope(const char* category, const char* name)
+        : m_buffer(trace_buffer()), m_category(category), m_name(name), m_start(trace_now()) {}
+    ~TraceScope() { trace_record(m_buffer, m_category, m_name, m_start, trace_now()); }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define TRACE_THREAD(name) trace_thread_name(name)
+#if CHESS_TRACE >= 2
+#define TRACE_SCOPE_FINE(category, name) TRACE_SCOPE(category, name)
+#else
+#define TRACE_SCOPE_FINE(category, name)
+#endif
+
+#else
+
+#define TRACE_SCOPE(category, name)
+#define TRACE_SCOPE_FINE(category, name)
+#define TRACE_THREAD(name)
+
+#endif
@@ -0,0 +1,144 @@
+#include "TranspositionTable.h"
+#include <cstring>
+
+static_assert(sizeof(TTEntry) == sizeof(uint64_t), "TTEntry should fill the 8 data bytes of a slot");
+
+static uint64_t pack_entry(const TTEntry& entry)
+{
+    uint64_t data;
+    memcpy(&data, &entry, sizeof(data));
+    return data;
+}
+
+static TTEntry unpack_entry(uint64_t data)
+{
+    TTEntry entry;
+    memcpy(&entry, &data, sizeof(entry));
+    return entry;
+}
+
+
+/*
+* NAME
+*      TranspositionTable -- creates an empty transposition table
+*
+* SYNOPSYS
+*
+*      TranspositionTable::TranspositionTable(size_t kilobytes);
+*      kilobytes   ->  memory used by the table
+*/
+TranspositionTable::TranspositionTable(size_t kilobytes)
+{
+    m_size = 0;
+    resize(kilobytes);
+}
+
+
+/*
+* NAME
+*      Resize -- changes the memory used by the table
+*
+* SYNOPSYS
+*
+*      void TranspositionTable::resize(size_t kilobytes);
+*      kilobytes   ->  memory used by the table
+*/
+void TranspositionTable::resize(size_t kilobytes)
+{
+    size_t slots = 1;
+    while (slots * 2 * sizeof(TTSlot) <= kilobytes * 1024)
+        slots *= 2;
+    if (slots != m_size)
+    {
+        m_slots.reset(new TTSlot[slots]);
+        m_size = slots;
+    }
+    clear();
+}
+
+
+/*
+* NAME
+*      Clear -- forgets every entry
+*
+* SYNOPSYS
+*
+*      void TranspositionTable::clear();
+*/
+void TranspositionTable::clear()
+{
+    for (size_t i = 0; i < m_size; i++)
+    {
+        m_slots[i].check.store(0, memory_order_relaxed);
+        m_slots[i].data.store(0, memory_order_relaxed);
+    }
+    m_generation.store(0, memory_order_relaxed);
+}
+
+
+/*
+* NAME
+*      Probe -- looks up a position
+*
+* SYNOPSYS
+*
+*      bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const;
+*      key         ->  Zobrist key of the position
+*      entry       ->  receives a copy of the entry on a hit
+*
+* DESCRIPTION
+*
+*  Returns true if the slot of the key holds a result for that same key. A slot another thread is writing
+ *  holds one thread's check with the other's data, and fails the comparison with the key.
+*/
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const
+{
+    const TTSlot& slot = m_slots[key & (m_size - 1)];
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    uint64_t check = slot.check.load(memory_order_relaxed);
+    if ((check ^ data) != key)
+        return false;
+    entry = unpack_entry(data);
+    return entry.bound != BOUND_NONE;
+}
+
+
+/*
+* NAME
+*      Store -- remembers the result of a position's search
+*
+* SYNOPSYS
+*
+*      void TranspositionTable::store(uint64_t key, Move move, int depth, int score, Bound bound);
+*      key         ->  Zobrist key of the position
+*      move        ->  best move found, or MOVE_NONE
+*      depth       ->  plies searched below the position
+*      score       ->  the utility found, must fit 16 bits
+*      bound       ->  BOUND_EXACT, or the side from which score bounds the utility
+*
+* DESCRIPTION
+*
+*  A result of the same position always replaces the old one, keeping the old move if the new search found none.
+ *  Another position's result is replaced if it came from an earlier search or was searched no deeper.
+*/
+void TranspositionTable::store(uint64_t key, Move move, int depth, int score, Bound bound)
+{
+    TTSlot& slot = m_slots[key & (m_size - 1)];
+    uint64_t old_data = slot.data.load(memory_order_relaxed);
+    bool same = (slot.check.load(memory_order_relaxed) ^ old_data) == key;
+    TTEntry old = unpack_entry(old_data);
+    uint8_t generation = m_generation.load(memory_order_relaxed);
+    if (!same && old.bound != BOUND_NONE && old.generation == generation && old.depth > depth)
+        return;
+
+    TTEntry entry;
+    entry.move = (same && move == MOVE_NONE) ? old.move : move;
+    entry.score = (int16_t)score;
+    entry.depth = (uint8_t)depth;
+    entry.bound = bound;
+    entry.generation = generation;
+    entry.padding = 0;
+    uint64_t data = pack_entry(entry);
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(key ^ data, memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+/*
+TranspositionTable class
+-- Remembers, by Zobrist key, the result of every position the search has finished:
+   its best move, the depth searched, the score and whether the score is exact or only a bound.
+-- The best move is searched first when the position comes back, the score ends the search of the position
+   if it was searched at least as deep and the bound settles it.
+-- Direct-mapped; a slot keeps the deeper of two results unless it was stored by an earlier search.
+-- Safe to share between searches on several threads without locks: a slot holds the entry and the key xor the entry,
+   each written atomically, so a slot torn by two threads writing at once fails the key check and reads as a miss.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "Position.h"
+
+using namespace std;
+
+// Size of a table in kilobytes unless given
+const size_t DEFAULT_TABLE_KILOBYTES = 8192;
+
+// What a stored score says about the position's true utility
+enum Bound : uint8_t { BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+struct TTEntry
+{
+    Move move;                              // best move found, MOVE_NONE if unknown
+    int16_t score;                          // utility, white's point of view, mates counted from this position
+    uint8_t depth;                          // plies searched below the position
+    uint8_t bound;                          // Bound of the score, BOUND_NONE for an empty slot
+    uint8_t generation;                     // search that stored the entry
+    uint8_t padding;
+};
+
+struct TTSlot
+{
+    atomic<uint64_t> check;                 // Zobrist key xor data
+    atomic<uint64_t> data;                  // the TTEntry's bytes
+};
+
+class TranspositionTable
+{
+private:
+    unique_ptr<TTSlot[]> m_slots;           // power of two slots, indexed by the low bits of the key
+    size_t m_size;
+    atomic<uint8_t> m_generation;           // counts searches, older entries are replaced first
+
+public:
+    // Table of the given size in kilobytes, rounded down to a power of two entries
+    TranspositionTable(size_t kilobytes = DEFAULT_TABLE_KILOBYTES);
+
+    // Change the size, which forgets every entry; no search may be using the table
+    void resize(size_t kilobytes);
+
+    // Look up a position, returns false on a miss
+    bool probe(uint64_t key, TTEntry& entry) const;
+
+    // Remember the result of a position's search
+    void store(uint64_t key, Move move, int depth, int score, Bound bound);
+
+    // Start a new search: entries of the earlier ones can still be used, but give way to new results
+    void new_search() { m_generation.fetch_add(1, memory_order_relaxed); }
+
+    // Forget every entry; no search may be using the table
+    void clear();
+
+    size_t size() const { return m_size; }
+};
@@ -0,0 +1,379 @@
+#include "Tuner.h"
+#include "EvalWeights.h"
+#include "PackedPosition.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Positions handled together by the vectorized loops
+static const size_t tuner_block = 256;
+
+static const double ln10_over_400 = 2.302585092994046 / 400.0;
+
+
+/*
+* NAME
+*      Tuner -- creates an empty tuner
+*
+* SYNOPSYS
+*
+*      Tuner::Tuner(int threads);
+*      threads     ->  threads used for loading and gradients, one per core if zero
+*/
+Tuner::Tuner(int threads)
+{
+    m_threads = (threads > 0) ? threads : std::max(1u, thread::hardware_concurrency());
+    m_k = 1.0;
+    for (int param = 0; param < EVAL_PARAMS; param++)
+        m_weights[param] = eval_weights[param];
+}
+
+
+/*
+* NAME
+*      Load -- loads labeled positions
+*
+* SYNOPSYS
+*
+*      bool Tuner::load(const string& filename, size_t max_positions);
+*      filename        ->  packed record file, see PackedPosition.h
+*      max_positions   ->  load at most this many records, all if zero
+*
+* DESCRIPTION
+*
+*  This function maps the file and traces the evaluation of every record on all threads,
+ *  each thread taking a contiguous shard. Records without a game result and corrupt records
+ *  are dropped afterwards.
+*/
+bool Tuner::load(const string& filename, size_t max_positions)
+{
+    PackedReader reader(filename);
+    if (!reader.is_open())
+        return false;
+    size_t count = reader.size();
+    if (max_positions && max_positions < count)
+        count = max_positions;
+
+    for (auto& feature : m_features)
+        feature.assign(count, 0);
+    m_results.assign(count, -1);
+
+    atomic<size_t> corrupt(0);
+    auto load_shard = [&](size_t begin, size_t end) {
+        Position position;
+        EvalTrace trace;
+        for (size_t i = begin; i < end; i++)
+        {
+            const PackedPosition& record = reader.record(i);
+            if (record.result == RESULT_NONE)
+                continue;
+            if (!unpack_position(record, position))
+            {
+                corrupt++;
+                continue;
+            }
+            evaluate(position, &trace);
+            for (int param = 0; param < EVAL_PARAMS; param++)
+                m_features[param][i] = (float)trace.counts[param];
+            m_results[i] = (record.result + 1) / 2.0f;
+        }
+    };
+    vector<thread> workers;
+    size_t shard = (count + m_threads - 1) / m_threads;
+    for (size_t begin = 0; begin < count; begin += shard)
+        workers.emplace_back(load_shard, begin, std::min(begin + shard, count));
+    for (auto& worker : workers)
+        worker.join();
+    if (corrupt)
+        cout << corrupt << " corrupt records in " << filename << " skipped" << endl;
+
+    // drop unusable records
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (m_results[i] < 0)
+            continue;
+        for (auto& feature : m_features)
+            feature[kept] = feature[i];
+        m_results[kept++] = m_results[i];
+    }
+    for (auto& feature : m_features)
+        feature.resize(kept);
+    m_results.resize(kept);
+
+    cout << kept << " labeled positions loaded from " << filename << endl;
+    return kept > 0;
+}
+
+
+/*
+* NAME
+*      ShardError -- error and gradient over a range of positions
+*
+* SYNOPSYS
+*
+*      double Tuner::shard_error(size_t begin, size_t end, const double* weights, double k, double* gradient) const;
+*
+* DESCRIPTION
+*
+*  Works through the range in blocks of tuner_block positions. The evaluation of a block is built one parameter
+ *  at a time, so every loop runs over consecutive floats. Returns the summed squared error and adds
+ *  the summed d error / d weight to gradient, both still to be divided by the number of positions.
+*/
+double Tuner::shard_error(size_t begin, size_t end, const double* weights, double k, double* gradient) const
+{
+    float evaluation[tuner_block];
+    float slope[tuner_block];
+    float scale = (float)(k * ln10_over_400);
+    double total = 0;
+
+    for (size_t block = begin; block < end; block += tuner_block)
+    {
+        size_t n = std::min(tuner_block, end - block);
+        const float* results = m_results.data() + block;
+
+        for (size_t j = 0; j < n; j++)
+            evaluation[j] = 0;
+        for (int param = 0; param < EVAL_PARAMS; param++)
+        {
+            float weight = (float)weights[param];
+            const float* feature = m_features[param].data() + block;
+            for (size_t j = 0; j < n; j++)
+                evaluation[j] += weight * feature[j];
+        }
+
+        float block_error = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            float sigmoid = 1.0f / (1.0f + expf(-scale * evaluation[j]));
+            float difference = results[j] - sigmoid;
+            block_error += difference * difference;
+            // d (r - s)^2 / d eval = -2 (r - s) s (1 - s) scale
+            slope[j] = -2.0f * difference * sigmoid * (1.0f - sigmoid) * scale;
+        }
+        total += block_error;
+
+        if (!gradient)
+            continue;
+        for (int param = 0; param < EVAL_PARAMS; param++)
+        {
+            const float* feature = m_features[param].data() + block;
+            float sum = 0;
+            for (size_t j = 0; j < n; j++)
+                sum += slope[j] * feature[j];
+            gradient[param] += sum;
+        }
+    }
+    return total;
+}
+
+
+/*
+* NAME
+*      Error -- mean squared error over all positions
+*
+* SYNOPSYS
+*
+*      double Tuner::error(const double* weights, double k, double* gradient) const;
+*
+* DESCRIPTION
+*
+*  This function splits the positions into one shard per thread, sums the shard errors and gradients,
+ *  and divides by the number of positions.
+*/
+double Tuner::error(const double* weights, double k, double* gradient) const
+{
+    size_t count = m_results.size();
+    int shards = (int)std::min<size_t>(m_threads, std::max<size_t>(1, count / tuner_block));
+    vector<double> errors(shards, 0);
+    vector<vector<double>> gradients(shards, vector<double>(EVAL_PARAMS, 0));
+
+    vector<thread> workers;
+    size_t shard = (count + shards - 1) / shards;
+    for (int i = 0; i < shards; i++)
+    {
+        size_t begin = std::min(i * shard, count), end = std::min(begin + shard, count);
+        workers.emplace_back([&, i, begin, end]() {
+            errors[i] = shard_error(begin, end, weights, k, gradient ? gradients[i].data() : nullptr);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    double total = 0;
+    if (gradient)
+        std::fill(gradient, gradient + EVAL_PARAMS, 0.0);
+    for (int i = 0; i < shards; i++)
+    {
+        total += errors[i];
+        for (int param = 0; gradient && param < EVAL_PARAMS; param++)
+            gradient[param] += gradients[i][param] / count;
+    }
+    return total / count;
+}
+
+
+/*
+* NAME
+*      FindK -- fits the sigmoid scale
+*
+* SYNOPSYS
+*
+*      double Tuner::find_k();
+*
+* DESCRIPTION
+*
+*  With the weights fixed, finds the K minimizing the error by a ternary search over (0, 10].
+*/
+double Tuner::find_k()
+{
+    double low = 0.01, high = 10;
+    for (int i = 0; i < 40; i++)
+    {
+        double a = low + (high - low) / 3, b = high - (high - low) / 3;
+        if (error(m_weights, a, nullptr) < error(m_weights, b, nullptr))
+            high = b;
+        else
+            low = a;
+    }
+    m_k = (low + high) / 2;
+    cout << "K = " << m_k << ", error " << error(m_weights, m_k, nullptr) << endl;
+    return m_k;
+}
+
+
+/*
+* NAME
+*      Tune -- fits the weights
+*
+* SYNOPSYS
+*
+*      void Tuner::tune(int iterations, double learning_rate);
+*      iterations      ->  number of full gradient steps
+*      learning_rate   ->  Adam step size in centipawns
+*
+* DESCRIPTION
+*
+*  This function runs Adam on the mean squared error with K fixed, reporting every 100 iterations.
+*/
+void Tuner::tune(int iterations, double learning_rate)
+{
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    double gradient[EVAL_PARAMS], moment[EVAL_PARAMS] = {}, velocity[EVAL_PARAMS] = {};
+
+    for (int iteration = 1; iteration <= iterations; iteration++)
+    {
+        double current = error(m_weights, m_k, gradient);
+        for (int param = 0; param < EVAL_PARAMS; param++)
+        {
+            moment[param] = beta1 * moment[param] + (1 - beta1) * gradient[param];
+            velocity[param] = beta2 * velocity[param] + (1 - beta2) * gradient[param] * gradient[param];
+            double corrected_moment = moment[param] / (1 - pow(beta1, iteration));
+            double corrected_velocity = velocity[param] / (1 - pow(beta2, iteration));
+            m_weights[param] -= learning_rate * corrected_moment / (sqrt(corrected_velocity) + epsilon);
+        }
+        if (iteration % 100 == 0 || iteration == iterations)
+            cout << "iteration " << iteration << ", error " << setprecision(8) << current << endl;
+    }
+}
+
+
+/*
+* NAME
+*      WriteHeader -- writes the weights as EvalWeights.h
+*
+* SYNOPSYS
+*
+*      bool Tuner::write_header(const string& filename) const;
+*
+* DESCRIPTION
+*
+*  This function writes the rounded weights, one per line with the parameter's name,
+ *  together with the number of positions, K and the final error.
+*/
+bool Tuner::write_header(const string& filename) const
+{
+    ofstream out(filename);
+    if (!out)
+    {
+        cout << "Could not open " << filename << " for writing" << endl;
+        return false;
+    }
+    out << "// Evaluation weights in centipawns, indexed by EvalParam (see Evaluation.h).\n"
+        << "// Generated by \"ChessAI tune\" -- rerun the tuner rather than editing by hand.\n"
+        << "// Fitted on " << m_results.size() << " positions, K = " << m_k
+        << ", error " << error(m_weights, m_k, nullptr) << ".\n\n"
+        << "#pragma once\n\n"
+        << "static const int eval_weights[] = {\n";
+    for (int param = 0; param < EVAL_PARAMS; param++)
+    {
+        string value = to_string((int)lround(m_weights[param])) + ",";
+        out << "    " << left << setw(8) << value << "// " << eval_param_names[param] << "\n";
+    }
+    out << "};\n";
+    cout << "Weights written to " << filename << endl;
+    return true;
+}
+
+
+/*
+* NAME
+*      TuneCommand -- command line entry point of the tuner
+*
+* SYNOPSYS
+*
+*      int tune_command(int argc, char* argv[]);
+*      argv        ->  the positions file followed by options
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -iterations <n>     Adam iterations, default 2000
+ *     -rate <r>           learning rate in centipawns, default 1
+ *     -threads <n>        default one per core
+ *     -max <n>            load at most n positions
+ *     -out <file>         header to write, default EvalWeights.h
+*/
+int tune_command(int argc, char* argv[])
+{
+    if (argc < 1 || argc % 2 == 0)
+    {
+        cout << "usage: ChessAI tune <positions.bin> [-iterations n] [-rate r] [-threads n] [-max n] [-out file]" << endl;
+        return 1;
+    }
+    int iterations = 2000, threads = 0;
+    double rate = 1.0;
+    size_t max_positions = 0;
+    string output = "EvalWeights.h";
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string option = argv[i], value = argv[i + 1];
+        if (option == "-iterations")
+            iterations = atoi(value.c_str());
+        else if (option == "-rate")
+            rate = atof(value.c_str());
+        else if (option == "-threads")
+            threads = atoi(value.c_str());
+        else if (option == "-max")
+            max_positions = strtoull(value.c_str(), nullptr, 10);
+        else if (option == "-out")
+            output = value;
+        else
+        {
+            cout << "Bad option " << option << endl;
+            return 1;
+        }
+    }
+
+    Tuner tuner(threads);
+    if (!tuner.load(argv[0], max_positions))
+        return 1;
+    tuner.find_k();
+    tuner.tune(iterations, rate);
+    return tuner.write_header(output) ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+/*
+Tuner class
+-- Texel tuning of the handcrafted evaluation weights.
+-- Loads labeled positions (packed records carrying a game result) and records their evaluation features once.
+-- Minimizes the mean squared error between the game results and sigmoid(K * evaluation) with Adam.
+-- Error and gradient are computed on all cores, each thread taking a shard of the positions;
+   features are stored one array per parameter so the inner loops vectorize.
+-- Writes the fitted weights as a new EvalWeights.h.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Evaluation.h"
+
+using namespace std;
+
+class Tuner
+{
+private:
+    vector<float> m_features[EVAL_PARAMS];  // feature counts of every position, one array per parameter
+    vector<float> m_results;                // game results from white's view: 1, 0.5, 0
+    int m_threads;                          // threads used for loading and gradients
+    double m_k;                             // sigmoid scale
+    double m_weights[EVAL_PARAMS];          // current weights, start from EvalWeights.h
+
+    // Error of the positions [begin, end), adds the error gradient to gradient if it is not nullptr
+    double shard_error(size_t begin, size_t end, const double* weights, double k, double* gradient) const;
+
+    // Mean squared error over all positions, computed in parallel, fills gradient if it is not nullptr
+    double error(const double* weights, double k, double* gradient) const;
+
+public:
+    Tuner(int threads);
+
+    // Load labeled positions from a packed record file, returns false if none could be loaded
+    bool load(const string& filename, size_t max_positions);
+    size_t size() const { return m_results.size(); }
+
+    // Fit the sigmoid scale to the current weights
+    double find_k();
+
+    // Run Adam for the number of iterations, printing the error as it goes
+    void tune(int iterations, double learning_rate);
+
+    // Write the weights as a C++ header in the format of EvalWeights.h
+    bool write_header(const string& filename) const;
+};
+
+// Command line entry point: ChessAI tune <positions.bin> [options]
+int tune_command(int argc, char* argv[]);
@@ -0,0 +1,462 @@
+#include "Board.h"
+#include "PackedPosition.h"
+#include "SelfPlay.h"
+#include "DataGen.h"
+#include "Tuner.h"
+#include "Notation.h"
+#include "Server.h"
+#include "Book.h"
+#include "PositionIndex.h"
+#include "MateSolver.h"
+#include "Mcts.h"
+#include "Difficulty.h"
+#include "Trace.h"
+#include "Cpu.h"
+#include "Microbench.h"
+#include "Simul.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+/*
+* NAME
+*      ResultName -- returns the PGN name of a game result
+*
+* SYNOPSYS
+*
+*      string result_name(int8_t result);
+*
+* DESCRIPTION
+*
+*  This function returns 1-0, 0-1, 1/2-1/2, or - if there is no result.
+*/
+static string result_name(int8_t result)
+{
+    if (result == 1)
+        return "1-0";
+    if (result == -1)
+        return "0-1";
+    if (result == 0)
+        return "1/2-1/2";
+    return "-";
+}
+
+
+/*
+* NAME
+*      FenToBinary -- converts a text file of FENs into packed records
+*
+* SYNOPSYS
+*
+*      int fen_to_binary(const string& input, const string& output);
+*
+* DESCRIPTION
+*
+*  Every line holds a FEN, optionally followed by "; score result" where the score is from white's view
+ *  and the result is 1-0, 0-1 or 1/2-1/2. Malformed lines are reported and skipped.
+*/
+static int fen_to_binary(const string& input, const string& output)
+{
+    ifstream in(input);
+    if (!in)
+    {
+        cout << "Could not open " << input << endl;
+        return 1;
+    }
+    PackedWriter writer(output);
+    if (!writer.is_open())
+        return 1;
+
+    string line;
+    size_t line_number = 0;
+    while (getline(in, line))
+    {
+        line_number++;
+        if (line.empty())
+            continue;
+        string fen = line.substr(0, line.find(';'));
+        int16_t score = SCORE_NONE;
+        int8_t result = RESULT_NONE;
+        if (line.find(';') != string::npos)
+        {
+            istringstream extra(line.substr(line.find(';') + 1));
+            string score_token, result_token;
+            extra >> score_token >> result_token;
+            if (!score_token.empty() && score_token != "-")
+                score = (int16_t)strtol(score_token.c_str(), nullptr, 10);
+            if (result_token == "1-0")
+                result = 1;
+            else if (result_token == "0-1")
+                result = -1;
+            else if (result_token == "1/2-1/2")
+                result = 0;
+        }
+        PackedPosition record;
+        if (!packed_from_fen(fen, record, score, result))
+        {
+            cout << input << ":" << line_number << ": bad FEN" << endl;
+            continue;
+        }
+        writer.write(record);
+    }
+    cout << writer.count() << " positions written to " << output << endl;
+    return 0;
+}
+
+
+/*
+* NAME
+*      BinaryToFen -- prints the records of a packed file as FENs
+*
+* SYNOPSYS
+*
+*      int binary_to_fen(const string& input);
+*
+* DESCRIPTION
+*
+*  This function prints one line per record in the format fen_to_binary reads.
+*/
+static int binary_to_fen(const string& input)
+{
+    PackedReader reader(input);
+    if (!reader.is_open())
+        return 1;
+    for (auto it = reader.begin(); it != reader.end(); ++it)
+    {
+        cout << it->get_fen();
+        if (it.score() != SCORE_NONE || it.result() != RESULT_NONE)
+            cout << " ; " << (it.score() == SCORE_NONE ? string("-") : to_string(it.score())) << " " << result_name(it.result());
+        cout << "\n";
+    }
+    return 0;
+}
+
+
+/*
+* NAME
+*      AnalyzeCommand -- prints the best lines of a position
+*
+* SYNOPSYS
+*
+*      int analyze_command(int argc, char* argv[]);
+*      argv        ->  the FEN, then options with their values
+*
+* DESCRIPTION
+*
+*  Options:
+ *     -depth <n>          search n plies deep, 4 by default unless a node or time limit is given
+ *     -nodes <n>          stop after n nodes
+ *     -movetime <ms>      stop after ms milliseconds
+ *     -multipv <k>        report the k best moves, 1 by default
+ *     -nnue <file>        evaluate with the network
+ *     -hashfile <file>    keep deep results in a persistent hash file, created if missing
+ *     -hashsize <mb>      size of the slots of a new hash file, 32 MB by default
+ *     -engine <name>      alphabeta, the default, or mcts, whose -nodes count playouts
+ *     -threads <n>        threads of the mcts engine, 1 by default
+ *     -level <n>          search with the node budget and lines of the difficulty level, see Difficulty.h
+ *     -seed <n>           seed of the level's pick, 0 by default
+ *  Prints one line per move: its rank, score, depth and line in SAN, then the level's pick if a level is given.
+*/
+static int analyze_command(int argc, char* argv[])
+{
+    Position position;
+    if (argc < 1 || !position.set_fen(argv[0]))
+    {
+        cout << "Bad FEN " << (argc < 1 ? "" : argv[0]) << endl;
+        return 1;
+    }
+    SearchLimits limits;
+    limits.depth = 0;
+    string network_filename, hash_filename;
+    EngineKind engine = ENGINE_ALPHABETA;
+    int threads = 1, level = 0;
+    size_t hash_file_mb = DEFAULT_HASH_FILE_MEGABYTES;
+    uint64_t seed = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string option = argv[i], value = argv[i + 1];
+        if (option == "-depth")
+            limits.depth = atoi(value.c_str());
+        else if (option == "-nodes")
+            limits.nodes = strtoull(value.c_str(), nullptr, 10);
+        else if (option == "-movetime")
+            limits.movetime_ms = atoi(value.c_str());
+        else if (option == "-multipv")
+            limits.multi_pv = atoi(value.c_str());
+        else if (option == "-nnue")
+            network_filename = value;
+        else if (option == "-hashfile")
+            hash_filename = value;
+        else if (option == "-hashsize")
+            hash_file_mb = std::max(1, atoi(value.c_str()));
+        else if (option == "-engine" && (value == "alphabeta" || value == "mcts"))
+            engine = (value == "mcts") ? ENGINE_MCTS : ENGINE_ALPHABETA;
+        else if (option == "-threads")
+            threads = atoi(value.c_str());
+        else if (option == "-level" && atoi(value.c_str()) >= 1 && atoi(value.c_str()) <= DIFFICULTY_LEVELS)
+            level = atoi(value.c_str());
+        else if (option == "-seed")
+            seed = strtoull(value.c_str(), nullptr, 10);
+        else
+        {
+            cout << "Bad option " << option << " " << value << endl;
+            return 1;
+        }
+    }
+    if (level)
+        limits = level_limits(level);
+    if (!limits.depth && !limits.nodes && !limits.movetime_ms)
+        limits.depth = SearchLimits().depth;
+
+    Search search;
+    Mcts mcts;
+    Network network;
+    if (!network_filename.empty())
+    {
+        if (!network.load(network_filename))
+            return 1;
+        search.set_evaluation(EVAL_NNUE, &network);
+        mcts.set_evaluation(EVAL_NNUE, &network);
+    }
+    mcts.set_threads(threads);
+    HashFile hash_file;
+    if (!hash_filename.empty())
+    {
+        if (!hash_file.open(hash_filename, hash_file_mb))
+            return 1;
+        search.set_hash_file(&hash_file);
+    }
+    SearchResult result = (engine == ENGINE_MCTS) ? mcts.search(position, limits) : search.smart_guy(position, limits);
+    for (size_t i = 0; i < result.lines.size(); i++)
+    {
+        const PvLine& line = result.lines[i];
+        cout << i + 1 << ". " << score_to_string(line.score) << " depth " << line.depth << "  "
+             << line_to_san(position, line.pv) << endl;
+    }
+    if (result.lines.empty())
+        cout << (position.in_check() ? "checkmate" : "stalemate") << endl;
+    else if (level && engine == ENGINE_ALPHABETA)
+        cout << "level " << level << " plays " << move_to_san(position, choose_level_move(result, position, level, seed)) << endl;
+    cout << result.nodes << (engine == ENGINE_MCTS ? " playouts, " : " nodes, ") << result.time_ms << " ms, "
+         << (result.time_ms ? result.nodes * 1000 / result.time_ms : 0) << " per second" << endl;
+    if (engine == ENGINE_ALPHABETA)
+    {
+        const EvalCache& cache = search.eval_cache();
+        const PawnTable& pawns = search.pawn_table();
+        uint64_t cache_probes = cache.hits() + cache.misses();
+        cout << fixed << setprecision(1) << "eval cache " << cache_probes << " probes, "
+             << (cache_probes ? 100.0 * cache.hits() / cache_probes : 0.0) << "% hits; pawn table " << pawns.probes()
+             << " probes, " << (pawns.probes() ? 100.0 * pawns.hits() / pawns.probes() : 0.0) << "% hits" << endl;
+    }
+    return 0;
+}
+
+
+/*
+* NAME
+*      Perft -- counts the leaves of the legal move tree
+*
+* SYNOPSYS
+*
+*      uint64_t perft(Position& position, int depth);
+*      position    ->  the position, made and unmade back to itself
+*      depth       ->  plies to go, at least 1
+*
+* DESCRIPTION
+*
+*  The last ply is counted from the move list without making its moves.
+*/
+static uint64_t perft(Position& position, int depth)
+{
+    MoveList moves;
+    position.get_all_valids(moves);
+    if (depth == 1)
+        return moves.size();
+    uint64_t nodes = 0;
+    for (Move m : moves)
+    {
+        Undo undo;
+        position.make_move(m, undo);
+        nodes += perft(position, depth - 1);
+        position.unmake_move(m, undo);
+    }
+    return nodes;
+}
+
+
+/*
+* NAME
+*      PerftCommand -- counts the move paths of a position, to check the move generator against known counts
+*
+* SYNOPSYS
+*
+*      int perft_command(int argc, char* argv[]);
+*      argv        ->  the FEN and the depth in plies
+*
+* DESCRIPTION
+*
+*  Prints every root move with the leaves below it, then the total, the time and the leaves per second.
+ *  Run it under every -cpu tier: the counts of the standard positions are checked by tests/perft.sh.
+*/
+static int perft_command(int argc, char* argv[])
+{
+    Position position;
+    if (argc != 2 || atoi(argv[1]) < 1)
+    {
+        cout << "usage: ChessAI perft <fen> <depth>" << endl;
+        return 1;
+    }
+    if (!position.set_fen(argv[0]))
+    {
+        cout << "Bad FEN " << argv[0] << endl;
+        return 1;
+    }
+    int depth = atoi(argv[1]);
+    auto start = chrono::steady_clock::now();
+    MoveList moves;
+    position.get_all_valids(moves);
+    uint64_t total = 0;
+    for (Move m : moves)
+    {
+        uint64_t nodes = 1;
+        if (depth > 1)
+        {
+            Undo undo;
+            position.make_move(m, undo);
+            nodes = perft(position, depth - 1);
+            position.unmake_move(m, undo);
+        }
+        cout << move_to_uci(m) << " " << nodes << endl;
+        total += nodes;
+    }
+    int time_ms = (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    cout << total << " nodes, " << time_ms << " ms, " << (time_ms ? total * 1000 / time_ms : 0) << " per second" << endl;
+    return 0;
+}
+
+
+/*
+* NAME
+*      Usage -- prints the command line usage
+*
+* SYNOPSYS
+*
+*      int usage();
+*/
+static int usage()
+{
+    cout << "usage: ChessAI [-cpu <tier>] <command>      force the kernels of generic, sse41, avx2 or bmi2, see Cpu.h" << endl
+         << "       ChessAI [-nnue <net.bin>] [-index <index.bin>] [-engine alphabeta|mcts] [-level 1-8] [-seed <n>]" << endl
+         << "                                              play against the engine" << endl
+         << "       ChessAI fen2bin <fens.txt> <out.bin>   pack FEN lines into 32 byte records" << endl
+         << "       ChessAI bin2fen <in.bin>               print packed records as FEN lines" << endl
+         << "       ChessAI selfplay [options]             play an engine match, see SelfPlay.cpp" << endl
+         << "       ChessAI datagen <out.bin> [options]    generate scored training positions, see DatagenCommand" << endl
+         << "       ChessAI nnue-init <out.bin>            write a material-only network" << endl
+         << "       ChessAI tune <positions.bin> [options] fit the evaluation weights, see Tuner.cpp" << endl
+         << "       ChessAI analyze <fen> [options]        print the best lines, see AnalyzeCommand" << endl
+         << "       ChessAI mate <fen> <moves> [options]   prove a forced mate, see MateCommand" << endl
+         << "       ChessAI perft <fen> <depth>            count the move paths, see PerftCommand" << endl
+         << "       ChessAI server [options]               serve analysis on a Unix socket, see Server.h" << endl
+         << "       ChessAI client <socket> [-repeat <n>]  send the request lines of stdin to a server" << endl
+         << "       ChessAI book build <games.pgn> <book.bin>  build an opening book, see BookCommand" << endl
+         << "       ChessAI book probe <book.bin> <fen>    print the book moves of a position" << endl
+         << "       ChessAI index build <games.pgn> <index.bin>  index games by position, see IndexCommand" << endl
+         << "       ChessAI index query <index.bin> <fen>  count and list the games reaching a position" << endl
+         << "       ChessAI cpu                            print the kernel tiers this CPU supports" << endl
+         << "       ChessAI microbench [options]           time the hot functions, see MicrobenchCommand" << endl
+         << "       ChessAI simul [options]                play many boards at once against the engine, see Simul.h" << endl;
+    return 1;
+}
+
+
+int main(int argc, char* argv[])
+{
+    TRACE_THREAD("main");
+    CpuTier tier = detect_cpu_tier();
+    if (argc >= 3 && string(argv[1]) == "-cpu")
+    {
+        if (!parse_cpu_tier(argv[2], tier))
+            return usage();
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
+    if (!set_cpu_tier(tier))
+        return 1;
+
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        Network network;
+        PositionIndex index;
+        Board board;
+        int level = DEFAULT_DIFFICULTY_LEVEL;
+        uint64_t seed = (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+        for (int i = 1; i < argc; i += 2)
+        {
+            string option = argv[i];
+            if (i + 1 == argc || (option != "-nnue" && option != "-index" && option != "-engine"
+                                  && option != "-level" && option != "-seed"))
+                return usage();
+            if (option == "-level")
+                level = atoi(argv[i + 1]);
+            else if (option == "-seed")
+                seed = strtoull(argv[i + 1], nullptr, 10);
+            else if (option == "-engine")
+                board.set_engine(string(argv[i + 1]) == "mcts" ? ENGINE_MCTS : ENGINE_ALPHABETA,
+                                 std::max(1, (int)thread::hardware_concurrency()));
+            else if (option == "-nnue")
+            {
+                if (!network.load(argv[i + 1]))
+                    return 1;
+                board.set_evaluation(EVAL_NNUE, &network);
+            }
+            else
+            {
+                if (!index.open(argv[i + 1]))
+                    return 1;
+                board.set_index(&index);
+            }
+        }
+        board.set_level(level, seed);
+        board.graphics();
+        return 0;
+    }
+
+    string command = argv[1];
+    if (command == "fen2bin" && argc == 4)
+        return fen_to_binary(argv[2], argv[3]);
+    if (command == "bin2fen" && argc == 3)
+        return binary_to_fen(argv[2]);
+    if (command == "selfplay")
+        return self_play_command(argc - 2, argv + 2);
+    if (command == "datagen")
+        return datagen_command(argc - 2, argv + 2);
+    if (command == "nnue-init" && argc == 3)
+        return write_material_network(argv[2]) ? 0 : 1;
+    if (command == "tune")
+        return tune_command(argc - 2, argv + 2);
+    if (command == "analyze")
+        return analyze_command(argc - 2, argv + 2);
+    if (command == "mate")
+        return mate_command(argc - 2, argv + 2);
+    if (command == "perft")
+        return perft_command(argc - 2, argv + 2);
+    if (command == "server")
+        return server_command(argc - 2, argv + 2);
+    if (command == "client")
+        return client_command(argc - 2, argv + 2);
+    if (command == "book")
+        return book_command(argc - 2, argv + 2);
+    if (command == "index")
+        return index_command(argc - 2, argv + 2);
+    if (command == "cpu" && argc == 2)
+        return cpu_command();
+    if (command == "microbench")
+        return microbench_command(argc - 2, argv + 2);
+    if (command == "simul")
+        return simul_command(argc - 2, argv + 2);
+    return usage();
+}
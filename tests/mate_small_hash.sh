@@ -0,0 +1,10 @@
+#!/bin/sh
+# A mate whose table does not fit in a small -hash is still found, with garbage collections along the way.
+# usage: tests/mate_small_hash.sh [path to ChessAI]
+CHESSAI=${1:-./ChessAI}
+
+REPLY=$("$CHESSAI" mate "8/8/8/8/8/3k4/8/3K2R1 w - - 0 1" 12 -hash 16 -nodes 40000000)
+
+echo "$REPLY" | grep -q "^mate in 12: " || { echo "FAIL: no mate in 12 with -hash 16"; echo "$REPLY"; exit 1; }
+echo "$REPLY" | grep -q " 0 collections" && { echo "FAIL: the table was never collected"; echo "$REPLY"; exit 1; }
+echo "PASS"
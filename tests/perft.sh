@@ -0,0 +1,31 @@
+#!/bin/sh
+# The move generator matches the published perft counts of the standard positions on every CPU tier the host
+# supports, since the tiers differ in popcount and sliding attacks.
+# usage: tests/perft.sh [path to ChessAI]
+CHESSAI=${1:-./ChessAI}
+
+TIERS=$("$CHESSAI" cpu | awk '$2 == "supported" { print $1 }')
+[ -n "$TIERS" ] || { echo "FAIL: no CPU tier supported"; exit 1; }
+
+FAILED=0
+check() # fen depth nodes
+{
+    for tier in $TIERS; do
+        NODES=$("$CHESSAI" -cpu $tier perft "$1" $2 | tail -n 1 | cut -d ' ' -f 1)
+        if [ "$NODES" != "$3" ]; then
+            echo "FAIL: $tier perft \"$1\" $2 gives $NODES instead of $3"
+            FAILED=1
+        fi
+    done
+}
+
+check "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" 5 4865609
+check "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1" 4 4085603
+check "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1" 5 674624
+check "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1" 4 422333
+check "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1" 4 422333
+check "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8" 4 2103487
+check "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" 4 3894594
+
+[ $FAILED = 0 ] && echo "PASS ($(echo $TIERS))"
+exit $FAILED
@@ -0,0 +1,22 @@
+#!/bin/sh
+# A request whose side not to move is in check is answered with an error and the server keeps serving.
+# usage: tests/server_bad_fen.sh [path to ChessAI]
+CHESSAI=${1:-./ChessAI}
+SOCKET=/tmp/chessai_test_$$.sock
+
+"$CHESSAI" server -socket "$SOCKET" -threads 1 -hash 1 > /dev/null &
+SERVER=$!
+trap 'kill $SERVER 2> /dev/null; rm -f "$SOCKET"' EXIT
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$SOCKET" ] && break
+    sleep 0.2
+done
+
+REPLY=$(printf '%s\n' "8/8/8/3k4/8/8/8/3QK3 w - - 0 1 ; depth=3" \
+                      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ; id=good depth=2" \
+        | "$CHESSAI" client "$SOCKET")
+
+echo "$REPLY" | grep -q "^1 error bad FEN" || { echo "FAIL: no error for the illegal FEN"; echo "$REPLY"; exit 1; }
+echo "$REPLY" | grep -q "^good done " || { echo "FAIL: no answer after the illegal FEN"; echo "$REPLY"; exit 1; }
+kill -0 $SERVER 2> /dev/null || { echo "FAIL: server died"; exit 1; }
+echo "PASS"